@@ -0,0 +1,563 @@
+//*****************************************************************************
+// chainemu.c
+//
+// Temperature and light chain emulator.
+//
+// Answers the commands the icedrifter and the chaintest sketch send to the
+// chain, so chain acquisition can be timed and its error paths exercised
+// without the chain hardware:
+//
+//   +1::chain\n     the temperature data, two big endian bytes a sensor in
+//                   1/128 degrees C.
+//   +1::light\n     the light data, clear, red, green and blue as two big
+//                   endian bytes each for every sensor.
+//   +1::measure\n   the temperature data followed by the light data.
+//   +1::debug=N\n   "\nDEBUG ON\n" or "\nDEBUG OFF\n".
+//
+// The emulator talks through a pty by default, printing the slave name, and
+// -L makes a symlink to it.  -d <device> uses a serial device, for a board
+// whose chain pins are wired to a USB serial adapter, and -d - uses stdin
+// and stdout as a stubbed stream.
+//
+// The chain model:
+//
+//   -c  temperature and light sensor counts, up to 160/64.  Default 16/6.
+//   -b  baud rate.  Each byte is sent 10 bit times after the one before.
+//   -u  milliseconds from power up until the chain answers.  Commands sent
+//       before then are lost, as they are on the hardware.
+//   -m  milliseconds the chain takes to measure before it answers.
+//   -D  percent chance each byte is dropped.
+//   -E  percent chance an extra byte is sent after each byte.
+//   -X  extra bytes sent at the end of every answer, for overruns.
+//   -Y  bytes left off the end of every answer, for timeouts.
+//
+// Power up is the first byte received after the other end has closed or
+// been quiet for -i seconds.  Faults are drawn from a generator seeded by
+// -S, so a run of the same commands sees the same faults every time.  A
+// CSV line is written to the -l log for each answer with the bytes sent,
+// dropped and added and the milliseconds from the command to the last
+// byte.
+//
+// Build with:
+//
+//   gcc -O2 -o chainemu chainemu.c
+//
+// Run with:
+//
+//   chainemu [-d <device> | -] [-L <link>] [-l <log>] [-c <temps>/<lights>]
+//            [-b <baud>] [-u <ms>] [-m <ms>] [-D <percent>] [-E <percent>]
+//            [-X <bytes>] [-Y <bytes>] [-i <seconds>] [-S <seed>] [-v]
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../idecode/idecode.h"
+
+#define COMMAND_SIZE 64
+#define ANSWER_SIZE (TEMP_DATA_SIZE + LIGHT_DATA_SIZE + 64)
+
+// Everything the chain model is set up with.
+typedef struct chainModel {
+  int cmTempCount;
+  int cmLightCount;
+  int cmBaud;
+  double cmStartup;      // seconds from power up until the chain answers.
+  double cmMeasure;      // seconds to measure before answering.
+  double cmDropPercent;
+  double cmExtraPercent;
+  int cmExtraBytes;
+  int cmShortBytes;
+  double cmIdle;         // seconds of quiet that count as a power cycle.
+  uint64_t cmSeed;
+} chainModel;
+
+typedef struct chainState {
+  int csInFd;
+  int csOutFd;
+  char csCommand[COMMAND_SIZE];
+  int csCommandLength;
+  bool csPowered;
+  double csPowerTime;    // when the chain was powered up.
+  double csLastInput;
+  int csPowerCycles;
+  uint64_t csRandom;
+  int csMeasurements;    // answers given, moves the sensor readings.
+} chainState;
+
+static chainModel model;
+static FILE* logFd;
+static bool verbose;
+static volatile sig_atomic_t stopRequested;
+
+static void stopHandler(int sig) {
+  (void)sig;
+  stopRequested = 1;
+}
+
+static double nowSeconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec + (ts.tv_nsec / 1e9));
+}
+
+static void sleepUntil(double when) {
+  struct timespec ts;
+  double wait;
+
+  if ((wait = when - nowSeconds()) <= 0.0) {
+    return;
+  }
+
+  ts.tv_sec = (time_t)wait;
+  ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+
+// xorshift64*, so the faults are the same on every machine.
+static double randomUnit(chainState* csPtr) {
+  csPtr->csRandom ^= csPtr->csRandom >> 12;
+  csPtr->csRandom ^= csPtr->csRandom << 25;
+  csPtr->csRandom ^= csPtr->csRandom >> 27;
+  return ((double)((csPtr->csRandom * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0);
+}
+
+static uint8_t* putBigEndian(uint8_t* ptr, uint16_t value) {
+  ptr[0] = value >> 8;
+  ptr[1] = value & 0xFF;
+  return (ptr + 2);
+}
+
+//*****************************************************************************
+//
+// buildAnswer
+//
+// Puts the sensor readings a command asks for in buff.
+//
+// returns the number of bytes.
+//
+//*****************************************************************************
+
+static int buildAnswer(chainState* csPtr, bool temps, bool lights, uint8_t* buff) {
+  uint8_t* ptr;
+  double tempC;
+  int i;
+
+  ptr = buff;
+
+  // The chain hangs down through the ice, so it warms towards the bottom
+  // and drifts slowly from one measurement to the next.
+  if (temps) {
+    for (i = 0; i < model.cmTempCount; ++i) {
+      tempC = -1.5 + (i * 0.02) + (((csPtr->csMeasurements + i) % 7) * 0.01);
+      ptr = putBigEndian(ptr, (uint16_t)(int16_t)(tempC * 128.0));
+    }
+  }
+
+  if (lights) {
+    for (i = 0; i < model.cmLightCount; ++i) {
+      ptr = putBigEndian(ptr, 4000 - (i * 50));
+      ptr = putBigEndian(ptr, 1200 - (i * 15));
+      ptr = putBigEndian(ptr, 1500 - (i * 20));
+      ptr = putBigEndian(ptr, 1800 - (i * 25));
+    }
+  }
+
+  ++csPtr->csMeasurements;
+  return (ptr - buff);
+}
+
+//*****************************************************************************
+//
+// sendAnswer
+//
+// Sends an answer a byte at a time at the baud rate, with the faults the
+// model asks for.
+//
+//*****************************************************************************
+
+static void sendAnswer(chainState* csPtr, const char* cmd, uint8_t* buff, int length, double start) {
+  double byteTime;
+  double when;
+  uint8_t extra;
+  int dropped;
+  int added;
+  int sent;
+  int i;
+
+  byteTime = 10.0 / model.cmBaud;
+  when = nowSeconds();
+  dropped = added = sent = 0;
+
+  for (i = 0; i < length; ++i) {
+    if (randomUnit(csPtr) * 100.0 < model.cmDropPercent) {
+      ++dropped;
+    } else {
+      when += byteTime;
+      sleepUntil(when);
+
+      if (write(csPtr->csOutFd, &buff[i], 1) == 1) {
+        ++sent;
+      }
+    }
+
+    if (randomUnit(csPtr) * 100.0 < model.cmExtraPercent) {
+      extra = (uint8_t)(randomUnit(csPtr) * 256.0);
+      when += byteTime;
+      sleepUntil(when);
+
+      if (write(csPtr->csOutFd, &extra, 1) == 1) {
+        ++added;
+        ++sent;
+      }
+    }
+  }
+
+  fprintf(logFd, "%d,%s,%d,%d,%d,%d,%.1f\n", csPtr->csPowerCycles, cmd, length, sent, dropped, added,
+          (nowSeconds() - start) * 1000.0);
+  fflush(logFd);
+}
+
+//*****************************************************************************
+//
+// doCommand
+//
+// Answers one command line.
+//
+//*****************************************************************************
+
+static void doCommand(chainState* csPtr, char* cmd, double start) {
+  uint8_t buff[ANSWER_SIZE];
+  const char* text;
+  int length;
+
+  if (verbose) {
+    fprintf(stderr, "chainemu: power cycle %d at %.0fms: %s\n", csPtr->csPowerCycles,
+            (start - csPtr->csPowerTime) * 1000.0, cmd);
+  }
+
+  // The chain is still starting up and does not hear the command.
+  if (start - csPtr->csPowerTime < model.cmStartup) {
+    fprintf(logFd, "%d,%s,0,0,0,0,\n", csPtr->csPowerCycles, cmd);
+    fflush(logFd);
+    return;
+  }
+
+  if (strncmp(cmd, "+1::debug=", 10) == 0) {
+    text = (atoi(cmd + 10) != 0) ? "\nDEBUG ON\n" : "\nDEBUG OFF\n";
+    length = strlen(text);
+    memcpy(buff, text, length);
+  } else if (strcmp(cmd, "+1::chain") == 0) {
+    length = buildAnswer(csPtr, true, false, buff);
+  } else if (strcmp(cmd, "+1::light") == 0) {
+    length = buildAnswer(csPtr, false, true, buff);
+  } else if (strcmp(cmd, "+1::measure") == 0) {
+    length = buildAnswer(csPtr, true, true, buff);
+  } else {
+    if (verbose) {
+      fprintf(stderr, "chainemu: Unknown command %s\n", cmd);
+    }
+
+    return;
+  }
+
+  sleepUntil(start + model.cmMeasure);
+
+  if (strncmp(cmd, "+1::debug=", 10) != 0) {
+    memset(buff + length, 0x55, model.cmExtraBytes);
+    length += model.cmExtraBytes;
+    length = (length > model.cmShortBytes) ? length - model.cmShortBytes : 0;
+  }
+
+  sendAnswer(csPtr, cmd, buff, length, start);
+}
+
+static void chainInput(chainState* csPtr, uint8_t chr) {
+  double now;
+
+  now = nowSeconds();
+
+  if (!csPtr->csPowered || (now - csPtr->csLastInput > model.cmIdle)) {
+    csPtr->csPowered = true;
+    csPtr->csPowerTime = now;
+    csPtr->csCommandLength = 0;
+    ++csPtr->csPowerCycles;
+  }
+
+  csPtr->csLastInput = now;
+
+  if (chr == '\n') {
+    csPtr->csCommand[csPtr->csCommandLength] = 0;
+    csPtr->csCommandLength = 0;
+    doCommand(csPtr, csPtr->csCommand, now);
+  } else if ((chr != '\r') && (csPtr->csCommandLength < COMMAND_SIZE - 1)) {
+    csPtr->csCommand[csPtr->csCommandLength++] = chr;
+  }
+}
+
+static speed_t baudSpeed(int baud) {
+  switch (baud) {
+    case 1200: return (B1200);
+    case 2400: return (B2400);
+    case 4800: return (B4800);
+    case 19200: return (B19200);
+    case 38400: return (B38400);
+    case 57600: return (B57600);
+    case 115200: return (B115200);
+  }
+
+  return (B9600);
+}
+
+//*****************************************************************************
+//
+// openPort
+//
+// Opens the pty, serial device or standard streams the chain talks through.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int openPort(char* device, char* linkName, chainState* csPtr) {
+  struct termios tio;
+  char* slaveName;
+  int fd;
+
+  if ((device != NULL) && (strcmp(device, "-") == 0)) {
+    csPtr->csInFd = STDIN_FILENO;
+    csPtr->csOutFd = STDOUT_FILENO;
+    return (0);
+  }
+
+  if (device != NULL) {
+    if ((fd = open(device, O_RDWR | O_NOCTTY)) < 0) {
+      fprintf(stderr, "Error: Unable to open %s!\n", device);
+      return (1);
+    }
+
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudSpeed(model.cmBaud));
+    cfsetospeed(&tio, baudSpeed(model.cmBaud));
+    tcsetattr(fd, TCSANOW, &tio);
+    csPtr->csInFd = csPtr->csOutFd = fd;
+    return (0);
+  }
+
+  if (((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0) ||
+      ((slaveName = ptsname(fd)) == NULL)) {
+    fprintf(stderr, "Error: Unable to create a pty!\n");
+    return (1);
+  }
+
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fd, TCSANOW, &tio);
+
+  if (linkName != NULL) {
+    unlink(linkName);
+
+    if (symlink(slaveName, linkName) != 0) {
+      fprintf(stderr, "Error: Unable to link %s to %s!\n", linkName, slaveName);
+      return (1);
+    }
+  }
+
+  fprintf(stderr, "chainemu: chain on %s\n", (linkName != NULL) ? linkName : slaveName);
+  csPtr->csInFd = csPtr->csOutFd = fd;
+  return (0);
+}
+
+static void usage(void) {
+  printf("chainemu [-d <device> | -] [-L <link>] [-l <log>] [-c <temps>/<lights>]\n");
+  printf("         [-b <baud>] [-u <ms>] [-m <ms>] [-D <percent>] [-E <percent>]\n");
+  printf("         [-X <bytes>] [-Y <bytes>] [-i <seconds>] [-S <seed>] [-v]\n");
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  struct sigaction sa;
+  struct pollfd pfd;
+  chainState state;
+  uint8_t buff[256];
+  char* device;
+  char* linkName;
+  char* logName;
+  int argIx;
+  int opt;
+  int rc;
+  int i;
+
+  memset(&model, 0, sizeof(model));
+  model.cmTempCount = 16;
+  model.cmLightCount = 6;
+  model.cmBaud = 9600;
+  model.cmStartup = 5.0;
+  model.cmMeasure = 0.75;
+  model.cmIdle = 30.0;
+  model.cmSeed = 1;
+  device = linkName = logName = NULL;
+  verbose = false;
+
+  for (argIx = 1; argIx < argc; ++argIx) {
+    if ((argv[argIx][0] != '-') || (argv[argIx][1] == 0) || (argv[argIx][2] != 0)) {
+      usage();
+    }
+
+    if (argv[argIx][1] == 'v') {
+      verbose = true;
+      continue;
+    }
+
+    if (argIx + 1 >= argc) {
+      usage();
+    }
+
+    opt = argv[argIx++][1];
+
+    switch (opt) {
+      case 'd':
+        device = argv[argIx];
+        break;
+
+      case 'L':
+        linkName = argv[argIx];
+        break;
+
+      case 'l':
+        logName = argv[argIx];
+        break;
+
+      case 'c':
+        if (sscanf(argv[argIx], "%d/%d", &model.cmTempCount, &model.cmLightCount) != 2) {
+          usage();
+        }
+
+        break;
+
+      case 'b':
+        model.cmBaud = atoi(argv[argIx]);
+        break;
+
+      case 'u':
+        model.cmStartup = atof(argv[argIx]) / 1000.0;
+        break;
+
+      case 'm':
+        model.cmMeasure = atof(argv[argIx]) / 1000.0;
+        break;
+
+      case 'D':
+        model.cmDropPercent = atof(argv[argIx]);
+        break;
+
+      case 'E':
+        model.cmExtraPercent = atof(argv[argIx]);
+        break;
+
+      case 'X':
+        model.cmExtraBytes = atoi(argv[argIx]);
+        break;
+
+      case 'Y':
+        model.cmShortBytes = atoi(argv[argIx]);
+        break;
+
+      case 'i':
+        model.cmIdle = atof(argv[argIx]);
+        break;
+
+      case 'S':
+        model.cmSeed = strtoull(argv[argIx], NULL, 10);
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if ((model.cmTempCount < 0) || (model.cmTempCount > TEMP_SENSOR_COUNT) || (model.cmLightCount < 0) ||
+      (model.cmLightCount > LIGHT_SENSOR_COUNT) || (model.cmBaud < 300) || (model.cmExtraBytes < 0) ||
+      (model.cmExtraBytes > 64) || (model.cmShortBytes < 0)) {
+    usage();
+  }
+
+  logFd = stderr;
+
+  if (logName != NULL) {
+    if ((logFd = fopen(logName, "a")) == NULL) {
+      fprintf(stderr, "Error: Unable to open log %s!\n", logName);
+      exit(1);
+    }
+
+    if (ftell(logFd) == 0) {
+      fprintf(logFd, "power,command,bytes,sent,dropped,added,ms\n");
+    }
+  }
+
+  memset(&state, 0, sizeof(state));
+  state.csRandom = (model.cmSeed + 1) * 0x9E3779B97F4A7C15ULL;
+
+  if (openPort(device, linkName, &state) != 0) {
+    exit(1);
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stopHandler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  while (!stopRequested) {
+    pfd.fd = state.csInFd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+
+    rc = read(state.csInFd, buff, sizeof(buff));
+
+    // A pty reads EIO while nothing has its slave open, which is the chain
+    // being powered down.  A stream reads 0 at its end.
+    if (rc <= 0) {
+      if ((rc < 0) && (errno == EINTR)) {
+        continue;
+      }
+
+      state.csPowered = false;
+
+      if ((rc == 0) || (device != NULL)) {
+        break;
+      }
+
+      usleep(100000);
+      continue;
+    }
+
+    for (i = 0; i < rc; ++i) {
+      chainInput(&state, buff[i]);
+    }
+  }
+
+  if (linkName != NULL) {
+    unlink(linkName);
+  }
+
+  return (0);
+}
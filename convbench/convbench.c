@@ -0,0 +1,301 @@
+//*****************************************************************************
+// convbench.c
+//
+// Micro-benchmark for the idecode bulk conversion kernels.
+//
+// Each kernel is checked against the one-at-a-time routines idecode used
+// before, then timed at every level the processor supports, and the result
+// is printed in GB/s of input.
+//
+// Build with:
+//
+//   gcc -O2 -o convbench convbench.c ../idecode/convert.c
+//
+// Run with:
+//
+//   convbench [megabytes]
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../idecode/convert.h"
+
+#define DEFAULT_MEGABYTES 64
+#define MIN_SECONDS 0.5  // each measurement is repeated for at least this long.
+
+//*****************************************************************************
+//
+// The routines as idecode had them, used to check and time the kernels
+// against.
+//
+//*****************************************************************************
+
+static char convertCharToHex(char chr) {
+  if ((chr >= '0') && (chr <= '9')) {
+    return (chr - '0');
+  } else if ((chr >= 'a') && (chr <= 'f')) {
+    return ((chr - 'a') + 10);
+  } else if ((chr >= 'A') && (chr <= 'F')) {
+    return ((chr - 'A') + 10);
+  }
+
+  return (0xFF);
+}
+
+static void convertBigEndianToLittleEndian(char* sPtr, int size) {
+  char tmp;
+  int i;
+
+  for (i = 0; i < (size / 2); ++i) {
+    tmp = *sPtr;
+    *sPtr = *(sPtr + 1);
+    *(sPtr + 1) = tmp;
+    sPtr += 2;
+  }
+}
+
+static float convertTempToC(short temp) {
+  if (temp & 0x8000) {
+    return ((float)((temp & 0x7FFF) - 0x8000) / 128.0);
+  }
+
+  return ((float)temp / 128.0);
+}
+
+static int refHexToBinary(const char* src, int len, uint8_t* dst) {
+  char hb1;
+  char hb2;
+  int i;
+
+  for (i = 0; i < len; i += 2) {
+    if (((hb1 = convertCharToHex(src[i])) == (char)0xFF) || ((hb2 = convertCharToHex(src[i + 1])) == (char)0xFF)) {
+      return (-1);
+    }
+
+    dst[i / 2] = (hb1 << 4) | hb2;
+  }
+
+  return (len / 2);
+}
+
+static void refTempsToC(uint16_t* temps, int count, float* out) {
+  int i;
+
+  convertBigEndianToLittleEndian((char*)temps, count * 2);
+
+  for (i = 0; i < count; ++i) {
+    out[i] = convertTempToC(temps[i]);
+  }
+}
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static void report(const char* name, const char* level, size_t bytes, int runs, double seconds) {
+  printf("%-8s %-8s %8.3f GB/s\n", name, level, ((double)bytes * runs) / seconds / 1e9);
+}
+
+//*****************************************************************************
+//
+// check
+//
+// Compares every kernel at the current level with the old routines,
+// including a bad hex character at every position of a short string.
+//
+// returns the number of differences found.
+//
+//*****************************************************************************
+
+static int check(void) {
+  static uint16_t temps[65536];
+  static uint16_t swapped[65536];
+  static float wantC[65536];
+  static float gotC[65536];
+  char hex[128];
+  char hold;
+  uint8_t want[64];
+  uint8_t got[64];
+  int errors;
+  int i;
+  int j;
+
+  errors = 0;
+
+  for (i = 0; i < 128; ++i) {
+    hex[i] = "0123456789abcdefABCDEF"[rand() % 22];
+  }
+
+  if ((refHexToBinary(hex, 128, want) != 64) || (convertHexToBinary(hex, 128, got) != 64) ||
+      (memcmp(want, got, 64) != 0)) {
+    printf("hex: good data decoded wrong\n");
+    ++errors;
+  }
+
+  for (i = 0; i < 128; ++i) {
+    for (j = 0; j < 256; ++j) {
+      if (convertCharToHex(j) != (char)0xFF) {
+        continue;
+      }
+
+      hold = hex[i];
+      hex[i] = j;
+
+      if (convertHexToBinary(hex, 128, got) != -1) {
+        printf("hex: bad character %02x at %d not found\n", j, i);
+        ++errors;
+      }
+
+      hex[i] = hold;
+    }
+  }
+
+  // Every possible reading, in big and little endian order.
+  for (i = 0; i < 65536; ++i) {
+    temps[i] = i;
+  }
+
+  memcpy(swapped, temps, sizeof(temps));
+  convertSwapHalfwords((uint8_t*)swapped, 65536 * 2);
+  convertBigEndianToLittleEndian((char*)temps, 65536 * 2);
+
+  if (memcmp(swapped, temps, 65536 * 2) != 0) {
+    printf("swap: halfwords swapped wrong\n");
+    ++errors;
+  }
+
+  convertBigEndianToLittleEndian((char*)temps, 65536 * 2);
+  convertTempsToC(temps, 65536, gotC, true);
+  refTempsToC(temps, 65536, wantC);
+
+  if (memcmp(wantC, gotC, 65536 * sizeof(float)) != 0) {
+    printf("temps: big endian readings converted wrong\n");
+    ++errors;
+  }
+
+  convertTempsToC(temps, 65536, gotC, false);
+
+  if (memcmp(wantC, gotC, 65536 * sizeof(float)) != 0) {
+    printf("temps: readings converted wrong\n");
+    ++errors;
+  }
+
+  return (errors);
+}
+
+int main(int argc, char** argv) {
+  size_t bytes;
+  char* hex;
+  uint8_t* bin;
+  uint16_t* temps;
+  float* out;
+  double start;
+  double seconds;
+  int best;
+  int level;
+  int runs;
+  int errors;
+  size_t i;
+
+  bytes = (size_t)((argc > 1) ? atoi(argv[1]) : DEFAULT_MEGABYTES) << 20;
+
+  if (bytes == 0) {
+    printf("Usage: convbench [megabytes]\n");
+    return (1);
+  }
+
+  hex = malloc(bytes);
+  bin = malloc(bytes / 2);
+  temps = malloc(bytes);
+  out = malloc(bytes * 2);
+
+  if ((hex == NULL) || (bin == NULL) || (temps == NULL) || (out == NULL)) {
+    printf("Error: Out of memory!\n");
+    return (1);
+  }
+
+  for (i = 0; i < bytes; ++i) {
+    hex[i] = "0123456789abcdef"[rand() & 15];
+  }
+
+  for (i = 0; i < bytes / 2; ++i) {
+    temps[i] = rand();
+  }
+
+  best = convertLevel();
+  errors = 0;
+
+  for (level = CONVERT_SCALAR; level <= best; ++level) {
+    convertSetLevel(level);
+
+    if (check() != 0) {
+      printf("%s kernels do not match the old routines!\n", convertLevelName(level));
+      ++errors;
+    }
+  }
+
+  if (errors != 0) {
+    return (1);
+  }
+
+  printf("%zu MB per run, best level %s\n\n", bytes >> 20, convertLevelName(best));
+
+  // The old routines.
+  for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+    refHexToBinary(hex, bytes, bin);
+  }
+
+  report("hex", "old", bytes, runs, seconds);
+
+  for (level = CONVERT_SCALAR; level <= best; ++level) {
+    convertSetLevel(level);
+
+    for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+      convertHexToBinary(hex, bytes, bin);
+    }
+
+    report("hex", convertLevelName(level), bytes, runs, seconds);
+  }
+
+  for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+    convertBigEndianToLittleEndian((char*)temps, bytes);
+  }
+
+  report("swap", "old", bytes, runs, seconds);
+
+  for (level = CONVERT_SCALAR; level <= best; ++level) {
+    convertSetLevel(level);
+
+    for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+      convertSwapHalfwords((uint8_t*)temps, bytes);
+    }
+
+    report("swap", convertLevelName(level), bytes, runs, seconds);
+  }
+
+  for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+    refTempsToC(temps, bytes / 2, out);
+  }
+
+  report("temps", "old", bytes, runs, seconds);
+
+  for (level = CONVERT_SCALAR; level <= best; ++level) {
+    convertSetLevel(level);
+
+    for (runs = 0, start = now(); (seconds = now() - start) < MIN_SECONDS; ++runs) {
+      convertTempsToC(temps, bytes / 2, out, true);
+    }
+
+    report("temps", convertLevelName(level), bytes, runs, seconds);
+  }
+
+  return (0);
+}
@@ -0,0 +1,665 @@
+//*****************************************************************************
+// fleetbench.c
+//
+// Throughput benchmark for idecode, run against a fleet made by fleetgen.
+//
+// Each ingest mode is run on the whole fleet in its own work directory
+// under the fleet directory:
+//
+//   batch   idecode -b with the .bin files.
+//   export  idecode -x csv -b with the .bin files.
+//   mbox    idecode -e with the mbox of .sbd attachments.
+//   maildir idecode -e with the maildir of hex data emails.
+//   chunk   idecode -c once for each complete report, the way a mail
+//           filter runs it.  Only the first -n reports are run.
+//   daemon  idecode -d with the .bin files moved into its spool in arrival
+//           order at -r files a second.
+//
+// For each mode the reports decoded, the reports a second, the peak RSS
+// and, where a report has a latency of its own, the 50th, 90th and 99th
+// percentile and largest latency are printed.  A chunk report's latency is
+// the run time of its idecode.  A daemon report's latency is the time from
+// its last chunk landing in the spool to idecode saying it has processed
+// it.
+//
+// Build with:
+//
+//   gcc -O2 -o fleetbench fleetbench.c
+//
+// Run with:
+//
+//   fleetbench [-n <chunk reports>] [-r <daemon files a second>] <idecode> <fleet directory>
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define NAME_SIZE 1024
+#define KEY_SIZE 64  // "<IMEI> <send time>"
+#define MAX_ARGS 16
+
+typedef struct fleetFile {
+  char ffName[NAME_SIZE / 4];
+  char ffKey[KEY_SIZE];
+  int ffChunk;
+  bool ffDone;
+} fleetFile;
+
+typedef struct benchResult {
+  long brReports;
+  double brSeconds;
+  long brPeakKb;
+  double* brLatency;  // milliseconds, NULL if the mode has none.
+  long brLatencyCount;
+} benchResult;
+
+static fleetFile* fileList;
+static int fileCount;
+static char fleetDir[NAME_SIZE];
+static char idecodePath[NAME_SIZE];
+
+static double nowSeconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec + (ts.tv_nsec / 1e9));
+}
+
+static int compareDouble(const void* a, const void* b) {
+  double aVal = *(const double*)a;
+  double bVal = *(const double*)b;
+
+  return ((aVal > bVal) - (aVal < bVal));
+}
+
+//*****************************************************************************
+//
+// readList
+//
+// Reads fleet.list into the file list.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int readList(void) {
+  char line[NAME_SIZE];
+  char imei[KEY_SIZE / 2];
+  char sendTime[KEY_SIZE / 2];
+  fleetFile* ffPtr;
+  FILE* fd;
+  int done;
+  int size;
+
+  if (snprintf(line, sizeof(line), "%s/fleet.list", fleetDir) >= (int)sizeof(line)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    return (1);
+  }
+
+  if ((fd = fopen(line, "r")) == NULL) {
+    printf("Error: Unable to open %s!\n", line);
+    return (1);
+  }
+
+  size = 0;
+
+  while (fgets(line, sizeof(line), fd) != NULL) {
+    if (fileCount == size) {
+      size = (size == 0) ? 4096 : size * 2;
+
+      if ((fileList = realloc(fileList, size * sizeof(fleetFile))) == NULL) {
+        printf("Error: Out of memory!\n");
+        return (1);
+      }
+    }
+
+    ffPtr = &fileList[fileCount];
+
+    if (sscanf(line, "%255s %31s %31s %d %d", ffPtr->ffName, imei, sendTime, &ffPtr->ffChunk, &done) == 5) {
+      snprintf(ffPtr->ffKey, sizeof(ffPtr->ffKey), "%s %s", imei, sendTime);
+      ffPtr->ffDone = (done != 0);
+      ++fileCount;
+    }
+  }
+
+  fclose(fd);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// startIdecode
+//
+// Runs idecode with args in workDir with its output going to outFd.
+//
+// returns the process id of idecode.
+//
+//*****************************************************************************
+
+static pid_t startIdecode(char* workDir, char** args, int outFd) {
+  pid_t pid;
+
+  mkdir(workDir, 0775);
+
+  if ((pid = fork()) == 0) {
+    if ((chdir(workDir) != 0) || (dup2(outFd, STDOUT_FILENO) < 0)) {
+      _exit(127);
+    }
+
+    execv(idecodePath, args);
+    _exit(127);
+  }
+
+  return (pid);
+}
+
+static long waitIdecode(pid_t pid, long* peakKb) {
+  struct rusage usage;
+  int status;
+
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    return (-1);
+  }
+
+  if (usage.ru_maxrss > *peakKb) {
+    *peakKb = usage.ru_maxrss;
+  }
+
+  return ((WIFEXITED(status) && (WEXITSTATUS(status) == 0)) ? 0 : -1);
+}
+
+static long countReports(char* outName) {
+  char line[NAME_SIZE];
+  FILE* fd;
+  long count;
+
+  if ((fd = fopen(outName, "r")) == NULL) {
+    return (0);
+  }
+
+  count = 0;
+
+  while (fgets(line, sizeof(line), fd) != NULL) {
+    if (strncmp(line, "Processing data for Rockblock", 29) == 0) {
+      ++count;
+    }
+  }
+
+  fclose(fd);
+  return (count);
+}
+
+//*****************************************************************************
+//
+// benchRun
+//
+// Runs one idecode over the whole fleet.  args[0] is filled in here.
+//
+//*****************************************************************************
+
+static int benchRun(char* mode, char** args, benchResult* brPtr) {
+  char workDir[NAME_SIZE];
+  char outName[NAME_SIZE];
+  double start;
+  int outFd;
+  pid_t pid;
+
+  if ((snprintf(workDir, sizeof(workDir), "%s/work.%s", fleetDir, mode) >= (int)sizeof(workDir)) ||
+      (snprintf(outName, sizeof(outName), "%s/work.%s.out", fleetDir, mode) >= (int)sizeof(outName))) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    return (1);
+  }
+
+  if ((outFd = open(outName, O_WRONLY | O_CREAT | O_TRUNC, 0664)) < 0) {
+    printf("Error: Unable to create %s!\n", outName);
+    return (1);
+  }
+
+  args[0] = idecodePath;
+  start = nowSeconds();
+  pid = startIdecode(workDir, args, outFd);
+  close(outFd);
+
+  if ((pid < 0) || (waitIdecode(pid, &brPtr->brPeakKb) != 0)) {
+    printf("Error: idecode failed in %s mode, see %s!\n", mode, outName);
+    return (1);
+  }
+
+  brPtr->brSeconds = nowSeconds() - start;
+  brPtr->brReports = countReports(outName);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// benchChunk
+//
+// Runs idecode -c once for each of the first limit complete reports.
+//
+//*****************************************************************************
+
+static int benchChunk(int limit, benchResult* brPtr) {
+  char workDir[NAME_SIZE];
+  char names[MAX_ARGS][NAME_SIZE];
+  char* args[MAX_ARGS + 3];
+  double start;
+  double runStart;
+  int argCount;
+  int outFd;
+  int i;
+  int j;
+  pid_t pid;
+
+  if (snprintf(workDir, sizeof(workDir), "%s/work.chunk", fleetDir) >= (int)sizeof(workDir)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    return (1);
+  }
+
+  outFd = open("/dev/null", O_WRONLY);
+  brPtr->brLatency = malloc(limit * sizeof(double));
+  start = nowSeconds();
+
+  for (i = 0; (i < fileCount) && (brPtr->brReports < limit); ++i) {
+    if (!fileList[i].ffDone) {
+      continue;
+    }
+
+    // The first copy of each chunk of the report, in chunk order.
+    args[0] = idecodePath;
+    args[1] = "-c";
+    argCount = 0;
+
+    for (j = 0; (j <= i) && (argCount < MAX_ARGS); ++j) {
+      if ((strcmp(fileList[j].ffKey, fileList[i].ffKey) == 0) && (fileList[j].ffChunk == argCount)) {
+        if (snprintf(names[argCount], NAME_SIZE, "%s/%s", fleetDir, fileList[j].ffName) >= NAME_SIZE) {
+          printf("Error: Chunk file name %s too long!\n", fileList[j].ffName);
+          close(outFd);
+          return (1);
+        }
+
+        args[2 + argCount] = names[argCount];
+        ++argCount;
+        j = -1;
+      }
+    }
+
+    args[2 + argCount] = NULL;
+    runStart = nowSeconds();
+    pid = startIdecode(workDir, args, outFd);
+
+    if ((pid < 0) || (waitIdecode(pid, &brPtr->brPeakKb) != 0)) {
+      printf("Error: idecode -c failed for %s!\n", fileList[i].ffKey);
+      close(outFd);
+      return (1);
+    }
+
+    brPtr->brLatency[brPtr->brLatencyCount++] = (nowSeconds() - runStart) * 1000.0;
+    ++brPtr->brReports;
+  }
+
+  brPtr->brSeconds = nowSeconds() - start;
+  close(outFd);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// benchDaemon
+//
+// Starts idecode -d on an empty spool and moves the .bin files into it in
+// arrival order at rate files a second, timing each report from its last
+// chunk landing to idecode's "Processing data" line for it.
+//
+//*****************************************************************************
+
+typedef struct daemonBench {
+  int dbPipe;          // idecode's output.
+  char dbLine[NAME_SIZE];
+  int dbUsed;          // bytes of a partial line in dbLine.
+  bool dbWatching;     // idecode has started watching the spool.
+  int* dbDoneOrder;    // the files that complete a report, sorted by key.
+  int dbDoneCount;
+  double* dbLanded;    // when each file landed in the spool.
+  double* dbAnswered;  // when idecode processed the report a file completes.
+  long dbAnsweredCount;
+} daemonBench;
+
+static int compareKey(const void* a, const void* b) {
+  return (strcmp(fileList[*(const int*)a].ffKey, fileList[*(const int*)b].ffKey));
+}
+
+static void daemonLine(daemonBench* dbPtr, char* line, double now) {
+  char rbId[KEY_SIZE / 2];
+  char sendTime[KEY_SIZE / 2];
+  char key[KEY_SIZE];
+  int lo;
+  int hi;
+  int mid;
+  int rc;
+  int ix;
+
+  if (strncmp(line, "Watching", 8) == 0) {
+    dbPtr->dbWatching = true;
+  }
+
+  if (sscanf(line, "Processing data for Rockblock %31s sent %31[0-9a-f]", rbId, sendTime) != 2) {
+    return;
+  }
+
+  // The last landed file with the key that has not been answered yet.
+  snprintf(key, sizeof(key), "%s %s", rbId, sendTime);
+  lo = 0;
+  hi = dbPtr->dbDoneCount;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    rc = strcmp(fileList[dbPtr->dbDoneOrder[mid]].ffKey, key);
+    lo = (rc < 0) ? mid + 1 : lo;
+    hi = (rc < 0) ? hi : mid;
+  }
+
+  for (; (lo < dbPtr->dbDoneCount) && (strcmp(fileList[dbPtr->dbDoneOrder[lo]].ffKey, key) == 0); ++lo) {
+    ix = dbPtr->dbDoneOrder[lo];
+
+    if ((dbPtr->dbLanded[ix] > 0) && (dbPtr->dbAnswered[ix] == 0)) {
+      dbPtr->dbAnswered[ix] = now;
+      ++dbPtr->dbAnsweredCount;
+      return;
+    }
+  }
+}
+
+static int daemonRead(daemonBench* dbPtr, int timeout) {
+  struct pollfd pfd;
+  char* linePtr;
+  char* endPtr;
+  double now;
+  int len;
+
+  pfd.fd = dbPtr->dbPipe;
+  pfd.events = POLLIN;
+
+  if ((poll(&pfd, 1, timeout) <= 0) ||
+      ((len = read(dbPtr->dbPipe, dbPtr->dbLine + dbPtr->dbUsed, NAME_SIZE - 1 - dbPtr->dbUsed)) <= 0)) {
+    return (0);
+  }
+
+  now = nowSeconds();
+  dbPtr->dbUsed += len;
+  dbPtr->dbLine[dbPtr->dbUsed] = 0;
+  linePtr = dbPtr->dbLine;
+
+  while ((endPtr = strchr(linePtr, '\n')) != NULL) {
+    *endPtr = 0;
+    daemonLine(dbPtr, linePtr, now);
+    linePtr = endPtr + 1;
+  }
+
+  // A line too long for the buffer is dropped.
+  dbPtr->dbUsed = (dbPtr->dbUsed == NAME_SIZE - 1) ? 0 : dbPtr->dbUsed - (linePtr - dbPtr->dbLine);
+  memmove(dbPtr->dbLine, linePtr, dbPtr->dbUsed);
+  return (1);
+}
+
+static int benchDaemon(int rate, benchResult* brPtr) {
+  char workDir[NAME_SIZE];
+  char spool[NAME_SIZE];
+  char fromName[NAME_SIZE];
+  char tempName[NAME_SIZE];
+  char toName[NAME_SIZE];
+  char buff[NAME_SIZE];
+  char* args[4];
+  daemonBench bench;
+  double start;
+  double next;
+  int pipeFds[2];
+  int inFd;
+  int outFd;
+  int len;
+  int i;
+  pid_t pid;
+
+  if ((snprintf(workDir, sizeof(workDir), "%s/work.daemon", fleetDir) >= (int)sizeof(workDir)) ||
+      (snprintf(spool, sizeof(spool), "%s/spool", workDir) >= (int)sizeof(spool))) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    return (1);
+  }
+
+  mkdir(workDir, 0775);
+  mkdir(spool, 0775);
+
+  if (pipe(pipeFds) != 0) {
+    return (1);
+  }
+
+  memset(&bench, 0, sizeof(bench));
+  bench.dbPipe = pipeFds[0];
+  bench.dbDoneOrder = malloc(fileCount * sizeof(int));
+  bench.dbLanded = calloc(fileCount, sizeof(double));
+  bench.dbAnswered = calloc(fileCount, sizeof(double));
+
+  for (i = 0; i < fileCount; ++i) {
+    if (fileList[i].ffDone) {
+      bench.dbDoneOrder[bench.dbDoneCount++] = i;
+    }
+  }
+
+  // Sorted by key, and by arrival within a key.
+  qsort(bench.dbDoneOrder, bench.dbDoneCount, sizeof(int), compareKey);
+
+  args[0] = idecodePath;
+  args[1] = "-d";
+  args[2] = spool;
+  args[3] = NULL;
+  pid = startIdecode(workDir, args, pipeFds[1]);
+  close(pipeFds[1]);
+
+  while (!bench.dbWatching && daemonRead(&bench, 5000)) {
+  }
+
+  if (!bench.dbWatching) {
+    printf("Error: idecode -d did not start!\n");
+    kill(pid, SIGTERM);
+    return (1);
+  }
+
+  start = next = nowSeconds();
+
+  for (i = 0; i < fileCount; ++i) {
+    // Copy to a hidden name first so the daemon sees the whole file land.
+    if ((snprintf(fromName, sizeof(fromName), "%s/%s", fleetDir, fileList[i].ffName) >= (int)sizeof(fromName)) ||
+        (snprintf(tempName, sizeof(tempName), "%s/.landing", spool) >= (int)sizeof(tempName)) ||
+        (snprintf(toName, sizeof(toName), "%s/%s", spool, strrchr(fileList[i].ffName, '/') + 1) >=
+         (int)sizeof(toName))) {
+      printf("Error: Chunk file name %s too long!\n", fileList[i].ffName);
+      kill(pid, SIGTERM);
+      return (1);
+    }
+
+    if (((inFd = open(fromName, O_RDONLY)) < 0) || ((outFd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0664)) < 0)) {
+      printf("Error: Unable to copy %s to the spool!\n", fromName);
+      kill(pid, SIGTERM);
+      return (1);
+    }
+
+    len = read(inFd, buff, sizeof(buff));
+    len = (len > 0) ? write(outFd, buff, len) : 0;
+    close(inFd);
+    close(outFd);
+    rename(tempName, toName);
+    bench.dbLanded[i] = nowSeconds();
+
+    // Keep to the delivery rate, reading the daemon's output meanwhile.
+    next += 1.0 / rate;
+
+    while (nowSeconds() < next) {
+      daemonRead(&bench, (int)((next - nowSeconds()) * 1000.0) + 1);
+    }
+  }
+
+  // Give the daemon time to catch up.
+  while ((bench.dbAnsweredCount < bench.dbDoneCount) && daemonRead(&bench, 2000)) {
+  }
+
+  brPtr->brSeconds = nowSeconds() - start;
+  kill(pid, SIGTERM);
+
+  while (daemonRead(&bench, 2000)) {
+  }
+
+  close(pipeFds[0]);
+  waitIdecode(pid, &brPtr->brPeakKb);
+  brPtr->brLatency = malloc((bench.dbDoneCount + 1) * sizeof(double));
+
+  for (i = 0; i < fileCount; ++i) {
+    if (bench.dbAnswered[i] != 0) {
+      brPtr->brLatency[brPtr->brLatencyCount++] = (bench.dbAnswered[i] - bench.dbLanded[i]) * 1000.0;
+    }
+  }
+
+  brPtr->brReports = brPtr->brLatencyCount;
+  free(bench.dbDoneOrder);
+  free(bench.dbLanded);
+  free(bench.dbAnswered);
+  return (0);
+}
+
+static void printResult(char* mode, benchResult* brPtr) {
+  double* latPtr;
+  long count;
+
+  printf("%-8s %8ld %9.2f %10.1f %10.1f", mode, brPtr->brReports, brPtr->brSeconds,
+         (brPtr->brSeconds > 0) ? brPtr->brReports / brPtr->brSeconds : 0.0, brPtr->brPeakKb / 1024.0);
+
+  if ((brPtr->brLatency == NULL) || (brPtr->brLatencyCount == 0)) {
+    printf("        -        -        -        -\n");
+    return;
+  }
+
+  latPtr = brPtr->brLatency;
+  count = brPtr->brLatencyCount;
+  qsort(latPtr, count, sizeof(double), compareDouble);
+  printf(" %8.2f %8.2f %8.2f %8.2f\n", latPtr[(count * 50) / 100], latPtr[(count * 90) / 100],
+         latPtr[(count * 99) / 100], latPtr[count - 1]);
+  free(latPtr);
+}
+
+int main(int argc, char** argv) {
+  char dataName[NAME_SIZE];
+  char exportName[NAME_SIZE];
+  char* args[8];
+  benchResult result;
+  int chunkLimit;
+  int rate;
+  int argIx;
+
+  chunkLimit = 200;
+  rate = 1000;
+
+  for (argIx = 1; (argIx < argc - 2) && (argv[argIx][0] == '-'); argIx += 2) {
+    if (argv[argIx][1] == 'n') {
+      chunkLimit = atoi(argv[argIx + 1]);
+    } else if (argv[argIx][1] == 'r') {
+      rate = atoi(argv[argIx + 1]);
+    } else {
+      break;
+    }
+  }
+
+  if ((argIx != argc - 2) || (chunkLimit < 1) || (rate < 1) ||
+      (realpath(argv[argIx], idecodePath) == NULL) || (realpath(argv[argIx + 1], fleetDir) == NULL)) {
+    printf("fleetbench [-n <chunk reports>] [-r <daemon files a second>] <idecode> <fleet directory>\n");
+    exit(1);
+  }
+
+  if (readList() != 0) {
+    exit(1);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  printf("%d chunk files in %s.\n\n", fileCount, fleetDir);
+  printf("mode      reports   seconds  reports/s  peak RSS MB  p50 ms   p90 ms   p99 ms   max ms\n");
+
+  if (snprintf(dataName, sizeof(dataName), "%s/bin", fleetDir) >= (int)sizeof(dataName)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    exit(1);
+  }
+
+  memset(&result, 0, sizeof(result));
+  args[1] = "-b";
+  args[2] = dataName;
+  args[3] = NULL;
+
+  if (benchRun("batch", args, &result) == 0) {
+    printResult("batch", &result);
+  }
+
+  if (snprintf(exportName, sizeof(exportName), "%s/work.export.csv", fleetDir) >= (int)sizeof(exportName)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    exit(1);
+  }
+
+  unlink(exportName);
+  memset(&result, 0, sizeof(result));
+  args[1] = "-x";
+  args[2] = "csv";
+  args[3] = exportName;
+  args[4] = "-b";
+  args[5] = dataName;
+  args[6] = NULL;
+
+  if (benchRun("export", args, &result) == 0) {
+    printResult("export", &result);
+  }
+
+  if (snprintf(dataName, sizeof(dataName), "%s/fleet.mbox", fleetDir) >= (int)sizeof(dataName)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    exit(1);
+  }
+
+  memset(&result, 0, sizeof(result));
+  args[1] = "-e";
+  args[2] = dataName;
+  args[3] = NULL;
+
+  if (benchRun("mbox", args, &result) == 0) {
+    printResult("mbox", &result);
+  }
+
+  if (snprintf(dataName, sizeof(dataName), "%s/hex", fleetDir) >= (int)sizeof(dataName)) {
+    printf("Error: Fleet directory name %s too long!\n", fleetDir);
+    exit(1);
+  }
+
+  memset(&result, 0, sizeof(result));
+
+  if (benchRun("maildir", args, &result) == 0) {
+    printResult("maildir", &result);
+  }
+
+  memset(&result, 0, sizeof(result));
+
+  if (benchChunk(chunkLimit, &result) == 0) {
+    printResult("chunk", &result);
+  }
+
+  memset(&result, 0, sizeof(result));
+
+  if (benchDaemon(rate, &result) == 0) {
+    printResult("daemon", &result);
+  }
+
+  return (0);
+}
@@ -0,0 +1,578 @@
+//*****************************************************************************
+// fleetgen.c
+//
+// Synthetic icedrifter fleet traffic generator.
+//
+// Builds the reports a fleet of simulated buoys would send, splits them
+// into chunks the way the icedrifter does and writes the chunks in the
+// order they arrive, as RockBLOCK .bin files, as RockBLOCK style emails
+// with hex data bodies in a maildir, and as Iridium style emails with .sbd
+// attachments in an mbox.  Chunks can be lost, delivered twice or delivered
+// out of order.  Half the buoys are v6.5 hardware and half v6.6, which send
+// different record layouts.
+//
+// The output directory gets:
+//
+//   bin/<IMEI>-<MOMSN>.bin  one file per chunk delivered.
+//   hex/                    maildir with one message per chunk delivered.
+//   fleet.mbox              mbox with one message per chunk delivered.
+//   fleet.list              one line per chunk delivered, in arrival order:
+//                           <bin file> <IMEI> <send time> <chunk> <done>
+//                           where done is 1 for the chunk that completes
+//                           its report.
+//
+// Build with:
+//
+//   gcc -O2 -o fleetgen fleetgen.c
+//
+// Run with:
+//
+//   fleetgen [-b <buoys>] [-r <reports per buoy>] [-c 16/6 | 160/64 | mixed]
+//            [-d <duplicate percent>] [-m <missing percent>] [-o]
+//            [-s <seed>] <output directory>
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "../idecode/idecode.h"
+
+#define FIRST_IMEI 300234010000000ULL  // IMEI of the first simulated buoy.
+#define FIRST_SEND_TIME 699408000       // 03/01/2022 in icedrifter time.
+#define REPORT_INTERVAL (4 * 60 * 60)   // seconds between a buoy's reports.
+#define REORDER_WINDOW 8                // how many places -o moves a chunk.
+#define V65_HEADER_LENGTH 36            // bytes before the chain data in a v6.5 record.
+
+typedef struct fleetChunk {
+  double fcArrival;  // position in the arrival order.
+  int fcBuoy;
+  uint32_t fcSendTime;
+  int fcLength;  // bytes in fcChunk.
+  bool fcDone;   // this delivery completes its report.
+  iceDrifterChunk fcChunk;
+} fleetChunk;
+
+typedef struct fleetBuoy {
+  uint64_t fbImei;
+  int fbTempCount;
+  int fbLightCount;
+  int fbLayout;  // RECORD_LAYOUT of the buoy's hardware version.
+  float fbLatitude;
+  float fbLongitude;
+  uint32_t fbMomsn;
+} fleetBuoy;
+
+static fleetChunk* chunkList;
+static int chunkCount;
+static int chunkSize;
+
+static double randomUnit(void) {
+  return ((double)rand() / ((double)RAND_MAX + 1.0));
+}
+
+static void putBigEndian(uint8_t* ptr, uint16_t value) {
+  ptr[0] = value >> 8;
+  ptr[1] = value & 0xFF;
+}
+
+static fleetChunk* addChunk(void) {
+  if (chunkCount == chunkSize) {
+    chunkSize = (chunkSize == 0) ? 4096 : chunkSize * 2;
+
+    if ((chunkList = realloc(chunkList, chunkSize * sizeof(fleetChunk))) == NULL) {
+      printf("Error: Out of memory!\n");
+      exit(1);
+    }
+  }
+
+  return (&chunkList[chunkCount++]);
+}
+
+// Number of bytes in a report of the buoy.
+static int reportLength(fleetBuoy* fbPtr) {
+  int length;
+
+  if (fbPtr->fbTempCount == 0) {
+    length = BASE_RECORD_LENGTH;
+  } else {
+    length = RECORD_LENGTH(fbPtr->fbTempCount, fbPtr->fbLightCount);
+  }
+
+  if (fbPtr->fbLayout == 0) {
+    length -= BASE_RECORD_LENGTH - V65_HEADER_LENGTH;
+  }
+
+  return (length);
+}
+
+//*****************************************************************************
+//
+// buildReport
+//
+// Builds the next report of a buoy the way the icedrifter sends it and adds
+// its chunks to the chunk list.  v6.5 has a shorter header than v6.6 and
+// no sensor counts.
+//
+//*****************************************************************************
+
+static void buildReport(fleetBuoy* fbPtr, int buoy, uint32_t sendTime, int missingPercent) {
+  uint8_t record[sizeof(icedrifterData)];
+  icedrifterData* idPtr;
+  fleetChunk* fcPtr;
+  uint8_t* wkPtr;
+  int length;
+  int offset;
+  int number;
+  int i;
+
+  memset(record, 0, sizeof(record));
+  idPtr = (icedrifterData*)record;
+  idPtr->idSwitches = PROCESS_REMOTE_TEMP_SWITCH | (fbPtr->fbLayout << RECORD_LAYOUT_SHIFT);
+  idPtr->idLastBootTime = FIRST_SEND_TIME - 600;
+  idPtr->idGPSTime = sendTime - 60;
+
+  // Drift a little further each report.
+  fbPtr->fbLatitude += (randomUnit() - 0.3) * 0.05;
+  fbPtr->fbLongitude += (randomUnit() - 0.5) * 0.1;
+  idPtr->idLatitude = fbPtr->fbLatitude;
+  idPtr->idLongitude = fbPtr->fbLongitude;
+  idPtr->idTemperature = -1.8 + randomUnit() * 0.5;
+  idPtr->idPressure = 1000.0 + randomUnit() * 30.0;
+  idPtr->idRemoteTemp = -2.0 + randomUnit();
+
+  if (fbPtr->fbLayout == RECORD_LAYOUT) {
+    idPtr->idSwitches |= CHECK_MEMORY_USE_SWITCH;
+    idPtr->idMinFreeMemory = 500 + randomUnit() * 300;
+    idPtr->idMinFreePhase = MEM_PHASE_TRANSMIT;
+    idPtr->idBootReason = BOOT_POWER_ON;
+
+    // A day of readings 15 minutes apart around the reading for the report.
+    idPtr->idSampleCount = 96;
+    idPtr->idSampleInterval = 15;
+    idPtr->idPressureMean = idPtr->idPressure + (randomUnit() - 0.5) * 4.0;
+    idPtr->idPressureVariance = randomUnit() * 9.0;
+    idPtr->idPressureMin = idPtr->idPressureMean - 5.0 - randomUnit() * 5.0;
+    idPtr->idPressureMax = idPtr->idPressureMean + 5.0 + randomUnit() * 5.0;
+    idPtr->idTemperatureMean = idPtr->idTemperature;
+    idPtr->idTemperatureVariance = randomUnit() * 0.1;
+    idPtr->idTemperatureMin = idPtr->idTemperature - randomUnit();
+    idPtr->idTemperatureMax = idPtr->idTemperature + randomUnit();
+    idPtr->idRemoteTempMean = idPtr->idRemoteTemp;
+    idPtr->idRemoteTempVariance = randomUnit() * 0.1;
+    idPtr->idRemoteTempMin = idPtr->idRemoteTemp - randomUnit();
+    idPtr->idRemoteTempMax = idPtr->idRemoteTemp + randomUnit();
+    idPtr->idPressureMinTime = idPtr->idTemperatureMinTime = idPtr->idRemoteTempMinTime =
+      idPtr->idGPSTime - (uint32_t)(randomUnit() * 86400);
+    idPtr->idPressureMaxTime = idPtr->idTemperatureMaxTime = idPtr->idRemoteTempMaxTime =
+      idPtr->idGPSTime - (uint32_t)(randomUnit() * 86400);
+
+    // A swell with a little of everything else.
+    idPtr->idBurstSamples = BURST_SEGMENTS * BURST_SEGMENT_LENGTH;
+    idPtr->idBurstEnergy0 = randomUnit() * 10.0;
+    idPtr->idBurstEnergy1 = randomUnit() * 50.0;
+    idPtr->idBurstEnergy2 = randomUnit() * 500.0;
+    idPtr->idBurstEnergy3 = 1000.0 + randomUnit() * 4000.0;
+    idPtr->idBurstEnergy4 = randomUnit() * 100.0;
+    idPtr->idBurstSigAmp = 4.0 * sqrt(idPtr->idBurstEnergy0 + idPtr->idBurstEnergy1 + idPtr->idBurstEnergy2 +
+                                      idPtr->idBurstEnergy3 + idPtr->idBurstEnergy4);
+    idPtr->idBurstPeakPeriod = 50 + randomUnit() * 100;
+  }
+
+  if (fbPtr->fbTempCount != 0) {
+    idPtr->idSwitches |= PROCESS_CHAIN_DATA_SWITCH;
+    idPtr->idTempByteCount = fbPtr->fbTempCount * sizeof(uint16_t);
+    idPtr->idLightByteCount = fbPtr->fbLightCount * LIGHT_SENSOR_FIELDS * sizeof(uint16_t);
+    wkPtr = (uint8_t*)&idPtr->idChainData;
+
+    if (fbPtr->fbLayout != 0) {
+      idPtr->idTempSensorCount = fbPtr->fbTempCount;
+      idPtr->idLightSensorCount = fbPtr->fbLightCount;
+    }
+
+    // Temperatures fall with depth, in the 1/128 degree units of the chain.
+    for (i = 0; i < fbPtr->fbTempCount; ++i, wkPtr += 2) {
+      putBigEndian(wkPtr, (uint16_t)(int16_t)((-1.5 + (i * 0.02) + randomUnit() * 0.1) * 128.0));
+    }
+
+    // Light falls off with depth too.  Every version sends it right after
+    // the temperature data it actually has.
+    for (i = 0; i < fbPtr->fbLightCount; ++i, wkPtr += 8) {
+      putBigEndian(wkPtr, 20000 / (i + 1));
+      putBigEndian(wkPtr + 2, 6000 / (i + 1));
+      putBigEndian(wkPtr + 4, 7000 / (i + 1));
+      putBigEndian(wkPtr + 6, 5000 / (i + 1));
+    }
+  }
+
+  // v6.5 has a shorter header, so its chain data starts sooner.
+  if (fbPtr->fbLayout == 0) {
+    memmove(record + V65_HEADER_LENGTH, record + BASE_RECORD_LENGTH, sizeof(record) - BASE_RECORD_LENGTH);
+  }
+
+  length = reportLength(fbPtr);
+
+  for (offset = number = 0; offset < length; offset += MAX_CHUNK_DATA_LENGTH, ++number) {
+    if (randomUnit() * 100.0 < missingPercent) {
+      continue;
+    }
+
+    fcPtr = addChunk();
+    memset(fcPtr, 0, sizeof(fleetChunk));
+    fcPtr->fcBuoy = buoy;
+    fcPtr->fcSendTime = sendTime;
+    fcPtr->fcChunk.idcSendTime = sendTime;
+    fcPtr->fcChunk.idcRecordType[0] = 'I';
+    fcPtr->fcChunk.idcRecordType[1] = 'D';
+    fcPtr->fcChunk.idcRecordNumber = number;
+    fcPtr->fcLength = (length - offset < MAX_CHUNK_DATA_LENGTH) ? length - offset : MAX_CHUNK_DATA_LENGTH;
+    memcpy(fcPtr->fcChunk.idcBuffer, &record[offset], fcPtr->fcLength);
+    fcPtr->fcLength += CHUNK_HEADER_SIZE;
+  }
+}
+
+static int compareArrival(const void* a, const void* b) {
+  const fleetChunk* aPtr = a;
+  const fleetChunk* bPtr = b;
+
+  return ((aPtr->fcArrival > bPtr->fcArrival) - (aPtr->fcArrival < bPtr->fcArrival));
+}
+
+static int compareReport(const void* a, const void* b) {
+  const fleetChunk* aPtr = &chunkList[*(const int*)a];
+  const fleetChunk* bPtr = &chunkList[*(const int*)b];
+
+  if (aPtr->fcBuoy != bPtr->fcBuoy) {
+    return (aPtr->fcBuoy - bPtr->fcBuoy);
+  }
+
+  if (aPtr->fcSendTime != bPtr->fcSendTime) {
+    return ((aPtr->fcSendTime > bPtr->fcSendTime) ? 1 : -1);
+  }
+
+  return (*(const int*)a - *(const int*)b);
+}
+
+//*****************************************************************************
+//
+// markDone
+//
+// Marks the delivery that completes each report, which is the first time
+// every chunk of the report has been delivered.  The chunk list must be in
+// arrival order.
+//
+// returns the number of reports that complete.
+//
+//*****************************************************************************
+
+static int markDone(fleetBuoy* buoyList) {
+  uint8_t seen[MAX_RECORD_CHUNKS];
+  fleetChunk* fcPtr;
+  int* order;
+  int needed;
+  int found;
+  int done;
+  int i;
+
+  if ((order = malloc(chunkCount * sizeof(int))) == NULL) {
+    printf("Error: Out of memory!\n");
+    exit(1);
+  }
+
+  for (i = 0; i < chunkCount; ++i) {
+    order[i] = i;
+  }
+
+  // Group the chunks by report, each report's chunks in arrival order.
+  qsort(order, chunkCount, sizeof(int), compareReport);
+  done = found = 0;
+
+  for (i = 0; i < chunkCount; ++i) {
+    fcPtr = &chunkList[order[i]];
+
+    if ((i == 0) || (chunkList[order[i - 1]].fcBuoy != fcPtr->fcBuoy) ||
+        (chunkList[order[i - 1]].fcSendTime != fcPtr->fcSendTime)) {
+      memset(seen, 0, sizeof(seen));
+      found = 0;
+    }
+
+    needed = CHUNK_COUNT(reportLength(&buoyList[fcPtr->fcBuoy]));
+
+    if (!seen[fcPtr->fcChunk.idcRecordNumber]) {
+      seen[fcPtr->fcChunk.idcRecordNumber] = 1;
+
+      if (++found == needed) {
+        fcPtr->fcDone = true;
+        ++done;
+      }
+    }
+  }
+
+  free(order);
+  return (done);
+}
+
+static void writeBase64(FILE* fd, uint8_t* data, int length) {
+  static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  uint32_t val;
+  int i;
+
+  for (i = 0; i < length; i += 3) {
+    val = data[i] << 16;
+    val |= (i + 1 < length) ? data[i + 1] << 8 : 0;
+    val |= (i + 2 < length) ? data[i + 2] : 0;
+    fputc(base64Chars[(val >> 18) & 0x3F], fd);
+    fputc(base64Chars[(val >> 12) & 0x3F], fd);
+    fputc((i + 1 < length) ? base64Chars[(val >> 6) & 0x3F] : '=', fd);
+    fputc((i + 2 < length) ? base64Chars[val & 0x3F] : '=', fd);
+
+    if ((i % 57) == 54) {
+      fputc('\n', fd);
+    }
+  }
+
+  fputc('\n', fd);
+}
+
+//*****************************************************************************
+//
+// writeFleet
+//
+// Writes the chunk list in all three delivery formats and the arrival list.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int writeFleet(char* outDir, fleetBuoy* buoyList) {
+  char fileName[FILE_NAME_SIZE];
+  fleetChunk* fcPtr;
+  fleetBuoy* fbPtr;
+  FILE* listFd;
+  FILE* mboxFd;
+  FILE* fd;
+  uint8_t* wkPtr;
+  int i;
+  int j;
+
+  snprintf(fileName, sizeof(fileName), "%s/bin", outDir);
+  mkdir(outDir, 0775);
+  mkdir(fileName, 0775);
+  snprintf(fileName, sizeof(fileName), "%s/hex", outDir);
+  mkdir(fileName, 0775);
+  snprintf(fileName, sizeof(fileName), "%s/hex/new", outDir);
+  mkdir(fileName, 0775);
+  snprintf(fileName, sizeof(fileName), "%s/hex/cur", outDir);
+  mkdir(fileName, 0775);
+  snprintf(fileName, sizeof(fileName), "%s/hex/tmp", outDir);
+  mkdir(fileName, 0775);
+
+  snprintf(fileName, sizeof(fileName), "%s/fleet.list", outDir);
+  listFd = fopen(fileName, "w");
+  snprintf(fileName, sizeof(fileName), "%s/fleet.mbox", outDir);
+  mboxFd = fopen(fileName, "w");
+
+  if ((listFd == NULL) || (mboxFd == NULL)) {
+    printf("Error: Unable to create the fleet files in %s!\n", outDir);
+    return (1);
+  }
+
+  for (i = 0; i < chunkCount; ++i) {
+    fcPtr = &chunkList[i];
+    fbPtr = &buoyList[fcPtr->fcBuoy];
+    ++fbPtr->fbMomsn;
+
+    snprintf(fileName, sizeof(fileName), "%s/bin/%llu-%u.bin", outDir,
+             (unsigned long long)fbPtr->fbImei, fbPtr->fbMomsn);
+
+    if (((fd = fopen(fileName, "wb")) == NULL) || (fwrite(&fcPtr->fcChunk, 1, fcPtr->fcLength, fd) != (size_t)fcPtr->fcLength)) {
+      printf("Error: Unable to write %s!\n", fileName);
+      return (1);
+    }
+
+    fclose(fd);
+    fprintf(listFd, "bin/%llu-%u.bin %llu %08x %d %d\n", (unsigned long long)fbPtr->fbImei, fbPtr->fbMomsn,
+            (unsigned long long)fbPtr->fbImei, fcPtr->fcSendTime, fcPtr->fcChunk.idcRecordNumber, fcPtr->fcDone);
+
+    // RockBLOCK delivery email with the data as hex in the body.
+    snprintf(fileName, sizeof(fileName), "%s/hex/new/%u.M%d.fleetgen", outDir, FIRST_SEND_TIME + i, i);
+
+    if ((fd = fopen(fileName, "w")) == NULL) {
+      printf("Error: Unable to write %s!\n", fileName);
+      return (1);
+    }
+
+    fprintf(fd, "From: no-reply@rockblock.rock7.com\nSubject: Message %u from RockBLOCK %d\n\n",
+            fbPtr->fbMomsn, fcPtr->fcBuoy);
+    fprintf(fd, "IMEI: %llu\r\nMOMSN: %u\r\nData: ", (unsigned long long)fbPtr->fbImei, fbPtr->fbMomsn);
+    wkPtr = (uint8_t*)&fcPtr->fcChunk;
+
+    for (j = 0; j < fcPtr->fcLength; ++j) {
+      fprintf(fd, "%02x", wkPtr[j]);
+    }
+
+    fprintf(fd, "\r\n");
+    fclose(fd);
+
+    // Iridium delivery email with the data as an .sbd attachment.
+    fprintf(mboxFd, "From sbdservice@sbd.iridium.com Tue Mar  1 00:00:00 2022\n");
+    fprintf(mboxFd, "From: sbdservice@sbd.iridium.com\nSubject: SBD Msg From Unit: %llu\n",
+            (unsigned long long)fbPtr->fbImei);
+    fprintf(mboxFd, "MIME-Version: 1.0\nContent-Type: multipart/mixed; boundary=\"SBD.%d\"\n\n", i);
+    fprintf(mboxFd, "--SBD.%d\nContent-Type: text/plain\n\nMOMSN: %u\nMTMSN: 0\n\n", i, fbPtr->fbMomsn);
+    fprintf(mboxFd, "--SBD.%d\nContent-Type: application/x-zip-compressed; name=\"%llu_%06u.sbd\"\n", i,
+            (unsigned long long)fbPtr->fbImei, fbPtr->fbMomsn);
+    fprintf(mboxFd, "Content-Disposition: attachment; filename=\"%llu_%06u.sbd\"\n",
+            (unsigned long long)fbPtr->fbImei, fbPtr->fbMomsn);
+    fprintf(mboxFd, "Content-Transfer-Encoding: base64\n\n");
+    writeBase64(mboxFd, (uint8_t*)&fcPtr->fcChunk, fcPtr->fcLength);
+    fprintf(mboxFd, "--SBD.%d--\n\n", i);
+  }
+
+  fclose(listFd);
+
+  if (fclose(mboxFd) != 0) {
+    printf("Error: Unable to write the fleet mbox!\n");
+    return (1);
+  }
+
+  return (0);
+}
+
+int main(int argc, char** argv) {
+  fleetBuoy* buoyList;
+  char* chainSize;
+  int buoyCount;
+  int reportCount;
+  int duplicatePercent;
+  int missingPercent;
+  bool reorder;
+  int argIx;
+  int generated;
+  int duplicates;
+  int done;
+  int i;
+  int j;
+
+  buoyCount = 100;
+  reportCount = 10;
+  chainSize = "mixed";
+  duplicatePercent = 0;
+  missingPercent = 0;
+  reorder = false;
+  srand(1);
+
+  for (argIx = 1; (argIx < argc - 1) && (argv[argIx][0] == '-'); argIx += 2) {
+    switch (argv[argIx][1]) {
+      case 'b':
+        buoyCount = atoi(argv[argIx + 1]);
+        break;
+
+      case 'r':
+        reportCount = atoi(argv[argIx + 1]);
+        break;
+
+      case 'c':
+        chainSize = argv[argIx + 1];
+        break;
+
+      case 'd':
+        duplicatePercent = atoi(argv[argIx + 1]);
+        break;
+
+      case 'm':
+        missingPercent = atoi(argv[argIx + 1]);
+        break;
+
+      case 'o':
+        reorder = true;
+        --argIx;
+        break;
+
+      case 's':
+        srand(atoi(argv[argIx + 1]));
+        break;
+
+      default:
+        argIx = argc;
+        break;
+    }
+  }
+
+  if ((argIx != argc - 1) || (buoyCount < 1) || (reportCount < 1) ||
+      ((strcmp(chainSize, "16/6") != 0) && (strcmp(chainSize, "160/64") != 0) && (strcmp(chainSize, "mixed") != 0))) {
+    printf("fleetgen [-b <buoys>] [-r <reports per buoy>] [-c 16/6 | 160/64 | mixed]\n");
+    printf("         [-d <duplicate percent>] [-m <missing percent>] [-o]\n");
+    printf("         [-s <seed>] <output directory>\n");
+    exit(1);
+  }
+
+  if ((buoyList = calloc(buoyCount, sizeof(fleetBuoy))) == NULL) {
+    printf("Error: Out of memory!\n");
+    exit(1);
+  }
+
+  // Mixed fleets have buoys without a chain, with the short chain and
+  // with the full chain, which are one, one and three chunks a report.
+  for (i = 0; i < buoyCount; ++i) {
+    buoyList[i].fbImei = FIRST_IMEI + i;
+    buoyList[i].fbLayout = (i & 1) ? RECORD_LAYOUT : 0;
+    buoyList[i].fbLatitude = 72.0 + randomUnit() * 10.0;
+    buoyList[i].fbLongitude = -180.0 + randomUnit() * 360.0;
+
+    if ((strcmp(chainSize, "160/64") == 0) || ((strcmp(chainSize, "mixed") == 0) && (i % 3 == 2))) {
+      buoyList[i].fbTempCount = 160;
+      buoyList[i].fbLightCount = 64;
+    } else if ((strcmp(chainSize, "16/6") == 0) || (i % 3 == 1)) {
+      buoyList[i].fbTempCount = 16;
+      buoyList[i].fbLightCount = 6;
+    }
+  }
+
+  // The buoys report at staggered times, so the chunks of one report land
+  // next to each other.
+  for (j = 0; j < reportCount; ++j) {
+    for (i = 0; i < buoyCount; ++i) {
+      buildReport(&buoyList[i], i, FIRST_SEND_TIME + (j * REPORT_INTERVAL) + i, missingPercent);
+    }
+  }
+
+  generated = chunkCount;
+  duplicates = 0;
+
+  for (i = 0; i < generated; ++i) {
+    chunkList[i].fcArrival = i;
+
+    // Chunks that arrive out of order land a few places from where they
+    // were sent.
+    if (reorder) {
+      chunkList[i].fcArrival += randomUnit() * REORDER_WINDOW;
+    }
+  }
+
+  // A duplicate arrives some time after the original, up to two rounds of
+  // reports later.
+  for (i = 0; i < generated; ++i) {
+    if (randomUnit() * 100.0 < duplicatePercent) {
+      addChunk();
+      chunkList[chunkCount - 1] = chunkList[i];
+      chunkList[chunkCount - 1].fcArrival += 1.0 + randomUnit() * buoyCount * 2;
+      ++duplicates;
+    }
+  }
+
+  qsort(chunkList, chunkCount, sizeof(fleetChunk), compareArrival);
+  done = markDone(buoyList);
+
+  if (writeFleet(argv[argc - 1], buoyList) != 0) {
+    exit(1);
+  }
+
+  printf("Fleet: %d buoys, %d reports, %d chunks written (%d duplicates), %d reports complete.\n",
+         buoyCount, buoyCount * reportCount, chunkCount, duplicates, done);
+  return (0);
+}
@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <avr/wdt.h>
+
+#include "icedrifter.h"
+#include "bootstate.h"
+
+bootState bootData;  // The state as of the last save.
+uint8_t bootReason;  // BOOT_xxx of this boot.
+
+static uint8_t bootSlot;  // Slot bootData was read from or last saved to.
+
+// Optiboot clears MCUSR before it starts the sketch and hands the reset
+// flags over in r2, so save r2 before the C runtime uses it.  Without
+// Optiboot r2 holds whatever was left in it, so it is only looked at when
+// MCUSR is clear.
+
+uint8_t bootResetFlags __attribute__((section(".noinit")));
+
+void bootSaveResetFlags(void) __attribute__((naked, used, section(".init0")));
+
+void bootSaveResetFlags(void) {
+  __asm__ __volatile__("sts %0, r2\n" : "=m"(bootResetFlags) :);
+}
+
+static uint8_t bootStateSum(bootState* bsPtr) {
+  uint8_t* wkPtr;
+  uint8_t sum;
+  uint8_t i;
+
+  wkPtr = (uint8_t*)bsPtr;
+  sum = 0;
+
+  for (i = 0; i < sizeof(bootState); ++i) {
+    sum += wkPtr[i];
+  }
+
+  return (sum);
+}
+
+static int bootSlotAddr(uint8_t slot) {
+  return (BOOT_STATE_EEPROM_ADDR + (slot * sizeof(bootState)));
+}
+
+// bootStateInit - Called first thing in setup.  Works out why the processor
+// was reset and reads the last saved state.  Returns true if this is a warm
+// restart, a brownout or watchdog reset with a good saved state, in which
+// case bootData holds the state to carry on with.  Otherwise bootData is
+// cleared for a cold boot.
+
+bool bootStateInit(void) {
+
+  bootState bs;
+  uint16_t sequence;
+  uint8_t flags;
+  uint8_t slot;
+  bool found;
+
+  flags = MCUSR;
+  MCUSR = 0;
+
+  if (flags == 0) {
+    flags = bootResetFlags;
+  }
+
+  // A watchdog reset leaves the watchdog running with its shortest timeout.
+  wdt_disable();
+
+  // A power on sets BORF as well as PORF and is always a cold boot.
+  if (flags & _BV(PORF)) {
+    bootReason = BOOT_POWER_ON;
+  } else if (flags & _BV(WDRF)) {
+    bootReason = BOOT_WATCHDOG;
+  } else if (flags & _BV(BORF)) {
+    bootReason = BOOT_BROWNOUT;
+  } else if (flags & _BV(EXTRF)) {
+    bootReason = BOOT_EXTERNAL;
+  } else {
+    bootReason = BOOT_UNKNOWN;
+  }
+
+  found = false;
+
+  for (slot = 0; slot < BOOT_STATE_SLOTS; ++slot) {
+    EEPROM.get(bootSlotAddr(slot), bs);
+
+    if (bs.bsMagic != BOOT_STATE_MAGIC || bootStateSum(&bs) != 0) {
+      continue;
+    }
+
+    // The sequence number wraps, so compare the difference.
+    if (!found || (int16_t)(bs.bsSequence - bootData.bsSequence) > 0) {
+      bootData = bs;
+      bootSlot = slot;
+      found = true;
+    }
+  }
+
+  if (found && (bootReason == BOOT_BROWNOUT || bootReason == BOOT_WATCHDOG)) {
+    ++bootData.bsResetCount;
+    return (true);
+  }
+
+  // A cold boot keeps only the sequence so the next save still goes to
+  // the next slot.
+  sequence = found ? bootData.bsSequence : 0;
+  memset(&bootData, 0, sizeof(bootData));
+  bootData.bsSequence = sequence;
+
+  if (!found) {
+    bootSlot = BOOT_STATE_SLOTS - 1;
+  }
+
+  return (false);
+}
+
+// bootStateSave - Writes bootData to the next slot.  Called once every time
+// through the loop and after each report, so each slot is written only a
+// few times a day.
+
+void bootStateSave(void) {
+
+  bootSlot = (bootSlot + 1) % BOOT_STATE_SLOTS;
+  ++bootData.bsSequence;
+  bootData.bsMagic = BOOT_STATE_MAGIC;
+  bootData.bsBootReason = bootReason;
+  bootData.bsCheck = 0;
+  bootData.bsCheck = -bootStateSum(&bootData);
+
+  // EEPROM.put only writes the bytes that changed.
+  EEPROM.put(bootSlotAddr(bootSlot), bootData);
+}
@@ -0,0 +1,37 @@
+#ifndef _BOOTSTATE_H
+#define _BOOTSTATE_H
+
+#include "icedrifter.h"
+
+// The state the icedrifter needs to carry on after a reset is kept in
+// EEPROM after the chain topology.  Each save goes to the next of
+// BOOT_STATE_SLOTS slots so no one slot wears out, and the slot with the
+// highest sequence number is the current state.
+#define BOOT_STATE_EEPROM_ADDR  16
+#define BOOT_STATE_SLOTS        8
+#define BOOT_STATE_MAGIC        0xB7  // change when bootState changes.
+
+// bsFlags
+#define BOOT_GOT_FULL_FIX  0x01
+
+typedef struct bootState {
+  uint8_t bsMagic;
+  uint8_t bsBootReason;       // BOOT_xxx of the reset before this state was saved.
+  uint16_t bsSequence;        // counts up with every save.
+  uint8_t bsFlags;
+  uint8_t bsNoFixFoundCount;
+  uint8_t bsHeartbeatsLeft;   // heartbeats to send before the next full report.
+  uint16_t bsResetCount;      // warm restarts since the last cold boot.
+  time_t bsLastBootTime;      // time of the last cold boot.
+  time_t bsLastFixTime;       // GPS time of the last fix, starts the clock after a warm restart.
+  time_t bsLastReportTime;    // GPS time of the last report sent.
+  uint8_t bsCheck;            // makes the bytes of the slot sum to 0.
+} bootState;
+
+extern bootState bootData;
+extern uint8_t bootReason;
+
+bool bootStateInit(void);
+void bootStateSave(void);
+
+#endif // _BOOTSTATE_H
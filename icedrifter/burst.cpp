@@ -0,0 +1,346 @@
+#include <Arduino.h>
+
+#include "icedrifter.h"
+#include "ms5837_02ba.h"
+#include "burst.h"
+
+#ifdef PRESSURE_BURST
+
+static_assert((BURST_SEGMENT_LENGTH & (BURST_SEGMENT_LENGTH - 1)) == 0,
+              "BURST_SEGMENT_LENGTH is not a power of two");
+
+#define BURST_BINS (BURST_SEGMENT_LENGTH / 2)
+
+// The largest reading given to the FFT.  Two readings make each complex
+// point, and each stage of the FFT halves its results, so values below
+// this can never overflow.
+#define BURST_FULL_SCALE 16383
+
+// The largest of the 16 bit peak sums.
+#define BURST_PEAK_LIMIT 65535UL
+
+static_assert(BURST_BANDS == 5, "the record has five band energies");
+
+static const uint16_t burstEdges[BURST_BANDS + 1] = BURST_BAND_EDGES;
+
+// Everything the burst works on, kept on the stack only while it runs.
+// The energies are summed by band as each segment is done, and the power
+// of each bin is only kept as a 16 bit sum for finding the peak.
+typedef struct burstWork {
+  int16_t bwData[BURST_SEGMENT_LENGTH];
+  uint16_t bwPeak[BURST_BINS];  // power of each bin in units of bwPeakUnit.
+  float bwPeakUnit;
+  float bwEnergy[BURST_BANDS];
+} burstWork;
+
+// burstRead - Reads one segment of pressures into data as ubar from base,
+// the first pressure of the burst, BURST_SAMPLE_HZ times a second.
+
+static void burstRead(int16_t* data, float* basePtr) {
+
+  uint32_t next;
+  float pressure;
+  long delta;
+  int i;
+
+  next = millis();
+
+  for (i = 0; i < BURST_SEGMENT_LENGTH; ++i) {
+    pressure = readMs5837Pressure();
+
+    if (isnan(*basePtr)) {
+      *basePtr = pressure;
+    }
+
+    // The MS5837 gives mbar.
+    delta = lround((pressure - *basePtr) * 1000.0);
+    data[i] = constrain(delta, -32767L, 32767L);
+
+    next += 1000 / BURST_SAMPLE_HZ;
+
+    while ((long)(millis() - next) < 0) {
+    }
+  }
+}
+
+// burstFft - An in place radix 2 FFT of the BURST_BINS complex points in
+// data, each a real part followed by an imaginary part, in 16 bit fixed
+// point.  Every stage halves its results, so the results are the transform
+// divided by BURST_BINS.
+
+static void burstFft(int16_t* data) {
+
+  int16_t wr;
+  int16_t wi;
+  int16_t swap;
+  int32_t tr;
+  int32_t ti;
+  int size;
+  int half;
+  int bit;
+  int i;
+  int j;
+  int k;
+
+  // Put the inputs in bit reversed order.
+  for (i = 1, j = 0; i < BURST_BINS; ++i) {
+    for (bit = BURST_BINS >> 1; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+
+    j ^= bit;
+
+    if (i < j) {
+      swap = data[2 * i];
+      data[2 * i] = data[2 * j];
+      data[2 * j] = swap;
+      swap = data[2 * i + 1];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j + 1] = swap;
+    }
+  }
+
+  for (size = 2; size <= BURST_BINS; size <<= 1) {
+    half = size >> 1;
+
+    for (k = 0; k < half; ++k) {
+      // The twiddle factor in Q15.
+      wr = lround(cos(-2.0 * M_PI * k / size) * 32767.0);
+      wi = lround(sin(-2.0 * M_PI * k / size) * 32767.0);
+
+      for (i = 2 * k; i < BURST_SEGMENT_LENGTH; i += 2 * size) {
+        j = i + 2 * half;
+        tr = (((int32_t)wr * data[j]) - ((int32_t)wi * data[j + 1])) >> 15;
+        ti = (((int32_t)wr * data[j + 1]) + ((int32_t)wi * data[j])) >> 15;
+        data[j] = (data[i] - tr) >> 1;
+        data[j + 1] = (data[i + 1] - ti) >> 1;
+        data[i] = (data[i] + tr) >> 1;
+        data[i + 1] = (data[i + 1] + ti) >> 1;
+      }
+    }
+  }
+}
+
+// burstBin - Returns the power of bin k, from 1 to BURST_BINS - 1, of the
+// real segment whose transform burstFft left in data, divided by the
+// square of BURST_SEGMENT_LENGTH.  The even readings went in as the real
+// parts and the odd readings as the imaginary parts, so the transforms of
+// the two are pulled apart here and then put together as one.
+
+static float burstBin(int16_t* data, int k) {
+
+  float evenRe;
+  float evenIm;
+  float oddRe;
+  float oddIm;
+  float wr;
+  float wi;
+  float re;
+  float im;
+  int a;
+  int b;
+
+  a = 2 * k;
+  b = 2 * (BURST_BINS - k);
+  evenRe = ((float)data[a] + data[b]) / 2.0;
+  evenIm = ((float)data[a + 1] - data[b + 1]) / 2.0;
+  oddRe = ((float)data[a + 1] + data[b + 1]) / 2.0;
+  oddIm = ((float)data[b] - data[a]) / 2.0;
+  wr = cos(2.0 * M_PI * k / BURST_SEGMENT_LENGTH);
+  wi = -sin(2.0 * M_PI * k / BURST_SEGMENT_LENGTH);
+
+  // The FFT divided by BURST_BINS, so halve again.
+  re = (evenRe + (wr * oddRe) - (wi * oddIm)) / 2.0;
+  im = (evenIm + (wr * oddIm) + (wi * oddRe)) / 2.0;
+  return ((re * re) + (im * im));
+}
+
+// burstBand - Returns the band bin i falls in, or -1 if it is outside all
+// of them.
+
+static int burstBand(int i) {
+
+  uint32_t freq;
+  int band;
+
+  freq = ((uint32_t)i * 1000UL * BURST_SAMPLE_HZ) / BURST_SEGMENT_LENGTH;
+
+  for (band = 0; band < BURST_BANDS; ++band) {
+    if (freq >= burstEdges[band] && freq < burstEdges[band + 1]) {
+      return (band);
+    }
+  }
+
+  return (-1);
+}
+
+// burstAddPeak - Adds power to the 16 bit sum of bin i.  All of the sums
+// are halved and bwPeakUnit doubled whenever one of them would overflow,
+// which only loses power far below the peak.
+
+static void burstAddPeak(burstWork* bwPtr, int i, float power) {
+
+  float value;
+  int j;
+
+  if (bwPtr->bwPeakUnit == 0) {
+    return;
+  }
+
+  value = power / bwPtr->bwPeakUnit;
+
+  while (bwPtr->bwPeak[i] + value > BURST_PEAK_LIMIT) {
+    for (j = 0; j < BURST_BINS; ++j) {
+      bwPtr->bwPeak[j] >>= 1;
+    }
+
+    bwPtr->bwPeakUnit *= 2.0;
+    value /= 2.0;
+  }
+
+  bwPtr->bwPeak[i] += lround(value);
+}
+
+// burstSegment - Takes the mean and any steady rise or fall of the
+// weather out of the segment in bwData, windows it, and adds the power of
+// each bin of its FFT to the band energies and the peak sums.
+
+static void burstSegment(burstWork* bwPtr) {
+
+  int32_t sum;
+  float slopeSum;
+  float maxDelta;
+  float mean;
+  float slope;
+  float center;
+  float delta;
+  float gain;
+  float window;
+  float windowSum;
+  float scale;
+  float power;
+  float maxPower;
+  int band;
+  int i;
+
+  // Fit a straight line to the segment.
+  center = (BURST_SEGMENT_LENGTH - 1) / 2.0;
+  sum = 0;
+  slopeSum = 0;
+
+  for (i = 0; i < BURST_SEGMENT_LENGTH; ++i) {
+    sum += bwPtr->bwData[i];
+    slopeSum += (i - center) * bwPtr->bwData[i];
+  }
+
+  mean = (float)sum / BURST_SEGMENT_LENGTH;
+  slope = slopeSum / ((float)BURST_SEGMENT_LENGTH * ((float)BURST_SEGMENT_LENGTH * BURST_SEGMENT_LENGTH - 1) / 12.0);
+  maxDelta = 0;
+
+  for (i = 0; i < BURST_SEGMENT_LENGTH; ++i) {
+    if (fabs(bwPtr->bwData[i] - mean - slope * (i - center)) > maxDelta) {
+      maxDelta = fabs(bwPtr->bwData[i] - mean - slope * (i - center));
+    }
+  }
+
+  // Scale the segment up or down to use as many bits as the FFT can.
+  gain = (maxDelta == 0) ? 1.0 : BURST_FULL_SCALE / maxDelta;
+  windowSum = 0;
+
+  for (i = 0; i < BURST_SEGMENT_LENGTH; ++i) {
+    // A Hann window keeps the power of one bin from leaking into the rest.
+    window = 0.5 - 0.5 * cos(2.0 * M_PI * i / BURST_SEGMENT_LENGTH);
+    windowSum += window * window;
+    delta = bwPtr->bwData[i] - mean - slope * (i - center);
+    bwPtr->bwData[i] = lround(delta * gain * window);
+  }
+
+  burstFft(bwPtr->bwData);
+
+  // Undo the gain and the halving in the FFT.  The one sided power of a
+  // bin, divided by the power of the window, is the variance of the
+  // pressure in that bin, and the segments are averaged.
+  scale = BURST_SEGMENT_LENGTH / gain;
+  scale *= scale;
+  scale *= 2.0 / (BURST_SEGMENTS * (float)BURST_SEGMENT_LENGTH * windowSum);
+
+  // The first segment sets the unit of the peak sums so that segments
+  // like it add up without overflowing.
+  if (bwPtr->bwPeakUnit == 0) {
+    maxPower = 0;
+
+    for (i = 1; i < BURST_BINS; ++i) {
+      if (burstBand(i) >= 0) {
+        power = burstBin(bwPtr->bwData, i) * scale;
+
+        if (power > maxPower) {
+          maxPower = power;
+        }
+      }
+    }
+
+    bwPtr->bwPeakUnit = maxPower / (BURST_PEAK_LIMIT / BURST_SEGMENTS);
+  }
+
+  for (i = 1; i < BURST_BINS; ++i) {
+    if ((band = burstBand(i)) >= 0) {
+      power = burstBin(bwPtr->bwData, i) * scale;
+      bwPtr->bwEnergy[band] += power;
+      burstAddPeak(bwPtr, i, power);
+    }
+  }
+}
+
+// burstRun - Takes the burst of pressure readings and puts the band
+// energies, significant amplitude and peak period in the record.  The
+// sensors must already be powered up.  If the MS5837 does not answer,
+// idBurstSamples is left at zero.
+
+void burstRun(icedrifterData* idPtr) {
+
+  burstWork bw;
+  float base;
+  uint16_t peak;
+  int peakBin;
+  int i;
+
+  idPtr->idBurstSamples = 0;
+
+  if (!startMs5837()) {
+    return;
+  }
+
+  memset(bw.bwPeak, 0, sizeof(bw.bwPeak));
+  memset(bw.bwEnergy, 0, sizeof(bw.bwEnergy));
+  bw.bwPeakUnit = 0;
+  base = NAN;
+
+  for (i = 0; i < BURST_SEGMENTS; ++i) {
+    burstRead(bw.bwData, &base);
+    burstSegment(&bw);
+  }
+
+  stopMs5837();
+
+  peakBin = 0;
+  peak = 0;
+
+  for (i = 1; i < BURST_BINS; ++i) {
+    if (bw.bwPeak[i] > peak) {
+      peak = bw.bwPeak[i];
+      peakBin = i;
+    }
+  }
+
+  idPtr->idBurstEnergy0 = bw.bwEnergy[0];
+  idPtr->idBurstEnergy1 = bw.bwEnergy[1];
+  idPtr->idBurstEnergy2 = bw.bwEnergy[2];
+  idPtr->idBurstEnergy3 = bw.bwEnergy[3];
+  idPtr->idBurstEnergy4 = bw.bwEnergy[4];
+  idPtr->idBurstSigAmp = 4.0 * sqrt(bw.bwEnergy[0] + bw.bwEnergy[1] + bw.bwEnergy[2] + bw.bwEnergy[3] + bw.bwEnergy[4]);
+  idPtr->idBurstPeakPeriod = (peakBin == 0) ? 0 :
+    lround((10.0 * BURST_SEGMENT_LENGTH) / ((float)peakBin * BURST_SAMPLE_HZ));
+  idPtr->idBurstSamples = BURST_SEGMENTS * BURST_SEGMENT_LENGTH;
+}
+
+#endif // PRESSURE_BURST
@@ -0,0 +1,15 @@
+#ifndef _BURST_H
+#define _BURST_H
+
+#include "icedrifter.h"
+
+// A burst of pressure readings, reduced on the icedrifter to the energy in
+// each of the BURST_BANDS bands by averaging the spectra of its segments.
+
+#ifdef PRESSURE_BURST
+void burstRun(icedrifterData* idPtr);
+#else
+#define burstRun(idPtr)
+#endif // PRESSURE_BURST
+
+#endif // _BURST_H
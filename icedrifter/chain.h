@@ -1,7 +1,8 @@
-
 #ifndef CHAIN_H
 #define CHAIN_H
 
+#include "icedrifter.h"
+
 #define CHAIN_POWER_PIN 1
 #define CHAIN_RX 3
 #define CHAIN_TX 2 //swapped
@@ -9,6 +10,27 @@
 // Number of minutes to wait while reading chain data before it times out.
 #define CHAIN_READ_TIMEOUT  3UL
 
-int processChainData(uint8_t* tempDataPtr, uint8_t* lightDataPtr);
+// Number of milliseconds of silence on the chain after the last byte that
+// marks the end of a response during topology discovery.
+#define CHAIN_IDLE_MS 2000UL
+
+// The chain topology discovered at boot is cached in EEPROM so a chain that
+// fails to answer during discovery still gets read with the last known sizes.
+#define CHAIN_TOPOLOGY_EEPROM_ADDR  0
+#define CHAIN_TOPOLOGY_MAGIC        0xC7
+
+typedef struct chainTopology {
+  uint8_t ctMagic;
+  uint8_t ctTempSensorCount;
+  uint8_t ctLightSensorCount;
+  uint8_t ctCheck;  // ctTempSensorCount ^ ctLightSensorCount ^ ctMagic
+} chainTopology;
+
+extern uint8_t chainTempSensorCount;
+extern uint8_t chainLightSensorCount;
+
+void chainLoadTopology(void);
+void chainDiscoverTopology(void);
+void processChainData(icedrifterData* idPtr);
 
-#endif 
+#endif
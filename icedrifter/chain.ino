@@ -1,12 +1,172 @@
 #include <SoftwareSerial.h>
+#include <EEPROM.h>
 
 #include "icedrifter.h"
 #include "chain.h"
+#include "trace.h"
 
 #ifdef PROCESS_CHAIN_DATA
 
 SoftwareSerial schain(CHAIN_RX, CHAIN_TX); 
 
+// Number of sensors actually on the chain.  These start out at the maximum
+// the record can hold and are set by chainDiscoverTopology at boot.
+uint8_t chainTempSensorCount = TEMP_SENSOR_COUNT;
+uint8_t chainLightSensorCount = LIGHT_SENSOR_COUNT;
+
+// Power up the chain and start talking to it.
+
+void chainPowerUp(void) {
+
+  int i;
+
+#ifdef SERIAL_DEBUG
+  DEBUG_SERIAL.print(F("\nPowering up chain.\n"));
+#endif // SERIAL_DEBUG
+
+  digitalWrite(CHAIN_POWER_PIN, HIGH);
+  traceEvent(TRACE_POWER_ON, TRACE_RAIL_CHAIN);
+
+  // 15 second delay for the chain hardware to initialize.
+  for(i = 0; i < 15; ++i) {
+    delay(1000);
+  }
+
+  schain = SoftwareSerial(CHAIN_RX, CHAIN_TX); 
+
+  schain.begin(9600);
+  schain.flush();
+  schain.listen();
+
+  // check to see of there is an extranious byte in the buffer.
+  if (schain.available()) {
+    schain.read();
+  }
+}
+
+// Stop talking to the chain and turn it off.
+
+void chainPowerDown(void) {
+  schain.flush();
+  schain.end();
+  digitalWrite(CHAIN_POWER_PIN, LOW);
+  traceEvent(TRACE_POWER_OFF, TRACE_RAIL_CHAIN);
+#ifdef DROP_CHAIN_RX_TX
+  digitalWrite(CHAIN_RX, LOW);
+  digitalWrite(CHAIN_TX, LOW);
+#endif // DROP_CHAIN_RX_TX
+  delay(1000);
+}
+
+// Count the bytes the chain sends back in response to a command.  The count
+// stops at maxBytes + 1 so an overrun can still be detected, and ends when
+// the chain has been quiet for CHAIN_IDLE_MS after the first byte or when
+// the normal chain read timeout has passed.
+
+uint16_t chainCountResponse(const __FlashStringHelper* cmd, uint16_t maxBytes) {
+
+  uint16_t byteCount;
+  uint32_t startTime;
+  uint32_t lastByteTime;
+
+  schain.print(cmd);
+  startTime = lastByteTime = millis();
+  byteCount = 0;
+
+  while (byteCount <= maxBytes) {
+    if (schain.available()) {
+      schain.read();
+      ++byteCount;
+      lastByteTime = millis();
+    } else if (byteCount != 0 && (millis() - lastByteTime) > CHAIN_IDLE_MS) {
+      break;
+    }
+
+    if ((millis() - startTime) > (CHAIN_READ_TIMEOUT * 60UL * 1000UL)) {
+      break;
+    }
+  }
+
+  // Throw away anything past the maximum.
+  while (schain.available()) {
+    schain.read();
+  }
+
+  return (byteCount);
+}
+
+// chainLoadTopology - Sets the sensor counts from the topology cached in
+// EEPROM, if there is one.  Used on its own after a warm restart, when the
+// chain does not need to be asked again.
+
+void chainLoadTopology(void) {
+
+  chainTopology ct;
+
+  EEPROM.get(CHAIN_TOPOLOGY_EEPROM_ADDR, ct);
+
+  if (ct.ctMagic == CHAIN_TOPOLOGY_MAGIC &&
+      ct.ctCheck == (ct.ctMagic ^ ct.ctTempSensorCount ^ ct.ctLightSensorCount) &&
+      ct.ctTempSensorCount <= TEMP_SENSOR_COUNT &&
+      ct.ctLightSensorCount <= LIGHT_SENSOR_COUNT) {
+    chainTempSensorCount = ct.ctTempSensorCount;
+    chainLightSensorCount = ct.ctLightSensorCount;
+  }
+}
+
+// chainDiscoverTopology - Called once from setup.  Asks the chain for its
+// temperature and light data and counts the bytes returned to learn how many
+// sensors are actually present.  A good result is cached in EEPROM.  If the
+// chain does not answer, the cached topology is used, and if there is none
+// the maximum sensor counts are assumed.
+
+void chainDiscoverTopology(void) {
+
+  uint16_t tempBytes;
+  uint16_t lightBytes;
+  chainTopology ct;
+
+  chainLoadTopology();
+  chainPowerUp();
+  tempBytes = chainCountResponse(F("+1::chain\n"), TEMP_DATA_SIZE);
+  lightBytes = chainCountResponse(F("+1::light\n"), LIGHT_DATA_SIZE);
+  chainPowerDown();
+
+#ifdef SERIAL_DEBUG_CHAIN
+  DEBUG_SERIAL.print(F("Chain discovery found "));
+  DEBUG_SERIAL.print(tempBytes);
+  DEBUG_SERIAL.print(F(" temp bytes and "));
+  DEBUG_SERIAL.print(lightBytes);
+  DEBUG_SERIAL.print(F(" light bytes.\n"));
+#endif // SERIAL_DEBUG_CHAIN
+
+  // Only trust a response that is a whole number of sensors and fits the record.
+  if (tempBytes == 0 || tempBytes > TEMP_DATA_SIZE ||
+      (tempBytes % sizeof(uint16_t)) != 0 ||
+      lightBytes > LIGHT_DATA_SIZE ||
+      (lightBytes % (LIGHT_SENSOR_FIELDS * sizeof(uint16_t))) != 0) {
+#ifdef SERIAL_DEBUG_CHAIN
+    DEBUG_SERIAL.print(F("Chain discovery failed, using "));
+    DEBUG_SERIAL.print(chainTempSensorCount);
+    DEBUG_SERIAL.print(F("/"));
+    DEBUG_SERIAL.print(chainLightSensorCount);
+    DEBUG_SERIAL.print(F(" sensors.\n"));
+#endif // SERIAL_DEBUG_CHAIN
+    return;
+  }
+
+  chainTempSensorCount = tempBytes / sizeof(uint16_t);
+  chainLightSensorCount = lightBytes / (LIGHT_SENSOR_FIELDS * sizeof(uint16_t));
+
+  ct.ctMagic = CHAIN_TOPOLOGY_MAGIC;
+  ct.ctTempSensorCount = chainTempSensorCount;
+  ct.ctLightSensorCount = chainLightSensorCount;
+  ct.ctCheck = ct.ctMagic ^ ct.ctTempSensorCount ^ ct.ctLightSensorCount;
+
+  // EEPROM.put only writes the bytes that changed.
+  EEPROM.put(CHAIN_TOPOLOGY_EEPROM_ADDR, ct);
+}
+
 void processChainData(icedrifterData* idPtr) {
 
   int i = 0;
@@ -16,6 +176,8 @@ void processChainData(icedrifterData* idPtr) {
 //  int main(int argc, char *argv[]) {
 //    ,nn
 //  }
+  uint16_t tempDataSize;
+  uint16_t lightDataSize;
   uint8_t* buffPtr;
   uint8_t* wkPtr;
   uint16_t* wordPtr;
@@ -32,37 +194,21 @@ void processChainData(icedrifterData* idPtr) {
   uint8_t rgbGreen;
   uint8_t rgbBlue;
 
-#ifdef SERIAL_DEBUG
-  DEBUG_SERIAL.print(F("\nPowering up chain.\n"));
-#endif // SERIAL_DEBUG
-
-  digitalWrite(CHAIN_POWER_PIN, HIGH);
-
-  // 15 second delay for the chain hardware to initialize.
-  for(i = 0; i < 15; ++i) {
-    delay(1000);
-  }
-
-  wkPtr = (uint8_t*)&idPtr->idChainData;
+  tempDataSize = chainTempSensorCount * sizeof(uint16_t);
+  lightDataSize = chainLightSensorCount * LIGHT_SENSOR_FIELDS * sizeof(uint16_t);
 
-  for (i = 0; i < TEMP_DATA_SIZE + LIGHT_DATA_SIZE; ++i) {
-    *wkPtr = 0;
-  }
+  idPtr->idTempSensorCount = chainTempSensorCount;
+  idPtr->idLightSensorCount = chainLightSensorCount;
 
-  schain = SoftwareSerial(CHAIN_RX, CHAIN_TX); 
+  memset(&idPtr->idChainData, 0, sizeof(idPtr->idChainData));
 
-  schain.begin(9600);
-  schain.flush();
-  schain.listen();
+  chainPowerUp();
 
+  // The light data is stored right after the temperature data actually
+  // received so the record only carries the sensors that are present.
   buffPtr = (uint8_t *)&idPtr->idChainData;
   idPtr->idcdError = 0;
 
-  // check to see of there is an extranious byte in the buffer.
-  if (schain.available()) {
-    schain.read();
-  }
-
 //#ifdef SERIAL_DEBUG
 //  DEBUG_SERIAL.print(F("Sending +1::debug=0\\n\n"));
 //#endif
@@ -79,7 +225,7 @@ void processChainData(icedrifterData* idPtr) {
   startTime = millis();
   idPtr->idTempByteCount = 0;
 
-  while (idPtr->idTempByteCount < (TEMP_DATA_SIZE)) {
+  while (idPtr->idTempByteCount < tempDataSize) {
     if (schain.available()) {
       *buffPtr = schain.read();
       ++buffPtr;
@@ -99,7 +245,7 @@ void processChainData(icedrifterData* idPtr) {
 
   if (idPtr->idcdError & TEMP_CHAIN_TIMEOUT_ERROR) {
     DEBUG_SERIAL.print(F("\nTimeout on temp chain!!!\n"));
-    DEBUG_SERIAL.print((TEMP_DATA_SIZE));
+    DEBUG_SERIAL.print(tempDataSize);
     DEBUG_SERIAL.print(F(" bytes requested but only "));
     DEBUG_SERIAL.print(idPtr->idTempByteCount);
     DEBUG_SERIAL.print(F(" bytes received\n"));
@@ -116,14 +262,11 @@ void processChainData(icedrifterData* idPtr) {
     DEBUG_SERIAL.print(F("\n"));
 #endif // SERIAL_DEBUG
 
-    schain.flush();
-    schain.end();
-    digitalWrite(CHAIN_POWER_PIN, LOW);
-#ifdef DROP_CHAIN_RX_TX
-    digitalWrite(CHAIN_RX, LOW);
-    digitalWrite(CHAIN_TX, LOW);
-#endif // DROP_CHAIN_RX_TX
-    delay(1000);
+    // The light chain is never read, so the trace only gets the
+    // temperature count and the error.
+    traceEvent(TRACE_CHAIN_TEMP, idPtr->idTempByteCount / sizeof(uint16_t));
+    traceEvent(TRACE_CHAIN_ERROR, idPtr->idcdError);
+    chainPowerDown();
     return;
   }
 
@@ -136,7 +279,7 @@ void processChainData(icedrifterData* idPtr) {
   idPtr->idLightByteCount = 0;
 
 
-  while (idPtr->idLightByteCount < (LIGHT_DATA_SIZE)) {
+  while (idPtr->idLightByteCount < lightDataSize) {
     if (schain.available()) {
       *buffPtr = schain.read();
       ++idPtr->idLightByteCount;
@@ -156,9 +299,9 @@ void processChainData(icedrifterData* idPtr) {
   DEBUG_SERIAL.print(idPtr->idLightByteCount);
   DEBUG_SERIAL.print(F(" bytes of light data.\n"));
 
-  if (chainError != 0) {
+  if (idPtr->idcdError & LIGHT_CHAIN_TIMEOUT_ERROR) {
     DEBUG_SERIAL.print(F("\nTimeout on light chain!!!\n"));
-    DEBUG_SERIAL.print(LIGHT_DATA_SIZE);
+    DEBUG_SERIAL.print(lightDataSize);
     DEBUG_SERIAL.print(F(" bytes requested but only "));
     DEBUG_SERIAL.print(idPtr->idLightByteCount);
     DEBUG_SERIAL.print(F(" bytes received\n"));
@@ -172,20 +315,20 @@ void processChainData(icedrifterData* idPtr) {
 #endif // SERIAL_DEBUG
   }
 
+  traceEvent(TRACE_CHAIN_TEMP, idPtr->idTempByteCount / sizeof(uint16_t));
+  traceEvent(TRACE_CHAIN_LIGHT, idPtr->idLightByteCount / (LIGHT_SENSOR_FIELDS * sizeof(uint16_t)));
+
+  if (idPtr->idcdError != 0) {
+    traceEvent(TRACE_CHAIN_ERROR, idPtr->idcdError);
+  }
+
 #ifdef SERIAL_DEBUG
   DEBUG_SERIAL.print(F("\nReturning with idData.idcdError = "));
   DEBUG_SERIAL.print(idPtr->idcdError);
   DEBUG_SERIAL.print(F("\n"));
 #endif // SERIAL_DEBUG
 
-  schain.flush();
-  schain.end();
-  digitalWrite(CHAIN_POWER_PIN, LOW);
-#ifdef DROP_CHAIN_RX_TX
-  digitalWrite(CHAIN_RX, LOW);
-  digitalWrite(CHAIN_TX, LOW);
-#endif // DROP_CHAIN_RX_TX
-  delay(1000);
+  chainPowerDown();
 }
 
 #endif // PROCESS_CHAIN_DATA
@@ -5,6 +5,7 @@
 
 #include "icedrifter.h"
 #include "gps.h"
+#include "trace.h"
 
 #define GET_FIX_COUNT_MAX  2
 #define FIX_FND_COUNT_MAX  10
@@ -129,6 +130,13 @@ else {
   GPS_SERIAL.end();
 //  digitalWrite(GPS_POWER_PIN, HIGH);
 //   setSerialMuxOff();
+
+  traceEvent(TRACE_FIX, fixfnd);
+
+  if (fixfnd) {
+    traceSetTime(idData->idGPSTime);
+  }
+
   return (fixfnd);
 }
 
@@ -7,6 +7,7 @@
 
 #ifndef _ICEDRIFTER_H
 #define _ICEDRIFTER_H
+#include <stddef.h>
 #include <time.h>
 
 #define HARDWARE_VERSION "6.6"
@@ -73,6 +74,66 @@
 
 #define PROCESS_REMOTE_TEMP
 
+// The CHECK_MEMORY_USE switch fills the free memory between the heap and
+// the stack with a pattern at boot and looks at how much of it is left at
+// each step of the work.  The least free memory seen and the step it was
+// seen in are sent with every report.  Comment out the next line to leave
+// the fields empty.
+
+#define CHECK_MEMORY_USE
+
+// The TIERED_REPORTS switch sends a heartbeat in most report slots instead
+// of the full report.  A heartbeat has just the time, position, pressure
+// and remote temperature and goes out as one 21 byte message, one credit.
+// The full report, with the chain data, is sent in the first slot after
+// boot, then every FULL_REPORT_INTERVAL slots, and in the slot after a
+// message starting with FULL_REPORT_REQUEST is sent to the icedrifter.  A
+// message to the icedrifter is only picked up when a heartbeat is sent.
+// Comment out the next line to send the full report in every slot.
+
+#define TIERED_REPORTS
+#define FULL_REPORT_INTERVAL 4
+#define FULL_REPORT_REQUEST "FULL"
+
+// The SAMPLE_BETWEEN_REPORTS switch wakes the icedrifter every
+// SAMPLE_INTERVAL_MINUTES while it sleeps to read the pressure and the
+// temperatures.  The number of readings and the mean, variance, minimum
+// and maximum of each, with the times of the minimum and maximum, are sent
+// in the next full report along with the readings taken for the report.
+// The GPS shares the power of the sensors, so each reading keeps the GPS
+// on for about two seconds.  Comment out the next line to only read the
+// sensors for the reports.
+
+#define SAMPLE_BETWEEN_REPORTS
+#define SAMPLE_INTERVAL_MINUTES 15
+
+// The PRESSURE_BURST switch reads the pressure BURST_SAMPLE_HZ times a
+// second for BURST_SEGMENTS segments of BURST_SEGMENT_LENGTH readings
+// before each full report, which is about 8.5 minutes with the values
+// below.  Each segment is put through a fixed point FFT on the icedrifter
+// and the spectra of the segments are averaged.  The energy in each of
+// the bands below, the significant amplitude and the peak period are sent
+// with the report.  BURST_SEGMENT_LENGTH must be a power of two, and the
+// burst takes about 3 bytes of stack for each reading in a segment while
+// it runs, 800 bytes with the values below.  The GPS shares the power of
+// the sensors and stays on for the burst.  Comment out the next line to
+// leave the burst fields empty.
+
+#define PRESSURE_BURST
+#define BURST_SAMPLE_HZ       2
+#define BURST_SEGMENT_LENGTH  256
+#define BURST_SEGMENTS        4
+
+// The COMPRESS_RECORDS switch compresses the record before it is cut into
+// chunks when that saves at least one chunk.  Every chunk of a compressed
+// record has CHUNK_COMPRESSED set in its record number.  The compressor
+// works straight from the record and needs only a few bytes of memory,
+// but it reads the record twice, once to see how short it gets and once
+// to send it.  Comment out the next line to always send the record as it
+// is.
+
+#define COMPRESS_RECORDS
+
 #ifdef ARDUINO
 
 // The next define controls whether or not data from the temperature and light
@@ -82,9 +143,14 @@
 
 #define DROP_CHAIN_RX_TX
 
-// These defines are used to determine how many sensors are on the temperature and
-// light chain.  They are only used if PROCESS_CHAIN_DATA is defined so you do not
-// need to change them if no chain hardware is attached.
+// These defines set the maximum number of sensors the temperature and light
+// chain can have.  The number actually attached is discovered when the
+// icedrifter boots and only that many sensors are read and sent.  The
+// chain data buffer in idData is always this big, and the full
+// specification of 160/64 sensors would take 832 bytes of the 2K of SRAM.
+// Keep these at the size of the chain deployed, and check the memory use
+// with CHECK_MEMORY_USE before making them larger.  They are only used if
+// PROCESS_CHAIN_DATA is defined.
 //#define TEMP_SENSOR_COUNT   160
 //#define LIGHT_SENSOR_COUNT  64
 #define TEMP_SENSOR_COUNT   16
@@ -109,7 +175,6 @@
 #define PROCESS_CHAIN_DATA
 #define TEMP_SENSOR_COUNT   160
 #define LIGHT_SENSOR_COUNT  64
-#define MAX_RECORD_LENGTH   340
 // *****************************************************************************************
 #endif // ARDUINO
 
@@ -126,49 +191,174 @@ typedef struct chainData {
   uint16_t cdLightData[LIGHT_SENSOR_COUNT][LIGHT_SENSOR_FIELDS];
 } chainData;
 
-//icedrifter data record definition.
-typedef struct icedrifterData {
-  uint8_t idSwitches;
-
 #define PROCESS_REMOTE_TEMP_SWITCH  0x01
 #define PROCESS_CHAIN_DATA_SWITCH   0x02
-  
-  uint8_t idcdError; 
+#define CHECK_MEMORY_USE_SWITCH     0x04
+#define HEARTBEAT_SWITCH            0x08  // only set by the decoder, in records made from a heartbeat.
+
+// The top three bits of the switches give the layout of the record so the
+// decoder can tell the records of each hardware version apart.  v6.5 sends
+// layout 0.  Change RECORD_LAYOUT whenever the record layout changes.
+#define RECORD_LAYOUT_MASK   0xE0
+#define RECORD_LAYOUT_SHIFT  5
+#define RECORD_LAYOUT        4
 
+// idcdError bits.
 #define TEMP_CHAIN_TIMEOUT_ERROR  0x01
 #define TEMP_CHAIN_OVERRUN_ERROR  0x02
 #define LIGHT_CHAIN_TIMEOUT_ERROR 0x04
 #define LIGHT_CHAIN_OVERRUN_ERROR 0x08
 
-  uint16_t idTempByteCount; 
-  uint16_t idLightByteCount;
-
-  uint16_t idSpare;
-
+// idMinFreePhase, the step of the work the least free memory was seen in.
+#define MEM_PHASE_NONE      0  // no less than when the memory was filled at boot.
+#define MEM_PHASE_BOOT      1
+#define MEM_PHASE_LOOP      2  // the hourly time check between reports.
+#define MEM_PHASE_GPS       3
+#define MEM_PHASE_SENSORS   4
+#define MEM_PHASE_CHAIN     5
+#define MEM_PHASE_FORMAT    6
+#define MEM_PHASE_TRANSMIT  7
+#define MEM_PHASE_BURST     8
+
+// idBootReason, why the processor was last reset.
+#define BOOT_UNKNOWN    0
+#define BOOT_POWER_ON   1
+#define BOOT_EXTERNAL   2  // reset button.
+#define BOOT_BROWNOUT   3
+#define BOOT_WATCHDOG   4
+
+// The frequency bands of the pressure burst spectrum, as the edges
+// between them in thousandths of a Hz.  Band 0 is ice motion and
+// infragravity waves, bands 1 to 3 are swell and wind waves, and band 4 is
+// chop and vibration.
+#define BURST_BANDS 5
+#define BURST_BAND_EDGES {8, 40, 100, 200, 500, 1000}
+
+// Times are sent as 32 bit seconds.  The icedrifter's time_t is 32 bits,
+// the decoder's usually is not.
 #ifdef ARDUINO
-  time_t idLastBootTime;
-  time_t idGPSTime;
+typedef time_t recordTime;
 #else
-  uint32_t idLastBootTime;
-  uint32_t idGPSTime; 
+typedef uint32_t recordTime;
 #endif // ARDUINO
 
-  float idLatitude;
-  float idLongitude;
-  float idTemperature;
-  float idPressure;
-  float idRemoteTemp;
-
-  #define BASE_RECORD_LENGTH  36
+// The header of the record, every field in the order it is sent.  The
+// icedrifterData structure, BASE_RECORD_LENGTH, and the decoder's reader
+// for the current RECORD_LAYOUT are all built from this one list, so a
+// header field is only ever added or changed here.  Each entry is
+// FIELD(name, type, storage, id): storage is how the decoder reads the
+// field (U8, U16, U32 or FLOAT) and id names it in the decoder (FIELD_id).
+//
+// idTempSensorCount and idLightSensorCount are the number of sensors on the
+// chain when the record was built.  They are zero in records from
+// icedrifters that do not discover the chain topology.  idMinFreeMemory is
+// only good if CHECK_MEMORY_USE_SWITCH is set.  The statistics of the
+// sensor readings since the last full report follow, and are only good if
+// idSampleCount is not zero.  Their times are in icedrifter seconds, which
+// are seconds since boot until the first GPS fix.  The pressure burst
+// spectrum comes last and is only good if idBurstSamples is not zero.  The
+// band energies are the variance of the pressure in each band in ubar^2,
+// the significant amplitude is four times the square root of their sum in
+// ubar, and the peak period is in tenths of a second.
+#define RECORD_HEADER_FIELDS(FIELD) \
+  FIELD(idSwitches,         uint8_t,    U8,    SWITCHES)      \
+  FIELD(idcdError,          uint8_t,    U8,    ERROR)         \
+  FIELD(idTempByteCount,    uint16_t,   U16,   TEMP_BYTES)    \
+  FIELD(idLightByteCount,   uint16_t,   U16,   LIGHT_BYTES)   \
+  FIELD(idTempSensorCount,  uint8_t,    U8,    TEMP_SENSORS)  \
+  FIELD(idLightSensorCount, uint8_t,    U8,    LIGHT_SENSORS) \
+  FIELD(idLastBootTime,     recordTime, U32,   BOOT_TIME)     \
+  FIELD(idGPSTime,          recordTime, U32,   GPS_TIME)      \
+  FIELD(idLatitude,         float,      FLOAT, LATITUDE)      \
+  FIELD(idLongitude,        float,      FLOAT, LONGITUDE)     \
+  FIELD(idTemperature,      float,      FLOAT, TEMPERATURE)   \
+  FIELD(idPressure,         float,      FLOAT, PRESSURE)      \
+  FIELD(idRemoteTemp,       float,      FLOAT, REMOTE_TEMP)   \
+  FIELD(idMinFreeMemory,    uint16_t,   U16,   MIN_FREE)      \
+  FIELD(idMinFreePhase,     uint8_t,    U8,    MIN_FREE_PHASE) \
+  FIELD(idBootReason,       uint8_t,    U8,    BOOT_REASON)   \
+  FIELD(idSampleCount,      uint16_t,   U16,   SAMPLE_COUNT)  \
+  FIELD(idSampleInterval,   uint16_t,   U16,   SAMPLE_INTERVAL) \
+  RECORD_STAT_FIELDS(FIELD, idPressure,   PRESSURE)          \
+  RECORD_STAT_FIELDS(FIELD, idTemperature, TEMPERATURE)      \
+  RECORD_STAT_FIELDS(FIELD, idRemoteTemp, REMOTE_TEMP)      \
+  FIELD(idBurstEnergy0,     float,      FLOAT, BURST_ENERGY_0) \
+  FIELD(idBurstEnergy1,     float,      FLOAT, BURST_ENERGY_1) \
+  FIELD(idBurstEnergy2,     float,      FLOAT, BURST_ENERGY_2) \
+  FIELD(idBurstEnergy3,     float,      FLOAT, BURST_ENERGY_3) \
+  FIELD(idBurstEnergy4,     float,      FLOAT, BURST_ENERGY_4) \
+  FIELD(idBurstSigAmp,      float,      FLOAT, BURST_SIG_AMP)  \
+  FIELD(idBurstPeakPeriod,  uint16_t,   U16,   BURST_PEAK_PERIOD) \
+  FIELD(idBurstSamples,     uint16_t,   U16,   BURST_SAMPLES)
+
+// The statistics of one sensor, named after the field of its reading.
+#define RECORD_STAT_FIELDS(FIELD, name, id) \
+  FIELD(name##Mean,         float,      FLOAT, id##_MEAN)     \
+  FIELD(name##Variance,     float,      FLOAT, id##_VARIANCE) \
+  FIELD(name##Min,          float,      FLOAT, id##_MIN)      \
+  FIELD(name##Max,          float,      FLOAT, id##_MAX)      \
+  FIELD(name##MinTime,      recordTime, U32,   id##_MIN_TIME) \
+  FIELD(name##MaxTime,      recordTime, U32,   id##_MAX_TIME)
+
+#define RECORD_FIELD_MEMBER(name, type, storage, id) type name;
+#define RECORD_FIELD_SIZE(name, type, storage, id) + sizeof(type)
+#define RECORD_FIELD_ONE(name, type, storage, id) + 1
+
+// Length of the record without chain data, and the number of header fields.
+#define BASE_RECORD_LENGTH (0 RECORD_HEADER_FIELDS(RECORD_FIELD_SIZE))
+#define RECORD_HEADER_FIELD_COUNT (0 RECORD_HEADER_FIELDS(RECORD_FIELD_ONE))
+
+//icedrifter data record definition.  The record is sent straight from the
+// structure, so the structure must not have any padding.
+typedef struct icedrifterData {
+  RECORD_HEADER_FIELDS(RECORD_FIELD_MEMBER)
 
 #ifdef PROCESS_CHAIN_DATA
   chainData idChainData;
 #endif // PROCESS_CHAIN_DATA
 
+} icedrifterData;
+
+// Length of a record carrying the given number of chain sensors.
+#define RECORD_LENGTH(tempCount, lightCount) \
+  (BASE_RECORD_LENGTH + ((tempCount) * sizeof(uint16_t)) + \
+   ((lightCount) * LIGHT_SENSOR_FIELDS * sizeof(uint16_t)))
+
+// Length of the longest record this build can send or receive.
+#ifdef PROCESS_CHAIN_DATA
+#define MAX_RECORD_LENGTH RECORD_LENGTH(TEMP_SENSOR_COUNT, LIGHT_SENSOR_COUNT)
+#else
+#define MAX_RECORD_LENGTH BASE_RECORD_LENGTH
+#endif // PROCESS_CHAIN_DATA
+
+// Checks on the record layout that are made when the code is compiled.
+#ifdef __cplusplus
+#define RECORD_ASSERT(test, message) static_assert(test, message)
+#else
+#define RECORD_ASSERT(test, message) _Static_assert(test, message)
+#endif // __cplusplus
+
+#define RECORD_SIZE_U8    1
+#define RECORD_SIZE_U16   2
+#define RECORD_SIZE_U32   4
+#define RECORD_SIZE_FLOAT 4
+
+#define RECORD_FIELD_CHECK(name, type, storage, id) \
+  RECORD_ASSERT(sizeof(type) == RECORD_SIZE_##storage, #name " is not the size it is sent as");
+
+RECORD_HEADER_FIELDS(RECORD_FIELD_CHECK)
+
+#ifdef PROCESS_CHAIN_DATA
+RECORD_ASSERT(offsetof(icedrifterData, idChainData) == BASE_RECORD_LENGTH,
+              "the record header has padding");
+#endif // PROCESS_CHAIN_DATA
+RECORD_ASSERT(sizeof(icedrifterData) == MAX_RECORD_LENGTH, "the record has padding");
+RECORD_ASSERT(BASE_RECORD_LENGTH == 144, "the record header changed, change RECORD_LAYOUT");
+
 #define MS5837_DS18B20_GPS_POWER_PIN 14
 
+#ifdef ARDUINO
 void printHexChar(uint8_t x);
-
-} icedrifterData;
+#endif // ARDUINO
 
 #endif // _ICEDRIFTER_H
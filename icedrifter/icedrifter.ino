@@ -43,6 +43,11 @@
 #endif //PROCESS_CHAIN_DATA
 
 #include "rockblock.h"
+#include "bootstate.h"
+#include "memcheck.h"
+#include "trace.h"
+#include "stats.h"
+#include "burst.h"
 
 #define CONSOLE_BAUD 115200
 
@@ -101,6 +106,11 @@ icedrifterData idData;  // Structure for accumulating and sending sensor data,
 
 time_t lbTime;  // Time and date of the last boot.
 
+bool warmStart;  // Set true in the setup function if the processor was reset
+                 // by a brownout or the watchdog and the saved state was restored.
+
+int sampleSecs;  // Seconds slept since the sensors were last read between reports.
+
 // print hex charactors mainly for debugging perposes.
 
 const char hexchars[] = "0123456789ABCDEF";
@@ -110,6 +120,59 @@ void printHexChar(uint8_t x) {
   Serial.print(hexchars[(x & 0x0f)]);
 }
 
+// A report is due on a report hour unless one was already sent that hour,
+// which happens when the icedrifter is reset right after reporting.
+
+bool reportDue(void) {
+  return (timeToReport[gpsGetHour()] == true &&
+          (idData.idGPSTime / 3600) != (bootData.bsLastReportTime / 3600));
+}
+
+// Save the state the icedrifter needs to carry on after a reset.
+
+void saveBootState(void) {
+  bootData.bsFlags = gotFullFix ? BOOT_GOT_FULL_FIX : 0;
+  bootData.bsNoFixFoundCount = noFixFoundCount;
+  bootData.bsLastBootTime = lbTime;
+
+  if (fixFound) {
+    bootData.bsLastFixTime = idData.idGPSTime;
+  }
+
+  bootStateSave();
+}
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+// Read the pressure and temperatures into idData while sleeping between
+// reports and add them to the statistics.  The readings are not traced so
+// they do not push the rest of the trace out of the ring.
+
+void sampleSensors(void) {
+#ifdef SERIAL_DEBUG
+  DEBUG_SERIAL.begin(CONSOLE_BAUD);
+#endif // SERIAL_DEBUG
+
+  digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, HIGH);
+  delay(1000);
+
+  getMs5837Data(&idData);
+
+#ifdef PROCESS_REMOTE_TEMP
+  getRemoteTemp(&idData);
+#else
+  idData.idRemoteTemp = 0;
+#endif // PROCESS_REMOTE_TEMP
+
+  digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, LOW);
+  statsAdd(&idData, traceTime());
+
+#ifdef SERIAL_DEBUG
+  DEBUG_SERIAL.flush();
+  DEBUG_SERIAL.end();
+#endif // SERIAL_DEBUG
+}
+#endif // SAMPLE_BETWEEN_REPORTS
+
 // Accumulate and send data. This function captures the sender
 // data and sends that data to the user.
 
@@ -120,6 +183,7 @@ void accumulateandsendData(void) {
   int chainRetryCount;
   int recCount;
   uint8_t* wkPtr;
+  bool fullReport;
 
 #ifdef SERIAL_DEBUG
   struct tm* debugtimeInfo;
@@ -127,8 +191,19 @@ void accumulateandsendData(void) {
   char debugbuff[32];
 #endif // SERIAL_DEBUG
 
+#ifdef TIERED_REPORTS
+  fullReport = (bootData.bsHeartbeatsLeft == 0);
+#else
+  fullReport = true;
+#endif // TIERED_REPORTS
+
   totalDataLength = BASE_RECORD_LENGTH;
   idData.idSwitches = idData.idTempByteCount = idData.idLightByteCount = idData.idcdError = 0;
+  idData.idTempSensorCount = idData.idLightSensorCount = 0;
+  idData.idMinFreeMemory = idData.idMinFreePhase = 0;
+  idData.idSampleCount = idData.idBurstSamples = 0;
+  idData.idBootReason = bootReason;
+  idData.idSwitches = RECORD_LAYOUT << RECORD_LAYOUT_SHIFT;
 
 #ifdef PROCESS_REMOTE_TEMP_SWITCH
   idData.idSwitches |= PROCESS_REMOTE_TEMP_SWITCH;
@@ -142,6 +217,7 @@ void accumulateandsendData(void) {
   idData.idLastBootTime = lbTime;
 
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, HIGH);
+  traceEvent(TRACE_POWER_ON, TRACE_RAIL_SENSORS);
   delay(1000);
 
   if ((fixFound = gpsGetFix(&idData)) == false) {
@@ -150,6 +226,8 @@ void accumulateandsendData(void) {
     idData.idLongitude = 0;
   }
 
+  memCheck(MEM_PHASE_GPS);
+
 #ifdef SERIAL_DEBUG_ROCKBLOCK
   debugtimeInfo = gmtime(&idData.idGPSTime);
   debugGMTPtr = asctime(debugtimeInfo);
@@ -167,14 +245,38 @@ void accumulateandsendData(void) {
   idData.idRemoteTemp = 0;
 #endif // PROCESS_REMOTE_TEMP
 
+  // Only a full report carries the pressure burst.
+  if (fullReport) {
+    burstRun(&idData);
+    memCheck(MEM_PHASE_BURST);
+  }
+
 // Turn off the power to the MS5837, DS18B20, and GPS.
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, LOW);
+  traceEvent(TRACE_POWER_OFF, TRACE_RAIL_SENSORS);
+
+  // The readings for the report are part of the statistics too.
+  statsAdd(&idData, traceTime());
+  statsPut(&idData);
+
+  memCheck(MEM_PHASE_SENSORS);
 
 #ifdef PROCESS_CHAIN_DATA
-  processChainData(&idData);
-  totalDataLength += (idData.idTempByteCount + idData.idLightByteCount);
+  // A heartbeat does not carry the chain data, so leave the chain off.
+  if (fullReport) {
+    processChainData(&idData);
+    totalDataLength += (idData.idTempByteCount + idData.idLightByteCount);
+    memCheck(MEM_PHASE_CHAIN);
+  }
 #endif  // PROCESS_CHAIN_DATA
 
+  // The memory used sending this report shows up in the next one.
+#ifdef CHECK_MEMORY_USE
+  idData.idSwitches |= CHECK_MEMORY_USE_SWITCH;
+  idData.idMinFreeMemory = memMinFree;
+  idData.idMinFreePhase = memMinFreePhase;
+#endif // CHECK_MEMORY_USE
+
   wkPtr = (uint8_t*)&idData;
 
 #ifdef SERIAL_DEBUG
@@ -193,17 +295,39 @@ void accumulateandsendData(void) {
   DEBUG_SERIAL.print(F("\n"));
 #endif // SERIAL_DEBUG
 
+  if (fullReport) {
 #ifdef HUMAN_READABLE_DISPLAY
-  rbTransmitIcedrifterData(&idData, 0);
+    rbTransmitIcedrifterData(&idData, 0);
 #else
-  rbTransmitIcedrifterData(&idData, totalDataLength);
+    rbTransmitIcedrifterData(&idData, totalDataLength);
 #endif // HUMAN_READABLE_DISPLAY
+    bootData.bsHeartbeatsLeft = FULL_REPORT_INTERVAL - 1;
+    statsClear();
+  } else if (rbTransmitHeartbeat(&idData)) {
+    // A full report was asked for, send it in the next slot.
+    bootData.bsHeartbeatsLeft = 0;
+  } else {
+    --bootData.bsHeartbeatsLeft;
+  }
+
+  memCheck(MEM_PHASE_TRANSMIT);
+
+  // Remember the report right away so a reset before the next save does
+  // not send it again.
+  bootData.bsLastReportTime = idData.idGPSTime;
+  saveBootState();
 }
 
 // setup - This is an arduino defined routine that is called only once after the processor is booted.
 
 void setup() {
 
+  // This has to come first to stop the watchdog after a watchdog reset.
+  warmStart = bootStateInit();
+  memFill();
+  traceInit();
+  traceEvent(TRACE_BOOT, bootReason);
+
   pinMode(MS5837_DS18B20_GPS_POWER_PIN, OUTPUT);
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, LOW);
 
@@ -218,18 +342,56 @@ void setup() {
 #ifdef SERIAL_DEBUG
   // Start the serial ports
   DEBUG_SERIAL.begin(CONSOLE_BAUD);
-  
-  delay(5000);  // Wait for the serial port to connect.
+
+  // Nobody is waiting at the serial port after a warm restart.
+  if (!warmStart) {
+    delay(5000);  // Wait for the serial port to connect.
+  }
 
   DEBUG_SERIAL.print(F("Icedrifter\nHardware version "));
   DEBUG_SERIAL.print(HARDWARE_VERSION);
   DEBUG_SERIAL.print(F("\nSoftware version "));
   DEBUG_SERIAL.print(SOFTWARE_VERSION);
+  DEBUG_SERIAL.print(F("\nBoot reason "));
+  DEBUG_SERIAL.print(bootReason);
+  DEBUG_SERIAL.print(warmStart ? F(" warm restart ") : F(" cold boot "));
+  DEBUG_SERIAL.print(bootData.bsResetCount);
   DEBUG_SERIAL.print(F("\n"));
   DEBUG_SERIAL.flush(); // Make sure the above message is displayed before continuing.
 #endif // SERIAL_DEBUG
 
-  firstTime = true;
+#ifdef PROCESS_CHAIN_DATA
+  // Find out how many sensors are really on the chain so the records
+  // we send are sized to match the hardware.  After a warm restart the
+  // topology found at the cold boot is still good.
+  if (warmStart) {
+    chainLoadTopology();
+  } else {
+    chainDiscoverTopology();
+  }
+#endif // PROCESS_CHAIN_DATA
+
+  // After a warm restart carry on where the icedrifter left off instead of
+  // starting over and reporting at boot again.
+  if (warmStart) {
+    firstTime = false;
+    lbTime = bootData.bsLastBootTime;
+    gotFullFix = (bootData.bsFlags & BOOT_GOT_FULL_FIX) != 0;
+    noFixFoundCount = bootData.bsNoFixFoundCount;
+
+    // Start the clock at the last fix rather than at zero, so times taken
+    // before the next fix still come after the ones already sent.
+    if (bootData.bsLastFixTime != 0) {
+      traceSetTime(bootData.bsLastFixTime);
+    }
+  } else {
+    firstTime = true;
+    lbTime = 0;
+    gotFullFix = false;
+    noFixFoundCount = 0;
+  }
+
+  memCheck(MEM_PHASE_BOOT);
 
 #ifdef SERIAL_DEBUG
   DEBUG_SERIAL.print(F("Setup done\n")); // Let the user know we are done with the setup function.
@@ -253,9 +415,10 @@ void loop() {
   int sleepSecs;  // Number of seconds to sleep before the processor is woken up.
   int sleepMins;  // Number of minutes to sleep before the processor is woken up.
 
-  noFixFoundCount = 0;  // clear the no fix found count.
+  traceEvent(TRACE_WAKE, 0);
 
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, HIGH);
+  traceEvent(TRACE_POWER_ON, TRACE_RAIL_SENSORS);
   delay(1000);
 
   // Try to get the GPS fix data.
@@ -268,7 +431,7 @@ void loop() {
     if (fixFound) {
     gotFullFix = true;
     noFixFoundCount = 0;
-    if (firstTime) {
+    if (firstTime || lbTime == 0) {
       lbTime = idData.idLastBootTime = idData.idGPSTime;
     }
   } else {
@@ -279,14 +442,14 @@ void loop() {
   accumulateandsendData();
 #elif defined(TRANSMIT_AT_BOOT)
   if (firstTime || 
-      ((fixFound && timeToReport[gpsGetHour()] == true) ||
+      ((fixFound && reportDue()) ||
        noFixFoundCount >= 24)) {
     noFixFoundCount = 0;
     accumulateandsendData();
   }
 #else // TRANSMIT_AT_BOOT
   if (!firstTime && 
-      (fixFound && timeToReport[gpsGetHour()] == true) ||
+      (fixFound && reportDue()) ||
       noFixFoundCount >= 24) {
     noFixFoundCount = 0;
     accumulateandsendData();
@@ -294,6 +457,7 @@ void loop() {
 #endif // TEST_ALL
 
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, HIGH);
+  traceEvent(TRACE_POWER_ON, TRACE_RAIL_SENSORS);
   delay(1000);
 
   // Accumulating and sending the data can take a while so update the time again.
@@ -301,7 +465,11 @@ void loop() {
   firstTime = false;
 
   digitalWrite(MS5837_DS18B20_GPS_POWER_PIN, LOW);
-  
+  traceEvent(TRACE_POWER_OFF, TRACE_RAIL_SENSORS);
+
+  saveBootState();
+  memCheck(MEM_PHASE_LOOP);
+
   // If a GPS fix was found
   if (fixFound) {
     // Calculate the minutes until the next half hour,
@@ -328,9 +496,23 @@ void loop() {
     sleepSecs = 3600;
   }
 
+  traceEvent(TRACE_SLEEP, sleepSecs / 60);
+
+  // The trace clock stops while the processor sleeps, so move it on by the
+  // time slept, eight seconds at a time.
   do {
     LowPower.powerDown(SLEEP_8S, ADC_OFF, BOD_OFF);
+    traceSleep(8);
     sleepSecs -= 8;
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+    sampleSecs += 8;
+
+    if (sampleSecs >= SAMPLE_INTERVAL_MINUTES * 60) {
+      sampleSensors();
+      sampleSecs = 0;
+    }
+#endif // SAMPLE_BETWEEN_REPORTS
   } while (sleepSecs > 0);
 
 #ifdef SERIAL_DEBUG
@@ -0,0 +1,96 @@
+#include <Arduino.h>
+
+#include "icedrifter.h"
+#include "lzss.h"
+
+#ifdef COMPRESS_RECORDS
+
+// lzssBegin - Starts compressing length bytes at data.  The data must stay
+// put until lzssRead has returned all of the stream.
+
+void lzssBegin(lzssState* lzPtr, const uint8_t* data, int length) {
+  lzPtr->lzData = data;
+  lzPtr->lzLength = length;
+  lzPtr->lzNext = 0;
+  lzPtr->lzBits = 0;
+  lzPtr->lzBitCount = 0;
+}
+
+// lzssToken - Finds the longest earlier copy of the next bytes and adds
+// the token for them to the waiting bits.
+
+static void lzssToken(lzssState* lzPtr) {
+
+  const uint8_t* dataPtr;
+  int bestLength;
+  int bestOffset;
+  int maxLength;
+  int length;
+  int start;
+  int i;
+
+  dataPtr = lzPtr->lzData + lzPtr->lzNext;
+  maxLength = lzPtr->lzLength - lzPtr->lzNext;
+
+  if (maxLength > LZSS_MAX_MATCH) {
+    maxLength = LZSS_MAX_MATCH;
+  }
+
+  start = (lzPtr->lzNext > LZSS_WINDOW) ? LZSS_WINDOW : lzPtr->lzNext;
+  bestLength = 0;
+  bestOffset = 0;
+
+  // The nearest copy is tried first, so of two as long the nearer wins.
+  for (i = 1; (i <= start) && (bestLength < maxLength); ++i) {
+    for (length = 0; (length < maxLength) && (dataPtr[length - i] == dataPtr[length]); ++length) {
+    }
+
+    if (length > bestLength) {
+      bestLength = length;
+      bestOffset = i;
+    }
+  }
+
+  if (bestLength >= LZSS_MIN_MATCH) {
+    lzPtr->lzBits = (lzPtr->lzBits << (1 + LZSS_OFFSET_BITS + LZSS_LENGTH_BITS)) |
+                    (1UL << (LZSS_OFFSET_BITS + LZSS_LENGTH_BITS)) |
+                    ((uint32_t)(bestOffset - 1) << LZSS_LENGTH_BITS) |
+                    (bestLength - LZSS_MIN_MATCH);
+    lzPtr->lzBitCount += 1 + LZSS_OFFSET_BITS + LZSS_LENGTH_BITS;
+    lzPtr->lzNext += bestLength;
+  } else {
+    lzPtr->lzBits = (lzPtr->lzBits << 9) | *dataPtr;
+    lzPtr->lzBitCount += 9;
+    ++lzPtr->lzNext;
+  }
+}
+
+// lzssRead - Puts up to size more bytes of the stream in out.  Returns the
+// number of bytes put there, which is less than size only at the end of
+// the stream.
+
+int lzssRead(lzssState* lzPtr, uint8_t* out, int size) {
+
+  int count;
+
+  count = 0;
+
+  while (count < size) {
+    if (lzPtr->lzBitCount >= 8) {
+      lzPtr->lzBitCount -= 8;
+      out[count++] = lzPtr->lzBits >> lzPtr->lzBitCount;
+    } else if (lzPtr->lzNext < lzPtr->lzLength) {
+      lzssToken(lzPtr);
+    } else if (lzPtr->lzBitCount > 0) {
+      // Pad the last byte out with 0 bits.
+      out[count++] = lzPtr->lzBits << (8 - lzPtr->lzBitCount);
+      lzPtr->lzBitCount = 0;
+    } else {
+      break;
+    }
+  }
+
+  return (count);
+}
+
+#endif // COMPRESS_RECORDS
@@ -0,0 +1,38 @@
+#ifndef _LZSS_H
+#define _LZSS_H
+
+#include "icedrifter.h"
+
+// A record sent compressed is a stream of bits, high bit of each byte
+// first.  Each token is a 0 bit and a literal byte, or a 1 bit, the
+// distance back to an earlier copy of the next bytes less 1 in
+// LZSS_OFFSET_BITS, and how many bytes to copy less LZSS_MIN_MATCH in
+// LZSS_LENGTH_BITS.  A copy may run into the bytes it makes.  The last
+// byte is padded with 0 bits, fewer than a token needs.  The record
+// itself is the window, so the icedrifter needs no memory for one.
+#define LZSS_OFFSET_BITS  8
+#define LZSS_LENGTH_BITS  4
+#define LZSS_WINDOW       (1 << LZSS_OFFSET_BITS)
+#define LZSS_MIN_MATCH    2
+#define LZSS_MAX_MATCH    ((1 << LZSS_LENGTH_BITS) - 1 + LZSS_MIN_MATCH)
+
+// Chunk 0 of a compressed record starts with the length of the stream in
+// bytes, then the stream runs on through the chunks like a record does.
+#define LZSS_HEADER_SIZE  2
+
+#ifdef ARDUINO
+
+typedef struct lzssState {
+  const uint8_t* lzData;   // the record being compressed.
+  int lzLength;
+  int lzNext;              // next byte of the record to compress.
+  uint32_t lzBits;         // bits waiting to go out, in the low lzBitCount bits.
+  uint8_t lzBitCount;
+} lzssState;
+
+void lzssBegin(lzssState* lzPtr, const uint8_t* data, int length);
+int lzssRead(lzssState* lzPtr, uint8_t* out, int size);
+
+#endif // ARDUINO
+
+#endif // _LZSS_H
@@ -0,0 +1,79 @@
+#include <Arduino.h>
+
+#include "icedrifter.h"
+#include "memcheck.h"
+
+// The free memory between the heap and the stack is filled with this, and
+// whatever is still this has never been used by the stack or the heap.
+#define MEM_FILL_BYTE    0xC5
+
+// Bytes below the stack pointer left alone by memFill, for interrupts that
+// come in while it runs.
+#define MEM_FILL_MARGIN  32
+
+extern char __heap_start;
+extern char* __brkval;
+
+uint16_t memMinFree;
+uint8_t memMinFreePhase;
+
+#ifdef CHECK_MEMORY_USE
+
+// The end of the heap, which is where the free memory starts.
+static uint8_t* memHeapEnd(void) {
+  return ((uint8_t*)(__brkval == 0 ? &__heap_start : __brkval));
+}
+
+// memFill - Called once at boot.  Fills the free memory with MEM_FILL_BYTE.
+
+void memFill(void) {
+
+  uint8_t* wkPtr;
+  uint8_t* endPtr;
+
+  wkPtr = memHeapEnd();
+  endPtr = (uint8_t*)SP - MEM_FILL_MARGIN;
+
+  while (wkPtr < endPtr) {
+    *wkPtr++ = MEM_FILL_BYTE;
+  }
+
+  memMinFree = endPtr - memHeapEnd();
+  memMinFreePhase = MEM_PHASE_NONE;
+}
+
+// memCheck - Called at the end of each step of the work.  Counts the filled
+// bytes still left above the heap.  The memory is only filled at boot, so
+// a new low can only have been reached since the last check, and the step
+// that just finished is blamed for it.
+
+void memCheck(uint8_t phase) {
+
+  uint8_t* wkPtr;
+  uint8_t* endPtr;
+  uint16_t free;
+
+  wkPtr = memHeapEnd();
+  endPtr = (uint8_t*)SP;
+
+  while (wkPtr < endPtr && *wkPtr == MEM_FILL_BYTE) {
+    ++wkPtr;
+  }
+
+  free = wkPtr - memHeapEnd();
+
+  if (free < memMinFree) {
+    memMinFree = free;
+    memMinFreePhase = phase;
+
+#ifdef SERIAL_DEBUG
+    DEBUG_SERIAL.print(F("Least free memory "));
+    DEBUG_SERIAL.print(memMinFree);
+    DEBUG_SERIAL.print(F(" phase "));
+    DEBUG_SERIAL.print(phase);
+    DEBUG_SERIAL.print(F("\n"));
+#endif // SERIAL_DEBUG
+  }
+}
+
+#endif // CHECK_MEMORY_USE
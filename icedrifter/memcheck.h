@@ -0,0 +1,18 @@
+#ifndef _MEMCHECK_H
+#define _MEMCHECK_H
+
+#include "icedrifter.h"
+
+// The least free memory seen since boot and the MEM_PHASE_xxx it was seen in.
+extern uint16_t memMinFree;
+extern uint8_t memMinFreePhase;
+
+#ifdef CHECK_MEMORY_USE
+void memFill(void);
+void memCheck(uint8_t phase);
+#else
+#define memFill()
+#define memCheck(phase)
+#endif // CHECK_MEMORY_USE
+
+#endif // _MEMCHECK_H
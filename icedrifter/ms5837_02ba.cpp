@@ -49,3 +49,29 @@ void getMs5837Data(icedrifterData* idData) {
   Wire.end();
 }
 
+// startMs5837, readMs5837Pressure and stopMs5837 - Used to take a burst of
+// pressure readings without setting up the sensor for each one.
+// startMs5837 returns false if the sensor does not answer.
+
+bool startMs5837(void) {
+
+  Wire.begin();
+
+  if (!sensor.init()) {
+    Wire.end();
+    return (false);
+  }
+
+  sensor.setModel(MS5837::MS5837_02BA);
+  sensor.setFluidDensity(997); // kg/m^3 (freshwater, 1029 for seawater)
+  return (true);
+}
+
+float readMs5837Pressure(void) {
+  sensor.read();
+  return (sensor.pressure());
+}
+
+void stopMs5837(void) {
+  Wire.end();
+}
@@ -2,5 +2,8 @@
 #define _MS5837_02ba_H
 
 void getMs5837Data(icedrifterData* idData);
+bool startMs5837(void);
+float readMs5837Pressure(void);
+void stopMs5837(void);
 
 #endif
@@ -4,6 +4,9 @@
 
 #include "icedrifter.h"
 #include "rockblock.h"
+#include "trace.h"
+#include "memcheck.h"
+#include "lzss.h"
 
 SoftwareSerial isbdss(ROCKBLOCK_RX_PIN, ROCKBLOCK_TX_PIN);
 
@@ -28,6 +31,238 @@ void ISBDDiagsCallback(IridiumSBD *device, char c) {
 }
 #endif
 
+#ifdef SEND_EVENT_TRACE
+static_assert(CHUNK_HEADER_SIZE + (TRACE_REPORT_EVENTS * TRACE_EVENT_SIZE) <= MAX_CHUNK_LENGTH,
+              "TRACE_REPORT_EVENTS do not fit in a chunk");
+
+// rbTransmitTrace - Sends the most recent trace events as a record of their
+// own.  The RockBLOCK must already be started.
+
+static void rbTransmitTrace(void) {
+
+  int chunkLen;
+  int rc;
+
+  idcChunk.idcSendTime = traceTime();
+  idcChunk.idcRecordType[0] = TRACE_RECORD_TYPE_0;
+  idcChunk.idcRecordType[1] = TRACE_RECORD_TYPE_1;
+  idcChunk.idcRecordNumber = 0;
+  chunkLen = CHUNK_HEADER_SIZE + traceRead(idcChunk.idcBuffer, TRACE_REPORT_EVENTS);
+
+  rc = isbd.sendSBDBinary((uint8_t *)&idcChunk, chunkLen);
+  traceEvent(TRACE_ISBD_SEND, rc);
+
+  if (rc == ISBD_SUCCESS) {
+    traceTrouble = false;
+  }
+
+#ifdef SERIAL_DEBUG_ROCKBLOCK
+  DEBUG_SERIAL.print(F("Trace sent, return code = "));
+  DEBUG_SERIAL.print(rc);
+  DEBUG_SERIAL.print(F("\n"));
+#endif // SERIAL_DEBUG_ROCKBLOCK
+}
+#endif // SEND_EVENT_TRACE
+
+#ifndef NEVER_TRANSMIT
+// rbBegin - Powers up the RockBLOCK and starts talking to it.  Returns the
+// return code of isbd.begin.  rbEnd must be called whatever the return code.
+
+static int rbBegin(void) {
+
+  int rc;
+
+  // Set up the RockBLOCK and power it up.
+  isbd.setPowerProfile(IridiumSBD::USB_POWER_PROFILE);
+
+#ifdef SERIAL_DEBUG_ROCKBLOCK
+  DEBUG_SERIAL.flush();
+  DEBUG_SERIAL.println(F("Powering up RockBLOCK\n"));
+  DEBUG_SERIAL.flush();
+#endif // SERIAL_DEBUG_ROCKBLOCK
+
+  digitalWrite(ROCKBLOCK_POWER_PIN, HIGH);
+  traceEvent(TRACE_POWER_ON, TRACE_RAIL_ROCKBLOCK);
+  delay(1000);
+
+  isbdss.begin(ROCKBLOCK_BAUD);
+
+  // Start talking to the RockBLOCK.
+#ifdef SERIAL_DEBUG_ROCKBLOCK
+  DEBUG_SERIAL.flush();
+  DEBUG_SERIAL.println(F("RockBLOCK begin\n"));
+  DEBUG_SERIAL.flush();
+#endif // SERIAL_DEBUG_ROCKBLOCK
+  isbdss.listen();
+
+  rc = isbd.begin();
+  traceEvent(TRACE_ISBD_BEGIN, rc);
+
+#ifdef SERIAL_DEBUG_ROCKBLOCK
+  if (rc != ISBD_SUCCESS) {
+    DEBUG_SERIAL.print("Bad return code from begin = ");
+    DEBUG_SERIAL.print(rc);
+    DEBUG_SERIAL.print("\n");
+    DEBUG_SERIAL.flush();
+  }
+#endif // SERIAL_DEBUG_ROCKBLOCK
+
+  return (rc);
+}
+
+// rbEnd - Puts the RockBLOCK to sleep and powers it down.
+
+static void rbEnd(void) {
+  isbd.sleep();
+  isbdss.end();
+  digitalWrite(ROCKBLOCK_POWER_PIN, LOW);
+  traceEvent(TRACE_POWER_OFF, TRACE_RAIL_ROCKBLOCK);
+}
+#endif // NEVER_TRANSMIT
+
+// rbTransmitHeartbeat - Sends the time, position, pressure and remote
+// temperature in idPtr as a heartbeat and picks up any message waiting for
+// the icedrifter.  Returns true if the message asks for a full report.
+
+bool rbTransmitHeartbeat(icedrifterData *idPtr) {
+
+  heartbeatData hb;
+  bool fullRequested;
+
+  hb.hbLatitude = lround(idPtr->idLatitude * 1000000.0);
+  hb.hbLongitude = lround(idPtr->idLongitude * 1000000.0);
+  hb.hbPressure = (uint16_t)lround(idPtr->idPressure * 10.0);
+  hb.hbRemoteTemp = (int16_t)lround(idPtr->idRemoteTemp * 100.0);
+  hb.hbSwitches = idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH;
+
+  // Without a fix the GPS time is 0, so use the icedrifter clock, which
+  // carries on from the last fix, to keep each heartbeat's send time its own.
+  idcChunk.idcSendTime = (idPtr->idGPSTime != 0) ? idPtr->idGPSTime : traceTime();
+  idcChunk.idcRecordType[0] = HEARTBEAT_RECORD_TYPE_0;
+  idcChunk.idcRecordType[1] = HEARTBEAT_RECORD_TYPE_1;
+  idcChunk.idcRecordNumber = 0;
+  memcpy(idcChunk.idcBuffer, &hb, HEARTBEAT_LENGTH);
+  memCheck(MEM_PHASE_FORMAT);
+
+  fullRequested = false;
+
+#ifdef NEVER_TRANSMIT
+  #ifdef SERIAL_DEBUG_ROCKBLOCK
+    DEBUG_SERIAL.print(F("Transmission disabled by NEVER_TRANSMIT switch.\n"));
+  #endif
+#else // NEVER_TRANSMIT
+
+  int rc;
+  uint8_t rxBuff[16];
+  size_t rxLen;
+
+  if (rbBegin() == ISBD_SUCCESS) {
+    rxLen = sizeof(rxBuff);
+    rc = isbd.sendReceiveSBDBinary((uint8_t *)&idcChunk, CHUNK_HEADER_SIZE + HEARTBEAT_LENGTH,
+                                   rxBuff, rxLen);
+    traceEvent(TRACE_ISBD_SEND, rc);
+
+    // Only the start of a longer message is kept, which is all that is
+    // looked at, so an overflow still counts.
+    if ((rc == ISBD_SUCCESS || rc == ISBD_RX_OVERFLOW) &&
+        rxLen >= sizeof(FULL_REPORT_REQUEST) - 1 &&
+        memcmp(rxBuff, FULL_REPORT_REQUEST, sizeof(FULL_REPORT_REQUEST) - 1) == 0) {
+      fullRequested = true;
+    }
+
+#ifdef SERIAL_DEBUG_ROCKBLOCK
+    DEBUG_SERIAL.print(F("Heartbeat sent, return code = "));
+    DEBUG_SERIAL.print(rc);
+    DEBUG_SERIAL.print(fullRequested ? F(" full report requested\n") : F("\n"));
+    DEBUG_SERIAL.flush();
+#endif // SERIAL_DEBUG_ROCKBLOCK
+
+#ifdef SEND_EVENT_TRACE
+    if (rc == ISBD_SUCCESS && traceTrouble) {
+      rbTransmitTrace();
+    }
+#endif // SEND_EVENT_TRACE
+  }
+
+  rbEnd();
+
+#endif // NEVER_TRANSMIT
+
+  return (fullRequested);
+}
+
+// rbAppend - Adds text to the human readable report in oBuff if it fits in
+// one message.  Text that does not fit is left off.
+
+static void rbAppend(char *oBuff, const char *text) {
+  if (strlen(oBuff) + strlen(text) < MAX_CHUNK_LENGTH) {
+    strcat(oBuff, text);
+  }
+}
+
+#if defined(SAMPLE_BETWEEN_REPORTS) || defined(PRESSURE_BURST)
+// rbAddValue - Adds a value to the human readable report with the given
+// decimals.  A value from a sensor that was not read can be anything, so a
+// value that is not finite or too big to be a reading is sent as "?".
+
+static void rbAddValue(char *oBuff, char *buff, float value, int decimals) {
+  if (!isfinite(value) || fabs(value) >= 100000.0) {
+    rbAppend(oBuff, "?");
+  } else {
+    rbAppend(oBuff, dtostrf(value, 4, decimals, buff));
+  }
+}
+#endif // SAMPLE_BETWEEN_REPORTS || PRESSURE_BURST
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+// rbAddStats - Adds the statistics of one sensor to the human readable
+// report as the mean, standard deviation, and the minimum and maximum with
+// the UTC hour and minute they were read.  buff is scratch space.
+
+static void rbAddStats(char *oBuff, char *buff, const char *name, float mean, float variance,
+                       float min, time_t minTime, float max, time_t maxTime) {
+
+  struct tm *timeInfo;
+
+  rbAppend(oBuff, name);
+  rbAppend(oBuff, " avg=");
+  rbAddValue(oBuff, buff, mean, 2);
+  rbAppend(oBuff, " sd=");
+  rbAddValue(oBuff, buff, sqrt(variance), 2);
+  rbAppend(oBuff, " min=");
+  rbAddValue(oBuff, buff, min, 2);
+  timeInfo = gmtime(&minTime);
+  sprintf(buff, "@%02d:%02d", timeInfo->tm_hour, timeInfo->tm_min);
+  rbAppend(oBuff, buff);
+  rbAppend(oBuff, " max=");
+  rbAddValue(oBuff, buff, max, 2);
+  timeInfo = gmtime(&maxTime);
+  sprintf(buff, "@%02d:%02d", timeInfo->tm_hour, timeInfo->tm_min);
+  rbAppend(oBuff, buff);
+}
+#endif // SAMPLE_BETWEEN_REPORTS
+
+#ifdef COMPRESS_RECORDS
+// rbCompressedLength - Returns the length of the record compressed.  The
+// stream is put in the chunk buffer while it is counted.
+
+static int rbCompressedLength(uint8_t *dataPtr, int dataLen) {
+
+  lzssState lz;
+  int streamLen;
+  int len;
+
+  lzssBegin(&lz, dataPtr, dataLen);
+  streamLen = 0;
+
+  while ((len = lzssRead(&lz, idcChunk.idcBuffer, MAX_CHUNK_DATA_LENGTH)) > 0) {
+    streamLen += len;
+  }
+
+  return (streamLen);
+}
+#endif // COMPRESS_RECORDS
+
 void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
 
   int rc;
@@ -35,15 +270,20 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
   int dataLen;
   int chunkLen;
   int i;
+  uint16_t recFlags;
   uint8_t *dataPtr;
   uint8_t *chunkPtr;
   uint8_t *wkPtr;
+#ifdef COMPRESS_RECORDS
+  lzssState lz;
+  uint16_t streamLen;
+#endif // COMPRESS_RECORDS
   struct tm *timeInfo;
   char *buffPtr;
   char buff[128];
-  char oBuff[340];
+  char oBuff[MAX_CHUNK_LENGTH];
 
-  if (dataLen == 0) {
+  if (idLen == 0) {
     oBuff[0] = 0;
     strcat(oBuff, "\nGMT=");
     timeInfo = gmtime(&idPtr->idGPSTime);
@@ -81,16 +321,40 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
     buffPtr = dtostrf(((idPtr->idRemoteTemp * 1.8) + 32), 4, 2, buff);
     strcat(oBuff, buffPtr);
     strcat(oBuff, " F\n");
-    strcat(oBuff, "\nIcedrifter H/V ");
-    strcat(oBuff, HARDWARE_VERSION);
-    strcat(oBuff, " S/V ");
-    strcat(oBuff, SOFTWARE_VERSION);
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+    if (idPtr->idSampleCount != 0) {
+      sprintf(buff, "\nN=%u/%um", idPtr->idSampleCount, idPtr->idSampleInterval);
+      rbAppend(oBuff, buff);
+      rbAddStats(oBuff, buff, "\nBP", idPtr->idPressureMean, idPtr->idPressureVariance,
+                 idPtr->idPressureMin, idPtr->idPressureMinTime,
+                 idPtr->idPressureMax, idPtr->idPressureMaxTime);
+      rbAddStats(oBuff, buff, "\nTs", idPtr->idRemoteTempMean, idPtr->idRemoteTempVariance,
+                 idPtr->idRemoteTempMin, idPtr->idRemoteTempMinTime,
+                 idPtr->idRemoteTempMax, idPtr->idRemoteTempMaxTime);
+      rbAppend(oBuff, "\n");
+    }
+#endif // SAMPLE_BETWEEN_REPORTS
+
+#ifdef PRESSURE_BURST
+    if (idPtr->idBurstSamples != 0) {
+      rbAppend(oBuff, "\nHs=");
+      rbAddValue(oBuff, buff, idPtr->idBurstSigAmp, 1);
+      rbAppend(oBuff, " ubar Tp=");
+      rbAddValue(oBuff, buff, idPtr->idBurstPeakPeriod / 10.0, 1);
+      rbAppend(oBuff, " s\n");
+    }
+#endif // PRESSURE_BURST
+
+    rbAppend(oBuff, "\nIcedrifter H/V " HARDWARE_VERSION " S/V " SOFTWARE_VERSION);
 
 #ifdef SERIAL_DEBUG_ROCKBLOCK
-    strcat(oBuff, "\n*** Debug is ON ***\n");
+    rbAppend(oBuff, "\n*** Debug is ON ***\n");
     DEBUG_SERIAL.print(oBuff);
     delay(1000);  
 #endif // SERIAL_DEBUG_ROCKBLOCK
+
+    memCheck(MEM_PHASE_FORMAT);
   }
 
 #ifdef NEVER_TRANSMIT
@@ -99,29 +363,9 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
   #endif
 #else // NEVER_TRANSMIT
 
-  // Setup the RockBLOCK
-  isbd.setPowerProfile(IridiumSBD::USB_POWER_PROFILE);
+  rc = rbBegin();
 
-#ifdef SERIAL_DEBUG_ROCKBLOCK
-  DEBUG_SERIAL.flush();
-  DEBUG_SERIAL.println(F("Powering up RockBLOCK\n"));
-  DEBUG_SERIAL.flush();
-#endif // SERIAL_DEBUG_ROCKBLOCK
-
-  digitalWrite(ROCKBLOCK_POWER_PIN, HIGH);
-  delay(1000);
-
-  isbdss.begin(ROCKBLOCK_BAUD);
-
-  // Step 3: Start talking to the RockBLOCK and power it up
-#ifdef SERIAL_DEBUG_ROCKBLOCK
-  DEBUG_SERIAL.flush();
-  DEBUG_SERIAL.println(F("RockBLOCK begin\n"));
-  DEBUG_SERIAL.flush();
-#endif // SERIAL_DEBUG_ROCKBLOCK
-  isbdss.listen();
-
-  if ((rc = isbd.begin()) == ISBD_SUCCESS) {
+  if (rc == ISBD_SUCCESS) {
 #ifdef SERIAL_DEBUG_ROCKBLOCK
     DEBUG_SERIAL.flush();
     DEBUG_SERIAL.print(F("Transmitting address="));
@@ -152,14 +396,33 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
         DEBUG_SERIAL.flush();
 #endif // SERIAL_DEBUG_ROCKBLOCK
       rc = isbd.sendSBDBinary((const uint8_t *)oBuff, dataLen);
+      traceEvent(TRACE_ISBD_SEND, rc);
 
     } else {
+      recFlags = 0;
+
+#ifdef COMPRESS_RECORDS
+      // Only send the record compressed if it takes fewer chunks.
+      streamLen = rbCompressedLength(dataPtr, dataLen);
+
+      if (CHUNK_COUNT(LZSS_HEADER_SIZE + streamLen) < CHUNK_COUNT(dataLen)) {
+        recFlags = CHUNK_COMPRESSED;
+        lzssBegin(&lz, dataPtr, dataLen);
+        dataLen = LZSS_HEADER_SIZE + streamLen;
+      }
+
+  #ifdef SERIAL_DEBUG_ROCKBLOCK
+      DEBUG_SERIAL.print(F("Compressed length="));
+      DEBUG_SERIAL.print(LZSS_HEADER_SIZE + streamLen);
+      DEBUG_SERIAL.print(F("\n"));
+  #endif
+#endif // COMPRESS_RECORDS
 
       while (dataLen > 0) {
         idcChunk.idcSendTime = idPtr->idGPSTime;
         idcChunk.idcRecordType[0] = 'I';
         idcChunk.idcRecordType[1] = 'D';
-        idcChunk.idcRecordNumber = recCount;
+        idcChunk.idcRecordNumber = recCount | recFlags;
 
         if (dataLen > MAX_CHUNK_DATA_LENGTH) {
           chunkLen = MAX_CHUNK_LENGTH;
@@ -169,7 +432,24 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
           dataLen = 0;
         }
 
-        memmove(chunkPtr, dataPtr, chunkLen);
+#ifdef COMPRESS_RECORDS
+        if (recFlags & CHUNK_COMPRESSED) {
+          wkPtr = chunkPtr;
+
+          if (recCount == 0) {
+            memcpy(wkPtr, &streamLen, LZSS_HEADER_SIZE);
+            wkPtr += LZSS_HEADER_SIZE;
+          }
+
+          lzssRead(&lz, wkPtr, chunkLen - CHUNK_HEADER_SIZE - (wkPtr - chunkPtr));
+        } else {
+          memmove(chunkPtr, dataPtr, chunkLen - CHUNK_HEADER_SIZE);
+        }
+#else
+        memmove(chunkPtr, dataPtr, chunkLen - CHUNK_HEADER_SIZE);
+#endif // COMPRESS_RECORDS
+
+        memCheck(MEM_PHASE_FORMAT);
         dataPtr += MAX_CHUNK_DATA_LENGTH;
         ++recCount;
 
@@ -196,6 +476,7 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
 #endif // SERIAL_DEBUG_ROCKBLOCK
 
         rc = isbd.sendSBDBinary((uint8_t *)&idcChunk, chunkLen);
+        traceEvent(TRACE_ISBD_SEND, rc);
       }
     }
 #ifdef SERIAL_DEBUG_ROCKBLOCK
@@ -211,18 +492,14 @@ void rbTransmitIcedrifterData(icedrifterData *idPtr, int idLen) {
     }
 #endif // SERIAL_DEBUG_ROCKBLOCK
 
-#ifdef SERIAL_DEBUG_ROCKBLOCK
-  } else {
-    DEBUG_SERIAL.print("Bad return code from begin = ");
-    DEBUG_SERIAL.print(rc);
-    DEBUG_SERIAL.print("\n");
-    DEBUG_SERIAL.flush();
-#endif // SERIAL_DEBUG_ROCKBLOCK
+#ifdef SEND_EVENT_TRACE
+    if (rc == ISBD_SUCCESS && traceTrouble) {
+      rbTransmitTrace();
+    }
+#endif // SEND_EVENT_TRACE
   }
 
-  isbd.sleep();
-  isbdss.end();
-  digitalWrite(ROCKBLOCK_POWER_PIN, LOW);
+  rbEnd();
 
 #endif // NEVER_TRANSMIT
 }
@@ -13,6 +13,18 @@
 #define CHUNK_HEADER_SIZE 8
 #define MAX_CHUNK_DATA_LENGTH (MAX_CHUNK_LENGTH - CHUNK_HEADER_SIZE)
 
+// Number of chunks needed to send a record of the given length.
+#define CHUNK_COUNT(recordLength) \
+  (((recordLength) + MAX_CHUNK_DATA_LENGTH - 1) / MAX_CHUNK_DATA_LENGTH)
+
+// The largest number of chunks a record can be sent in.
+#define MAX_RECORD_CHUNKS CHUNK_COUNT(MAX_RECORD_LENGTH)
+
+// Set in idcRecordNumber of every chunk of a record sent compressed.  The
+// rest of idcRecordNumber is the chunk number.
+#define CHUNK_COMPRESSED 0x8000
+#define CHUNK_NUMBER(recordNumber) ((recordNumber) & ~CHUNK_COMPRESSED)
+
 typedef struct iceDrifterChunk {
 #ifdef ARDUINO
   time_t idcSendTime;
@@ -21,9 +33,30 @@ typedef struct iceDrifterChunk {
 #endif
   char idcRecordType[2];
   uint16_t idcRecordNumber;
-  uint8_t idcBuffer[MAX_CHUNK_LENGTH];
+  uint8_t idcBuffer[MAX_CHUNK_DATA_LENGTH];
 } iceDrifterChunk; 
 
+// A heartbeat is sent as one chunk of its own type, with the GPS time as
+// the send time and a heartbeatData in place of the record.  Without a fix
+// the send time is the icedrifter clock, so no two heartbeats share one.
+// The values are scaled to integers to keep the chunk short.
+#define HEARTBEAT_RECORD_TYPE_0 'H'
+#define HEARTBEAT_RECORD_TYPE_1 'B'
+
+typedef struct heartbeatData {
+  int32_t hbLatitude;     // degrees * 1000000.
+  int32_t hbLongitude;    // degrees * 1000000.
+  uint16_t hbPressure;    // hPa * 10.
+  int16_t hbRemoteTemp;   // degrees C * 100.
+  uint8_t hbSwitches;     // PROCESS_REMOTE_TEMP_SWITCH if hbRemoteTemp was read.
+} heartbeatData;
+
+#define HEARTBEAT_LENGTH 13  // bytes of the heartbeatData that are sent.
+
+RECORD_ASSERT(offsetof(heartbeatData, hbSwitches) + 1 == HEARTBEAT_LENGTH,
+              "the heartbeat has padding");
+
 void rbTransmitIcedrifterData(icedrifterData *, int);
+bool rbTransmitHeartbeat(icedrifterData *);
 
 #endif  //_ROCKBLOCK_H
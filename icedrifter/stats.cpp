@@ -0,0 +1,90 @@
+#include <Arduino.h>
+
+#include "icedrifter.h"
+#include "stats.h"
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+
+typedef struct sensorStats {
+  float ssMean;
+  float ssM2;         // sum of the squares of the differences from the mean.
+  float ssMin;
+  float ssMax;
+  uint32_t ssMinTime;
+  uint32_t ssMaxTime;
+} sensorStats;
+
+static uint16_t statsCount;  // readings added since the last statsClear.
+static sensorStats statsPressure;
+static sensorStats statsTemperature;
+static sensorStats statsRemoteTemp;
+
+// Adds one reading to the statistics of a sensor with Welford's method,
+// which keeps the variance accurate without keeping the readings.
+// statsCount has already been counted up for the reading.
+
+static void statsAddOne(sensorStats* ssPtr, float value, uint32_t time) {
+
+  float delta;
+
+  if (statsCount == 1 || value < ssPtr->ssMin) {
+    ssPtr->ssMin = value;
+    ssPtr->ssMinTime = time;
+  }
+
+  if (statsCount == 1 || value > ssPtr->ssMax) {
+    ssPtr->ssMax = value;
+    ssPtr->ssMaxTime = time;
+  }
+
+  if (statsCount == 1) {
+    ssPtr->ssMean = value;
+    ssPtr->ssM2 = 0;
+  } else {
+    delta = value - ssPtr->ssMean;
+    ssPtr->ssMean += delta / statsCount;
+    ssPtr->ssM2 += delta * (value - ssPtr->ssMean);
+  }
+}
+
+// statsAdd - Adds the pressure, temperature and remote temperature in
+// idPtr, read at time, to the statistics.
+
+void statsAdd(icedrifterData* idPtr, uint32_t time) {
+
+  // Stop counting rather than wrap, which would take over a year.
+  if (statsCount == 0xFFFF) {
+    return;
+  }
+
+  ++statsCount;
+  statsAddOne(&statsPressure, idPtr->idPressure, time);
+  statsAddOne(&statsTemperature, idPtr->idTemperature, time);
+  statsAddOne(&statsRemoteTemp, idPtr->idRemoteTemp, time);
+}
+
+#define STATS_PUT(ss, name) \
+  idPtr->name##Mean = ss.ssMean; \
+  idPtr->name##Variance = (statsCount > 1) ? ss.ssM2 / (statsCount - 1) : 0; \
+  idPtr->name##Min = ss.ssMin; \
+  idPtr->name##Max = ss.ssMax; \
+  idPtr->name##MinTime = ss.ssMinTime; \
+  idPtr->name##MaxTime = ss.ssMaxTime;
+
+// statsPut - Puts the statistics in the record.
+
+void statsPut(icedrifterData* idPtr) {
+  idPtr->idSampleCount = statsCount;
+  idPtr->idSampleInterval = SAMPLE_INTERVAL_MINUTES;
+  STATS_PUT(statsPressure, idPressure)
+  STATS_PUT(statsTemperature, idTemperature)
+  STATS_PUT(statsRemoteTemp, idRemoteTemp)
+}
+
+// statsClear - Starts the statistics over after a full report.
+
+void statsClear(void) {
+  statsCount = 0;
+}
+
+#endif // SAMPLE_BETWEEN_REPORTS
@@ -0,0 +1,20 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "icedrifter.h"
+
+// Running statistics of the pressure and temperature readings taken
+// since the last full report, kept in a fixed amount of memory however
+// many readings there are.
+
+#ifdef SAMPLE_BETWEEN_REPORTS
+void statsAdd(icedrifterData* idPtr, uint32_t time);
+void statsPut(icedrifterData* idPtr);
+void statsClear(void);
+#else
+#define statsAdd(idPtr, time)
+#define statsPut(idPtr)
+#define statsClear()
+#endif // SAMPLE_BETWEEN_REPORTS
+
+#endif // _STATS_H
@@ -0,0 +1,132 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include "icedrifter.h"
+#include "bootstate.h"
+#include "trace.h"
+
+static_assert(BOOT_STATE_EEPROM_ADDR + (BOOT_STATE_SLOTS * sizeof(bootState)) <= TRACE_EEPROM_ADDR,
+              "the boot state runs into the trace");
+
+typedef struct traceRecord {
+  uint32_t trTime;
+  uint8_t trEvent;  // event code and TRACE_LAP.
+  uint8_t trValue;
+} traceRecord;
+
+static_assert(sizeof(traceRecord) == TRACE_EVENT_SIZE, "traceRecord is not TRACE_EVENT_SIZE");
+
+bool traceTrouble;  // Something went wrong that the next trace record should show.
+
+static uint8_t traceNext;  // ring slot the next event goes in.
+static uint8_t traceLap;   // TRACE_LAP bit of the events written this lap.
+
+static uint32_t traceBaseTime;    // icedrifter time at traceBaseMillis.
+static uint32_t traceBaseMillis;
+
+static int traceAddr(uint8_t slot) {
+  return (TRACE_EEPROM_ADDR + (slot * TRACE_EVENT_SIZE));
+}
+
+static uint8_t traceReadEvent(uint8_t slot) {
+  return (EEPROM.read(traceAddr(slot) + offsetof(traceRecord, trEvent)));
+}
+
+// traceInit - Called once at boot.  Finds the slot after the last event
+// written, which is the first one whose lap bit differs from slot 0's.
+
+void traceInit(void) {
+
+  uint8_t lap;
+  uint8_t slot;
+
+  lap = traceReadEvent(0) & TRACE_LAP;
+
+  for (slot = 1; slot < TRACE_EVENTS; ++slot) {
+    if ((traceReadEvent(slot) & TRACE_LAP) != lap) {
+      break;
+    }
+  }
+
+  if (slot < TRACE_EVENTS) {
+    traceNext = slot;
+    traceLap = lap;
+  } else {
+    // Every slot is on the same lap, so the next one starts a new lap.
+    traceNext = 0;
+    traceLap = lap ^ TRACE_LAP;
+  }
+
+  traceBaseTime = 0;
+  traceBaseMillis = millis();
+}
+
+// traceEvent - Adds an event to the ring.  Writing the six bytes takes
+// about 20 milliseconds.
+
+void traceEvent(uint8_t event, uint8_t value) {
+
+  traceRecord tr;
+
+  tr.trTime = traceTime();
+  tr.trEvent = (event & TRACE_EVENT_MASK) | traceLap;
+  tr.trValue = value;
+
+  EEPROM.put(traceAddr(traceNext), tr);
+
+  if (++traceNext >= TRACE_EVENTS) {
+    traceNext = 0;
+    traceLap ^= TRACE_LAP;
+  }
+
+  // Resets and failed sends are worth a trace record.
+  if ((event == TRACE_BOOT && (value == BOOT_BROWNOUT || value == BOOT_WATCHDOG)) ||
+      ((event == TRACE_ISBD_BEGIN || event == TRACE_ISBD_SEND) && value != 0)) {
+    traceTrouble = true;
+  }
+}
+
+// The trace clock.  It is set from the GPS, runs on millis while the
+// processor is awake, and is moved on by the time slept, when millis stops.
+
+uint32_t traceTime(void) {
+  return (traceBaseTime + ((millis() - traceBaseMillis) / 1000UL));
+}
+
+void traceSetTime(uint32_t time) {
+  traceBaseTime = time;
+  traceBaseMillis = millis();
+}
+
+void traceSleep(uint32_t seconds) {
+  traceBaseTime += seconds;
+}
+
+// traceRead - Copies up to count of the most recent events into buffer,
+// oldest first, in the format they are kept in.  Returns the number of
+// bytes copied.
+
+int traceRead(uint8_t* buffer, int count) {
+
+  uint8_t slot;
+  int length;
+  int i;
+
+  if (count > TRACE_EVENTS) {
+    count = TRACE_EVENTS;
+  }
+
+  slot = (traceNext + TRACE_EVENTS - count) % TRACE_EVENTS;
+  length = 0;
+
+  for (i = 0; i < count; ++i) {
+    if ((traceReadEvent(slot) & TRACE_EVENT_MASK) != TRACE_EMPTY) {
+      EEPROM.get(traceAddr(slot), *(traceRecord*)(buffer + length));
+      length += TRACE_EVENT_SIZE;
+    }
+
+    slot = (slot + 1) % TRACE_EVENTS;
+  }
+
+  return (length);
+}
@@ -0,0 +1,61 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "icedrifter.h"
+
+// The SEND_EVENT_TRACE switch sends the most recent trace events in a
+// record of their own after a report whenever there was a reset or a failed
+// send since the last trace was sent.  Comment out the next line to keep
+// the trace in EEPROM only.
+
+#define SEND_EVENT_TRACE
+
+// The icedrifter keeps a trace of what it has been doing in an EEPROM ring
+// after the boot state.  Each event is TRACE_EVENT_SIZE bytes: the time in
+// 32 bit icedrifter seconds, the event code, and one byte of value, all
+// little endian.  The top bit of the event code flips every time the ring
+// wraps, so the next event to write is found at boot without keeping a
+// pointer anywhere.  Times before the first GPS fix are seconds since boot.
+#define TRACE_EEPROM_ADDR   256
+#define TRACE_EVENTS        128
+#define TRACE_EVENT_SIZE    6
+#define TRACE_LAP           0x80
+#define TRACE_EVENT_MASK    0x7F
+
+// Trace records are sent as a single chunk with record type "TR" and hold
+// up to TRACE_REPORT_EVENTS events, oldest first.
+#define TRACE_RECORD_TYPE_0   'T'
+#define TRACE_RECORD_TYPE_1   'R'
+#define TRACE_REPORT_EVENTS   48
+
+// Event codes and what their value is.
+#define TRACE_EMPTY         0x7F  // never written.
+#define TRACE_BOOT          1     // BOOT_xxx reason.
+#define TRACE_WAKE          2     // 0
+#define TRACE_SLEEP         3     // minutes.
+#define TRACE_POWER_ON      4     // TRACE_RAIL_xxx.
+#define TRACE_POWER_OFF     5     // TRACE_RAIL_xxx.
+#define TRACE_FIX           6     // 1 if a fix was found, 0 if not.
+#define TRACE_CHAIN_TEMP    7     // temperature sensors received.
+#define TRACE_CHAIN_LIGHT   8     // light sensors received.
+#define TRACE_CHAIN_ERROR   9     // idcdError.
+#define TRACE_ISBD_BEGIN    10    // isbd.begin return code.
+#define TRACE_ISBD_SEND     11    // sendSBDBinary return code.
+
+// Power rails.
+#define TRACE_RAIL_SENSORS  1  // MS5837, DS18B20 and GPS.
+#define TRACE_RAIL_ROCKBLOCK 2
+#define TRACE_RAIL_CHAIN    3
+
+#ifdef ARDUINO
+extern bool traceTrouble;
+
+void traceInit(void);
+void traceEvent(uint8_t event, uint8_t value);
+uint32_t traceTime(void);
+void traceSetTime(uint32_t time);
+void traceSleep(uint32_t seconds);
+int traceRead(uint8_t* buffer, int count);
+#endif // ARDUINO
+
+#endif // _TRACE_H
@@ -0,0 +1,444 @@
+//*****************************************************************************
+// batch.c
+//
+// Batch mode for idecode.
+//
+// A batch runs as a three stage pipeline on a work-stealing thread pool:
+//
+//   read        Every chunk file is read and checked by its own task.
+//   reassemble  The chunks are split into shards by a hash of their
+//               Rockblock ID and send time.  Each shard groups its chunks
+//               into chunk sets with its own reassembler and rebuilds the
+//               records whose chunks have all been found.
+//   decode      Every rebuilt record is finished by its own task.
+//
+// Each stage runs to completion before the next starts.  All console output
+// is held with the file or record it belongs to and printed at the end in
+// file name or Rockblock ID and send time order, so the output does not
+// depend on the number of threads.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "idecode.h"
+#include "threadpool.h"
+#include "store.h"
+#include "geoindex.h"
+#include "export.h"
+#include "summary.h"
+#include "reassemble.h"
+
+#define SHARDS_PER_THREAD 4    // reassembly shards per decoder thread.
+
+// One chunk file read by the read stage.
+typedef struct batchFile {
+  char* bfName;
+  iceDrifterChunk bfChunk;
+  int bfLength;  // bytes of chunk data, 0 if the file was skipped, CHUNK_FILE_TRACE for a trace.
+  uint32_t bfHash;
+  char bfRockblockId[ROCKBLOCK_ID_SIZE];
+  char bfMessage[DECODE_MESSAGE_SIZE];  // why the file was skipped.
+} batchFile;
+
+// One reassembly shard and what it produced.
+typedef struct batchShard {
+  int bsIndex;
+  reassembler bsReassembler;
+  decodeContext** bsRecords;  // complete records.
+  int bsRecordCount;
+  int bsRecordSize;
+} batchShard;
+
+typedef struct batchJob {
+  batchFile* bjFiles;
+  int bjFileCount;
+  batchShard* bjShards;
+  int bjShardCount;
+} batchJob;
+
+// Task arguments carry a pointer to the job and an index into it.
+typedef struct batchTask {
+  batchJob* btJob;
+  int btIndex;
+} batchTask;
+
+//*****************************************************************************
+//
+// getRockblockId
+//
+// path: a chunk file name, optionally with a path.
+//
+// rbId: buffer of ROCKBLOCK_ID_SIZE bytes that receives the Rockblock ID.
+//
+// The Rockblock ID is the part of the file name before the first '-' or '_'.
+//
+// returns true if an ID was found.
+//
+//*****************************************************************************
+
+bool getRockblockId(char* path, char* rbId) {
+  char* fnPtr;
+  char* wkPtr;
+  int len;
+
+  fnPtr = path;
+
+  for (wkPtr = path; *wkPtr != 0; ++wkPtr) {
+    if ((*wkPtr == '/') || (*wkPtr == '\\')) {
+      fnPtr = wkPtr + 1;
+    }
+  }
+
+  len = strcspn(fnPtr, "-_");
+
+  if ((fnPtr[len] == 0) || (len == 0) || (len >= ROCKBLOCK_ID_SIZE)) {
+    return (false);
+  }
+
+  memcpy(rbId, fnPtr, len);
+  rbId[len] = 0;
+  return (true);
+}
+
+//*****************************************************************************
+//
+// Read stage - read and check one chunk file.
+//
+//*****************************************************************************
+
+static void batchReadTask(void* arg) {
+  batchTask* task = arg;
+  batchFile* bfPtr = &task->btJob->bjFiles[task->btIndex];
+
+  bfPtr->bfLength = chunkFileRead(bfPtr->bfName, bfPtr->bfRockblockId, &bfPtr->bfChunk,
+                                  bfPtr->bfMessage, sizeof(bfPtr->bfMessage));
+
+  if (bfPtr->bfLength > 0) {
+    bfPtr->bfHash = chunkHash(bfPtr->bfRockblockId, bfPtr->bfChunk.idcSendTime);
+  }
+}
+
+//*****************************************************************************
+//
+// Reassembly stage - group the chunks of one shard and rebuild every record
+// that is complete.  Files are visited in name order so the first of two
+// copies of a chunk is always the one that is kept.
+//
+//*****************************************************************************
+
+static void batchReassembleTask(void* arg) {
+  batchTask* task = arg;
+  batchJob* job = task->btJob;
+  batchShard* bsPtr = &job->bjShards[task->btIndex];
+  batchFile* bfPtr;
+  chunkSet* csPtr;
+  decodeContext* ctx;
+  int i;
+
+  reassemblerInit(&bsPtr->bsReassembler, reassembleMemory / job->bjShardCount);
+
+  for (i = 0; i < job->bjFileCount; ++i) {
+    bfPtr = &job->bjFiles[i];
+
+    if ((bfPtr->bfLength <= 0) || ((bfPtr->bfHash % job->bjShardCount) != (uint32_t)bsPtr->bsIndex)) {
+      continue;
+    }
+
+    if (reassemblerAdd(&bsPtr->bsReassembler, bfPtr->bfRockblockId, &bfPtr->bfChunk, bfPtr->bfLength, &csPtr) !=
+        CHUNK_COMPLETE) {
+      continue;
+    }
+
+    // Rebuild the record in a new decode context.
+    ctx = chunkSetRecord(csPtr);
+
+    if (bsPtr->bsRecordCount >= bsPtr->bsRecordSize) {
+      bsPtr->bsRecordSize = (bsPtr->bsRecordSize == 0) ? 64 : bsPtr->bsRecordSize * 2;
+
+      if ((bsPtr->bsRecords = realloc(bsPtr->bsRecords, bsPtr->bsRecordSize * sizeof(decodeContext*))) == NULL) {
+        printf("Error: Out of memory in batch mode!\n");
+        exit(1);
+      }
+    }
+
+    bsPtr->bsRecords[bsPtr->bsRecordCount++] = ctx;
+    reassemblerDone(&bsPtr->bsReassembler, csPtr);
+  }
+}
+
+//*****************************************************************************
+//
+// Decode stage - finish one record.
+//
+//*****************************************************************************
+
+static void batchDecodeTask(void* arg) {
+  decodeContext* ctx = arg;
+
+  snprintf(ctx->dcMessage, sizeof(ctx->dcMessage), "Processing data for Rockblock %s sent %08x.\n",
+           ctx->dcRockblockId, ctx->dcSendTime);
+  finishRecord(ctx);
+}
+
+static int compareNames(const void* a, const void* b) {
+  return (strcmp(*(char**)a, *(char**)b));
+}
+
+static int compareKeys(char* aId, uint32_t aTime, char* bId, uint32_t bTime) {
+  int rc;
+
+  if ((rc = strcmp(aId, bId)) != 0) {
+    return (rc);
+  }
+
+  return ((aTime > bTime) - (aTime < bTime));
+}
+
+static int compareRecords(const void* a, const void* b) {
+  decodeContext* aPtr = *(decodeContext**)a;
+  decodeContext* bPtr = *(decodeContext**)b;
+
+  return (compareKeys(aPtr->dcRockblockId, aPtr->dcSendTime, bPtr->dcRockblockId, bPtr->dcSendTime));
+}
+
+//*****************************************************************************
+//
+// batchListFiles
+//
+// Adds the chunk files named by path to the list.  If path is a directory
+// every .bin file in it is added.
+//
+//*****************************************************************************
+
+static void batchListFiles(char* path, char*** list, int* count, int* size) {
+  DIR* dir;
+  struct dirent* entry;
+  struct stat fileStat;
+  char fileName[FILE_NAME_SIZE];
+  int len;
+
+  if ((stat(path, &fileStat) == 0) && S_ISDIR(fileStat.st_mode)) {
+    if ((dir = opendir(path)) == NULL) {
+      printf("Skipping %s: Unable to open directory!\n", path);
+      return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+      len = strlen(entry->d_name);
+
+      if ((len > 4) && (strcmp(&entry->d_name[len - 4], ".bin") == 0)) {
+        snprintf(fileName, sizeof(fileName), "%s/%s", path, entry->d_name);
+        batchListFiles(fileName, list, count, size);
+      }
+    }
+
+    closedir(dir);
+    return;
+  }
+
+  if (*count >= *size) {
+    *size = (*size == 0) ? 1024 : *size * 2;
+
+    if ((*list = realloc(*list, *size * sizeof(char*))) == NULL) {
+      printf("Error: Out of memory for the file list!\n");
+      printf("idecode terminating.\n");
+      exit(1);
+    }
+  }
+
+  (*list)[(*count)++] = strdup(path);
+}
+
+//*****************************************************************************
+//
+// getDataByBatch
+//
+// fnl is a pointer to the first directory or chunk file name specified on
+// the command line.
+//
+// cnt is the number of names specified on the command line.
+//
+// Reads every chunk file given and processes every report for which all
+// chunks are found.  Reports that are missing chunks are listed at the end
+// without stopping the batch.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int getDataByBatch(char** fnl, int cnt) {
+  threadPool* pool;
+  batchJob job;
+  batchTask* tasks;
+  reassembler total;
+  char** fileList;
+  chunkSet** setList;
+  chunkSet* csPtr;
+  decodeContext** recList;
+  int fileCount;
+  int listSize;
+  int recordCount;
+  int badCount;
+  int errorCount;
+  int setCount;
+  int threads;
+  int i;
+  int j;
+  int k;
+
+  fileList = NULL;
+  fileCount = listSize = 0;
+
+  for (i = 0; i < cnt; ++i) {
+    batchListFiles(fnl[i], &fileList, &fileCount, &listSize);
+  }
+
+  qsort(fileList, fileCount, sizeof(char*), compareNames);
+
+  threads = (decodeThreads > 0) ? decodeThreads : tpDefaultThreads();
+  pool = tpCreate(threads);
+
+  memset(&job, 0, sizeof(job));
+  job.bjFileCount = fileCount;
+  job.bjFiles = reassembleAlloc((fileCount + 1) * sizeof(batchFile));
+  job.bjShardCount = threads * SHARDS_PER_THREAD;
+  job.bjShards = reassembleAlloc(job.bjShardCount * sizeof(batchShard));
+  tasks = reassembleAlloc(((fileCount > job.bjShardCount) ? fileCount : job.bjShardCount) * sizeof(batchTask));
+
+  // Read stage.
+  for (i = 0; i < fileCount; ++i) {
+    job.bjFiles[i].bfName = fileList[i];
+    tasks[i].btJob = &job;
+    tasks[i].btIndex = i;
+    tpSubmit(pool, batchReadTask, &tasks[i]);
+  }
+
+  tpWait(pool);
+
+  badCount = 0;
+
+  for (i = 0; i < fileCount; ++i) {
+    if (job.bjFiles[i].bfLength == CHUNK_FILE_TRACE) {
+      printf("%s", job.bjFiles[i].bfMessage);
+    } else if (job.bjFiles[i].bfLength == 0) {
+      printf("%s", job.bjFiles[i].bfMessage);
+      ++badCount;
+    }
+  }
+
+  // Reassembly stage.
+  for (i = 0; i < job.bjShardCount; ++i) {
+    job.bjShards[i].bsIndex = i;
+    tasks[i].btJob = &job;
+    tasks[i].btIndex = i;
+    tpSubmit(pool, batchReassembleTask, &tasks[i]);
+  }
+
+  tpWait(pool);
+
+  // Decode stage.
+  recordCount = setCount = 0;
+
+  for (i = 0; i < job.bjShardCount; ++i) {
+    recordCount += job.bjShards[i].bsRecordCount;
+    setCount += job.bjShards[i].bsReassembler.raTable.ctCount;
+  }
+
+  recList = reassembleAlloc((recordCount + 1) * sizeof(decodeContext*));
+
+  for (i = k = 0; i < job.bjShardCount; ++i) {
+    for (j = 0; j < job.bjShards[i].bsRecordCount; ++j) {
+      recList[k] = job.bjShards[i].bsRecords[j];
+      tpSubmit(pool, batchDecodeTask, recList[k]);
+      ++k;
+    }
+
+    free(job.bjShards[i].bsRecords);
+  }
+
+  tpWait(pool);
+  tpDestroy(pool);
+
+  // Report the records in Rockblock ID and send time order.  Mail is sent
+  // from here, one record at a time.
+  qsort(recList, recordCount, sizeof(decodeContext*), compareRecords);
+  errorCount = 0;
+
+  for (i = k = 0; i < recordCount; ++i) {
+    printf("%s", recList[i]->dcMessage);
+
+    if ((recList[i]->dcResult != 0) || (mailRecord(recList[i]) != 0)) {
+      ++errorCount;
+      free(recList[i]);
+    } else {
+      recList[k++] = recList[i];
+    }
+  }
+
+  // Each Rockblock's records go into the store together.
+  if ((storeDirectory != NULL) && (storeAppend(storeDirectory, recList, k) != 0)) {
+    ++errorCount;
+  }
+
+  if ((indexDirectory != NULL) && (geoIndexAppend(indexDirectory, recList, k) != 0)) {
+    ++errorCount;
+  }
+
+  if ((exportFileName != NULL) && (exportAppend(recList, k) != 0)) {
+    ++errorCount;
+  }
+
+  if ((summaryFileName != NULL) && (summaryUpdate(recList, k) != 0)) {
+    ++errorCount;
+  }
+
+  for (i = 0; i < k; ++i) {
+    free(recList[i]);
+  }
+
+  free(recList);
+
+  // Whatever is left in the shard reassemblers is missing at least one chunk.
+  setList = reassembleAlloc((setCount + 1) * sizeof(chunkSet*));
+
+  for (i = k = 0; i < job.bjShardCount; ++i) {
+    for (csPtr = job.bjShards[i].bsReassembler.raOldest; csPtr != NULL; csPtr = csPtr->csNewer) {
+      setList[k++] = csPtr;
+    }
+  }
+
+  qsort(setList, setCount, sizeof(chunkSet*), compareChunkSets);
+
+  for (i = 0; i < setCount; ++i) {
+    chunkSetReport(setList[i]);
+  }
+
+  free(setList);
+  memset(&total, 0, sizeof(total));
+
+  for (i = 0; i < job.bjShardCount; ++i) {
+    reassemblerSum(&total, &job.bjShards[i].bsReassembler);
+    reassemblerFree(&job.bjShards[i].bsReassembler);
+  }
+
+  reassemblerPrint(&total);
+
+  for (i = 0; i < fileCount; ++i) {
+    free(fileList[i]);
+  }
+
+  free(fileList);
+  free(job.bjShards);
+  free(job.bjFiles);
+  free(tasks);
+
+  printf("Batch done: %d reports decoded, %d incomplete, %d files skipped.\n",
+         recordCount - errorCount, setCount, badCount);
+  return (errorCount != 0);
+}
@@ -0,0 +1,399 @@
+//*****************************************************************************
+// convert.c
+//
+// Bulk conversion kernels used when decoding many reports at once.
+//
+//   convertHexToBinary    hex characters to bytes, checking every character.
+//   convertSwapHalfwords  big endian halfwords to little endian in place.
+//   convertTempsToC       DS18B20 readings to Celsius, optionally swapping
+//                         them from big endian on the way.
+//
+// Each kernel has an SSE2 and a plain C version, and the first two have an
+// AVX2 version as well.  The best version the processor supports is picked
+// the first time one is called.  The plain
+// C versions give the same results as convertCharToHex,
+// convertBigEndianToLittleEndian and convertTempToC and are the only ones
+// built for processors other than x86.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "convert.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVERT_X86
+#include <immintrin.h>
+#endif
+
+static int convertLevelSet = -1;  // version in use, -1 until it is picked.
+
+static int convertBestLevel(void) {
+#ifdef CONVERT_X86
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return (CONVERT_AVX2);
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return (CONVERT_SSE2);
+  }
+#endif
+
+  return (CONVERT_SCALAR);
+}
+
+//*****************************************************************************
+//
+// convertLevel
+//
+// returns the version of the kernels in use.
+//
+//*****************************************************************************
+
+int convertLevel(void) {
+  if (convertLevelSet < 0) {
+    convertLevelSet = convertBestLevel();
+  }
+
+  return (convertLevelSet);
+}
+
+//*****************************************************************************
+//
+// convertSetLevel
+//
+// Selects the version of the kernels to use.  A version the processor does
+// not support is replaced by the best one it does.
+//
+//*****************************************************************************
+
+void convertSetLevel(int level) {
+  int best;
+
+  best = convertBestLevel();
+  convertLevelSet = (level > best) ? best : level;
+}
+
+const char* convertLevelName(int level) {
+  if (level == CONVERT_AVX2) {
+    return ("avx2");
+  }
+
+  if (level == CONVERT_SSE2) {
+    return ("sse2");
+  }
+
+  return ("scalar");
+}
+
+//*****************************************************************************
+//
+// Plain C versions.
+//
+//*****************************************************************************
+
+static int hexValue(char chr) {
+  if ((chr >= '0') && (chr <= '9')) {
+    return (chr - '0');
+  } else if ((chr >= 'a') && (chr <= 'f')) {
+    return ((chr - 'a') + 10);
+  } else if ((chr >= 'A') && (chr <= 'F')) {
+    return ((chr - 'A') + 10);
+  }
+
+  return (-1);
+}
+
+static int hexToBinaryScalar(const char* src, int len, uint8_t* dst) {
+  int hb1;
+  int hb2;
+  int i;
+
+  for (i = 0; i + 1 < len; i += 2) {
+    if (((hb1 = hexValue(src[i])) < 0) || ((hb2 = hexValue(src[i + 1])) < 0)) {
+      return (-1);
+    }
+
+    dst[i / 2] = (hb1 << 4) | hb2;
+  }
+
+  return (i / 2);
+}
+
+static void swapHalfwordsScalar(uint8_t* buf, int size) {
+  uint8_t tmp;
+  int i;
+
+  for (i = 0; i + 1 < size; i += 2) {
+    tmp = buf[i];
+    buf[i] = buf[i + 1];
+    buf[i + 1] = tmp;
+  }
+}
+
+static void tempsToCScalar(const uint16_t* temps, int count, float* out, bool bigEndian) {
+  uint16_t temp;
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    temp = temps[i];
+
+    if (bigEndian) {
+      temp = (uint16_t)((temp << 8) | (temp >> 8));
+    }
+
+    // The reading is a signed count of 1/128 degrees.
+    out[i] = (float)(int16_t)temp * (1.0f / 128.0f);
+  }
+}
+
+#ifdef CONVERT_X86
+
+//*****************************************************************************
+//
+// SSE2 versions.
+//
+// The hex kernel works out the value of 16 characters at once: digits are
+// found with one range compare, letters with another on the character with
+// the lower case bit set.  Any character in neither range fails the whole
+// call.  The high and low nibbles of each byte are then in the low and high
+// byte of a 16 bit lane, so a shift and an or put them together and a pack
+// with unsigned saturation keeps the low bytes.
+//
+//*****************************************************************************
+
+__attribute__((target("sse2")))
+static inline __m128i hexNibblesSse2(__m128i chars, int* bad) {
+  __m128i lower;
+  __m128i isDigit;
+  __m128i isLetter;
+
+  lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                          _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+  isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                           _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+  *bad |= _mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) ^ 0xFFFF;
+  return (_mm_or_si128(_mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                       _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)))));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i hexPairsSse2(__m128i nibbles) {
+  return (_mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4),
+                       _mm_srli_epi16(nibbles, 8)));
+}
+
+__attribute__((target("sse2")))
+static int hexToBinarySse2(const char* src, int len, uint8_t* dst) {
+  __m128i lo;
+  __m128i hi;
+  int bad;
+  int i;
+
+  bad = 0;
+
+  for (i = 0; i + 32 <= len; i += 32) {
+    lo = hexPairsSse2(hexNibblesSse2(_mm_loadu_si128((const __m128i*)(src + i)), &bad));
+    hi = hexPairsSse2(hexNibblesSse2(_mm_loadu_si128((const __m128i*)(src + i + 16)), &bad));
+    _mm_storeu_si128((__m128i*)(dst + (i / 2)), _mm_packus_epi16(lo, hi));
+  }
+
+  if ((bad != 0) || (hexToBinaryScalar(src + i, len - i, dst + (i / 2)) < 0)) {
+    return (-1);
+  }
+
+  return (len / 2);
+}
+
+__attribute__((target("sse2")))
+static void swapHalfwordsSse2(uint8_t* buf, int size) {
+  __m128i val;
+  int i;
+
+  for (i = 0; i + 16 <= size; i += 16) {
+    val = _mm_loadu_si128((const __m128i*)(buf + i));
+    _mm_storeu_si128((__m128i*)(buf + i), _mm_or_si128(_mm_slli_epi16(val, 8), _mm_srli_epi16(val, 8)));
+  }
+
+  swapHalfwordsScalar(buf + i, size - i);
+}
+
+__attribute__((target("sse2")))
+static void tempsToCSse2(const uint16_t* temps, int count, float* out, bool bigEndian) {
+  const __m128 scale = _mm_set1_ps(1.0f / 128.0f);
+  __m128i val;
+  int i;
+
+  for (i = 0; i + 8 <= count; i += 8) {
+    val = _mm_loadu_si128((const __m128i*)(temps + i));
+
+    if (bigEndian) {
+      val = _mm_or_si128(_mm_slli_epi16(val, 8), _mm_srli_epi16(val, 8));
+    }
+
+    // Unpacking a lane with itself and shifting it back down sign extends it.
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(val, val), 16)), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(val, val), 16)), scale));
+  }
+
+  tempsToCScalar(temps + i, count - i, out + i, bigEndian);
+}
+
+//*****************************************************************************
+//
+// AVX2 versions.
+//
+// The same as the SSE2 versions on 32 byte vectors.  The pack works within
+// each 16 byte half, so its result is put back in order with a permute.
+//
+//*****************************************************************************
+
+__attribute__((target("avx2")))
+static inline __m256i hexNibblesAvx2(__m256i chars, uint32_t* bad) {
+  __m256i lower;
+  __m256i isDigit;
+  __m256i isLetter;
+
+  lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  isDigit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)),
+                             _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+  isLetter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                              _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+  *bad |= ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(isDigit, isLetter));
+  return (_mm256_or_si256(_mm256_and_si256(isDigit, _mm256_sub_epi8(chars, _mm256_set1_epi8('0'))),
+                          _mm256_and_si256(isLetter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)))));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hexPairsAvx2(__m256i nibbles) {
+  return (_mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4),
+                          _mm256_srli_epi16(nibbles, 8)));
+}
+
+__attribute__((target("avx2")))
+static int hexToBinaryAvx2(const char* src, int len, uint8_t* dst) {
+  __m256i lo;
+  __m256i hi;
+  uint32_t bad;
+  int i;
+
+  bad = 0;
+
+  for (i = 0; i + 64 <= len; i += 64) {
+    lo = hexPairsAvx2(hexNibblesAvx2(_mm256_loadu_si256((const __m256i*)(src + i)), &bad));
+    hi = hexPairsAvx2(hexNibblesAvx2(_mm256_loadu_si256((const __m256i*)(src + i + 32)), &bad));
+    _mm256_storeu_si256((__m256i*)(dst + (i / 2)),
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+  }
+
+  if ((bad != 0) || (hexToBinarySse2(src + i, len - i, dst + (i / 2)) < 0)) {
+    return (-1);
+  }
+
+  return (len / 2);
+}
+
+__attribute__((target("avx2")))
+static void swapHalfwordsAvx2(uint8_t* buf, int size) {
+  __m256i val;
+  int i;
+
+  for (i = 0; i + 32 <= size; i += 32) {
+    val = _mm256_loadu_si256((const __m256i*)(buf + i));
+    _mm256_storeu_si256((__m256i*)(buf + i), _mm256_or_si256(_mm256_slli_epi16(val, 8), _mm256_srli_epi16(val, 8)));
+  }
+
+  swapHalfwordsSse2(buf + i, size - i);
+}
+
+#endif // CONVERT_X86
+
+//*****************************************************************************
+//
+// convertHexToBinary
+//
+// src: the hex characters to convert.
+//
+// len: the number of characters, which must be even.
+//
+// dst: receives len / 2 bytes.
+//
+// returns the number of bytes stored, or -1 if len is odd or a character is
+// not a hex digit.  dst may have been written to when -1 is returned.
+//
+//*****************************************************************************
+
+int convertHexToBinary(const char* src, int len, uint8_t* dst) {
+  if (len & 1) {
+    return (-1);
+  }
+
+#ifdef CONVERT_X86
+  switch (convertLevel()) {
+    case CONVERT_AVX2:
+      return (hexToBinaryAvx2(src, len, dst));
+
+    case CONVERT_SSE2:
+      return (hexToBinarySse2(src, len, dst));
+  }
+#endif
+
+  return (hexToBinaryScalar(src, len, dst));
+}
+
+//*****************************************************************************
+//
+// convertSwapHalfwords
+//
+// Swaps the two bytes of each halfword in the size bytes at buf.
+//
+//*****************************************************************************
+
+void convertSwapHalfwords(uint8_t* buf, int size) {
+#ifdef CONVERT_X86
+  switch (convertLevel()) {
+    case CONVERT_AVX2:
+      swapHalfwordsAvx2(buf, size);
+      return;
+
+    case CONVERT_SSE2:
+      swapHalfwordsSse2(buf, size);
+      return;
+  }
+#endif
+
+  swapHalfwordsScalar(buf, size);
+}
+
+//*****************************************************************************
+//
+// convertTempsToC
+//
+// temps: count DS18B20 readings.
+//
+// out: receives count temperatures in Celsius.
+//
+// bigEndian: true if the readings are still in the big endian order the
+//            sensors send them in.
+//
+//*****************************************************************************
+
+void convertTempsToC(const uint16_t* temps, int count, float* out, bool bigEndian) {
+#ifdef CONVERT_X86
+  switch (convertLevel()) {
+    // An AVX2 version of this one measured slower than the SSE2 one, so
+    // the AVX2 level uses SSE2 here too.
+    case CONVERT_AVX2:
+    case CONVERT_SSE2:
+      tempsToCSse2(temps, count, out, bigEndian);
+      return;
+  }
+#endif
+
+  tempsToCScalar(temps, count, out, bigEndian);
+}
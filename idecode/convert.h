@@ -0,0 +1,25 @@
+//*****************************************************************************
+// convert.h
+//
+// Bulk conversion kernels used when decoding many reports at once.
+//
+//*****************************************************************************
+
+#ifndef _CONVERT_H
+#define _CONVERT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONVERT_SCALAR  0
+#define CONVERT_SSE2    1
+#define CONVERT_AVX2    2
+
+int convertLevel(void);
+void convertSetLevel(int level);
+const char* convertLevelName(int level);
+int convertHexToBinary(const char* src, int len, uint8_t* dst);
+void convertSwapHalfwords(uint8_t* buf, int size);
+void convertTempsToC(const uint16_t* temps, int count, float* out, bool bigEndian);
+
+#endif // _CONVERT_H
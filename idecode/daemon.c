@@ -0,0 +1,608 @@
+//*****************************************************************************
+// daemon.c
+//
+// Daemon mode for idecode.
+//
+// Watches a spool directory with inotify and decodes each report as soon as
+// the last of its chunk files lands there.  Chunk files are read when they
+// are closed after writing or moved into the spool, filed in a reassembler
+// and moved to <spool>/done, or to <spool>/bad if they are not chunk files.
+//
+// Every chunk is written to the journal <spool>/.idecode.journal before its
+// file is moved, and every report that is finished or given up on is noted
+// there too.  On start the journal is read back to rebuild the chunk sets
+// that were still waiting for chunks, then rewritten with only those, and
+// any chunk files that landed while the daemon was down are read.
+//
+// A chunk set that gets no new chunks for the timeout, or that is pushed
+// out by the reassembly memory cap, is reported as incomplete and dropped.
+//
+// If a finished report can not be written out, its chunks are written back
+// to <spool>/bad as chunk files, so the report can be decoded again by
+// moving them into the spool.  A chunk file that can not be journaled is
+// left in the spool and read again at the next sweep.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "idecode.h"
+#include "reassemble.h"
+#include "store.h"
+#include "geoindex.h"
+#include "notify.h"
+#include "export.h"
+#include "summary.h"
+
+#define DAEMON_JOURNAL_NAME ".idecode.journal"
+#define DAEMON_SWEEP_SECONDS 60             // how often timed out sets are looked for.
+#define DAEMON_JOURNAL_LIMIT (4 * 1024 * 1024)  // journal size that causes it to be rewritten.
+#define DAEMON_EVENT_BUFFER 16384
+
+#define JOURNAL_CHUNK   1  // a chunk was filed.
+#define JOURNAL_DONE    2  // a report was finished.
+#define JOURNAL_EXPIRE  3  // a report was given up on.
+
+// A journal entry.  A JOURNAL_CHUNK entry is followed by jeLength bytes of
+// chunk data.
+typedef struct journalEntry {
+  char jeMagic[2];  // "IJ"
+  uint8_t jeType;
+  uint8_t jeSpare;
+  uint32_t jeTime;  // unix time the entry was written.
+  uint32_t jeSendTime;
+  uint16_t jeRecordNumber;
+  uint16_t jeLength;
+  char jeRockblockId[ROCKBLOCK_ID_SIZE];
+} journalEntry;
+
+typedef struct daemonState {
+  char* dsSpool;
+  char dsJournalName[FILE_NAME_SIZE];
+  FILE* dsJournal;
+  reassembler dsReassembler;
+  time_t dsLastSweep;
+  long dsReports;
+  long dsExpired;
+  bool dsRescan;  // a chunk file was left in the spool to be read again.
+} daemonState;
+
+static volatile sig_atomic_t daemonStop;
+
+static void daemonSignal(int sig) {
+  (void)sig;
+  daemonStop = 1;
+}
+
+//*****************************************************************************
+//
+// journalAppend
+//
+// Adds an entry written at time when to the journal buffer.
+//
+//*****************************************************************************
+
+static int journalAppend(daemonState* dsPtr, int type, char* rbId, uint32_t sendTime,
+                         iceDrifterChunk* idcPtr, int length, time_t when) {
+  journalEntry entry;
+
+  memset(&entry, 0, sizeof(entry));
+  entry.jeMagic[0] = 'I';
+  entry.jeMagic[1] = 'J';
+  entry.jeType = type;
+  entry.jeTime = when;
+  entry.jeSendTime = sendTime;
+  strcpy(entry.jeRockblockId, rbId);
+
+  if (idcPtr != NULL) {
+    entry.jeRecordNumber = idcPtr->idcRecordNumber;
+    entry.jeLength = length;
+  }
+
+  if ((fwrite(&entry, sizeof(entry), 1, dsPtr->dsJournal) != 1) ||
+      ((length != 0) && (fwrite(idcPtr->idcBuffer, length, 1, dsPtr->dsJournal) != 1))) {
+    printf("Error writing journal %s!\n", dsPtr->dsJournalName);
+    return (1);
+  }
+
+  return (0);
+}
+
+static int journalSync(daemonState* dsPtr) {
+  if ((fflush(dsPtr->dsJournal) != 0) || (fdatasync(fileno(dsPtr->dsJournal)) != 0)) {
+    printf("Error writing journal %s!\n", dsPtr->dsJournalName);
+    return (1);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// journalWrite
+//
+// Appends an entry to the journal and waits for it to reach the disk.
+//
+//*****************************************************************************
+
+static int journalWrite(daemonState* dsPtr, int type, char* rbId, uint32_t sendTime,
+                        iceDrifterChunk* idcPtr, int length) {
+  if (journalAppend(dsPtr, type, rbId, sendTime, idcPtr, length, time(NULL)) != 0) {
+    return (1);
+  }
+
+  return (journalSync(dsPtr));
+}
+
+//*****************************************************************************
+//
+// journalRewrite
+//
+// Replaces the journal with one that only holds the chunks of the sets
+// still waiting for chunks.
+//
+//*****************************************************************************
+
+static int journalRewrite(daemonState* dsPtr) {
+  char tempName[FILE_NAME_SIZE];
+  iceDrifterChunk chunk;
+  chunkSet* csPtr;
+  FILE* oldJournal;
+  int j;
+  int rc;
+
+  if (snprintf(tempName, sizeof(tempName), "%s.tmp", dsPtr->dsJournalName) >= (int)sizeof(tempName)) {
+    printf("Error: Journal name %s too long!\n", dsPtr->dsJournalName);
+    return (1);
+  }
+
+  oldJournal = dsPtr->dsJournal;
+
+  if ((dsPtr->dsJournal = fopen(tempName, "wb")) == NULL) {
+    printf("Error creating journal %s!\n", tempName);
+    dsPtr->dsJournal = oldJournal;
+    return (1);
+  }
+
+  rc = 0;
+
+  // The sets are written oldest first so a replay puts them back in the
+  // same order.
+  for (csPtr = dsPtr->dsReassembler.raOldest; (csPtr != NULL) && (rc == 0); csPtr = csPtr->csNewer) {
+    for (j = 0; j < (int)MAX_RECORD_CHUNKS; ++j) {
+      if (csPtr->csChunkLength[j] != 0) {
+        chunk.idcRecordNumber = j | (csPtr->csCompressed ? CHUNK_COMPRESSED : 0);
+        memcpy(chunk.idcBuffer, csPtr->csChunkData[j], csPtr->csChunkLength[j]);
+
+        // The time the set was last added to is kept so a restart does
+        // not put off its timeout.
+        if ((rc = journalAppend(dsPtr, JOURNAL_CHUNK, csPtr->csRockblockId, csPtr->csSendTime,
+                                &chunk, csPtr->csChunkLength[j], csPtr->csUpdated)) != 0) {
+          break;
+        }
+      }
+    }
+  }
+
+  if ((rc != 0) || (journalSync(dsPtr) != 0) || (rename(tempName, dsPtr->dsJournalName) != 0)) {
+    printf("Error replacing journal %s!\n", dsPtr->dsJournalName);
+    fclose(dsPtr->dsJournal);
+    unlink(tempName);
+    dsPtr->dsJournal = oldJournal;
+    return (1);
+  }
+
+  if (oldJournal != NULL) {
+    fclose(oldJournal);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// journalReplay
+//
+// Rebuilds the reassembler from the journal.  Every chunk file read was
+// journaled, so duplicate and late chunks are weeded out again here just as
+// they were when they were read.  A torn entry at the end, left by a crash
+// while it was written, ends the replay.
+//
+//*****************************************************************************
+
+static void journalReplay(daemonState* dsPtr) {
+  journalEntry entry;
+  iceDrifterChunk chunk;
+  chunkSet* csPtr;
+  FILE* fd;
+  long entries;
+
+  if ((fd = fopen(dsPtr->dsJournalName, "rb")) == NULL) {
+    return;
+  }
+
+  entries = 0;
+
+  while (fread(&entry, sizeof(entry), 1, fd) == 1) {
+    if ((entry.jeMagic[0] != 'I') || (entry.jeMagic[1] != 'J') ||
+        (entry.jeLength > MAX_CHUNK_DATA_LENGTH) || (CHUNK_NUMBER(entry.jeRecordNumber) >= MAX_RECORD_CHUNKS) ||
+        (memchr(entry.jeRockblockId, 0, sizeof(entry.jeRockblockId)) == NULL)) {
+      break;
+    }
+
+    if (entry.jeType == JOURNAL_CHUNK) {
+      if ((entry.jeLength == 0) || (fread(chunk.idcBuffer, entry.jeLength, 1, fd) != 1)) {
+        break;
+      }
+
+      chunk.idcSendTime = entry.jeSendTime;
+      chunk.idcRecordNumber = entry.jeRecordNumber;
+      reassemblerAdd(&dsPtr->dsReassembler, entry.jeRockblockId, &chunk, entry.jeLength, &csPtr);
+
+      if (csPtr != NULL) {
+        csPtr->csUpdated = entry.jeTime;
+      }
+    } else if ((csPtr = chunkTableLookup(&dsPtr->dsReassembler.raTable, entry.jeRockblockId, entry.jeSendTime,
+                                         chunkHash(entry.jeRockblockId, entry.jeSendTime))) != NULL) {
+      if (entry.jeType == JOURNAL_DONE) {
+        reassemblerDone(&dsPtr->dsReassembler, csPtr);
+      } else {
+        reassemblerDrop(&dsPtr->dsReassembler, csPtr);
+      }
+    }
+
+    ++entries;
+  }
+
+  fclose(fd);
+  printf("Journal replayed: %ld entries, %d reports waiting for chunks.\n", entries,
+         dsPtr->dsReassembler.raTable.ctCount);
+}
+
+//*****************************************************************************
+//
+// daemonSaveBad
+//
+// Writes the chunks of a set to <spool>/bad as chunk files named
+// <Rockblock ID>-<send time>-<chunk>.bin.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int daemonSaveBad(daemonState* dsPtr, chunkSet* csPtr) {
+  char fileName[FILE_NAME_SIZE];
+  iceDrifterChunk chunk;
+  FILE* fd;
+  int j;
+
+  chunk.idcSendTime = csPtr->csSendTime;
+  chunk.idcRecordType[0] = 'I';
+  chunk.idcRecordType[1] = 'D';
+
+  for (j = 0; j < (int)MAX_RECORD_CHUNKS; ++j) {
+    if (csPtr->csChunkLength[j] == 0) {
+      continue;
+    }
+
+    if (snprintf(fileName, sizeof(fileName), "%s/bad/%s-%08x-%d.bin", dsPtr->dsSpool, csPtr->csRockblockId,
+                 csPtr->csSendTime, j) >= (int)sizeof(fileName)) {
+      printf("Error: Spool directory name %s too long!\n", dsPtr->dsSpool);
+      return (1);
+    }
+
+    chunk.idcRecordNumber = j | (csPtr->csCompressed ? CHUNK_COMPRESSED : 0);
+    memcpy(chunk.idcBuffer, csPtr->csChunkData[j], csPtr->csChunkLength[j]);
+
+    if (((fd = fopen(fileName, "wb")) == NULL) ||
+        (fwrite(&chunk, CHUNK_HEADER_SIZE + csPtr->csChunkLength[j], 1, fd) != 1) || (fclose(fd) != 0)) {
+      printf("Error writing %s!\n", fileName);
+      return (1);
+    }
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// daemonFinish
+//
+// Finishes a complete chunk set the same way as batch mode and notes it in
+// the journal.  If the report can not be written out its chunks are saved
+// in <spool>/bad.  If even that fails the set is kept, and the next sweep
+// tries it again.
+//
+//*****************************************************************************
+
+static void daemonFinish(daemonState* dsPtr, chunkSet* csPtr) {
+  decodeContext* ctx;
+
+  ctx = chunkSetRecord(csPtr);
+  printf("Processing data for Rockblock %s sent %08x.\n", ctx->dcRockblockId, ctx->dcSendTime);
+
+  if ((finishRecord(ctx) != 0) || (mailRecord(ctx) != 0) ||
+      ((storeDirectory != NULL) && (storeAppend(storeDirectory, &ctx, 1) != 0)) ||
+      ((indexDirectory != NULL) && (geoIndexAppend(indexDirectory, &ctx, 1) != 0)) ||
+      ((exportFileName != NULL) && (exportAppend(&ctx, 1) != 0)) ||
+      ((summaryFileName != NULL) && (summaryUpdate(&ctx, 1) != 0))) {
+    printf("Error processing data for Rockblock %s sent %08x!\n", ctx->dcRockblockId, ctx->dcSendTime);
+
+    if (daemonSaveBad(dsPtr, csPtr) != 0) {
+      free(ctx);
+      fflush(stdout);
+      return;
+    }
+
+    printf("Chunks of the report saved in %s/bad.\n", dsPtr->dsSpool);
+  } else {
+    ++dsPtr->dsReports;
+  }
+
+  journalWrite(dsPtr, JOURNAL_DONE, csPtr->csRockblockId, csPtr->csSendTime, NULL, 0);
+  reassemblerDone(&dsPtr->dsReassembler, csPtr);
+  free(ctx);
+  fflush(stdout);
+}
+
+static void daemonMove(daemonState* dsPtr, char* name, char* subDir) {
+  char fileName[FILE_NAME_SIZE];
+  char newName[FILE_NAME_SIZE];
+
+  if ((snprintf(fileName, sizeof(fileName), "%s/%s", dsPtr->dsSpool, name) >= (int)sizeof(fileName)) ||
+      (snprintf(newName, sizeof(newName), "%s/%s/%s", dsPtr->dsSpool, subDir, name) >= (int)sizeof(newName))) {
+    printf("Error: Name of %s in the spool too long!\n", name);
+    return;
+  }
+
+  if (rename(fileName, newName) != 0) {
+    printf("Error moving %s to %s!\n", fileName, newName);
+  }
+}
+
+//*****************************************************************************
+//
+// daemonFile
+//
+// Reads one chunk file from the spool.
+//
+//*****************************************************************************
+
+static void daemonFile(daemonState* dsPtr, char* name) {
+  char fileName[FILE_NAME_SIZE];
+  char message[DECODE_MESSAGE_SIZE];
+  char rbId[ROCKBLOCK_ID_SIZE];
+  iceDrifterChunk chunk;
+  chunkSet* csPtr;
+  int len;
+
+  len = strlen(name);
+
+  if ((name[0] == '.') || (len <= 4) || (strcmp(&name[len - 4], ".bin") != 0)) {
+    return;
+  }
+
+  snprintf(fileName, sizeof(fileName), "%s/%s", dsPtr->dsSpool, name);
+
+  if ((len = chunkFileRead(fileName, rbId, &chunk, message, sizeof(message))) == 0) {
+    printf("%s", message);
+    daemonMove(dsPtr, name, "bad");
+    return;
+  }
+
+  if (len == CHUNK_FILE_TRACE) {
+    printf("%s", message);
+    daemonMove(dsPtr, name, "done");
+    return;
+  }
+
+  // Without an inotify event for it the file is only read again by a scan.
+  if (journalWrite(dsPtr, JOURNAL_CHUNK, rbId, chunk.idcSendTime, &chunk, len) != 0) {
+    dsPtr->dsRescan = true;
+    return;
+  }
+
+  daemonMove(dsPtr, name, "done");
+
+  if (reassemblerAdd(&dsPtr->dsReassembler, rbId, &chunk, len, &csPtr) == CHUNK_COMPLETE) {
+    daemonFinish(dsPtr, csPtr);
+  }
+}
+
+//*****************************************************************************
+//
+// daemonEvict
+//
+// Gives up on a set that has timed out or has been pushed out by the memory
+// cap.
+//
+//*****************************************************************************
+
+static void daemonEvict(chunkSet* csPtr, void* arg) {
+  daemonState* dsPtr = arg;
+
+  chunkSetReport(csPtr);
+  journalWrite(dsPtr, JOURNAL_EXPIRE, csPtr->csRockblockId, csPtr->csSendTime, NULL, 0);
+  ++dsPtr->dsExpired;
+}
+
+static int daemonScan(daemonState* dsPtr) {
+  DIR* dir;
+  struct dirent* entry;
+
+  if ((dir = opendir(dsPtr->dsSpool)) == NULL) {
+    printf("Error: Unable to open spool directory %s!\n", dsPtr->dsSpool);
+    return (1);
+  }
+
+  while ((entry = readdir(dir)) != NULL) {
+    daemonFile(dsPtr, entry->d_name);
+  }
+
+  closedir(dir);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// daemonSweep
+//
+// Reads any chunk files left in the spool, finishes any complete sets and
+// gives up on sets that have waited longer than the timeout.  The journal
+// is rewritten if it has grown too big.
+//
+//*****************************************************************************
+
+static void daemonSweep(daemonState* dsPtr) {
+  chunkSet* csPtr;
+  chunkSet* nextPtr;
+
+  dsPtr->dsLastSweep = time(NULL);
+
+  if (dsPtr->dsRescan) {
+    dsPtr->dsRescan = false;
+    daemonScan(dsPtr);
+  }
+
+  // Only a replay of the journal, or a report that could not be written
+  // out or saved, can leave a complete set behind.
+  for (csPtr = dsPtr->dsReassembler.raOldest; csPtr != NULL; csPtr = nextPtr) {
+    nextPtr = csPtr->csNewer;
+
+    if (chunkSetComplete(csPtr)) {
+      daemonFinish(dsPtr, csPtr);
+    }
+  }
+
+  reassemblerExpire(&dsPtr->dsReassembler, dsPtr->dsLastSweep - daemonTimeout + 1);
+
+  if (ftell(dsPtr->dsJournal) > DAEMON_JOURNAL_LIMIT) {
+    journalRewrite(dsPtr);
+  }
+
+  fflush(stdout);
+}
+
+//*****************************************************************************
+//
+// getDataByDaemon
+//
+// spool: the directory chunk files are delivered to.
+//
+// Runs until it is sent SIGINT or SIGTERM.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int getDataByDaemon(char* spool) {
+  daemonState state;
+  struct sigaction action;
+  struct pollfd pfd;
+  struct inotify_event* event;
+  char dirName[FILE_NAME_SIZE];
+  char events[DAEMON_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+  char* evPtr;
+  ssize_t len;
+  int watchFd;
+  int waitTime;
+
+  memset(&state, 0, sizeof(state));
+  state.dsSpool = spool;
+  snprintf(state.dsJournalName, sizeof(state.dsJournalName), "%s/%s", spool, DAEMON_JOURNAL_NAME);
+  snprintf(dirName, sizeof(dirName), "%s/done", spool);
+  mkdir(dirName, 0775);
+  snprintf(dirName, sizeof(dirName), "%s/bad", spool);
+  mkdir(dirName, 0775);
+
+  // Watch before the first scan so no chunk file can slip in between.
+  if (((watchFd = inotify_init1(IN_CLOEXEC)) < 0) ||
+      (inotify_add_watch(watchFd, spool, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)) {
+    printf("Error: Unable to watch spool directory %s!\n", spool);
+    return (1);
+  }
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = daemonSignal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  reassemblerInit(&state.dsReassembler, reassembleMemory);
+  journalReplay(&state);
+  state.dsReassembler.raEvict = daemonEvict;
+  state.dsReassembler.raEvictArg = &state;
+
+  if (journalRewrite(&state) != 0) {
+    return (1);
+  }
+
+  if (daemonScan(&state) != 0) {
+    return (1);
+  }
+
+  daemonSweep(&state);
+  printf("Watching %s.\n", spool);
+  fflush(stdout);
+
+  pfd.fd = watchFd;
+  pfd.events = POLLIN;
+
+  while (!daemonStop) {
+    // Wake up in time to send the notification digest when it is due.
+    waitTime = notifyTimeLeft();
+    waitTime = ((waitTime < 0) || (waitTime > DAEMON_SWEEP_SECONDS)) ? DAEMON_SWEEP_SECONDS : waitTime;
+
+    if (poll(&pfd, 1, waitTime * 1000) > 0) {
+      if ((len = read(watchFd, events, sizeof(events))) <= 0) {
+        if ((len < 0) && (errno != EINTR) && (errno != EAGAIN)) {
+          printf("Error reading spool directory events!\n");
+          break;
+        }
+
+        continue;
+      }
+
+      for (evPtr = events; evPtr < events + len; evPtr += sizeof(struct inotify_event) + event->len) {
+        event = (struct inotify_event*)evPtr;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+          // Events were lost, so look at everything in the spool.
+          daemonScan(&state);
+        } else if (event->len != 0) {
+          daemonFile(&state, event->name);
+        }
+      }
+    }
+
+    if (time(NULL) - state.dsLastSweep >= DAEMON_SWEEP_SECONDS) {
+      daemonSweep(&state);
+    }
+
+    // Rows written since the last wake up go out together.
+    exportFlush();
+    summaryFlush();
+    notifyFlush(false);
+  }
+
+  exportClose();
+  summaryFlush();
+  notifyFlush(true);
+  journalRewrite(&state);
+  fclose(state.dsJournal);
+  close(watchFd);
+  printf("Daemon done: %ld reports decoded, %ld timed out, %d waiting for chunks.\n",
+         state.dsReports, state.dsExpired, state.dsReassembler.raTable.ctCount);
+  reassemblerPrint(&state.dsReassembler);
+  reassemblerFree(&state.dsReassembler);
+  return (0);
+}
@@ -0,0 +1,543 @@
+//*****************************************************************************
+// drift.c
+//
+// Drift analytics for idecode.
+//
+// The GPS fixes of every Rockblock in the columnar store are loaded into
+// one set of fleet wide arrays, one array per value, with each track a
+// contiguous slice.  For each fix the great circle distance, drift speed,
+// heading and time from the previous fix are worked out, along with the
+// distance drifted since the first fix.  If an interval is given, each
+// track is also resampled onto fixes that interval apart, interpolated
+// between the fixes either side.
+//
+// The work runs on the thread pool in two stages:
+//
+//   load     Each track's lat and lon columns are read from the store by
+//            its own task.
+//   analyze  Each track is cleaned up, copied into its slice of the fleet
+//            arrays, analyzed and formatted as CSV by its own task.
+//
+// The analysis loops work a whole track at a time on plain arrays with no
+// branches in their bodies, so the compiler can vectorize them.  The rows
+// are printed at the end in Rockblock id order, so the output does not
+// depend on the number of threads.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "idecode.h"
+#include "threadpool.h"
+#include "store.h"
+#include "drift.h"
+
+#define DEG_TO_RAD (M_PI / 180.0)
+#define RAD_TO_DEG (180.0 / M_PI)
+
+// Task arguments carry a pointer to the fleet and an index into it.
+typedef struct driftTask {
+  driftFleet* dkFleet;
+  int dkIndex;
+} driftTask;
+
+static void* driftAlloc(size_t size) {
+  void* ptr;
+
+  if ((ptr = malloc(size)) == NULL) {
+    printf("Error: Out of memory for the drift analysis!\n");
+    printf("idecode terminating.\n");
+    exit(1);
+  }
+
+  return (ptr);
+}
+
+static int compareTracks(const void* a, const void* b) {
+  return (strcmp(((driftTrack*)a)->dtRockblockId, ((driftTrack*)b)->dtRockblockId));
+}
+
+//*****************************************************************************
+//
+// driftLoadTask
+//
+// Reads the lat and lon columns of one track from the store.
+//
+//*****************************************************************************
+
+static void driftLoadTask(void* arg) {
+  driftFleet* dfPtr;
+  driftTrack* dtPtr;
+  uint32_t* lonTime;
+  int lonCount;
+
+  dfPtr = ((driftTask*)arg)->dkFleet;
+  dtPtr = &dfPtr->dfTracks[((driftTask*)arg)->dkIndex];
+
+  dtPtr->dtLoadCount = storeLoad(dfPtr->dfStoreDir, dtPtr->dtRockblockId, "lat", dfPtr->dfFromTime,
+                                 dfPtr->dfToTime, &dtPtr->dtLoadTime, &dtPtr->dtLoadLat);
+  lonCount = storeLoad(dfPtr->dfStoreDir, dtPtr->dtRockblockId, "lon", dfPtr->dfFromTime, dfPtr->dfToTime,
+                       &lonTime, &dtPtr->dtLoadLon);
+
+  // Both columns are written from the same records, so they have the same
+  // times.
+  if ((dtPtr->dtLoadCount < 0) || (lonCount != dtPtr->dtLoadCount) ||
+      ((lonCount > 0) && (memcmp(lonTime, dtPtr->dtLoadTime, lonCount * sizeof(uint32_t)) != 0))) {
+    printf("Error: The lat and lon columns of Rockblock %s do not match!\n", dtPtr->dtRockblockId);
+    dtPtr->dtResult = 1;
+    dtPtr->dtLoadCount = 0;
+  }
+
+  free(lonTime);
+}
+
+//*****************************************************************************
+//
+// driftClean
+//
+// Copies a loaded track into its slice of the fleet arrays in time order,
+// leaving out records without a fix and all but the last of any fixes
+// with the same time.
+//
+// returns the number of fixes kept.
+//
+//*****************************************************************************
+
+static int driftClean(driftFleet* dfPtr, driftTrack* dtPtr) {
+  uint32_t* t;
+  double* phi;
+  double* lambda;
+  uint32_t wkTime;
+  double wkPhi;
+  double wkLambda;
+  int count;
+  int i;
+  int j;
+  int k;
+
+  t = dfPtr->dfTime + dtPtr->dtStart;
+  phi = dfPtr->dfPhi + dtPtr->dtStart;
+  lambda = dfPtr->dfLambda + dtPtr->dtStart;
+
+  for (i = count = 0; i < dtPtr->dtLoadCount; ++i) {
+    if ((dtPtr->dtLoadLat[i] != 0.0) || (dtPtr->dtLoadLon[i] != 0.0)) {
+      t[count] = dtPtr->dtLoadTime[i];
+      phi[count] = dtPtr->dtLoadLat[i] * DEG_TO_RAD;
+      lambda[count++] = dtPtr->dtLoadLon[i] * DEG_TO_RAD;
+    }
+  }
+
+  free(dtPtr->dtLoadTime);
+  free(dtPtr->dtLoadLat);
+  free(dtPtr->dtLoadLon);
+  dtPtr->dtLoadTime = NULL;
+  dtPtr->dtLoadLat = dtPtr->dtLoadLon = NULL;
+
+  // The fixes are nearly always in order already.
+  for (i = 1; i < count; ++i) {
+    wkTime = t[i];
+    wkPhi = phi[i];
+    wkLambda = lambda[i];
+
+    for (j = i; (j > 0) && (t[j - 1] > wkTime); --j) {
+      t[j] = t[j - 1];
+      phi[j] = phi[j - 1];
+      lambda[j] = lambda[j - 1];
+    }
+
+    t[j] = wkTime;
+    phi[j] = wkPhi;
+    lambda[j] = wkLambda;
+  }
+
+  for (i = k = 0; i < count; ++i) {
+    if ((k > 0) && (t[k - 1] == t[i])) {
+      --k;
+    }
+
+    t[k] = t[i];
+    phi[k] = phi[i];
+    lambda[k++] = lambda[i];
+  }
+
+  return (k);
+}
+
+//*****************************************************************************
+//
+// driftSteps
+//
+// n: number of fixes in the track.
+//
+// Works out the step from the previous fix to each fix: the haversine
+// distance, the speed, the initial great circle heading and the time.  The
+// first fix has no step, so its values are 0.
+//
+//*****************************************************************************
+
+static void driftSteps(int n, const uint32_t* restrict t, const double* restrict phi,
+                       const double* restrict lambda, double* restrict sinPhi, double* restrict cosPhi,
+                       double* restrict step, double* restrict distance, double* restrict speed,
+                       double* restrict heading, double* restrict gap) {
+  double dPhi;
+  double dLambda;
+  double s1;
+  double s2;
+  double a;
+  double dt;
+  double h;
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    sinPhi[i] = sin(phi[i]);
+    cosPhi[i] = cos(phi[i]);
+  }
+
+  step[0] = speed[0] = heading[0] = gap[0] = 0.0;
+
+  for (i = 1; i < n; ++i) {
+    dPhi = phi[i] - phi[i - 1];
+    dLambda = lambda[i] - lambda[i - 1];
+    s1 = sin(dPhi * 0.5);
+    s2 = sin(dLambda * 0.5);
+    a = fmin((s1 * s1) + (cosPhi[i - 1] * cosPhi[i] * s2 * s2), 1.0);
+    step[i] = 2.0 * EARTH_RADIUS_KM * asin(sqrt(a));
+    dt = (double)(t[i] - t[i - 1]);
+    speed[i] = (step[i] * 1000.0) / dt;
+    gap[i] = dt / 3600.0;
+    h = atan2(sin(dLambda) * cosPhi[i], (cosPhi[i - 1] * sinPhi[i]) - (sinPhi[i - 1] * cosPhi[i] * cos(dLambda)));
+    h *= RAD_TO_DEG;
+    heading[i] = h + ((h < 0.0) ? 360.0 : 0.0);
+  }
+
+  // The running total is the only loop carried dependency, so it is kept
+  // out of the loop above.
+  distance[0] = 0.0;
+
+  for (i = 1; i < n; ++i) {
+    distance[i] = distance[i - 1] + step[i];
+  }
+}
+
+// Appends one row to a track's output, growing it as needed.
+static char* driftRow(driftTrack* dtPtr, size_t* size) {
+  if (dtPtr->dtOutputLength + DRIFT_ROW_SIZE > *size) {
+    *size = (*size == 0) ? 64 * DRIFT_ROW_SIZE : *size * 2;
+
+    if ((dtPtr->dtOutput = realloc(dtPtr->dtOutput, *size)) == NULL) {
+      printf("Error: Out of memory for the drift analysis!\n");
+      printf("idecode terminating.\n");
+      exit(1);
+    }
+  }
+
+  return (dtPtr->dtOutput + dtPtr->dtOutputLength);
+}
+
+static void driftTime(char* buff, int size, uint32_t unixTime) {
+  struct tm timeInfo;
+  time_t tempTime;
+
+  tempTime = unixTime;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(buff, size, "%Y-%m-%dT%H:%M:%SZ", &timeInfo);
+}
+
+//*****************************************************************************
+//
+// driftFixes
+//
+// Formats a row for each fix of a track.
+//
+//*****************************************************************************
+
+static void driftFixes(driftFleet* dfPtr, driftTrack* dtPtr) {
+  char timeBuff[32];
+  size_t size;
+  int ix;
+  int i;
+
+  size = 0;
+
+  for (i = 0; i < dtPtr->dtCount; ++i) {
+    ix = dtPtr->dtStart + i;
+    driftTime(timeBuff, sizeof(timeBuff), dfPtr->dfTime[ix]);
+
+    if (i == 0) {
+      dtPtr->dtOutputLength += snprintf(driftRow(dtPtr, &size), DRIFT_ROW_SIZE, "%s,%s,%.6f,%.6f,0.000,0.000,,,\n",
+                                        dtPtr->dtRockblockId, timeBuff, dfPtr->dfPhi[ix] * RAD_TO_DEG,
+                                        dfPtr->dfLambda[ix] * RAD_TO_DEG);
+    } else {
+      dtPtr->dtOutputLength += snprintf(driftRow(dtPtr, &size), DRIFT_ROW_SIZE,
+                                        "%s,%s,%.6f,%.6f,%.3f,%.3f,%.4f,%.1f,%.2f\n", dtPtr->dtRockblockId,
+                                        timeBuff, dfPtr->dfPhi[ix] * RAD_TO_DEG, dfPtr->dfLambda[ix] * RAD_TO_DEG,
+                                        dfPtr->dfStep[ix], dfPtr->dfDistance[ix], dfPtr->dfSpeed[ix],
+                                        dfPtr->dfHeading[ix], dfPtr->dfGap[ix]);
+    }
+  }
+}
+
+//*****************************************************************************
+//
+// driftResample
+//
+// Formats a row for each multiple of the interval between the first and
+// last fix of a track.  The position is interpolated along the step the
+// time falls in, and the speed, heading and gap are those of that step.
+//
+//*****************************************************************************
+
+static void driftResample(driftFleet* dfPtr, driftTrack* dtPtr) {
+  char timeBuff[32];
+  uint32_t* t;
+  uint32_t first;
+  uint32_t last;
+  uint32_t g;
+  int* seg;
+  double* f;
+  double* lat;
+  double* lon;
+  double* phi;
+  double* lambda;
+  double d;
+  size_t size;
+  int count;
+  int ix;
+  int i;
+  int j;
+
+  if (dtPtr->dtCount < 2) {
+    return;
+  }
+
+  t = dfPtr->dfTime + dtPtr->dtStart;
+  phi = dfPtr->dfPhi + dtPtr->dtStart;
+  lambda = dfPtr->dfLambda + dtPtr->dtStart;
+  first = ((t[0] + dfPtr->dfInterval - 1) / dfPtr->dfInterval) * dfPtr->dfInterval;
+  last = t[dtPtr->dtCount - 1];
+
+  if (first > last) {
+    return;
+  }
+
+  count = ((last - first) / dfPtr->dfInterval) + 1;
+  seg = driftAlloc(count * sizeof(int));
+  f = driftAlloc(count * sizeof(double));
+  lat = driftAlloc(count * sizeof(double));
+  lon = driftAlloc(count * sizeof(double));
+
+  // Find the step each time falls in and how far along it.
+  for (i = 0, j = 1, g = first; i < count; ++i, g += dfPtr->dfInterval) {
+    while (t[j] < g) {
+      ++j;
+    }
+
+    seg[i] = j;
+    f[i] = (double)(g - t[j - 1]) / (double)(t[j] - t[j - 1]);
+  }
+
+  // Interpolate, taking the short way across the date line.
+  for (i = 0; i < count; ++i) {
+    j = seg[i];
+    lat[i] = (phi[j - 1] + (f[i] * (phi[j] - phi[j - 1]))) * RAD_TO_DEG;
+    d = lambda[j] - lambda[j - 1];
+    d -= (d > M_PI) ? 2.0 * M_PI : 0.0;
+    d += (d < -M_PI) ? 2.0 * M_PI : 0.0;
+    lon[i] = (lambda[j - 1] + (f[i] * d)) * RAD_TO_DEG;
+    lon[i] -= (lon[i] > 180.0) ? 360.0 : 0.0;
+    lon[i] += (lon[i] < -180.0) ? 360.0 : 0.0;
+  }
+
+  size = 0;
+
+  for (i = 0, g = first; i < count; ++i, g += dfPtr->dfInterval) {
+    ix = dtPtr->dtStart + seg[i];
+    driftTime(timeBuff, sizeof(timeBuff), g);
+    dtPtr->dtOutputLength += snprintf(driftRow(dtPtr, &size), DRIFT_ROW_SIZE, "%s,%s,%.6f,%.6f,%.4f,%.1f,%.2f\n",
+                                      dtPtr->dtRockblockId, timeBuff, lat[i], lon[i], dfPtr->dfSpeed[ix],
+                                      dfPtr->dfHeading[ix], dfPtr->dfGap[ix]);
+  }
+
+  free(seg);
+  free(f);
+  free(lat);
+  free(lon);
+}
+
+//*****************************************************************************
+//
+// driftAnalyzeTask
+//
+// Cleans up, analyzes and formats one track.
+//
+//*****************************************************************************
+
+static void driftAnalyzeTask(void* arg) {
+  driftFleet* dfPtr;
+  driftTrack* dtPtr;
+  int s;
+
+  dfPtr = ((driftTask*)arg)->dkFleet;
+  dtPtr = &dfPtr->dfTracks[((driftTask*)arg)->dkIndex];
+
+  if ((dtPtr->dtCount = driftClean(dfPtr, dtPtr)) == 0) {
+    return;
+  }
+
+  s = dtPtr->dtStart;
+  driftSteps(dtPtr->dtCount, dfPtr->dfTime + s, dfPtr->dfPhi + s, dfPtr->dfLambda + s, dfPtr->dfSinPhi + s,
+             dfPtr->dfCosPhi + s, dfPtr->dfStep + s, dfPtr->dfDistance + s, dfPtr->dfSpeed + s,
+             dfPtr->dfHeading + s, dfPtr->dfGap + s);
+
+  if (dfPtr->dfInterval == 0) {
+    driftFixes(dfPtr, dtPtr);
+  } else {
+    driftResample(dfPtr, dtPtr);
+  }
+}
+
+//*****************************************************************************
+//
+// driftQuery
+//
+// storeDir: the columnar store holding the tracks.
+//
+// fromTime, toTime: unix times of the fixes to use, inclusive.
+//
+// interval: seconds between resampled fixes, or 0 to print every fix.
+//
+// Prints the drift of every Rockblock in the store as CSV to out.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int driftQuery(char* storeDir, uint32_t fromTime, uint32_t toTime, uint32_t interval, FILE* out) {
+  driftFleet fleet;
+  driftTask* tasks;
+  threadPool* pool;
+  DIR* dir;
+  struct dirent* entry;
+  struct stat fileStat;
+  char dirName[FILE_NAME_SIZE];
+  int size;
+  int rc;
+  int i;
+
+  if ((dir = opendir(storeDir)) == NULL) {
+    printf("Error: Unable to open store directory %s!\n", storeDir);
+    return (1);
+  }
+
+  memset(&fleet, 0, sizeof(fleet));
+  fleet.dfStoreDir = storeDir;
+  fleet.dfFromTime = fromTime;
+  fleet.dfToTime = toTime;
+  fleet.dfInterval = interval;
+  size = 0;
+
+  while ((entry = readdir(dir)) != NULL) {
+    snprintf(dirName, sizeof(dirName), "%s/%s", storeDir, entry->d_name);
+
+    if ((entry->d_name[0] == '.') || (strlen(entry->d_name) >= ROCKBLOCK_ID_SIZE) ||
+        (stat(dirName, &fileStat) != 0) || !S_ISDIR(fileStat.st_mode)) {
+      continue;
+    }
+
+    if (fleet.dfTrackCount >= size) {
+      size = (size == 0) ? 256 : size * 2;
+
+      if ((fleet.dfTracks = realloc(fleet.dfTracks, size * sizeof(driftTrack))) == NULL) {
+        printf("Error: Out of memory for the drift analysis!\n");
+        printf("idecode terminating.\n");
+        exit(1);
+      }
+    }
+
+    memset(&fleet.dfTracks[fleet.dfTrackCount], 0, sizeof(driftTrack));
+    strcpy(fleet.dfTracks[fleet.dfTrackCount].dtRockblockId, entry->d_name);
+    ++fleet.dfTrackCount;
+  }
+
+  closedir(dir);
+
+  if (fleet.dfTrackCount > 1) {
+    qsort(fleet.dfTracks, fleet.dfTrackCount, sizeof(driftTrack), compareTracks);
+  }
+
+  pool = tpCreate((decodeThreads > 0) ? decodeThreads : tpDefaultThreads());
+  tasks = driftAlloc((fleet.dfTrackCount + 1) * sizeof(driftTask));
+
+  // Load stage.
+  for (i = 0; i < fleet.dfTrackCount; ++i) {
+    tasks[i].dkFleet = &fleet;
+    tasks[i].dkIndex = i;
+    tpSubmit(pool, driftLoadTask, &tasks[i]);
+  }
+
+  tpWait(pool);
+
+  // Give each track its slice of the fleet arrays.
+  for (i = 0; i < fleet.dfTrackCount; ++i) {
+    fleet.dfTracks[i].dtStart = fleet.dfFixCount;
+    fleet.dfFixCount += fleet.dfTracks[i].dtLoadCount;
+  }
+
+  size = fleet.dfFixCount + 1;
+  fleet.dfTime = driftAlloc(size * sizeof(uint32_t));
+  fleet.dfPhi = driftAlloc(size * sizeof(double));
+  fleet.dfLambda = driftAlloc(size * sizeof(double));
+  fleet.dfSinPhi = driftAlloc(size * sizeof(double));
+  fleet.dfCosPhi = driftAlloc(size * sizeof(double));
+  fleet.dfStep = driftAlloc(size * sizeof(double));
+  fleet.dfDistance = driftAlloc(size * sizeof(double));
+  fleet.dfSpeed = driftAlloc(size * sizeof(double));
+  fleet.dfHeading = driftAlloc(size * sizeof(double));
+  fleet.dfGap = driftAlloc(size * sizeof(double));
+
+  // Analyze stage.
+  for (i = 0; i < fleet.dfTrackCount; ++i) {
+    tpSubmit(pool, driftAnalyzeTask, &tasks[i]);
+  }
+
+  tpWait(pool);
+  tpDestroy(pool);
+
+  if (interval == 0) {
+    fprintf(out, "rockblock,time,lat,lon,stepkm,distancekm,speedms,heading,gaph\n");
+  } else {
+    fprintf(out, "rockblock,time,lat,lon,speedms,heading,gaph\n");
+  }
+
+  rc = 0;
+
+  for (i = 0; i < fleet.dfTrackCount; ++i) {
+    rc |= fleet.dfTracks[i].dtResult;
+
+    if (fleet.dfTracks[i].dtOutputLength != 0) {
+      fwrite(fleet.dfTracks[i].dtOutput, 1, fleet.dfTracks[i].dtOutputLength, out);
+    }
+
+    free(fleet.dfTracks[i].dtOutput);
+  }
+
+  free(fleet.dfTime);
+  free(fleet.dfPhi);
+  free(fleet.dfLambda);
+  free(fleet.dfSinPhi);
+  free(fleet.dfCosPhi);
+  free(fleet.dfStep);
+  free(fleet.dfDistance);
+  free(fleet.dfSpeed);
+  free(fleet.dfHeading);
+  free(fleet.dfGap);
+  free(fleet.dfTracks);
+  free(tasks);
+  return (rc);
+}
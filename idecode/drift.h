@@ -0,0 +1,53 @@
+//*****************************************************************************
+// drift.h
+//
+// Drift analytics over the tracks in the columnar store.
+//
+//*****************************************************************************
+
+#ifndef _DRIFT_H
+#define _DRIFT_H
+
+#include "idecode.h"
+
+#define DRIFT_ROW_SIZE 160  // most bytes one CSV row can take.
+
+// One buoy's track.  Its fixes are a slice of the fleet arrays.
+typedef struct driftTrack {
+  char dtRockblockId[ROCKBLOCK_ID_SIZE];
+  uint32_t* dtLoadTime;  // fixes as read from the store.
+  float* dtLoadLat;
+  float* dtLoadLon;
+  int dtLoadCount;
+  int dtStart;           // first fix in the fleet arrays.
+  int dtCount;           // fixes left once the track is cleaned up.
+  char* dtOutput;        // CSV rows of the track.
+  size_t dtOutputLength;
+  int dtResult;
+} driftTrack;
+
+// The tracks of the whole fleet, held as one array per value so each step
+// of the analysis is a plain loop over contiguous memory.
+typedef struct driftFleet {
+  char* dfStoreDir;
+  uint32_t dfFromTime;
+  uint32_t dfToTime;
+  uint32_t dfInterval;   // seconds between resampled fixes, 0 for none.
+  driftTrack* dfTracks;
+  int dfTrackCount;
+  int dfFixCount;
+  uint32_t* dfTime;      // unix time of the fix.
+  double* dfPhi;         // latitude in radians.
+  double* dfLambda;      // longitude in radians.
+  double* dfSinPhi;
+  double* dfCosPhi;
+  double* dfStep;        // km from the previous fix.
+  double* dfDistance;    // km from the first fix.
+  double* dfSpeed;       // m/s from the previous fix.
+  double* dfHeading;     // degrees true from the previous fix.
+  double* dfGap;         // hours since the previous fix.
+} driftFleet;
+
+int driftQuery(char* storeDir, uint32_t fromTime, uint32_t toTime, uint32_t interval, FILE* out);
+
+#endif // _DRIFT_H
@@ -0,0 +1,580 @@
+//*****************************************************************************
+// export.c
+//
+// Bulk export of decoded icedrifter records.
+//
+// Records are formatted straight into a large buffer which is written out
+// when it fills, so an archive of any size streams into one file.  The
+// numbers and times are formatted here rather than with printf, and the
+// date part of a time is only worked out again when the day changes.
+//
+// CSV has one row per record.  The columns are rockblock, sendtime, time,
+// lastboot, errors, tempbytes, lightbytes, lat, lon, temperature, pressure,
+// remotetemp, chaintemp000 to chaintemp159 and chainlight00c to
+// chainlight63b, named as in the columnar store.  Values a record does not
+// have are left empty.  NDJSON has one object per line with the same names
+// and only the chain sensors the record has, in chaintemp and chainlight
+// arrays.  A record made from a heartbeat has "heartbeat":true.  A record
+// with readings taken between reports has their count and interval in
+// samples and sampleinterval, and pressurestats, temperaturestats and
+// remotetempstats objects with their mean, variance, min, mintime, max and
+// maxtime.  A record with a pressure burst has a burst object with its
+// samples, sigamp in ubar, peakperiod in seconds and the energy of each
+// band in a bands array.
+//
+// The export file is appended to, so a daemon that is restarted carries on
+// with the same file.  The CSV header is only written to an empty file.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "idecode.h"
+#include "export.h"
+#include "convert.h"
+
+typedef struct exportDay {
+  int32_t edDay;      // days since 01/01/1970 of the cached date.
+  char edText[12];    // "yyyy-mm-ddT" for that day.
+} exportDay;
+
+typedef struct exportStream {
+  int esFd;
+  char* esBuffer;
+  int esUsed;
+  exportDay esDays[2];  // one for GPS times and one for boot and sample times.
+} exportStream;
+
+static exportStream* exportOutput;  // NULL until the first record is exported.
+
+static const char digitPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const uint32_t powersOfTen[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+static char* putText(char* outPtr, const char* text) {
+  while (*text != 0) {
+    *outPtr++ = *text++;
+  }
+
+  return (outPtr);
+}
+
+static char* putUnsigned(char* outPtr, uint64_t value) {
+  char digits[20];
+  char* wkPtr;
+
+  wkPtr = &digits[sizeof(digits)];
+
+  // Two digits at a time from the end.
+  while (value >= 100) {
+    wkPtr -= 2;
+    memcpy(wkPtr, &digitPairs[(value % 100) * 2], 2);
+    value /= 100;
+  }
+
+  if (value >= 10) {
+    wkPtr -= 2;
+    memcpy(wkPtr, &digitPairs[value * 2], 2);
+  } else {
+    *--wkPtr = '0' + value;
+  }
+
+  while (wkPtr < &digits[sizeof(digits)]) {
+    *outPtr++ = *wkPtr++;
+  }
+
+  return (outPtr);
+}
+
+//*****************************************************************************
+//
+// putFixed
+//
+// Formats value with a fixed number of decimals, rounded half away from
+// zero.  Values that are not numbers, and the rare value too large to scale,
+// are written as nullText.
+//
+//*****************************************************************************
+
+static char* putFixed(char* outPtr, double value, int decimals, const char* nullText) {
+  uint64_t scaled;
+  uint32_t fraction;
+  int i;
+
+  if (!isfinite(value) || (fabs(value) >= 1e12)) {
+    return (putText(outPtr, nullText));
+  }
+
+  scaled = (uint64_t)(fabs(value) * powersOfTen[decimals] + 0.5);
+
+  if ((value < 0) && (scaled != 0)) {
+    *outPtr++ = '-';
+  }
+
+  outPtr = putUnsigned(outPtr, scaled / powersOfTen[decimals]);
+
+  if (decimals != 0) {
+    *outPtr++ = '.';
+    fraction = scaled % powersOfTen[decimals];
+
+    for (i = decimals; i >= 2; i -= 2) {
+      memcpy(&outPtr[i - 2], &digitPairs[(fraction % 100) * 2], 2);
+      fraction /= 100;
+    }
+
+    if (i == 1) {
+      outPtr[0] = '0' + fraction;
+    }
+
+    outPtr += decimals;
+  }
+
+  return (outPtr);
+}
+
+//*****************************************************************************
+//
+// putTime
+//
+// Formats an icedrifter time as yyyy-mm-ddThh:mm:ssZ.  The date part is
+// kept in dayPtr and only rebuilt when the day changes.
+//
+//*****************************************************************************
+
+static char* putTime(char* outPtr, exportDay* dayPtr, uint32_t driftTime) {
+  struct tm timeInfo;
+  time_t unixTime;
+  uint32_t seconds;
+  int32_t day;
+
+  unixTime = (time_t)driftTime + SECONDS_IN_30_YEARS;
+  day = unixTime / (24 * 60 * 60);
+  seconds = unixTime % (24 * 60 * 60);
+
+  if (day != dayPtr->edDay) {
+    gmtime_r(&unixTime, &timeInfo);
+    strftime(dayPtr->edText, sizeof(dayPtr->edText), "%Y-%m-%dT", &timeInfo);
+    dayPtr->edDay = day;
+  }
+
+  outPtr = putText(outPtr, dayPtr->edText);
+  memcpy(outPtr, &digitPairs[(seconds / 3600) * 2], 2);
+  outPtr[2] = ':';
+  memcpy(outPtr + 3, &digitPairs[((seconds / 60) % 60) * 2], 2);
+  outPtr[5] = ':';
+  memcpy(outPtr + 6, &digitPairs[(seconds % 60) * 2], 2);
+  outPtr[8] = 'Z';
+  return (outPtr + 9);
+}
+
+// The statistics of one sensor as an NDJSON object, after the name given.
+static char* putStats(char* outPtr, exportStream* esPtr, const char* name, int decimals, float mean,
+                      float variance, float min, uint32_t minTime, float max, uint32_t maxTime) {
+  outPtr = putText(outPtr, name);
+  outPtr = putText(outPtr, "{\"mean\":");
+  outPtr = putFixed(outPtr, mean, decimals, "null");
+  outPtr = putText(outPtr, ",\"variance\":");
+  outPtr = putFixed(outPtr, variance, decimals + 2, "null");
+  outPtr = putText(outPtr, ",\"min\":");
+  outPtr = putFixed(outPtr, min, decimals, "null");
+  outPtr = putText(outPtr, ",\"mintime\":\"");
+  outPtr = putTime(outPtr, &esPtr->esDays[1], minTime);
+  outPtr = putText(outPtr, "\",\"max\":");
+  outPtr = putFixed(outPtr, max, decimals, "null");
+  outPtr = putText(outPtr, ",\"maxtime\":\"");
+  outPtr = putTime(outPtr, &esPtr->esDays[1], maxTime);
+  return (putText(outPtr, "\"}"));
+}
+
+static char* putHex(char* outPtr, uint32_t value) {
+  int i;
+
+  for (i = 7; i >= 0; --i) {
+    outPtr[i] = "0123456789abcdef"[value & 0x0F];
+    value >>= 4;
+  }
+
+  return (outPtr + 8);
+}
+
+//*****************************************************************************
+//
+// formatCsv
+// formatJson
+//
+// Format one finished record into outPtr.
+//
+// returns the end of the formatted record.
+//
+//*****************************************************************************
+
+static char* formatCsv(char* outPtr, exportStream* esPtr, decodeContext* ctx) {
+  icedrifterData* idPtr;
+  float temps[TEMP_SENSOR_COUNT];
+  int tempCount;
+  int lightCount;
+  int i;
+  int j;
+
+  idPtr = &ctx->dcData;
+  outPtr = putText(outPtr, ctx->dcRockblockId);
+  *outPtr++ = ',';
+  outPtr = putHex(outPtr, ctx->dcSendTime);
+  *outPtr++ = ',';
+  outPtr = putTime(outPtr, &esPtr->esDays[0], idPtr->idGPSTime);
+  *outPtr++ = ',';
+
+  // A heartbeat has no last boot time or temperature.
+  if (!(idPtr->idSwitches & HEARTBEAT_SWITCH)) {
+    outPtr = putTime(outPtr, &esPtr->esDays[1], idPtr->idLastBootTime);
+  }
+
+  *outPtr++ = ',';
+  outPtr = putUnsigned(outPtr, idPtr->idcdError);
+  *outPtr++ = ',';
+  outPtr = putUnsigned(outPtr, idPtr->idTempByteCount);
+  *outPtr++ = ',';
+  outPtr = putUnsigned(outPtr, idPtr->idLightByteCount);
+  *outPtr++ = ',';
+  outPtr = putFixed(outPtr, idPtr->idLatitude, 6, "");
+  *outPtr++ = ',';
+  outPtr = putFixed(outPtr, idPtr->idLongitude, 6, "");
+  *outPtr++ = ',';
+  outPtr = putFixed(outPtr, (idPtr->idSwitches & HEARTBEAT_SWITCH) ? NAN : idPtr->idTemperature, 2, "");
+  *outPtr++ = ',';
+  outPtr = putFixed(outPtr, idPtr->idPressure, 2, "");
+  *outPtr++ = ',';
+
+  if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+    outPtr = putFixed(outPtr, idPtr->idRemoteTemp, 4, "");
+  }
+
+  tempCount = lightCount = 0;
+
+  if (idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH) {
+    tempCount = chainTempCount(idPtr);
+    lightCount = chainLightCount(idPtr);
+    convertTempsToC(idPtr->idChainData.cdTempData, tempCount, temps, false);
+  }
+
+  for (i = 0; i < TEMP_SENSOR_COUNT; ++i) {
+    *outPtr++ = ',';
+
+    if (i < tempCount) {
+      outPtr = putFixed(outPtr, temps[i], 4, "");
+    }
+  }
+
+  for (i = 0; i < LIGHT_SENSOR_COUNT; ++i) {
+    for (j = 0; j < LIGHT_SENSOR_FIELDS; ++j) {
+      *outPtr++ = ',';
+
+      if (i < lightCount) {
+        outPtr = putUnsigned(outPtr, idPtr->idChainData.cdLightData[i][j]);
+      }
+    }
+  }
+
+  *outPtr++ = '\n';
+  return (outPtr);
+}
+
+static char* formatJson(char* outPtr, exportStream* esPtr, decodeContext* ctx) {
+  icedrifterData* idPtr;
+  float temps[TEMP_SENSOR_COUNT];
+  int tempCount;
+  int lightCount;
+  int i;
+  int j;
+
+  // Rockblock IDs come from file names and mail, so only plain characters
+  // are kept to keep the line valid JSON.
+  idPtr = &ctx->dcData;
+  outPtr = putText(outPtr, "{\"rockblock\":\"");
+
+  for (i = 0; ctx->dcRockblockId[i] != 0; ++i) {
+    if ((ctx->dcRockblockId[i] >= ' ') && (ctx->dcRockblockId[i] != '"') && (ctx->dcRockblockId[i] != '\\')) {
+      *outPtr++ = ctx->dcRockblockId[i];
+    }
+  }
+
+  outPtr = putText(outPtr, "\",\"sendtime\":\"");
+  outPtr = putHex(outPtr, ctx->dcSendTime);
+  outPtr = putText(outPtr, "\",\"time\":\"");
+  outPtr = putTime(outPtr, &esPtr->esDays[0], idPtr->idGPSTime);
+
+  // A heartbeat has no last boot time or temperature.
+  if (idPtr->idSwitches & HEARTBEAT_SWITCH) {
+    outPtr = putText(outPtr, "\",\"heartbeat\":true,\"lastboot\":null,\"errors\":");
+  } else {
+    outPtr = putText(outPtr, "\",\"lastboot\":\"");
+    outPtr = putTime(outPtr, &esPtr->esDays[1], idPtr->idLastBootTime);
+    outPtr = putText(outPtr, "\",\"errors\":");
+  }
+
+  outPtr = putUnsigned(outPtr, idPtr->idcdError);
+  outPtr = putText(outPtr, ",\"tempbytes\":");
+  outPtr = putUnsigned(outPtr, idPtr->idTempByteCount);
+  outPtr = putText(outPtr, ",\"lightbytes\":");
+  outPtr = putUnsigned(outPtr, idPtr->idLightByteCount);
+  outPtr = putText(outPtr, ",\"lat\":");
+  outPtr = putFixed(outPtr, idPtr->idLatitude, 6, "null");
+  outPtr = putText(outPtr, ",\"lon\":");
+  outPtr = putFixed(outPtr, idPtr->idLongitude, 6, "null");
+  outPtr = putText(outPtr, ",\"temperature\":");
+  outPtr = putFixed(outPtr, (idPtr->idSwitches & HEARTBEAT_SWITCH) ? NAN : idPtr->idTemperature, 2, "null");
+  outPtr = putText(outPtr, ",\"pressure\":");
+  outPtr = putFixed(outPtr, idPtr->idPressure, 2, "null");
+
+  if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+    outPtr = putText(outPtr, ",\"remotetemp\":");
+    outPtr = putFixed(outPtr, idPtr->idRemoteTemp, 4, "null");
+  }
+
+  if (idPtr->idSampleCount != 0) {
+    outPtr = putText(outPtr, ",\"samples\":");
+    outPtr = putUnsigned(outPtr, idPtr->idSampleCount);
+    outPtr = putText(outPtr, ",\"sampleinterval\":");
+    outPtr = putUnsigned(outPtr, idPtr->idSampleInterval);
+    outPtr = putStats(outPtr, esPtr, ",\"pressurestats\":", 2, idPtr->idPressureMean, idPtr->idPressureVariance,
+                      idPtr->idPressureMin, idPtr->idPressureMinTime, idPtr->idPressureMax, idPtr->idPressureMaxTime);
+    outPtr = putStats(outPtr, esPtr, ",\"temperaturestats\":", 2, idPtr->idTemperatureMean, idPtr->idTemperatureVariance,
+                      idPtr->idTemperatureMin, idPtr->idTemperatureMinTime, idPtr->idTemperatureMax,
+                      idPtr->idTemperatureMaxTime);
+
+    if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+      outPtr = putStats(outPtr, esPtr, ",\"remotetempstats\":", 4, idPtr->idRemoteTempMean, idPtr->idRemoteTempVariance,
+                        idPtr->idRemoteTempMin, idPtr->idRemoteTempMinTime, idPtr->idRemoteTempMax,
+                        idPtr->idRemoteTempMaxTime);
+    }
+  }
+
+  if (idPtr->idBurstSamples != 0) {
+    outPtr = putText(outPtr, ",\"burst\":{\"samples\":");
+    outPtr = putUnsigned(outPtr, idPtr->idBurstSamples);
+    outPtr = putText(outPtr, ",\"sigamp\":");
+    outPtr = putFixed(outPtr, idPtr->idBurstSigAmp, 1, "null");
+    outPtr = putText(outPtr, ",\"peakperiod\":");
+    outPtr = putFixed(outPtr, idPtr->idBurstPeakPeriod / 10.0, 1, "null");
+    outPtr = putText(outPtr, ",\"bands\":[");
+    outPtr = putFixed(outPtr, idPtr->idBurstEnergy0, 4, "null");
+    *outPtr++ = ',';
+    outPtr = putFixed(outPtr, idPtr->idBurstEnergy1, 4, "null");
+    *outPtr++ = ',';
+    outPtr = putFixed(outPtr, idPtr->idBurstEnergy2, 4, "null");
+    *outPtr++ = ',';
+    outPtr = putFixed(outPtr, idPtr->idBurstEnergy3, 4, "null");
+    *outPtr++ = ',';
+    outPtr = putFixed(outPtr, idPtr->idBurstEnergy4, 4, "null");
+    outPtr = putText(outPtr, "]}");
+  }
+
+  if (idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH) {
+    tempCount = chainTempCount(idPtr);
+    lightCount = chainLightCount(idPtr);
+    convertTempsToC(idPtr->idChainData.cdTempData, tempCount, temps, false);
+    outPtr = putText(outPtr, ",\"chaintemp\":[");
+
+    for (i = 0; i < tempCount; ++i) {
+      if (i != 0) {
+        *outPtr++ = ',';
+      }
+
+      outPtr = putFixed(outPtr, temps[i], 4, "null");
+    }
+
+    outPtr = putText(outPtr, "],\"chainlight\":[");
+
+    for (i = 0; i < lightCount; ++i) {
+      outPtr = putText(outPtr, (i == 0) ? "[" : ",[");
+
+      for (j = 0; j < LIGHT_SENSOR_FIELDS; ++j) {
+        if (j != 0) {
+          *outPtr++ = ',';
+        }
+
+        outPtr = putUnsigned(outPtr, idPtr->idChainData.cdLightData[i][j]);
+      }
+
+      *outPtr++ = ']';
+    }
+
+    *outPtr++ = ']';
+  }
+
+  *outPtr++ = '}';
+  *outPtr++ = '\n';
+  return (outPtr);
+}
+
+static int exportWrite(exportStream* esPtr) {
+  ssize_t len;
+  int done;
+
+  for (done = 0; done < esPtr->esUsed; done += len) {
+    if ((len = write(esPtr->esFd, esPtr->esBuffer + done, esPtr->esUsed - done)) <= 0) {
+      printf("Error: Unable to write export file %s!\n", exportFileName);
+      esPtr->esUsed = 0;
+      return (1);
+    }
+  }
+
+  esPtr->esUsed = 0;
+  return (0);
+}
+
+//*****************************************************************************
+//
+// exportOpen
+//
+// Opens the export file for appending and writes the CSV header if the
+// file is empty.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int exportOpen(void) {
+  static const char* const baseNames[] = {
+    "rockblock", "sendtime", "time", "lastboot", "errors", "tempbytes", "lightbytes",
+    "lat", "lon", "temperature", "pressure", "remotetemp"
+  };
+  exportStream* esPtr;
+  struct stat fileStat;
+  char* outPtr;
+  int i;
+
+  if (((esPtr = calloc(1, sizeof(exportStream))) == NULL) ||
+      ((esPtr->esBuffer = malloc(EXPORT_BUFFER_SIZE)) == NULL)) {
+    printf("Error: Out of memory for the export buffer!\n");
+    free(esPtr);
+    return (1);
+  }
+
+  if (((esPtr->esFd = open(exportFileName, O_WRONLY | O_CREAT | O_APPEND, 0664)) < 0) ||
+      (fstat(esPtr->esFd, &fileStat) != 0)) {
+    printf("Error: Unable to open export file %s!\n", exportFileName);
+    free(esPtr->esBuffer);
+    free(esPtr);
+    return (1);
+  }
+
+  esPtr->esDays[0].edDay = esPtr->esDays[1].edDay = -1;
+
+  if ((exportFormat == EXPORT_CSV) && (fileStat.st_size == 0)) {
+    outPtr = esPtr->esBuffer;
+
+    for (i = 0; i < (int)(sizeof(baseNames) / sizeof(baseNames[0])); ++i) {
+      outPtr = putText(outPtr, (i == 0) ? "" : ",");
+      outPtr = putText(outPtr, baseNames[i]);
+    }
+
+    for (i = 0; i < TEMP_SENSOR_COUNT; ++i) {
+      outPtr += sprintf(outPtr, ",chaintemp%03d", i);
+    }
+
+    for (i = 0; i < LIGHT_SENSOR_COUNT * LIGHT_SENSOR_FIELDS; ++i) {
+      outPtr += sprintf(outPtr, ",chainlight%02d%c", i / LIGHT_SENSOR_FIELDS, "crgb"[i % LIGHT_SENSOR_FIELDS]);
+    }
+
+    *outPtr++ = '\n';
+    esPtr->esUsed = outPtr - esPtr->esBuffer;
+  }
+
+  exportOutput = esPtr;
+  return (0);
+}
+
+//*****************************************************************************
+//
+// exportAppend
+//
+// ctxList: finished records to add to the export file.
+//
+// count: number of records in ctxList.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int exportAppend(decodeContext** ctxList, int count) {
+  exportStream* esPtr;
+  char* outPtr;
+  int rc;
+  int i;
+
+  if ((exportOutput == NULL) && (exportOpen() != 0)) {
+    return (1);
+  }
+
+  esPtr = exportOutput;
+  rc = 0;
+
+  for (i = 0; i < count; ++i) {
+    if (esPtr->esUsed > EXPORT_BUFFER_SIZE - EXPORT_RECORD_SIZE) {
+      rc |= exportWrite(esPtr);
+    }
+
+    outPtr = esPtr->esBuffer + esPtr->esUsed;
+
+    if (exportFormat == EXPORT_CSV) {
+      outPtr = formatCsv(outPtr, esPtr, ctxList[i]);
+    } else {
+      outPtr = formatJson(outPtr, esPtr, ctxList[i]);
+    }
+
+    esPtr->esUsed = outPtr - esPtr->esBuffer;
+  }
+
+  return (rc);
+}
+
+//*****************************************************************************
+//
+// exportFlush
+// exportClose
+//
+// Write out whatever is in the export buffer.  exportClose also closes the
+// export file.  Both do nothing if nothing was exported.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int exportFlush(void) {
+  if ((exportOutput == NULL) || (exportOutput->esUsed == 0)) {
+    return (0);
+  }
+
+  return (exportWrite(exportOutput));
+}
+
+int exportClose(void) {
+  int rc;
+
+  if (exportOutput == NULL) {
+    return (0);
+  }
+
+  rc = exportFlush();
+
+  if (close(exportOutput->esFd) != 0) {
+    printf("Error: Unable to close export file %s!\n", exportFileName);
+    rc = 1;
+  }
+
+  free(exportOutput->esBuffer);
+  free(exportOutput);
+  exportOutput = NULL;
+  return (rc);
+}
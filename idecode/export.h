@@ -0,0 +1,23 @@
+//*****************************************************************************
+// export.h
+//
+// Streams decoded icedrifter records into one CSV or NDJSON file.
+//
+//*****************************************************************************
+
+#ifndef _EXPORT_H
+#define _EXPORT_H
+
+#include "idecode.h"
+
+#define EXPORT_CSV    0  // one row per record with a header row.
+#define EXPORT_NDJSON 1  // one JSON object per line.
+
+#define EXPORT_BUFFER_SIZE (1024 * 1024)  // bytes held before they are written.
+#define EXPORT_RECORD_SIZE (16 * 1024)    // most bytes one record can take.
+
+int exportAppend(decodeContext** ctxList, int count);
+int exportFlush(void);
+int exportClose(void);
+
+#endif // _EXPORT_H
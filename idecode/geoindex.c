@@ -0,0 +1,586 @@
+//*****************************************************************************
+// geoindex.c
+//
+// Spatio-temporal index of decoded icedrifter positions.
+//
+// The index is a geohash grid partitioned by month.  Every decoded record
+// with a GPS fix adds one small fixed size entry to
+//
+//   <index directory>/<yyyymm>/<geohash>.gix
+//
+// where the geohash is GEOINDEX_PRECISION characters long.  The latest
+// position of every Rockblock is also kept in <index directory>/latest.gix.
+//
+// A bounding box and time range query only opens the month directories in
+// the time range and, within them, only the cells whose bounds overlap the
+// box.  A latest position query only reads latest.gix.  The decoded records
+// themselves are never read.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "idecode.h"
+#include "geoindex.h"
+
+static const char geohashChars[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+// A record position with where it goes in the index.
+typedef struct geoIndexItem {
+  geoIndexEntry gtEntry;
+  char gtMonth[8];
+  char gtCell[GEOINDEX_PRECISION + 1];
+} geoIndexItem;
+
+//*****************************************************************************
+//
+// geohashEncode
+//
+// Builds the precision character geohash of lat/lon in hash.
+//
+//*****************************************************************************
+
+void geohashEncode(float lat, float lon, int precision, char* hash) {
+  double latLo = -90.0, latHi = 90.0;
+  double lonLo = -180.0, lonHi = 180.0;
+  double mid;
+  int bit;
+  int ch;
+  int even;
+  int i;
+
+  even = 1;
+
+  for (i = 0; i < precision; ++i) {
+    ch = 0;
+
+    for (bit = 0; bit < 5; ++bit) {
+      if (even) {
+        mid = (lonLo + lonHi) / 2;
+
+        if (lon >= mid) {
+          ch = (ch << 1) | 1;
+          lonLo = mid;
+        } else {
+          ch <<= 1;
+          lonHi = mid;
+        }
+      } else {
+        mid = (latLo + latHi) / 2;
+
+        if (lat >= mid) {
+          ch = (ch << 1) | 1;
+          latLo = mid;
+        } else {
+          ch <<= 1;
+          latHi = mid;
+        }
+      }
+
+      even = !even;
+    }
+
+    hash[i] = geohashChars[ch];
+  }
+
+  hash[precision] = 0;
+}
+
+//*****************************************************************************
+//
+// geohashBounds
+//
+// Works out the area covered by a geohash.
+//
+// returns false if hash is not a geohash.
+//
+//*****************************************************************************
+
+bool geohashBounds(char* hash, float* minLat, float* minLon, float* maxLat, float* maxLon) {
+  double latLo = -90.0, latHi = 90.0;
+  double lonLo = -180.0, lonHi = 180.0;
+  char* chPtr;
+  int even;
+  int bit;
+  int val;
+
+  if (*hash == 0) {
+    return (false);
+  }
+
+  even = 1;
+
+  for (; *hash != 0; ++hash) {
+    if ((chPtr = strchr(geohashChars, *hash)) == NULL) {
+      return (false);
+    }
+
+    val = chPtr - geohashChars;
+
+    for (bit = 4; bit >= 0; --bit) {
+      if (even) {
+        if ((val >> bit) & 1) {
+          lonLo = (lonLo + lonHi) / 2;
+        } else {
+          lonHi = (lonLo + lonHi) / 2;
+        }
+      } else {
+        if ((val >> bit) & 1) {
+          latLo = (latLo + latHi) / 2;
+        } else {
+          latHi = (latLo + latHi) / 2;
+        }
+      }
+
+      even = !even;
+    }
+  }
+
+  *minLat = latLo;
+  *maxLat = latHi;
+  *minLon = lonLo;
+  *maxLon = lonHi;
+  return (true);
+}
+
+static int compareItems(const void* a, const void* b) {
+  geoIndexItem* aPtr = (geoIndexItem*)a;
+  geoIndexItem* bPtr = (geoIndexItem*)b;
+  int rc;
+
+  if ((rc = strcmp(aPtr->gtMonth, bPtr->gtMonth)) != 0) {
+    return (rc);
+  }
+
+  return (strcmp(aPtr->gtCell, bPtr->gtCell));
+}
+
+static int compareEntries(const void* a, const void* b) {
+  geoIndexEntry* aPtr = (geoIndexEntry*)a;
+  geoIndexEntry* bPtr = (geoIndexEntry*)b;
+  int rc;
+
+  if ((rc = strncmp(aPtr->giRockblockId, bPtr->giRockblockId, GEOINDEX_ID_SIZE)) != 0) {
+    return (rc);
+  }
+
+  return ((aPtr->giTime > bPtr->giTime) - (aPtr->giTime < bPtr->giTime));
+}
+
+static int makeDirectory(char* dirName) {
+  if ((mkdir(dirName, 0775) != 0) && (errno != EEXIST)) {
+    printf("Error creating index directory %s!\n", dirName);
+    return (1);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// updateLatest
+//
+// Merges the newest position of each Rockblock in items into latest.gix.
+//
+//*****************************************************************************
+
+static int updateLatest(char* indexDir, geoIndexItem* items, int count) {
+  char fileName[FILE_NAME_SIZE];
+  char latestName[FILE_NAME_SIZE];
+  geoIndexEntry* latest;
+  FILE* fd;
+  int latestCount;
+  int latestSize;
+  int i;
+  int j;
+
+  // latest.tmp and latest.gix are the same length.
+  if (snprintf(fileName, sizeof(fileName), "%s/latest.gix", indexDir) >= (int)sizeof(fileName)) {
+    printf("Error: Index file name in %s too long!\n", indexDir);
+    return (1);
+  }
+
+  latest = NULL;
+  latestCount = latestSize = 0;
+
+  if ((fd = fopen(fileName, "rb")) != NULL) {
+    fseek(fd, 0, SEEK_END);
+    latestSize = ftell(fd) / sizeof(geoIndexEntry);
+    fseek(fd, 0, SEEK_SET);
+  }
+
+  latestSize += count;
+
+  if ((latest = malloc((latestSize + 1) * sizeof(geoIndexEntry))) == NULL) {
+    printf("Error: Out of memory in the index!\n");
+    exit(1);
+  }
+
+  if (fd != NULL) {
+    latestCount = fread(latest, sizeof(geoIndexEntry), latestSize - count, fd);
+    fclose(fd);
+  }
+
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < latestCount; ++j) {
+      if (strncmp(latest[j].giRockblockId, items[i].gtEntry.giRockblockId, GEOINDEX_ID_SIZE) == 0) {
+        break;
+      }
+    }
+
+    if (j == latestCount) {
+      latest[latestCount++] = items[i].gtEntry;
+    } else if (items[i].gtEntry.giTime >= latest[j].giTime) {
+      latest[j] = items[i].gtEntry;
+    }
+  }
+
+  // Write a new copy and rename it over the old one so a reader never sees
+  // a partly written file.
+  snprintf(fileName, sizeof(fileName), "%s/latest.tmp", indexDir);
+
+  if (((fd = fopen(fileName, "wb")) == NULL) ||
+      (fwrite(latest, sizeof(geoIndexEntry), latestCount, fd) != (size_t)latestCount) ||
+      (fclose(fd) != 0)) {
+    printf("Error writing index file %s!\n", fileName);
+    free(latest);
+    return (1);
+  }
+
+  free(latest);
+  snprintf(latestName, sizeof(latestName), "%s/latest.gix", indexDir);
+
+  if (rename(fileName, latestName) != 0) {
+    printf("Error renaming index file %s!\n", fileName);
+    return (1);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// geoIndexAppend
+//
+// indexDir: the directory holding the index.
+//
+// ctxList: finished records to add.
+//
+// count: the number of records in ctxList.
+//
+// Adds the position of each record that has a GPS fix to the index.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int geoIndexAppend(char* indexDir, decodeContext** ctxList, int count) {
+  geoIndexItem* items;
+  icedrifterData* idPtr;
+  struct tm timeInfo;
+  time_t tempTime;
+  char dirName[FILE_NAME_SIZE];
+  char fileName[FILE_NAME_SIZE];
+  FILE* fd;
+  int itemCount;
+  int first;
+  int last;
+  int rc;
+  int i;
+
+  if (makeDirectory(indexDir) != 0) {
+    return (1);
+  }
+
+  if ((items = calloc(count + 1, sizeof(geoIndexItem))) == NULL) {
+    printf("Error: Out of memory in the index!\n");
+    exit(1);
+  }
+
+  for (i = itemCount = 0; i < count; ++i) {
+    idPtr = &ctxList[i]->dcData;
+
+    // Records sent without a GPS fix have no position to index.
+    if (idPtr->idGPSTime == 0) {
+      continue;
+    }
+
+    // The ID is only NUL terminated when it is shorter than the field.
+    memcpy(items[itemCount].gtEntry.giRockblockId, ctxList[i]->dcRockblockId,
+           strnlen(ctxList[i]->dcRockblockId, GEOINDEX_ID_SIZE));
+    tempTime = (time_t)idPtr->idGPSTime + SECONDS_IN_30_YEARS;
+    items[itemCount].gtEntry.giTime = (uint32_t)tempTime;
+    items[itemCount].gtEntry.giLatitude = idPtr->idLatitude;
+    items[itemCount].gtEntry.giLongitude = idPtr->idLongitude;
+    gmtime_r(&tempTime, &timeInfo);
+    strftime(items[itemCount].gtMonth, sizeof(items[itemCount].gtMonth), "%Y%m", &timeInfo);
+    geohashEncode(idPtr->idLatitude, idPtr->idLongitude, GEOINDEX_PRECISION, items[itemCount].gtCell);
+    ++itemCount;
+  }
+
+  // Group the entries by file so each cell file is opened once.
+  qsort(items, itemCount, sizeof(geoIndexItem), compareItems);
+  rc = 0;
+
+  for (first = 0; first < itemCount; first = last) {
+    for (last = first + 1; (last < itemCount) && (compareItems(&items[first], &items[last]) == 0); ++last) {
+    }
+
+    if ((snprintf(dirName, sizeof(dirName), "%s/%s", indexDir, items[first].gtMonth) >= (int)sizeof(dirName)) ||
+        (snprintf(fileName, sizeof(fileName), "%s/%s.gix", dirName, items[first].gtCell) >= (int)sizeof(fileName))) {
+      printf("Error: Index file name in %s too long!\n", indexDir);
+      rc = 1;
+      continue;
+    }
+
+    if ((makeDirectory(dirName) != 0) || ((fd = fopen(fileName, "ab")) == NULL)) {
+      printf("Error opening index file %s!\n", fileName);
+      rc = 1;
+      continue;
+    }
+
+    for (i = first; i < last; ++i) {
+      if (fwrite(&items[i].gtEntry, sizeof(geoIndexEntry), 1, fd) != 1) {
+        printf("Error writing index file %s!\n", fileName);
+        rc = 1;
+        break;
+      }
+    }
+
+    fclose(fd);
+  }
+
+  if (itemCount != 0) {
+    rc |= updateLatest(indexDir, items, itemCount);
+  }
+
+  free(items);
+  return (rc);
+}
+
+//*****************************************************************************
+//
+// Query output
+//
+//*****************************************************************************
+
+static void writeResults(geoIndexEntry* entries, int count, int format, FILE* out) {
+  char timeBuff[32];
+  char idBuff[GEOINDEX_ID_SIZE + 1];
+  struct tm timeInfo;
+  time_t tempTime;
+  int i;
+
+  if (format == GEOQUERY_GEOJSON) {
+    fprintf(out, "{\"type\":\"FeatureCollection\",\"features\":[");
+  } else {
+    fprintf(out, "rockblock,time,latitude,longitude\n");
+  }
+
+  for (i = 0; i < count; ++i) {
+    memcpy(idBuff, entries[i].giRockblockId, GEOINDEX_ID_SIZE);
+    idBuff[GEOINDEX_ID_SIZE] = 0;
+    tempTime = entries[i].giTime;
+    gmtime_r(&tempTime, &timeInfo);
+    strftime(timeBuff, sizeof(timeBuff), "%Y-%m-%dT%H:%M:%SZ", &timeInfo);
+
+    if (format == GEOQUERY_GEOJSON) {
+      fprintf(out, "%s\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.6f,%.6f]},"
+              "\"properties\":{\"rockblock\":\"%s\",\"time\":\"%s\"}}",
+              (i == 0) ? "" : ",", entries[i].giLongitude, entries[i].giLatitude, idBuff, timeBuff);
+    } else {
+      fprintf(out, "%s,%s,%.6f,%.6f\n", idBuff, timeBuff, entries[i].giLatitude, entries[i].giLongitude);
+    }
+  }
+
+  if (format == GEOQUERY_GEOJSON) {
+    fprintf(out, "\n]}\n");
+  }
+}
+
+static void addResult(geoIndexEntry** results, int* count, int* size, geoIndexEntry* entry) {
+  if (*count >= *size) {
+    *size = (*size == 0) ? 1024 : *size * 2;
+
+    if ((*results = realloc(*results, *size * sizeof(geoIndexEntry))) == NULL) {
+      printf("Error: Out of memory in the index!\n");
+      exit(1);
+    }
+  }
+
+  (*results)[(*count)++] = *entry;
+}
+
+// Whether the longitudes from west to east overlap those of the box.  A box
+// with minLon greater than maxLon crosses the antimeridian and covers
+// minLon to 180 and -180 to maxLon.
+static bool lonOverlaps(float west, float east, float minLon, float maxLon) {
+  if (minLon <= maxLon) {
+    return ((east >= minLon) && (west <= maxLon));
+  }
+
+  return ((east >= minLon) || (west <= maxLon));
+}
+
+//*****************************************************************************
+//
+// geoIndexQuery
+//
+// Writes every indexed position inside the box (inclusive) between fromTime
+// and toTime (unix times, inclusive) to out, sorted by Rockblock ID and time.
+// If minLon is greater than maxLon the box crosses the antimeridian.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int geoIndexQuery(char* indexDir, float minLat, float minLon, float maxLat, float maxLon,
+                  uint32_t fromTime, uint32_t toTime, int format, FILE* out) {
+  DIR* indexDirPtr;
+  DIR* monthDirPtr;
+  struct dirent* monthEntry;
+  struct dirent* cellEntry;
+  struct tm timeInfo;
+  time_t tempTime;
+  geoIndexEntry* results;
+  geoIndexEntry entries[256];
+  char fromMonth[8];
+  char toMonth[8];
+  char dirName[FILE_NAME_SIZE];
+  char fileName[FILE_NAME_SIZE];
+  char cell[GEOINDEX_PRECISION + 1];
+  float cellMinLat, cellMinLon, cellMaxLat, cellMaxLon;
+  FILE* fd;
+  int resultCount;
+  int resultSize;
+  int len;
+  int n;
+  int i;
+
+  if ((indexDirPtr = opendir(indexDir)) == NULL) {
+    printf("Error: Unable to open index directory %s!\n", indexDir);
+    return (1);
+  }
+
+  tempTime = fromTime;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(fromMonth, sizeof(fromMonth), "%Y%m", &timeInfo);
+  tempTime = toTime;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(toMonth, sizeof(toMonth), "%Y%m", &timeInfo);
+
+  results = NULL;
+  resultCount = resultSize = 0;
+
+  while ((monthEntry = readdir(indexDirPtr)) != NULL) {
+    // Only the month partitions in the time range are looked at.
+    if ((strlen(monthEntry->d_name) != 6) ||
+        (strcmp(monthEntry->d_name, fromMonth) < 0) || (strcmp(monthEntry->d_name, toMonth) > 0)) {
+      continue;
+    }
+
+    if ((snprintf(dirName, sizeof(dirName), "%s/%s", indexDir, monthEntry->d_name) >= (int)sizeof(dirName)) ||
+        ((monthDirPtr = opendir(dirName)) == NULL)) {
+      continue;
+    }
+
+    while ((cellEntry = readdir(monthDirPtr)) != NULL) {
+      len = strlen(cellEntry->d_name);
+
+      if ((len != GEOINDEX_PRECISION + 4) || (strcmp(&cellEntry->d_name[GEOINDEX_PRECISION], ".gix") != 0)) {
+        continue;
+      }
+
+      // Only the cells that overlap the box are read.
+      memcpy(cell, cellEntry->d_name, GEOINDEX_PRECISION);
+      cell[GEOINDEX_PRECISION] = 0;
+
+      if (!geohashBounds(cell, &cellMinLat, &cellMinLon, &cellMaxLat, &cellMaxLon) ||
+          (cellMaxLat < minLat) || (cellMinLat > maxLat) ||
+          !lonOverlaps(cellMinLon, cellMaxLon, minLon, maxLon)) {
+        continue;
+      }
+
+      if ((snprintf(fileName, sizeof(fileName), "%s/%s", dirName, cellEntry->d_name) >= (int)sizeof(fileName)) ||
+          ((fd = fopen(fileName, "rb")) == NULL)) {
+        continue;
+      }
+
+      while ((n = fread(entries, sizeof(geoIndexEntry), 256, fd)) > 0) {
+        for (i = 0; i < n; ++i) {
+          if ((entries[i].giTime >= fromTime) && (entries[i].giTime <= toTime) &&
+              (entries[i].giLatitude >= minLat) && (entries[i].giLatitude <= maxLat) &&
+              lonOverlaps(entries[i].giLongitude, entries[i].giLongitude, minLon, maxLon)) {
+            addResult(&results, &resultCount, &resultSize, &entries[i]);
+          }
+        }
+      }
+
+      fclose(fd);
+    }
+
+    closedir(monthDirPtr);
+  }
+
+  closedir(indexDirPtr);
+
+  // A record indexed twice shows up once.
+  qsort(results, resultCount, sizeof(geoIndexEntry), compareEntries);
+
+  for (i = n = 0; i < resultCount; ++i) {
+    if ((n == 0) || (compareEntries(&results[n - 1], &results[i]) != 0)) {
+      results[n++] = results[i];
+    }
+  }
+
+  writeResults(results, n, format, out);
+  free(results);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// geoIndexLatest
+//
+// Writes the latest indexed position of every Rockblock to out.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int geoIndexLatest(char* indexDir, int format, FILE* out) {
+  char fileName[FILE_NAME_SIZE];
+  geoIndexEntry* latest;
+  FILE* fd;
+  long size;
+  int count;
+
+  if ((snprintf(fileName, sizeof(fileName), "%s/latest.gix", indexDir) >= (int)sizeof(fileName)) ||
+      ((fd = fopen(fileName, "rb")) == NULL)) {
+    printf("Error: No index found in %s!\n", indexDir);
+    return (1);
+  }
+
+  fseek(fd, 0, SEEK_END);
+  size = ftell(fd) / sizeof(geoIndexEntry);
+  fseek(fd, 0, SEEK_SET);
+
+  if ((latest = malloc((size + 1) * sizeof(geoIndexEntry))) == NULL) {
+    printf("Error: Out of memory in the index!\n");
+    exit(1);
+  }
+
+  count = fread(latest, sizeof(geoIndexEntry), size, fd);
+  fclose(fd);
+
+  qsort(latest, count, sizeof(geoIndexEntry), compareEntries);
+  writeResults(latest, count, format, out);
+  free(latest);
+  return (0);
+}
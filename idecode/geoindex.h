@@ -0,0 +1,34 @@
+//*****************************************************************************
+// geoindex.h
+//
+// Spatio-temporal index of decoded icedrifter positions.
+//
+//*****************************************************************************
+
+#ifndef _GEOINDEX_H
+#define _GEOINDEX_H
+
+#include "idecode.h"
+
+#define GEOINDEX_PRECISION 3  // geohash characters per cell, about 156km square.
+#define GEOINDEX_ID_SIZE 20   // Rockblock ID space in an index entry.
+
+// One position in the index.
+typedef struct geoIndexEntry {
+  char giRockblockId[GEOINDEX_ID_SIZE];
+  uint32_t giTime;  // unix time of the GPS fix.
+  float giLatitude;
+  float giLongitude;
+} geoIndexEntry;
+
+#define GEOQUERY_CSV      0
+#define GEOQUERY_GEOJSON  1
+
+int geoIndexAppend(char* indexDir, decodeContext** ctxList, int count);
+int geoIndexQuery(char* indexDir, float minLat, float minLon, float maxLat, float maxLon,
+                  uint32_t fromTime, uint32_t toTime, int format, FILE* out);
+int geoIndexLatest(char* indexDir, int format, FILE* out);
+void geohashEncode(float lat, float lon, int precision, char* hash);
+bool geohashBounds(char* hash, float* minLat, float* minLon, float* maxLat, float* maxLon);
+
+#endif // _GEOINDEX_H
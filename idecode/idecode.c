@@ -9,6 +9,10 @@
 // It also has the ability to read in a reconstructed data record and print
 // that data.
 //
+// Build with:
+//
+//   gcc -O2 -pthread -o idecode *.c -lm
+//
 //*****************************************************************************
 
 #include <stdio.h>
@@ -19,33 +23,50 @@
 #include <time.h>
 #include <stdbool.h>
 
-#include "../icedrifter_v6.5/icedrifter.h"
-#include "../icedrifter_v6.5/rockblock.h"
+#include "idecode.h"
+#include "threadpool.h"
+#include "store.h"
+#include "geoindex.h"
+#include "convert.h"
+#include "notify.h"
+#include "export.h"
+#include "reassemble.h"
+#include "summary.h"
+#include "drift.h"
+#include "timeline.h"
+#include "layout.h"
 
-icedrifterData idData; // structure that defines the icedrifter record.
+bool mailResultsSwitch; // switch to indicate an email should be sent.
 
-#define BUFF_SIZE 2048  // size of the buffer used to decode character data.
-#define FILE_NAME_SIZE  1024  // size of buffers used for file names.
-#define GPS_TIME_SIZE 16  // size of the buffer used to decode gps time and date.
+char** emailAddress; // email addresses to send the digests to.
 
-// number of seconds in the 30 years betweem 01/01/1970 and 01/01/2000.
-// Used during the conversion of arduino's time_t and linux's time_t.
-#define SECONDS_IN_30_YEARS (time_t)946684800                                     
+int emailCount;  // number of email addresses.
 
-bool mailResultsSwitch; // switch to indicate an email should be sent.
+char* notifyDelivery;  // maildir directory or "|command" digests are sent through.
+
+int notifyWindow;  // seconds a report may wait in the notification queue.
+
+int decodeThreads;  // number of threads used by batch mode, 0 for one per core.
+
+char* storeDirectory;  // columnar store records are added to, NULL if none.
+
+char* indexDirectory;  // position index records are added to, NULL if none.
 
-#define maxEmailAddresses 5  // The maximum number of email addresses that can be specified.
+char* exportFileName;  // CSV or NDJSON file records are exported to, NULL if none.
 
-char emailAddress[maxEmailAddresses][256]; // email address to send the email to.
+int exportFormat;  // EXPORT_CSV or EXPORT_NDJSON.
+
+char* summaryFileName;  // per-buoy summary file kept up to date, NULL if none.
+
+int daemonTimeout;  // seconds a report may wait for its next chunk in daemon mode.
+size_t reassembleMemory;  // most bytes of chunk sets held, 0 for no limit.
 
 int getDataByChunk(char**, int);
-void saveData(char* fileName);
 int getDataByFile(char**);
 int getDataByChar(char**, int);
-void decodeData(char* fileName);
-char convertCharToHex(char);
-void convertBigEndianToLittleEndian(char* sPtr, int size);
-float convertTempToC(short temp);
+int queryIndex(char**, int);
+int queryDrift(char**, int);
+int queryTrace(char**, int);
 void printHelp(void);
 
 //*****************************************************************************
@@ -57,9 +78,9 @@ void printHelp(void);
 
 int main(int argc, char** argv) {
 
-  int i;
   int argIx;
-  int argCompare;
+  uint32_t fromTime;
+  uint32_t toTime;
   struct stat fileStat;
 
 // we are expecting at least one argument.
@@ -71,11 +92,19 @@ int main(int argc, char** argv) {
 
   argIx = 1;
 
-  for (i = 0; i < maxEmailAddresses; ++i ) {
-    emailAddress[i][0] = 0;
-  }
-
   mailResultsSwitch = false;
+  emailAddress = NULL;
+  emailCount = 0;
+  notifyDelivery = NOTIFY_DEFAULT_DELIVERY;
+  notifyWindow = 5 * 60;
+  decodeThreads = 0;
+  storeDirectory = NULL;
+  indexDirectory = NULL;
+  exportFileName = NULL;
+  exportFormat = EXPORT_CSV;
+  summaryFileName = NULL;
+  daemonTimeout = 24 * 60 * 60;
+  reassembleMemory = 0;
 
 // check the arguments and invoke the proper routines.
   if (argv[argIx][0] == '-') {
@@ -87,31 +116,23 @@ int main(int argc, char** argv) {
         case 'm':
 
           mailResultsSwitch = true;
-          argCompare = argIx;
-          i = 0;
           ++argIx;
 
-          if (argv[argIx][0] == '-') {
+          if ((argIx >= argc) || (argv[argIx][0] == '-')) {
             printf("Error: Mail results switch set but no email addresses specified!!!\n\n");
             printHelp();
             exit(1);
           }
 
-          while (argv[argIx][0] != '-') {
-
-            if ((argIx - argCompare) <= maxEmailAddresses) {
-              strcpy(emailAddress[i], argv[argIx]);
-              ++i;
-              ++argIx;
+          // The addresses are used where they are on the command line.
+          emailAddress = &argv[argIx];
 
-              if (argIx >= argc) {
-                printf("Error: No arguments found after email addresses!\n\n");
-                printHelp();
-                exit(1);
-              }
-            } else {
+          while (argv[argIx][0] != '-') {
+            ++emailCount;
+            ++argIx;
 
-              printf("Error: Too many email addresses specified - only five allowed!!!\n\n");
+            if (argIx >= argc) {
+              printf("Error: No arguments found after email addresses!\n\n");
               printHelp();
               exit(1);
             }
@@ -119,6 +140,30 @@ int main(int argc, char** argv) {
 
           break;
 
+        case 'n':
+
+          if (argIx + 2 >= argc) {
+            printf("Error: -n must be followed by a maildir directory or \"|command\" and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          notifyDelivery = argv[argIx + 1];
+          argIx += 2;
+          break;
+
+        case 'w':
+
+          if ((argIx + 2 >= argc) || (atoi(argv[argIx + 1]) < 0)) {
+            printf("Error: -w must be followed by a number of seconds and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          notifyWindow = atoi(argv[argIx + 1]);
+          argIx += 2;
+          break;
+
         case 'c':
 
           if (stat(argv[argIx + 1], &fileStat) < 0) {
@@ -126,13 +171,205 @@ int main(int argc, char** argv) {
             return (0);
           }
 
-          if (getDataByChunk(&argv[argIx + 1], argc - argIx - 1) != 0) {
+          if ((getDataByChunk(&argv[argIx + 1], argc - argIx - 1) != 0) || (exportClose() != 0) ||
+              (summaryFlush() != 0) || (notifyFlush(true) != 0)) {
             exit(1);
           }
 
           printf("Decode sucessful.\n");
           return (0);
 
+        case 'j':
+
+          if ((argIx + 2 >= argc) || ((decodeThreads = atoi(argv[argIx + 1])) < 1)) {
+            printf("Error: -j must be followed by a thread count and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          argIx += 2;
+          break;
+
+        case 's':
+
+          if (argIx + 2 >= argc) {
+            printf("Error: -s must be followed by a store directory and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          storeDirectory = argv[argIx + 1];
+          argIx += 2;
+          break;
+
+        case 'S':
+
+          if (argIx + 5 >= argc) {
+            printf("Error: -S needs a store directory, Rockblock id, column, start and end date!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          if (!parseDateTime(argv[argIx + 4], &fromTime) || !parseDateTime(argv[argIx + 5], &toTime)) {
+            printf("Error: Dates must be yyyymmdd or yyyymmddhhmmss!\n\n");
+            exit(1);
+          }
+
+          // A date without a time includes the whole end day.
+          if (strlen(argv[argIx + 5]) == 8) {
+            toTime += (24 * 60 * 60) - 1;
+          }
+
+          if (storeQuery(argv[argIx + 1], argv[argIx + 2], argv[argIx + 3], fromTime, toTime, stdout) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'i':
+
+          if (argIx + 2 >= argc) {
+            printf("Error: -i must be followed by an index directory and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          indexDirectory = argv[argIx + 1];
+          argIx += 2;
+          break;
+
+        case 'x':
+
+          if ((argIx + 3 >= argc) ||
+              ((strcmp(argv[argIx + 1], "csv") != 0) && (strcmp(argv[argIx + 1], "ndjson") != 0))) {
+            printf("Error: -x must be followed by csv or ndjson, an export file and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          exportFormat = (strcmp(argv[argIx + 1], "csv") == 0) ? EXPORT_CSV : EXPORT_NDJSON;
+          exportFileName = argv[argIx + 2];
+          argIx += 3;
+          break;
+
+        case 'u':
+
+          if (argIx + 2 >= argc) {
+            printf("Error: -u must be followed by a summary file and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          summaryFileName = argv[argIx + 1];
+          argIx += 2;
+          break;
+
+        case 'U':
+
+          if (argIx + 1 >= argc) {
+            printf("Error: -U must be followed by a summary file!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          if (summaryPrint(argv[argIx + 1], stdout) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'D':
+
+          if (queryDrift(&argv[argIx + 1], argc - argIx - 1) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'T':
+
+          if (queryTrace(&argv[argIx + 1], argc - argIx - 1) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'q':
+
+          if (queryIndex(&argv[argIx + 1], argc - argIx - 1) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'b':
+
+          if (argIx + 1 >= argc) {
+            printf("Error: No directory or files specified with -b!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          if ((getDataByBatch(&argv[argIx + 1], argc - argIx - 1) != 0) || (exportClose() != 0) ||
+              (summaryFlush() != 0) || (notifyFlush(true) != 0)) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 'e':
+
+          if (argIx + 1 >= argc) {
+            printf("Error: No mbox files or maildir directories specified with -e!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          if ((getDataByMail(&argv[argIx + 1], argc - argIx - 1) != 0) || (exportClose() != 0) ||
+              (summaryFlush() != 0) || (notifyFlush(true) != 0)) {
+            exit(1);
+          }
+
+          return (0);
+
+        case 't':
+
+          if ((argIx + 2 >= argc) || (atoi(argv[argIx + 1]) < 1)) {
+            printf("Error: -t must be followed by a number of minutes and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          daemonTimeout = atoi(argv[argIx + 1]) * 60;
+          argIx += 2;
+          break;
+
+        case 'M':
+
+          if ((argIx + 2 >= argc) || (atoi(argv[argIx + 1]) < 0)) {
+            printf("Error: -M must be followed by a number of megabytes and another option!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          reassembleMemory = (size_t)atoi(argv[argIx + 1]) * 1024 * 1024;
+          argIx += 2;
+          break;
+
+        case 'd':
+
+          if (argIx + 1 >= argc) {
+            printf("Error: No spool directory specified with -d!\n\n");
+            printHelp();
+            exit(1);
+          }
+
+          if (getDataByDaemon(argv[argIx + 1]) != 0) {
+            exit(1);
+          }
+
+          return (0);
+
         case 'f':
 
           if (mailResultsSwitch == true) {
@@ -180,14 +417,16 @@ int main(int argc, char** argv) {
 //
 // getDataByChunk
 //
-// This routine reads in 1 to 3 chunk files, verifies that the data is all
-// associated with one idrifterData record and then rebuilds the data record.
+// This routine reads in chunk files, in any order, groups them by Rockblock
+// id and send time and rebuilds a data record from each group.  A duplicate
+// of a chunk already read is ignored.
 //
 // It then decodes the data and send the data in a humand readable format
 // to the console and writes out the idrifter data record to the current
 // directory with the file name of Rockblock id number followed by a '-'
 // followed by the date and time the sample was taken, and has an extension
-// of '.dat'.
+// of '.dat'.  A record that is missing a chunk other than chunk 0 is listed
+// as incomplete and decoded with the missing data left as zeros.
 //
 // Optionally, the decoded data and the idrifterData file can be sent by email
 // to the email address specified.
@@ -201,245 +440,221 @@ int main(int argc, char** argv) {
 //*****************************************************************************
 
 int getDataByChunk(char** fnl, int cnt) {
-  char** argIx;
-  iceDrifterChunk* idcPtr;
-  FILE* fd;
-  char* wkPtr;
-  char* fnPtr;
-  int recordTime;
-  int recordSize;
+  reassembler ra;
+  iceDrifterChunk chunk;
+  chunkSet** setList;
+  chunkSet* csPtr;
+  decodeContext* ctx;
+  char rbId[ROCKBLOCK_ID_SIZE];
+  char message[DECODE_MESSAGE_SIZE];
+  int setCount;
+  int recordCount;
+  int traceCount;
+  int len;
   int i;
-  time_t tempTime;
-  struct tm* timeInfo;
-  bool firstTime;
-  bool dashFound;
-  bool zeroRecordFound;
-  char fileBuffer[MAX_RECORD_LENGTH];
-  char tempHold[FILE_NAME_SIZE];
-  char fileName[FILE_NAME_SIZE];
-  char datName[FILE_NAME_SIZE];
-  char txtName[FILE_NAME_SIZE];
-  char gpsTime[GPS_TIME_SIZE];
-
-  wkPtr = (char*)&idData;
-  argIx = fnl;
-  firstTime = true;
-  fileName[0] = 0;
 
-  // Initialize the icedrifterData structure to zeros.
+  reassemblerInit(&ra, 0);
+  traceCount = 0;
 
-  for (i = 0; i < (BASE_RECORD_LENGTH + TEMP_DATA_SIZE + LIGHT_DATA_SIZE); ++i) {
-    *wkPtr = 0;
-    ++wkPtr;
-  }
-
-  zeroRecordFound = false;
-
-  // Extract the Rockblock ID number from the file name and make sure
-  // all IDs match.
   for (i = 0; i < cnt; ++i) {
+    printf("Processing file name %s\n", fnl[i]);
 
-    printf("Processing file name %s\n", argIx[i]);
-    strcpy(tempHold, argIx[i]);
-    wkPtr = tempHold;
-    fnPtr = tempHold;
-    dashFound = false;
-
-    while (*wkPtr != 0) {
-      // if the file specification contains a path we want to ignore that.
-      if ((*wkPtr == '/') || (*wkPtr == '\\')) {
-        fnPtr = wkPtr + 1;
-      } else {
-        if ((*wkPtr == '-') || (*wkPtr == '_')) {
-          dashFound = true;
-          *wkPtr = 0;
-          if (fileName[0] == 0) {
-            strcpy(fileName, fnPtr);
-            printf("Processing data for Rockblock %s.\n", fileName);
-            break;
-          } else {
-            // If the Rockblock ID's don't match we can not continue.
-            if (strcmp(fileName, fnPtr) != 0) {
-              printf("Error: File %d Rockblock name not equal previous file(s)!", i);
-              printf("idecode terminating.\n");
-              exit(1);
-            }
-            break;
-          }
-        }
-      }
-      ++wkPtr;
-    }
-
-    // If no dash was found we don't know what type of file this is
-    // so we quit.
-    if (dashFound == false) {
-      printf("Error: Invalid Icedrifter file name = %s!", argIx[i]);
+    if ((len = chunkFileRead(fnl[i], rbId, &chunk, message, sizeof(message))) == 0) {
+      printf("Error: %s", message);
       printf("idecode terminating.\n");
       exit(1);
     }
 
-    if ((fd = fopen(argIx[i], "r")) == NULL) {
-      printf("Error opening input file %s!\n", argIx[0]);
-      printf("idecode terminating.\n");
-      fclose(fd);
-      exit(1);
+    if (len == CHUNK_FILE_TRACE) {
+      printf("%s", message);
+      ++traceCount;
+      continue;
     }
 
-    // Get the length of this chunk.
-    fseek(fd, 0, SEEK_END);
-
-    recordSize = ftell(fd);
+    switch (reassemblerAdd(&ra, rbId, &chunk, len, &csPtr)) {
+      case CHUNK_DUPLICATE:
+        printf("Ignoring %s: Chunk %d was already read.\n", fnl[i], CHUNK_NUMBER(chunk.idcRecordNumber));
+        break;
 
-    if ((recordSize == 0) || (recordSize > MAX_CHUNK_LENGTH)) {
-      printf("Error: Record size zero or too long = %d!!!\n", recordSize);
-      printf("idecode terminating.\n");
-      fclose(fd);
-      exit(1);
+      case CHUNK_CONFLICT:
+        printf("Ignoring %s: Chunk %d does not match the other chunks.\n", fnl[i], CHUNK_NUMBER(chunk.idcRecordNumber));
+        break;
     }
+  }
 
-    fseek(fd, 0, SEEK_SET);
+  // Complete records and those missing a chunk past chunk 0 are decoded in
+  // Rockblock ID and send time order.
+  setCount = ra.raTable.ctCount;
+  setList = reassembleAlloc((setCount + 1) * sizeof(chunkSet*));
 
-    if (fread(fileBuffer, recordSize, 1, fd) == 0) {
-      printf("Error reading data file!\n");
-      printf("idecode terminating.\n");
-      fclose(fd);
-      exit(1);
-    }
+  for (csPtr = ra.raOldest, i = 0; csPtr != NULL; csPtr = csPtr->csNewer) {
+    setList[i++] = csPtr;
+  }
 
-    idcPtr = (iceDrifterChunk*)&fileBuffer;
+  qsort(setList, setCount, sizeof(chunkSet*), compareChunkSets);
+  recordCount = 0;
 
-    // Check that is is really an icedrifter chunk.
-    if (!((idcPtr->idcRecordType[0] == 'I') &&
-          (idcPtr->idcRecordType[1] == 'D'))) {
-      printf("Invalid record! Chunk header - not \"IDxx\"!\n");
-      exit(1);
-    }
+  for (i = 0; i < setCount; ++i) {
+    csPtr = setList[i];
 
-    // Pick up the report time from the first chunk processed and check
-    // that the other chunks have the same report time.
-    if (firstTime) {
-      recordTime = idcPtr->idcSendTime;
-      firstTime = false;
-    } else {
-      if (idcPtr->idcSendTime != recordTime) {
-        printf("Error: Sent time of record %d does not equal sent time of first record!\n", i + 1);
-        printf("  recordTime = %x idcPtr->idcSendTime = %x.\n", recordTime, idcPtr->idcSendTime);
-        printf("idecode terminating.\n");
-        fclose(fd);
-        exit(1);
-      }
-    }
+    if (!chunkSetComplete(csPtr)) {
+      chunkSetReport(csPtr);
 
-    // Copy the chunk data to the proper location within the icedrifterData structure.
-    if (idcPtr->idcRecordNumber == 0) {
-      wkPtr = (char*)&idData;
-      memmove(wkPtr, (char*)&idcPtr->idcBuffer, recordSize - CHUNK_HEADER_SIZE);
-      zeroRecordFound = true;
-    } else if (idcPtr->idcRecordNumber == 1) {
-      wkPtr = (char*)&idData;
-      wkPtr += MAX_CHUNK_DATA_LENGTH;
-      memmove(wkPtr, (char*)&idcPtr->idcBuffer, recordSize - CHUNK_HEADER_SIZE);
-    } else if (idcPtr->idcRecordNumber == 2) {
-      wkPtr = (char*)&idData;
-      wkPtr += (MAX_CHUNK_DATA_LENGTH * 2);
-      memmove(wkPtr, (char*)&idcPtr->idcBuffer, recordSize - CHUNK_HEADER_SIZE);
-    } else {
-      printf("Invalid record number!!! Record number = %d!!!\n", idcPtr->idcRecordNumber);
-      fclose(fd);
-      exit(1);
+      if (chunkSetNeeded(csPtr) == 0) {
+        continue;
+      }
     }
 
-    fclose(fd);
+    ctx = chunkSetRecord(csPtr);
+    printf("Processing data for Rockblock %s sent %08x.\n", ctx->dcRockblockId, ctx->dcSendTime);
+    processRecord(ctx);
+    free(ctx);
+    ++recordCount;
   }
 
-  // If no Zero record was found it doesn't make sense to continue.
-  if (zeroRecordFound == false) {
+  free(setList);
+  reassemblerPrint(&ra);
+  reassemblerFree(&ra);
+
+  // If no record could be rebuilt there was no chunk 0.
+  if ((recordCount == 0) && (traceCount == 0)) {
     printf("Error: No record 0 found.  Can not continue!\n");
-    printf("idecode terminating.\n");
-    exit(1);
+    return (1);
   }
 
-  // The temperature and light probes return their data in big endien format so
-  // we need to convert that data to little endien.
-  convertBigEndianToLittleEndian((char*)&idData.idChainData, sizeof(idData.idChainData));
+  // Only event traces may have been given, so say what was done.
+  printf("%d reports decoded, %d event traces written.\n", recordCount, traceCount);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// finishRecord
+//
+// ctx: The context holding a record that has been reassembled from its chunks.
+//
+// Finishes a reassembled record.  The human readable data is written to
+// <Rockblock ID>-<report date and time>.txt and the record is saved to
+// <Rockblock ID>-<report date and time>.dat.  Only the context passed in is
+// used, so several records may be finished at the same time.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int finishRecord(decodeContext* ctx) {
+  time_t tempTime;
+  struct tm timeInfo;
+  char gpsTime[GPS_TIME_SIZE];
 
   // Build the file names that will be used to output the data.
   // The file names will be <Rockblock ID>-<report date and time>.
-  strcpy(datName, fileName);
-  strcat(datName, "-");
   // The linux system defines time_t as a 64 bit number of seconds starting 01/01/1970
   // and the arduino system defines time_t as a 32 bit number of seconds starting on
   // 01/01/2000.  The arduino time_t must be converted to a 64 bit number and then
   // 30 years of seconds between 01/01/1970 and 01/01/2000 needs to be added to the 
   // arduino time_t value to get the equivalent linux time_t.
-  tempTime = (time_t)idData.idGPSTime + SECONDS_IN_30_YEARS;
-  timeInfo = gmtime(&tempTime);
+  tempTime = (time_t)ctx->dcData.idGPSTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
   gpsTime[0] = 0;
-  strftime(gpsTime, sizeof(gpsTime), "%Y%m%d%H%M%S", timeInfo);
-  strcat(datName, gpsTime);
-  strcpy(txtName, datName);
-  strcat(datName, ".dat");
-  strcat(txtName, ".txt");
+  strftime(gpsTime, sizeof(gpsTime), "%Y%m%d%H%M%S", &timeInfo);
+  snprintf(ctx->dcDatName, sizeof(ctx->dcDatName), "%s-%s.dat", ctx->dcRockblockId, gpsTime);
+  snprintf(ctx->dcTxtName, sizeof(ctx->dcTxtName), "%s-%s.txt", ctx->dcRockblockId, gpsTime);
+
+  // Records going to the store or an export file only need the .txt and
+  // .dat files if they are to be mailed.
+  if (((storeDirectory != NULL) || (exportFileName != NULL)) && (mailResultsSwitch == false)) {
+    ctx->dcResult = 0;
+    return (0);
+  }
 
   // Print the icedrifter data in human readable format to the .txt file.
-  decodeData(txtName);
+  if ((ctx->dcResult = decodeData(&ctx->dcData, ctx->dcTxtName)) != 0) {
+    return (ctx->dcResult);
+  }
 
   // Save the data to disk.
-  saveData(datName);
-
-  // If the user wants to send this data out by email, use mutt to do it.
-  if (mailResultsSwitch == true) {
-    sprintf(tempHold, "mutt -s \"Decoded data for %s\" -a %s %s -- %s %s %s %s %s < %s",
-            fileName, 
-            datName, 
-            txtName, 
-            emailAddress[0], 
-            emailAddress[1],
-            emailAddress[2],
-            emailAddress[3],
-            emailAddress[4], 
-            txtName);
-
-    if (system(tempHold) != 0) {
-      printf("Error returned from mutt command!!!\n");
-      printf("idecode terminating.\n");
-      exit(1);
-    }
+  ctx->dcResult = saveData(&ctx->dcData, ctx->dcDatName);
+  return (ctx->dcResult);
+}
+
+//*****************************************************************************
+//
+// mailRecord
+//
+// ctx: The context of a record that has been finished.
+//
+// If the user wants the data sent out by email, queue it for the next
+// digest.  The digests are sent by the notification spooler.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int mailRecord(decodeContext* ctx) {
+  if (mailResultsSwitch == false) {
+    return (0);
   }
-  return(0);
+
+  return (notifyQueue(ctx));
+}
+
+//*****************************************************************************
+//
+// processRecord
+//
+// ctx: The context holding a record that has been reassembled from its chunks.
+//
+// Finishes the record, mails it if asked to and adds it to the store and
+// the position index if they were given.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int processRecord(decodeContext* ctx) {
+  if ((finishRecord(ctx) != 0) || (mailRecord(ctx) != 0) ||
+      ((storeDirectory != NULL) && (storeAppend(storeDirectory, &ctx, 1) != 0)) ||
+      ((indexDirectory != NULL) && (geoIndexAppend(indexDirectory, &ctx, 1) != 0)) ||
+      ((exportFileName != NULL) && (exportAppend(&ctx, 1) != 0)) ||
+      ((summaryFileName != NULL) && (summaryUpdate(&ctx, 1) != 0))) {
+    printf("idecode terminating.\n");
+    exit(1);
+  }
+
+  return (0);
 }
 
 //*****************************************************************************
 //
 // saveData
 //
+// idPtr is the record to save.
+//
 // fileName is the name that will be given the file.
 //
-// returns nothing.
+// returns 0 for good completion and non-zero if an error is detected.
 //
 // This function writes the icedrifterData structure to disk.
 //
 //*****************************************************************************
 
-void saveData(char* fileName) {
+int saveData(icedrifterData* idPtr, char* fileName) {
   FILE* fd;
 
   if ((fd = fopen(fileName, "w")) == NULL) {
-    printf("Error opening input file %s!\n", fileName);
-    printf("idecode terminating.\n");
-    fclose(fd);
-    exit(1);
+    printf("Error opening output file %s!\n", fileName);
+    return (1);
   }
 
-  if (fwrite((char*)&idData, sizeof(idData), 1, fd) != 1) {
+  if (fwrite((char*)idPtr, sizeof(icedrifterData), 1, fd) != 1) {
     printf("Error writing output %s!\n", fileName);
-    printf("idecode terminating.\n");
     fclose(fd);
-    exit(1);
+    return (1);
   }
 
   fclose(fd);
+  return (0);
 }
 
 //*****************************************************************************
@@ -456,28 +671,25 @@ void saveData(char* fileName) {
 //*****************************************************************************
 
 int getDataByFile(char** fnl) {
-  size_t recordSize;
-  int i;
   char** argIx;
   FILE* fd;
-  char* wkPtr;
+  icedrifterData data;
+  uint8_t buff[sizeof(icedrifterData) + 1];
+  int length;
 
-  wkPtr = (char*)&idData;
   argIx = fnl;
 
-  // Initialize the icedrifterData structure.
-  for (i = 0; i < (BASE_RECORD_LENGTH + TEMP_DATA_SIZE + LIGHT_DATA_SIZE); ++i) {
-    *wkPtr - 0;
-  }
-
   if ((fd = fopen(argIx[0], "r")) == NULL) {
     printf("Error opening input file %s!\n", argIx[0]);
     printf("idecode terminating.\n");
-    fclose(fd);
     exit(1);
   }
 
-  if ((fread((char*)&idData, sizeof(idData), 1, fd) == 0)) {
+  // Files written by earlier versions of idecode are shorter, so the whole
+  // file is read and its length picks the layout.
+  length = fread(buff, 1, sizeof(buff), fd);
+
+  if (ferror(fd) || !layoutDecodeSaved(buff, length, &data)) {
     printf("Error reading data file %s!\n", argIx[0]);
     printf("idecode terminating.\n");
     fclose(fd);
@@ -489,8 +701,7 @@ int getDataByFile(char** fnl) {
   // Write the data in human readable forman to sysout.
   // Passing a NULL to the decodeData function tells it to write to sysout instead
   // of a disk file.
-  decodeData(NULL);
-  return (0);
+  return (decodeData(&data, NULL));
 }
 
 //*****************************************************************************
@@ -510,67 +721,58 @@ int getDataByFile(char** fnl) {
 //*****************************************************************************
 
 int getDataByChar(char** data, int cnt) {
-  char* cunkPtr;
-  char* wkPtr;
   iceDrifterChunk* idcPtr;
-  char* recPtr;
+  chunkSet* csPtr;
+  decodeContext* ctx;
+  reassembler ra;
   int recNum;
   int dataIx;
   int i;
   int recLen;
-  char hb1;
-  char hb2;
-  char buffHold;
-  struct tm* timeInfo;
-  uint32_t tempTime;
-  uint32_t timeHold;
+  int rc;
+  uint32_t timeHold = 0;
   bool gotDate;
   char buff[BUFF_SIZE];
 
-  wkPtr = buff;
+  reassemblerInit(&ra, 0);
   gotDate = false;
 
   for (recNum = 0; recNum < cnt; ++recNum) {
 
-    dataIx = 0;
-    recLen = 0;
-
     if (*data[recNum] == 0) {
       break;
     }
 
-    while (1) {
-      hb1 = hb2 = 0;
+    dataIx = strcspn(data[recNum], "\r\n");
 
-      if (!((data[recNum][dataIx] == 0) ||
-            (data[recNum][dataIx] == '\r') ||
-            (data[recNum][dataIx] == '\n'))) {
-        if ((hb1 = convertCharToHex(data[recNum][dataIx])) == 0xFF) {
-          printf("\nInvalid hex charactor found at location %d!!!\n", dataIx);
-          exit(1);
-        }
-      } else {
-        break;
-      }
+    if (dataIx > MAX_CHUNK_LENGTH * 2) {
+      printf("\nChunk %d is longer than %d bytes!!!\n", recNum, MAX_CHUNK_LENGTH);
+      exit(1);
+    }
 
-      if (!((data[recNum][dataIx + 1] == 0) ||
-            (data[recNum][dataIx + 1] == '\r') ||
-            (data[recNum][dataIx + 1] == '\n'))) {
-        if ((hb2 = convertCharToHex(data[recNum][dataIx + 1])) == 0xFF) {
-          printf("\nInvalid hex charactor found at location %d!!!\n", (i + 1));
-          exit(1);
-        }
+    // Convert all of the whole bytes at once.  An odd last charactor is the
+    // high half of one more byte.
+    if (((recLen = convertHexToBinary(data[recNum], dataIx & ~1, (uint8_t*)buff)) < 0) ||
+        ((dataIx & 1) && (convertCharToHex(data[recNum][dataIx - 1]) == (char)0xFF))) {
+      for (i = 0; convertCharToHex(data[recNum][i]) != (char)0xFF; ++i) {
       }
 
-      *wkPtr = (hb1 << 4) | hb2;
-      ++wkPtr;
-      ++recLen;
-      dataIx += 2;
+      printf("\nInvalid hex charactor found at location %d!!!\n", i);
+      exit(1);
+    }
+
+    if (dataIx & 1) {
+      buff[recLen++] = convertCharToHex(data[recNum][dataIx - 1]) << 4;
     }
 
     idcPtr = (iceDrifterChunk*)buff;
 
-    if (!((idcPtr->idcRecordType[0] == 'I') && (idcPtr->idcRecordType[1] == 'D'))) {
+    // A heartbeat is decoded as a record without chain data.
+    if (recLen > CHUNK_HEADER_SIZE) {
+      recLen = layoutHeartbeat(idcPtr, recLen - CHUNK_HEADER_SIZE) + CHUNK_HEADER_SIZE;
+    }
+
+    if ((recLen < CHUNK_HEADER_SIZE) || !((idcPtr->idcRecordType[0] == 'I') && (idcPtr->idcRecordType[1] == 'D'))) {
       printf("Record ID not = \"ID\"!!!\n");
       exit(1);
     }
@@ -585,21 +787,27 @@ int getDataByChar(char** data, int cnt) {
       gotDate = true;
     }
 
-    recPtr = (char*)&idData;
-
-    if (idcPtr->idcRecordNumber == 1) {
-      recPtr += sizeof(idcPtr->idcBuffer);
-    } else if (idcPtr->idcRecordNumber == 2) {
-      recPtr += sizeof(idcPtr->idcBuffer) * 2;
+    // The chunks may be given in any order.
+    if (reassemblerAdd(&ra, "", idcPtr, recLen - CHUNK_HEADER_SIZE, &csPtr) == CHUNK_INVALID) {
+      printf("Chunk %d extends past the end of the record!!!\n", CHUNK_NUMBER(idcPtr->idcRecordNumber));
+      exit(1);
     }
+  }
 
-    wkPtr = (char*)idcPtr->idcBuffer;
-    memmove(recPtr, wkPtr, recLen);
+  if (((csPtr = ra.raOldest) == NULL) || (chunkSetNeeded(csPtr) == 0)) {
+    printf("No record 0 found!!!\n");
+    exit(1);
   }
 
-  convertBigEndianToLittleEndian((char*)&idData.idChainData, sizeof(idData.idChainData));
-  decodeData(NULL);
-  return(0);
+  if (!chunkSetComplete(csPtr)) {
+    chunkSetReport(csPtr);
+  }
+
+  ctx = chunkSetRecord(csPtr);
+  reassemblerFree(&ra);
+  rc = decodeData(&ctx->dcData, NULL);
+  free(ctx);
+  return (rc);
 }
 
 //*****************************************************************************
@@ -610,31 +818,62 @@ int getDataByChar(char** data, int cnt) {
 //           If fileName is NULL the data will be written to sysour.
 //
 // The function decodes and prints in human readable format the data contained
-// in the icddrifterData structure.
+// in the icddrifterData structure pointed to by idPtr.
+//
+// returns 0 for good completion and non-zero if an error is detected.
 //
 //*****************************************************************************
 
-void decodeData(char* fileName) {
+// Names of the MEM_PHASE_xxx and BOOT_xxx values.
+static const char* memPhaseNames[] = {"boot fill", "setup", "time check", "GPS", "sensors", "chain", "format", "transmit", "burst"};
+static const int burstBandEdges[] = BURST_BAND_EDGES;
+static const char* bootReasonNames[] = {"unknown", "power on", "reset button", "brownout", "watchdog"};
+
+// Prints the statistics of the readings of one sensor.
+static void printStats(FILE* fd, char* name, float mean, float variance, float min, uint32_t minTime,
+                       float max, uint32_t maxTime) {
+  struct tm timeInfo;
+  time_t tempTime;
+  char minBuff[32];
+  char maxBuff[32];
+
+  tempTime = (time_t)minTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(minBuff, sizeof(minBuff), "%Y-%m-%d %H:%M:%S", &timeInfo);
+  tempTime = (time_t)maxTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(maxBuff, sizeof(maxBuff), "%Y-%m-%d %H:%M:%S", &timeInfo);
+
+  fprintf(fd, "%s mean %f variance %f\n", name, mean, variance);
+  fprintf(fd, "             min %f at %s max %f at %s\n", min, minBuff, max, maxBuff);
+}
+
+#define NAME_OF(names, value) \
+  (((value) < sizeof(names) / sizeof(names[0])) ? names[value] : "unknown")
+
+int decodeData(icedrifterData* idPtr, char* fileName) {
 
-  struct tm* timeInfo;
+  struct tm timeInfo;
   time_t tempTime;
+  char timeBuff[32];
   int i;
+  int tempCount;
+  int lightCount;
   FILE* fd;
   uint32_t ltClear;
   uint8_t rgbRed;
   uint8_t rgbGreen;
   uint8_t rgbBlue;
-
+  float temps[TEMP_SENSOR_COUNT];
+  float burstEnergy[BURST_BANDS];
 
 
   if (fileName == NULL) {
     fd = stdout;
   } else {
     if ((fd = fopen(fileName, "w")) == NULL) {
-      printf("Error opening input file %s!\n", fileName);
-      printf("idecode terminating.\n");
-      fclose(fd);
-      exit(1);
+      printf("Error opening output file %s!\n", fileName);
+      return (1);
     }
   }
   // The linux system defines time_t as a 64 bit number of seconds starting 01/01/1970
@@ -642,70 +881,170 @@ void decodeData(char* fileName) {
   // 01/01/2000.  The arduino time_t must be converted to a 64 bit number and then
   // 30 years of seconds between 01/01/1970 and 01/01/2000 needs to be added to the 
   // arduino time_t value to get the equivalent linux time_t.
-  tempTime = (time_t)idData.idLastBootTime + SECONDS_IN_30_YEARS;
-  timeInfo = gmtime(&tempTime);
-  fprintf(fd, "Last Boot:   %s", asctime(timeInfo));
+  // A heartbeat only has the time, position, pressure and remote temperature.
+  if (idPtr->idSwitches & HEARTBEAT_SWITCH) {
+    fprintf(fd, "Heartbeat report\n");
+  } else {
+    tempTime = (time_t)idPtr->idLastBootTime + SECONDS_IN_30_YEARS;
+    gmtime_r(&tempTime, &timeInfo);
+    fprintf(fd, "Last Boot:   %s", asctime_r(&timeInfo, timeBuff));
+  }
 
-  tempTime = (time_t)idData.idGPSTime + SECONDS_IN_30_YEARS;
-  timeInfo = gmtime(&tempTime);
-  fprintf(fd, "GPS time:    %s", asctime(timeInfo));
+  tempTime = (time_t)idPtr->idGPSTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
+  fprintf(fd, "GPS time:    %s", asctime_r(&timeInfo, timeBuff));
 
-  if (idData.idcdError == 0) {
+  if (idPtr->idcdError == 0) {
     fprintf(fd, "No errors found.\n");
   } else {
     fprintf(fd, "\nError(s) found!!!\n");
-    if (idData.idcdError & TEMP_CHAIN_TIMEOUT_ERROR) {
+    if (idPtr->idcdError & TEMP_CHAIN_TIMEOUT_ERROR) {
       fprintf(fd, "*** Temperature chain timeout.\n");
     }
-    if (idData.idcdError & TEMP_CHAIN_OVERRUN_ERROR) {
+    if (idPtr->idcdError & TEMP_CHAIN_OVERRUN_ERROR) {
       fprintf(fd, "*** Temperature chain overrun.\n");
     }
-    if (idData.idcdError & LIGHT_CHAIN_TIMEOUT_ERROR) {
+    if (idPtr->idcdError & LIGHT_CHAIN_TIMEOUT_ERROR) {
       fprintf(fd, "*** Light chain timeout.\n");
     }
-    if (idData.idcdError & LIGHT_CHAIN_OVERRUN_ERROR) {
+    if (idPtr->idcdError & LIGHT_CHAIN_OVERRUN_ERROR) {
       fprintf(fd, "*** Light chain overrun.\n");
     }
     fprintf(fd, "\n");
   }
 
-  fprintf(fd, "Temp chain bytes received %d\n", idData.idTempByteCount);
-  fprintf(fd, "Light chain bytes received %d\n\n", idData.idLightByteCount);
+  fprintf(fd, "Temp chain bytes received %d\n", idPtr->idTempByteCount);
+  fprintf(fd, "Light chain bytes received %d\n", idPtr->idLightByteCount);
 
-  fprintf(fd, "latitude:    %f\n", idData.idLatitude);
-  fprintf(fd, "longitude:   %f\n", idData.idLongitude);
-  fprintf(fd, "temperature: %f C\n", idData.idTemperature);
-  fprintf(fd, "pressure:    %f Pa\n", idData.idPressure);
+  if (idPtr->idTempSensorCount != 0 || idPtr->idLightSensorCount != 0) {
+    fprintf(fd, "Chain sensors discovered %d temp %d light\n", idPtr->idTempSensorCount, idPtr->idLightSensorCount);
+  }
+
+  if (idPtr->idSwitches & CHECK_MEMORY_USE_SWITCH) {
+    fprintf(fd, "Least free memory %d bytes during %s\n", idPtr->idMinFreeMemory,
+            NAME_OF(memPhaseNames, idPtr->idMinFreePhase));
+  }
+
+  if (idPtr->idBootReason != BOOT_UNKNOWN) {
+    fprintf(fd, "Last reset: %s\n", NAME_OF(bootReasonNames, idPtr->idBootReason));
+  }
+
+  fprintf(fd, "\n");
 
-  if (idData.idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
-    fprintf(fd, "remote temp: %f C\n\n", idData.idRemoteTemp);
+  fprintf(fd, "latitude:    %f\n", idPtr->idLatitude);
+  fprintf(fd, "longitude:   %f\n", idPtr->idLongitude);
+
+  if (!(idPtr->idSwitches & HEARTBEAT_SWITCH)) {
+    fprintf(fd, "temperature: %f C\n", idPtr->idTemperature);
   }
 
-  if (idData.idSwitches & PROCESS_CHAIN_DATA_SWITCH) {
-    for (i = 0; i < TEMP_SENSOR_COUNT; ++i) {
-      fprintf(fd, "Chain temperature sensor %3d = %f\n", i, convertTempToC(idData.idChainData.cdTempData[i]));
+  fprintf(fd, "pressure:    %f Pa\n", idPtr->idPressure);
+
+  if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+    fprintf(fd, "remote temp: %f C\n\n", idPtr->idRemoteTemp);
+  }
+
+  if (idPtr->idSampleCount != 0) {
+    fprintf(fd, "%d readings %d minutes apart since the last full report\n", idPtr->idSampleCount,
+            idPtr->idSampleInterval);
+    printStats(fd, "pressure:   ", idPtr->idPressureMean, idPtr->idPressureVariance, idPtr->idPressureMin,
+               idPtr->idPressureMinTime, idPtr->idPressureMax, idPtr->idPressureMaxTime);
+    printStats(fd, "temperature:", idPtr->idTemperatureMean, idPtr->idTemperatureVariance, idPtr->idTemperatureMin,
+               idPtr->idTemperatureMinTime, idPtr->idTemperatureMax, idPtr->idTemperatureMaxTime);
+
+    if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+      printStats(fd, "remote temp:", idPtr->idRemoteTempMean, idPtr->idRemoteTempVariance, idPtr->idRemoteTempMin,
+                 idPtr->idRemoteTempMinTime, idPtr->idRemoteTempMax, idPtr->idRemoteTempMaxTime);
     }
 
     fprintf(fd, "\n");
+  }
 
-    for (i = 0; i < LIGHT_SENSOR_COUNT; ++i) {
-      if (idData.idChainData.cdLightData[i][0] == 0) {
+  if (idPtr->idBurstSamples != 0) {
+    burstEnergy[0] = idPtr->idBurstEnergy0;
+    burstEnergy[1] = idPtr->idBurstEnergy1;
+    burstEnergy[2] = idPtr->idBurstEnergy2;
+    burstEnergy[3] = idPtr->idBurstEnergy3;
+    burstEnergy[4] = idPtr->idBurstEnergy4;
+    fprintf(fd, "pressure burst of %d readings: Hs %.1f ubar, peak period %.1f s\n", idPtr->idBurstSamples,
+            idPtr->idBurstSigAmp, idPtr->idBurstPeakPeriod / 10.0);
+
+    for (i = 0; i < BURST_BANDS; ++i) {
+      fprintf(fd, "  %4d - %4d mHz: %f ubar^2\n", burstBandEdges[i], burstBandEdges[i + 1], burstEnergy[i]);
+    }
+
+    fprintf(fd, "\n");
+  }
+
+  if (idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH) {
+    tempCount = chainTempCount(idPtr);
+    lightCount = chainLightCount(idPtr);
+
+    convertTempsToC((uint16_t*)idPtr->idChainData.cdTempData, tempCount, temps, false);
+
+    for (i = 0; i < tempCount; ++i) {
+      fprintf(fd, "Chain temperature sensor %3d = %f\n", i, temps[i]);
+    }
+
+    fprintf(fd, "\n");
+
+    for (i = 0; i < lightCount; ++i) {
+      if (idPtr->idChainData.cdLightData[i][0] == 0) {
         rgbRed = rgbGreen = rgbBlue = 0;
       } else {
-        ltClear = (uint32_t)idData.idChainData.cdLightData[i][0];
-        rgbRed = (float)idData.idChainData.cdLightData[i][1] / ltClear * 255.0;
-        rgbGreen = (float)idData.idChainData.cdLightData[i][2] / ltClear * 255.0;
-        rgbBlue = (float)idData.idChainData.cdLightData[i][3] / ltClear * 255.0;
+        ltClear = (uint32_t)idPtr->idChainData.cdLightData[i][0];
+        rgbRed = (float)idPtr->idChainData.cdLightData[i][1] / ltClear * 255.0;
+        rgbGreen = (float)idPtr->idChainData.cdLightData[i][2] / ltClear * 255.0;
+        rgbBlue = (float)idPtr->idChainData.cdLightData[i][3] / ltClear * 255.0;
       }
 
       fprintf(fd, "Chain light sensor %2d = %5hu %5hu %5hu %5hu  RGB %3d %3d %3d\n", i,
-              idData.idChainData.cdLightData[i][0], idData.idChainData.cdLightData[i][1], idData.idChainData.cdLightData[i][2], idData.idChainData.cdLightData[i][3],
+              idPtr->idChainData.cdLightData[i][0], idPtr->idChainData.cdLightData[i][1], idPtr->idChainData.cdLightData[i][2], idPtr->idChainData.cdLightData[i][3],
               rgbRed, rgbGreen, rgbBlue);
     }
   }
   if (fileName != NULL) {
     fclose(fd);
   }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// chainTempCount
+// chainLightCount
+//
+// returns: the number of temperature or light sensors to print.
+//
+// Records from an icedrifter that discovers its chain carry the sensor
+// counts in the header.  Older records only have the number of bytes the
+// chain sent, which is used instead.
+//
+//*****************************************************************************
+
+int chainTempCount(icedrifterData* idPtr) {
+  int count;
+
+  count = idPtr->idTempSensorCount;
+
+  if (count == 0) {
+    count = idPtr->idTempByteCount / sizeof(uint16_t);
+  }
+
+  return (count > TEMP_SENSOR_COUNT ? TEMP_SENSOR_COUNT : count);
+}
+
+int chainLightCount(icedrifterData* idPtr) {
+  int count;
+
+  count = idPtr->idLightSensorCount;
+
+  if (count == 0) {
+    count = idPtr->idLightByteCount / (LIGHT_SENSOR_FIELDS * sizeof(uint16_t));
+  }
+
+  return (count > LIGHT_SENSOR_COUNT ? LIGHT_SENSOR_COUNT : count);
 }
 
 //*****************************************************************************
@@ -744,15 +1083,7 @@ char convertCharToHex(char chr) {
 //
 //*****************************************************************************
 void convertBigEndianToLittleEndian(char* sPtr, int size) {
-  char tmp;
-  int i;
-
-  for (i = 0; i < (size / 2); ++i) {
-    tmp = *sPtr;
-    *sPtr = *(sPtr + 1);
-    *(sPtr + 1) = tmp;
-    sPtr += 2;
-  }
+  convertSwapHalfwords((uint8_t*)sPtr, size);
 }
 //*****************************************************************************
 //
@@ -775,17 +1106,262 @@ float convertTempToC(short temp) {
   return ((float)temp / 128.0);
 }
 
+//*****************************************************************************
+//
+// lzssDecode
+//
+// in, inLength: the stream of a record sent compressed.
+//
+// out, outSize: where the record goes and the room there.
+//
+// Expands the stream a token at a time in one pass, the way the icedrifter
+// made it.  Stops at the end of the stream or when out is full.
+//
+// returns the number of bytes put in out, or -1 if a copy reaches back
+// before the start of the record.
+//
+//*****************************************************************************
+
+int lzssDecode(uint8_t* in, int inLength, uint8_t* out, int outSize) {
+  uint32_t bits;
+  int bitCount;
+  int outLength;
+  int offset;
+  int length;
+
+  bits = 0;
+  bitCount = 0;
+  outLength = 0;
+
+  while (outLength < outSize) {
+    // Take in enough bytes for the longest token.
+    while ((bitCount < 1 + LZSS_OFFSET_BITS + LZSS_LENGTH_BITS) && (inLength > 0)) {
+      bits = (bits << 8) | *in++;
+      bitCount += 8;
+      --inLength;
+    }
+
+    // Fewer bits than a literal takes are the padding of the last byte.
+    if (bitCount < 9) {
+      break;
+    }
+
+    if (((bits >> (bitCount - 1)) & 1) == 0) {
+      bitCount -= 9;
+      out[outLength++] = bits >> bitCount;
+    } else {
+      if (bitCount < 1 + LZSS_OFFSET_BITS + LZSS_LENGTH_BITS) {
+        break;
+      }
+
+      bitCount -= 1 + LZSS_OFFSET_BITS + LZSS_LENGTH_BITS;
+      offset = ((bits >> (bitCount + LZSS_LENGTH_BITS)) & (LZSS_WINDOW - 1)) + 1;
+      length = ((bits >> bitCount) & ((1 << LZSS_LENGTH_BITS) - 1)) + LZSS_MIN_MATCH;
+
+      if (offset > outLength) {
+        return (-1);
+      }
+
+      // Byte by byte, as a copy may run into the bytes it makes.
+      for (; (length > 0) && (outLength < outSize); --length, ++outLength) {
+        out[outLength] = out[outLength - offset];
+      }
+    }
+
+    bits &= (1UL << bitCount) - 1;
+  }
+
+  return (outLength);
+}
+
+//*****************************************************************************
+//
+// queryIndex
+//
+// argv: the arguments following -q.
+//
+// argCount: the number of arguments in argv.
+//
+// Runs a bbox or latest query against the position index.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int queryIndex(char** argv, int argCount) {
+  uint32_t fromTime;
+  uint32_t toTime;
+  int format;
+  int fmtIx;
+
+  if (argCount < 2) {
+    printf("Error: -q needs an index directory and a query!\n\n");
+    printHelp();
+    return (1);
+  }
+
+  if (strcmp(argv[1], "latest") == 0) {
+    fmtIx = 2;
+  } else if (strcmp(argv[1], "bbox") == 0) {
+    if (argCount < 8) {
+      printf("Error: bbox needs min lat, min lon, max lat, max lon, start and end date!\n\n");
+      printHelp();
+      return (1);
+    }
+
+    if (!parseDateTime(argv[6], &fromTime) || !parseDateTime(argv[7], &toTime)) {
+      printf("Error: Dates must be yyyymmdd or yyyymmddhhmmss!\n\n");
+      return (1);
+    }
+
+    // A date without a time includes the whole end day.
+    if (strlen(argv[7]) == 8) {
+      toTime += (24 * 60 * 60) - 1;
+    }
+
+    fmtIx = 8;
+  } else {
+    printf("Error: Unknown index query %s!\n\n", argv[1]);
+    printHelp();
+    return (1);
+  }
+
+  format = GEOQUERY_CSV;
+
+  if (fmtIx < argCount) {
+    if (strcmp(argv[fmtIx], "geojson") == 0) {
+      format = GEOQUERY_GEOJSON;
+    } else if (strcmp(argv[fmtIx], "csv") != 0) {
+      printf("Error: Output format must be csv or geojson!\n\n");
+      return (1);
+    }
+  }
+
+  if (fmtIx == 2) {
+    return (geoIndexLatest(argv[0], format, stdout));
+  }
+
+  return (geoIndexQuery(argv[0], atof(argv[2]), atof(argv[3]), atof(argv[4]), atof(argv[5]),
+                        fromTime, toTime, format, stdout));
+}
+
+//*****************************************************************************
+//
+// queryDrift
+//
+// argv: the store directory, start and end date and optional interval in
+// minutes that followed -D.
+//
+// Prints the drift of every Rockblock in the store between the dates,
+// either at every fix or resampled to the interval.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int queryDrift(char** argv, int argCount) {
+  uint32_t fromTime;
+  uint32_t toTime;
+  int minutes;
+
+  if (argCount < 3) {
+    printf("Error: -D needs a store directory, start and end date!\n\n");
+    printHelp();
+    return (1);
+  }
+
+  if (!parseDateTime(argv[1], &fromTime) || !parseDateTime(argv[2], &toTime)) {
+    printf("Error: Dates must be yyyymmdd or yyyymmddhhmmss!\n\n");
+    return (1);
+  }
+
+  // A date without a time includes the whole end day.
+  if (strlen(argv[2]) == 8) {
+    toTime += (24 * 60 * 60) - 1;
+  }
+
+  minutes = 0;
+
+  if ((argCount > 3) && ((minutes = atoi(argv[3])) < 1)) {
+    printf("Error: The resample interval must be a number of minutes!\n\n");
+    return (1);
+  }
+
+  return (driftQuery(argv[0], fromTime, toTime, minutes * 60, stdout));
+}
+
+//*****************************************************************************
+//
+// queryTrace
+//
+// argv: the trace chunk files that followed -T.
+//
+// Prints the event trace in each file as a timeline.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int queryTrace(char** argv, int argCount) {
+  iceDrifterChunk chunk;
+  FILE* fd;
+  int length;
+  int i;
+
+  if (argCount < 1) {
+    printf("Error: No trace chunk files specified with -T!\n\n");
+    printHelp();
+    return (1);
+  }
+
+  for (i = 0; i < argCount; ++i) {
+    if ((fd = fopen(argv[i], "r")) == NULL) {
+      printf("Error: Unable to open %s!\n", argv[i]);
+      return (1);
+    }
+
+    length = (int)fread(&chunk, 1, sizeof(chunk), fd) - CHUNK_HEADER_SIZE;
+    fclose(fd);
+
+    if ((length < 0) || !timelineChunk(&chunk)) {
+      printf("Skipping %s: Not an event trace chunk!\n\n", argv[i]);
+      continue;
+    }
+
+    printf("%s\n", argv[i]);
+    timelinePrint(&chunk, length, stdout);
+    printf("\n");
+  }
+
+  return (0);
+}
+
 //*****************************************************************************
 //
 // Print out the following help information:
 //
 // Help for idecode.
 //
-// idecode [-m <email address>] -c <file name list or *.bin>
+// idecode [-m <email address list>] -c <file name list or *.bin>
+// idecode [-m <email address list>] [-j <threads>] -b <directory or file name list>
+// idecode -s <store directory> [-m ...] [-j ...] -c, -b, -e or -d ...
+// idecode -S <store directory> <Rockblock id> <column> <start date> <end date>
+// idecode [-m <email address list>] -e <mbox file or maildir directory list>
+// idecode [-m <email address list>] [-t <minutes>] -d <spool directory>
+// idecode -M <megabytes> [-s ...] [-m ...] [-j ...] -b, -e or -d ...
+// idecode -i <index directory> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...
+// idecode [-n <maildir directory or "|command">] [-w <seconds>] -m ...
+// idecode -x <csv | ndjson> <export file> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...
+// idecode -u <summary file> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...
+// idecode -U <summary file>
+// idecode -q <index directory> bbox <min lat> <min lon> <max lat> <max lon> <start date> <end date> [csv | geojson]
+// idecode -q <index directory> latest [csv | geojson]
+// idecode [-j <threads>] -D <store directory> <start date> <end date> [<minutes>]
+// idecode -T <trace chunk file list>
 // idecode -f <path and file name of a .dat file>
 // idecode <character data from email(s) as a single string>
 //
-// -c Read one to three .bin chunk files, decode the data, display
+// -c Read .bin chunk files in any order, decode the data, display
 //    human readable data on the console, write the human
 //    readable data to a file with the file name of
 //    <Rockblock id>-<yyyymmddhhmmss>.txt, and write the accumulated data
@@ -793,41 +1369,247 @@ float convertTempToC(short temp) {
 //    <Rockblock id>-<yyyymmddhhmmss>.dat.  The file names should
 //    not contain a path.
 //
+// -b Batch mode.  Read every .bin chunk file in the directories and
+//    every chunk file named, group the chunks by Rockblock id and sent
+//    time, and process each complete report the same way as -c.
+//    Reports with missing chunks are listed but do not stop the batch.
+//
+// -e Mailbox mode.  Read the RockBLOCK or Iridium delivery emails in mbox
+//    files and maildir directories, take the chunks from their .sbd
+//    attachments or hex data lines, and process each complete report the
+//    same way as -c.  The mailboxes are read a line at a time, so they may
+//    be any size.
+//
+// -d Daemon mode.  Watch <spool directory> and process each report the
+//    same way as -c as soon as all of its chunk files have landed there.
+//    Chunk files are moved to the done or bad directory in the spool once
+//    they are read.  Reports still waiting for chunks are kept in a journal
+//    in the spool so they survive a restart.  Runs until it is stopped
+//    with SIGINT or SIGTERM.
+//
+// -t Only used with -d.  Must be specified before the -d option.  The
+//    number of minutes a report may wait for its next chunk before it is
+//    listed as incomplete and dropped.  The default is one day.
+//
+// -M Only used with -b, -e or -d.  Must be specified before that option.
+//    The most megabytes of chunks held for reports still waiting for chunks.
+//    When it is reached, the report that has waited longest for its next
+//    chunk is listed as incomplete and dropped.  The default, 0, is no
+//    limit.
+//
+// -j Only used with -b or -D.  Must be specified before that option.
+//    Sets the number of threads used to read, reassemble and decode the
+//    chunks, or to analyze the tracks.  The default is one thread per core.
+//    The output is the same for any number of threads.
+//
+// -s Only used with -c, -b, -e or -d.  Must be specified before that option.
+//    Adds each decoded record to the columnar store in <store directory>
+//    instead of writing the .txt and .dat files, which are still written if
+//    -m is also given.  Each Rockblock has a directory in the store with one
+//    compressed column for the time, lat, lon, pressure, temperature,
+//    remotetemp and each chain sensor (chaintemp000, chainlight00c, ...).
+//
+// -S Print the values of one column of one Rockblock from the store as CSV.
+//    Dates are yyyymmdd or yyyymmddhhmmss UTC.  Only the blocks of that
+//    column that cover the dates are read.
+//
+// -i Only used with -c, -b, -e or -d.  Must be specified before that option.
+//    Adds the GPS position of each decoded record to the position index in
+//    <index directory>.  The index is split by month and by geohash cell so
+//    a query only reads the part of the index it needs.
+//
+// -q Query the position index.  bbox prints every position inside the box
+//    between the dates, sorted by Rockblock id and time.  A box with a min
+//    lon greater than its max lon crosses the antimeridian.  latest prints
+//    the latest position of each Rockblock.  The output is CSV unless
+//    geojson is given.
+//
+// -D Print the drift of every Rockblock in the store as CSV, sorted by
+//    Rockblock id and time.  Without <minutes> there is a row for each fix
+//    between the dates with the great circle distance from the previous
+//    fix, the distance drifted since the first fix, the drift speed,
+//    heading and hours since the previous fix.  With <minutes> each track
+//    is resampled to fixes that many minutes apart, interpolated between
+//    the fixes either side, with the speed, heading and hours between
+//    those fixes.  -j sets the number of threads used.
+//
+// -T Print the event traces in the .bin chunk files as timelines.  An
+//    icedrifter sends its most recent events in a chunk of record type TR
+//    after a reset or a failed send.  Trace chunks found by -c, -b or -d
+//    are written as timelines to <Rockblock id>-<yyyymmddhhmmss>.trc.
+//
+// -x Only used with -c, -b, -e or -d.  Must be specified before that option.
+//    Appends each decoded record to <export file> as a CSV row or an NDJSON
+//    line instead of writing the .txt and .dat files, which are still
+//    written if -m is also given.  The columns are named as in the store.
+//    Times are UTC in yyyy-mm-ddThh:mm:ssZ form.  Exporting a whole archive
+//    with -b is the fast way to get it into analysis tools.
+//
+// -u Only used with -c, -b, -e or -d.  Must be specified before that option.
+//    Keeps a summary of each Rockblock in <summary file> up to date as its
+//    reports are decoded: the report count and gaps, the latest fix, the
+//    distance drifted, the drift speed and heading between the last two
+//    fixes and the min, max and mean of each temperature and the pressure.
+//    A report not sent after the latest one summarized is not added again.
+//
+// -U Print the summary in <summary file> as CSV, one row per Rockblock.
+//    Only the summary file is read, so it is fast for any size of archive.
+//
 // -f Read in the specified file expecting it to be a .dat type
 //    icedrifterData structured file and print it's data in a human
 //    readable format to the console.
 //
-// -m Only used with -c.  Must be specified before the -c option.
-//    Indicates that an email should be created and sent to <email address>
-//    which contains the console output and attached .dat and .txt files.
+// -m Only used with -c, -b, -e or -d.  Must be specified before that option.
+//    Indicates that the decoded reports should be emailed to each of the
+//    email addresses which follow the -m.  The reports are sent as digests
+//    with the console output of each report in the body and the .dat and
+//    .txt files of each report attached.  A digest is sent when its oldest
+//    report has waited for the -w window, when it holds 200 reports, or
+//    when idecode is done.
+//
+// -n Only used with -m.  Must be specified before -c, -b, -e or -d.
+//    Where the digests are sent.  "|command" pipes each digest to a
+//    sendmail compatible command, anything else is a maildir directory the
+//    digests are written to.  The default is "|/usr/sbin/sendmail -t -i".
+//
+// -w Only used with -m.  Must be specified before -c, -b, -e or -d.
+//    The number of seconds a report may wait for more reports to share its
+//    digest.  The default is five minutes.
 //
-// For the -c option, if more than one file is specified, these files
-// should be a set of chunks from a single icedrifter report.  The
-// Rockblock id number and sent times should all match.
+// For the -c, -b, -e and -d options, the chunks of a report may arrive in
+// any order.  A second copy of a chunk is ignored, as is a chunk that does
+// not fit the record its chunk 0 describes and a chunk of a report that
+// has already been decoded.  A count of each is printed at the end.
+// Reports from v6.5 and v6.6 icedrifters may be mixed in any of them.
+// A heartbeat, the short report of record type HB sent between full
+// reports, is decoded as a report with no last boot time, temperature or
+// chain data.  A report sent compressed is expanded once its chunks are
+// in.  If a chunk is missing, the report is expanded up to that chunk.
 //
 //*****************************************************************************
 
 void printHelp(void) {
   printf("Help for idecode.\n\n");
-  printf("idecode [-m <one to five email addresses>] -c <file name list>\n");
+  printf("idecode [-m <email address list>] -c <file name list>\n");
+  printf("idecode [-m <email address list>] [-j <threads>] -b <directory or file name list>\n");
+  printf("idecode -s <store directory> [-m ...] [-j ...] -c, -b, -e or -d ...\n");
+  printf("idecode -S <store directory> <Rockblock id> <column> <start date> <end date>\n");
+  printf("idecode [-m <email address list>] -e <mbox file or maildir directory list>\n");
+  printf("idecode [-m <email address list>] [-t <minutes>] -d <spool directory>\n");
+  printf("idecode -M <megabytes> [-s ...] [-m ...] [-j ...] -b, -e or -d ...\n");
+  printf("idecode -i <index directory> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...\n");
+  printf("idecode [-n <maildir directory or \"|command\">] [-w <seconds>] -m ...\n");
+  printf("idecode -x <csv | ndjson> <export file> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...\n");
+  printf("idecode -u <summary file> [-s ...] [-m ...] [-j ...] -c, -b, -e or -d ...\n");
+  printf("idecode -U <summary file>\n");
+  printf("idecode -q <index directory> bbox <min lat> <min lon> <max lat> <max lon> <start date> <end date> [csv | geojson]\n");
+  printf("idecode -q <index directory> latest [csv | geojson]\n");
+  printf("idecode [-j <threads>] -D <store directory> <start date> <end date> [<minutes>]\n");
+  printf("idecode -T <trace chunk file list>\n");
   printf("idecode -f <path and file name of a .dat file>\n");
   printf("idecode <character data from email(s) as a single string>\n\n");
-  printf("-c Read one to three .bin chunk files, decode the data, display\n");
+  printf("-c Read .bin chunk files in any order, decode the data, display\n");
   printf("   human readable data on the console, write the human\n");
   printf("   readable data to a file with the file name of\n");
   printf("   <Rockblock id>-<yyyymmddhhmmss>.txt, and write the accumulated data\n");
   printf("   as an icedrifterData structured file with a file name of\n");
   printf("   <Rockblock id>-<yyyymmddhhmmss>.dat.  The file names should\n");
   printf("   not contain a path.\n\n");
+  printf("-b Batch mode.  Read every .bin chunk file in the directories and\n");
+  printf("   every chunk file named, group the chunks by Rockblock id and sent\n");
+  printf("   time, and process each complete report the same way as -c.\n");
+  printf("   Reports with missing chunks are listed but do not stop the batch.\n\n");
+  printf("-e Mailbox mode.  Read the RockBLOCK or Iridium delivery emails in mbox\n");
+  printf("   files and maildir directories, take the chunks from their .sbd\n");
+  printf("   attachments or hex data lines, and process each complete report the\n");
+  printf("   same way as -c.  The mailboxes are read a line at a time, so they may\n");
+  printf("   be any size.\n\n");
+  printf("-d Daemon mode.  Watch <spool directory> and process each report the\n");
+  printf("   same way as -c as soon as all of its chunk files have landed there.\n");
+  printf("   Chunk files are moved to the done or bad directory in the spool once\n");
+  printf("   they are read.  Reports still waiting for chunks are kept in a journal\n");
+  printf("   in the spool so they survive a restart.  Runs until it is stopped\n");
+  printf("   with SIGINT or SIGTERM.\n\n");
+  printf("-t Only used with -d.  Must be specified before the -d option.  The\n");
+  printf("   number of minutes a report may wait for its next chunk before it is\n");
+  printf("   listed as incomplete and dropped.  The default is one day.\n\n");
+  printf("-M Only used with -b, -e or -d.  Must be specified before that option.\n");
+  printf("   The most megabytes of chunks held for reports still waiting for chunks.\n");
+  printf("   When it is reached, the report that has waited longest for its next\n");
+  printf("   chunk is listed as incomplete and dropped.  The default, 0, is no\n");
+  printf("   limit.\n\n");
+  printf("-j Only used with -b or -D.  Must be specified before that option.\n");
+  printf("   Sets the number of threads used to read, reassemble and decode the\n");
+  printf("   chunks, or to analyze the tracks.  The default is one thread per core.\n");
+  printf("   The output is the same for any number of threads.\n\n");
+  printf("-s Only used with -c, -b, -e or -d.  Must be specified before that option.\n");
+  printf("   Adds each decoded record to the columnar store in <store directory>\n");
+  printf("   instead of writing the .txt and .dat files, which are still written if\n");
+  printf("   -m is also given.  Each Rockblock has a directory in the store with one\n");
+  printf("   compressed column for the time, lat, lon, pressure, temperature,\n");
+  printf("   remotetemp and each chain sensor (chaintemp000, chainlight00c, ...).\n\n");
+  printf("-S Print the values of one column of one Rockblock from the store as CSV.\n");
+  printf("   Dates are yyyymmdd or yyyymmddhhmmss UTC.  Only the blocks of that\n");
+  printf("   column that cover the dates are read.\n\n");
+  printf("-i Only used with -c, -b, -e or -d.  Must be specified before that option.\n");
+  printf("   Adds the GPS position of each decoded record to the position index in\n");
+  printf("   <index directory>.  The index is split by month and by geohash cell so\n");
+  printf("   a query only reads the part of the index it needs.\n\n");
+  printf("-q Query the position index.  bbox prints every position inside the box\n");
+  printf("   between the dates, sorted by Rockblock id and time.  A box with a min\n");
+  printf("   lon greater than its max lon crosses the antimeridian.  latest prints\n");
+  printf("   the latest position of each Rockblock.  The output is CSV unless\n");
+  printf("   geojson is given.\n\n");
+  printf("-D Print the drift of every Rockblock in the store as CSV, sorted by\n");
+  printf("   Rockblock id and time.  Without <minutes> there is a row for each fix\n");
+  printf("   between the dates with the great circle distance from the previous\n");
+  printf("   fix, the distance drifted since the first fix, the drift speed,\n");
+  printf("   heading and hours since the previous fix.  With <minutes> each track\n");
+  printf("   is resampled to fixes that many minutes apart, interpolated between\n");
+  printf("   the fixes either side, with the speed, heading and hours between\n");
+  printf("   those fixes.  -j sets the number of threads used.\n\n");
+  printf("-T Print the event traces in the .bin chunk files as timelines.  An\n");
+  printf("   icedrifter sends its most recent events in a chunk of record type TR\n");
+  printf("   after a reset or a failed send.  Trace chunks found by -c, -b or -d\n");
+  printf("   are written as timelines to <Rockblock id>-<yyyymmddhhmmss>.trc.\n\n");
+  printf("-x Only used with -c, -b, -e or -d.  Must be specified before that option.\n");
+  printf("   Appends each decoded record to <export file> as a CSV row or an NDJSON\n");
+  printf("   line instead of writing the .txt and .dat files, which are still\n");
+  printf("   written if -m is also given.  The columns are named as in the store.\n");
+  printf("   Times are UTC in yyyy-mm-ddThh:mm:ssZ form.  Exporting a whole archive\n");
+  printf("   with -b is the fast way to get it into analysis tools.\n\n");
+  printf("-u Only used with -c, -b, -e or -d.  Must be specified before that option.\n");
+  printf("   Keeps a summary of each Rockblock in <summary file> up to date as its\n");
+  printf("   reports are decoded: the report count and gaps, the latest fix, the\n");
+  printf("   distance drifted, the drift speed and heading between the last two\n");
+  printf("   fixes and the min, max and mean of each temperature and the pressure.\n");
+  printf("   A report not sent after the latest one summarized is not added again.\n\n");
+  printf("-U Print the summary in <summary file> as CSV, one row per Rockblock.\n");
+  printf("   Only the summary file is read, so it is fast for any size of archive.\n\n");
   printf("-f Read in the specified file expecting it to be a .dat type\n");
   printf("   icedrifterData structured file and print it's data in a human\n");
   printf("   readable format to the console.\n\n");
-  printf("-m Only used with -c.  Must be specified before the -c option.\n");
-  printf("   Indicates that an email should be created and sent to at least one\n");
-  printf("   but not more than five email addresses which follow the -m separated\n");
-  printf("   by at least one space.  The email contains the console output in the body\n");
-  printf("   of the message and has the .dat and .txt files as attachments.\n\n");
-  printf("For the -c option, if more than one file is specified, these files\n");
-  printf("should be a set of chunks from a single icedrifter report.  The\n");
-  printf("Rockblock id number and sent times should all match.\n");
+  printf("-m Only used with -c, -b, -e or -d.  Must be specified before that option.\n");
+  printf("   Indicates that the decoded reports should be emailed to each of the\n");
+  printf("   email addresses which follow the -m separated by at least one space.\n");
+  printf("   The reports are sent as digests with the console output of each report\n");
+  printf("   in the body and the .dat and .txt files of each report attached.  A\n");
+  printf("   digest is sent when its oldest report has waited for the -w window,\n");
+  printf("   when it holds 200 reports, or when idecode is done.\n\n");
+  printf("-n Only used with -m.  Must be specified before -c, -b, -e or -d.\n");
+  printf("   Where the digests are sent.  \"|command\" pipes each digest to a\n");
+  printf("   sendmail compatible command, anything else is a maildir directory the\n");
+  printf("   digests are written to.  The default is \"|/usr/sbin/sendmail -t -i\".\n\n");
+  printf("-w Only used with -m.  Must be specified before -c, -b, -e or -d.\n");
+  printf("   The number of seconds a report may wait for more reports to share its\n");
+  printf("   digest.  The default is five minutes.\n\n");
+  printf("For the -c, -b, -e and -d options, the chunks of a report may arrive in\n");
+  printf("any order.  A second copy of a chunk is ignored, as is a chunk that does\n");
+  printf("not fit the record its chunk 0 describes and a chunk of a report that\n");
+  printf("has already been decoded.  A count of each is printed at the end.\n");
+  printf("Reports from v6.5 and v6.6 icedrifters may be mixed in any of them.\n");
+  printf("A heartbeat, the short report of record type HB sent between full\n");
+  printf("reports, is decoded as a report with no last boot time, temperature or\n");
+  printf("chain data.  A report sent compressed is expanded once its chunks are\n");
+  printf("in.  If a chunk is missing, the report is expanded up to that chunk.\n");
 }
@@ -0,0 +1,77 @@
+//*****************************************************************************
+// idecode.h
+//
+// Definitions shared by the parts of the icedrifter decoder.
+//
+//*****************************************************************************
+
+#ifndef _IDECODE_H
+#define _IDECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../icedrifter_v6.5/icedrifter.h"
+#include "../icedrifter_v6.5/rockblock.h"
+#include "../icedrifter_v6.5/trace.h"
+#include "../icedrifter_v6.5/lzss.h"
+
+#define BUFF_SIZE 2048  // size of the buffer used to decode character data.
+#define FILE_NAME_SIZE  1024  // size of buffers used for file names.
+#define GPS_TIME_SIZE 16  // size of the buffer used to decode gps time and date.
+#define ROCKBLOCK_ID_SIZE 64  // size of the buffer used to hold a Rockblock id.
+#define DECODE_MESSAGE_SIZE 256  // size of the console message held for a record.
+
+// number of seconds in the 30 years betweem 01/01/1970 and 01/01/2000.
+// Used during the conversion of arduino's time_t and linux's time_t.
+#define SECONDS_IN_30_YEARS (time_t)946684800
+#define EARTH_RADIUS_KM 6371.0  // mean radius used for great circle distances.
+
+extern bool mailResultsSwitch;
+extern char** emailAddress;
+extern int emailCount;
+extern char* notifyDelivery;
+extern int notifyWindow;
+extern int decodeThreads;
+extern char* storeDirectory;
+extern char* indexDirectory;
+extern char* exportFileName;
+extern int exportFormat;
+extern char* summaryFileName;
+extern int daemonTimeout;
+extern size_t reassembleMemory;
+
+// Everything needed to finish one record.  The decoder core only works on
+// the context it is handed, so records can be decoded on several threads
+// at once.
+typedef struct decodeContext {
+  icedrifterData dcData;  // the reassembled record.
+  uint32_t dcSendTime;    // send time from the chunk headers.
+  char dcRockblockId[ROCKBLOCK_ID_SIZE];
+  char dcDatName[FILE_NAME_SIZE];
+  char dcTxtName[FILE_NAME_SIZE];
+  char dcMessage[DECODE_MESSAGE_SIZE];  // console output held until the record is reported.
+  int dcResult;           // 0 if the record was finished without errors.
+} decodeContext;
+
+int getDataByBatch(char**, int);
+int getDataByMail(char**, int);
+int getDataByDaemon(char* spool);
+bool getRockblockId(char* path, char* rbId);
+int getRecordLength(uint8_t* recPtr);
+int getSentLength(uint8_t* recPtr, bool compressed);
+int lzssDecode(uint8_t* in, int inLength, uint8_t* out, int outSize);
+int finishRecord(decodeContext* ctx);
+int mailRecord(decodeContext* ctx);
+int processRecord(decodeContext* ctx);
+int saveData(icedrifterData* idPtr, char* fileName);
+int decodeData(icedrifterData* idPtr, char* fileName);
+char convertCharToHex(char);
+void convertBigEndianToLittleEndian(char* sPtr, int size);
+float convertTempToC(short temp);
+int chainTempCount(icedrifterData* idPtr);
+int chainLightCount(icedrifterData* idPtr);
+
+#endif // _IDECODE_H
@@ -0,0 +1,381 @@
+//*****************************************************************************
+// layout.c
+//
+// Record layouts for idecode.
+//
+// Each hardware version of the icedrifter has its own record layout, which
+// is described by an entry in the layout table instead of by the
+// icedrifterData structure the decoder was compiled with.  The layout of a
+// record is picked at run time from the top bits of its switches byte, so
+// one decoder handles records from every version, mixed in any order.
+//
+// A record is read through a view, which reads each field straight out of
+// the received bytes, so the header of chunk 0 can be looked at before the
+// rest of the record has arrived.  viewDecode turns a whole record into the
+// icedrifterData structure the rest of the decoder works on.
+//
+// The layout of the current RECORD_LAYOUT, and the code that reads its
+// header, are built from RECORD_HEADER_FIELDS in icedrifter.h, so they
+// always match the record the icedrifter sends.  To add a hardware version,
+// write out the generated layout of the old version as a fixed entry in the
+// table, then give the new version the next RECORD_LAYOUT value in the
+// icedrifter.
+//
+// A heartbeat is turned into a record of the current layout, so the rest
+// of the decoder only ever sees records.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "idecode.h"
+#include "layout.h"
+
+RECORD_ASSERT(RECORD_HEADER_FIELD_COUNT == FIELD_COUNT, "a header field has no FIELD_ id");
+
+#define LAYOUT_FIELD(name, type, storage, id) {FIELD_##storage, offsetof(icedrifterData, name)},
+
+// The fields a fixed entry does not list are FIELD_ABSENT.
+static const recordLayout layoutTable[] = {
+  // v6.5 has spare bytes where v6.6 has the sensor counts.  Like every
+  // version, it sends the light data right after the temperature bytes it
+  // received.
+  {0, "6.5", 36,
+   {{FIELD_U8, 0}, {FIELD_U8, 1}, {FIELD_U16, 2}, {FIELD_U16, 4}, {FIELD_ABSENT, 6}, {FIELD_ABSENT, 7},
+    {FIELD_U32, 8}, {FIELD_U32, 12}, {FIELD_FLOAT, 16}, {FIELD_FLOAT, 20}, {FIELD_FLOAT, 24},
+    {FIELD_FLOAT, 28}, {FIELD_FLOAT, 32}, {FIELD_ABSENT, 0}, {FIELD_ABSENT, 0}, {FIELD_ABSENT, 0}}},
+
+  // v6.6 sends only the chain sensors it has.
+  {1, "6.6", 36,
+   {{FIELD_U8, 0}, {FIELD_U8, 1}, {FIELD_U16, 2}, {FIELD_U16, 4}, {FIELD_U8, 6}, {FIELD_U8, 7},
+    {FIELD_U32, 8}, {FIELD_U32, 12}, {FIELD_FLOAT, 16}, {FIELD_FLOAT, 20}, {FIELD_FLOAT, 24},
+    {FIELD_FLOAT, 28}, {FIELD_FLOAT, 32}, {FIELD_ABSENT, 0}, {FIELD_ABSENT, 0}, {FIELD_ABSENT, 0}}},
+
+  // v6.6 added the memory check and boot reason to the end of the header.
+  {2, "6.6", 40,
+   {{FIELD_U8, 0}, {FIELD_U8, 1}, {FIELD_U16, 2}, {FIELD_U16, 4}, {FIELD_U8, 6}, {FIELD_U8, 7},
+    {FIELD_U32, 8}, {FIELD_U32, 12}, {FIELD_FLOAT, 16}, {FIELD_FLOAT, 20}, {FIELD_FLOAT, 24},
+    {FIELD_FLOAT, 28}, {FIELD_FLOAT, 32}, {FIELD_U16, 36}, {FIELD_U8, 38}, {FIELD_U8, 39}}},
+
+  // v6.6 added the statistics of the sensor readings between reports.
+  {3, "6.6", 116,
+   {{FIELD_U8, 0}, {FIELD_U8, 1}, {FIELD_U16, 2}, {FIELD_U16, 4}, {FIELD_U8, 6}, {FIELD_U8, 7},
+    {FIELD_U32, 8}, {FIELD_U32, 12}, {FIELD_FLOAT, 16}, {FIELD_FLOAT, 20}, {FIELD_FLOAT, 24},
+    {FIELD_FLOAT, 28}, {FIELD_FLOAT, 32}, {FIELD_U16, 36}, {FIELD_U8, 38}, {FIELD_U8, 39},
+    {FIELD_U16, 40}, {FIELD_U16, 42},
+    {FIELD_FLOAT, 44}, {FIELD_FLOAT, 48}, {FIELD_FLOAT, 52}, {FIELD_FLOAT, 56}, {FIELD_U32, 60}, {FIELD_U32, 64},
+    {FIELD_FLOAT, 68}, {FIELD_FLOAT, 72}, {FIELD_FLOAT, 76}, {FIELD_FLOAT, 80}, {FIELD_U32, 84}, {FIELD_U32, 88},
+    {FIELD_FLOAT, 92}, {FIELD_FLOAT, 96}, {FIELD_FLOAT, 100}, {FIELD_FLOAT, 104}, {FIELD_U32, 108},
+    {FIELD_U32, 112}}},
+
+  // The current layout adds the spectrum of the pressure burst.
+  {RECORD_LAYOUT, HARDWARE_VERSION, BASE_RECORD_LENGTH,
+   {RECORD_HEADER_FIELDS(LAYOUT_FIELD)}},
+};
+
+#define LAYOUT_COUNT (int)(sizeof(layoutTable) / sizeof(layoutTable[0]))
+
+//*****************************************************************************
+//
+// layoutFind
+//
+// recPtr: the start of a record, at least its first 8 bytes.
+//
+// returns the layout of the record, or NULL if it is from a hardware
+// version this decoder does not know.
+//
+//*****************************************************************************
+
+const recordLayout* layoutFind(uint8_t* recPtr) {
+  int version;
+  int i;
+
+  version = (recPtr[0] & RECORD_LAYOUT_MASK) >> RECORD_LAYOUT_SHIFT;
+
+  // v6.6 icedrifters built before the layout was put in the switches send
+  // layout 0, but with their sensor counts where v6.5 has zeros.
+  if ((version == 0) && ((recPtr[6] != 0) || (recPtr[7] != 0))) {
+    version = 1;
+  }
+
+  for (i = 0; i < LAYOUT_COUNT; ++i) {
+    if (layoutTable[i].rlVersion == version) {
+      return (&layoutTable[i]);
+    }
+  }
+
+  return (NULL);
+}
+
+//*****************************************************************************
+//
+// viewOpen
+//
+// rvPtr: the view to set up.
+//
+// recPtr, length: the record and the number of its bytes that are present.
+//
+// returns false if the record is from an unknown hardware version.
+//
+//*****************************************************************************
+
+bool viewOpen(recordView* rvPtr, uint8_t* recPtr, int length) {
+  if ((length < 8) || ((rvPtr->rvLayout = layoutFind(recPtr)) == NULL)) {
+    return (false);
+  }
+
+  rvPtr->rvData = recPtr;
+  rvPtr->rvLength = length;
+  return (true);
+}
+
+//*****************************************************************************
+//
+// viewUnsigned
+// viewFloat
+//
+// returns the value of a field, or 0 if the layout does not have it or it
+// is past the bytes present.
+//
+//*****************************************************************************
+
+uint32_t viewUnsigned(recordView* rvPtr, int field) {
+  const layoutField* lfPtr;
+  uint8_t* wkPtr;
+
+  lfPtr = &rvPtr->rvLayout->rlFields[field];
+  wkPtr = rvPtr->rvData + lfPtr->lfOffset;
+
+  switch (lfPtr->lfType) {
+    case FIELD_U8:
+      return ((lfPtr->lfOffset + 1 <= rvPtr->rvLength) ? wkPtr[0] : 0);
+
+    case FIELD_U16:
+      return ((lfPtr->lfOffset + 2 <= rvPtr->rvLength) ? wkPtr[0] | (wkPtr[1] << 8) : 0);
+
+    case FIELD_U32:
+    case FIELD_FLOAT:
+      if (lfPtr->lfOffset + 4 > rvPtr->rvLength) {
+        return (0);
+      }
+
+      return (wkPtr[0] | (wkPtr[1] << 8) | (wkPtr[2] << 16) | ((uint32_t)wkPtr[3] << 24));
+  }
+
+  return (0);
+}
+
+float viewFloat(recordView* rvPtr, int field) {
+  uint32_t bits;
+  float value;
+
+  bits = viewUnsigned(rvPtr, field);
+  memcpy(&value, &bits, sizeof(value));
+  return (value);
+}
+
+//*****************************************************************************
+//
+// viewRecordLength
+//
+// returns the number of bytes the icedrifter sent for the record, worked
+// out from the switches and chain byte counts in its header.
+//
+//*****************************************************************************
+
+int viewRecordLength(recordView* rvPtr) {
+  int len;
+
+  len = rvPtr->rvLayout->rlHeaderLength;
+
+  if (viewUnsigned(rvPtr, FIELD_SWITCHES) & PROCESS_CHAIN_DATA_SWITCH) {
+    len += viewUnsigned(rvPtr, FIELD_TEMP_BYTES) + viewUnsigned(rvPtr, FIELD_LIGHT_BYTES);
+  }
+
+  return (len);
+}
+
+// Copies up to length bytes of the record from offset, as far as the bytes
+// present go.
+static void viewCopy(recordView* rvPtr, void* toPtr, int offset, int length) {
+  if (offset + length > rvPtr->rvLength) {
+    length = rvPtr->rvLength - offset;
+  }
+
+  if (length > 0) {
+    memcpy(toPtr, rvPtr->rvData + offset, length);
+  }
+}
+
+//*****************************************************************************
+//
+// viewDecode
+//
+// idPtr: receives the record.
+//
+// Fills in an icedrifterData structure from the record.  The chain data is
+// put in the cdTempData and cdLightData arrays and converted from the big
+// endian format the chain sends.  Anything the record does not have is
+// left as zeros.
+//
+//*****************************************************************************
+
+#define VIEW_U8    viewUnsigned
+#define VIEW_U16   viewUnsigned
+#define VIEW_U32   viewUnsigned
+#define VIEW_FLOAT viewFloat
+#define VIEW_FIELD(name, type, storage, id) idPtr->name = VIEW_##storage(rvPtr, FIELD_##id);
+
+void viewDecode(recordView* rvPtr, icedrifterData* idPtr) {
+  int tempBytes;
+  int lightBytes;
+
+  memset(idPtr, 0, sizeof(icedrifterData));
+  RECORD_HEADER_FIELDS(VIEW_FIELD)
+
+  if (!(idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH)) {
+    return;
+  }
+
+  tempBytes = idPtr->idTempByteCount;
+  lightBytes = idPtr->idLightByteCount;
+
+  viewCopy(rvPtr, idPtr->idChainData.cdTempData, rvPtr->rvLayout->rlHeaderLength,
+           (tempBytes > (int)TEMP_DATA_SIZE) ? (int)TEMP_DATA_SIZE : tempBytes);
+  viewCopy(rvPtr, idPtr->idChainData.cdLightData, rvPtr->rvLayout->rlHeaderLength + tempBytes,
+           (lightBytes > (int)LIGHT_DATA_SIZE) ? (int)LIGHT_DATA_SIZE : lightBytes);
+
+  // The temperature and light probes return their data in big endien format
+  // so we need to convert that data to little endien.
+  convertBigEndianToLittleEndian((char*)&idPtr->idChainData, sizeof(idPtr->idChainData));
+}
+
+//*****************************************************************************
+//
+// layoutDecodeSaved
+//
+// datPtr, length: the contents of a .dat file.
+//
+// idPtr: receives the record.
+//
+// A .dat file holds the icedrifterData structure of the decoder that wrote
+// it.  That is the header of the decoder's own layout, then the whole chain
+// data, already little endian.  The switches give the layout of the record
+// that was decoded, not of the decoder, so the layout is picked by the
+// length of the file.  The newest layout with a header that long is used.
+//
+// returns false if no layout has a header that fits the file.
+//
+//*****************************************************************************
+
+bool layoutDecodeSaved(uint8_t* datPtr, int length, icedrifterData* idPtr) {
+  recordView view;
+  recordView* rvPtr;
+  int i;
+
+  for (i = LAYOUT_COUNT - 1; (i >= 0) && (layoutTable[i].rlHeaderLength + (int)sizeof(chainData) != length); --i) {
+  }
+
+  if (i < 0) {
+    return (false);
+  }
+
+  rvPtr = &view;
+  rvPtr->rvLayout = &layoutTable[i];
+  rvPtr->rvData = datPtr;
+  rvPtr->rvLength = length;
+
+  memset(idPtr, 0, sizeof(icedrifterData));
+  RECORD_HEADER_FIELDS(VIEW_FIELD)
+  memcpy(&idPtr->idChainData, datPtr + rvPtr->rvLayout->rlHeaderLength, sizeof(chainData));
+  return (true);
+}
+
+//*****************************************************************************
+//
+// layoutHeartbeat
+//
+// idcPtr, length: a chunk and the number of its data bytes.
+//
+// If the chunk is a heartbeat it is rewritten in place as chunk 0 of a
+// record in the current layout with no chain data.  The record has
+// HEARTBEAT_SWITCH set and no last boot time or temperature, which a
+// heartbeat does not carry.
+//
+// returns the number of data bytes of the rewritten chunk, 0 if the chunk
+// is a heartbeat that is too short, or length if it is not a heartbeat.
+//
+//*****************************************************************************
+
+static void layoutPut(uint8_t* recPtr, int field, uint32_t value) {
+  const layoutField* lfPtr;
+  int i;
+
+  lfPtr = &layoutTable[LAYOUT_COUNT - 1].rlFields[field];
+
+  for (i = 0; i < ((lfPtr->lfType == FIELD_U8) ? 1 : (lfPtr->lfType == FIELD_U16) ? 2 : 4); ++i) {
+    recPtr[lfPtr->lfOffset + i] = (value >> (i * 8)) & 0xFF;
+  }
+}
+
+static void layoutPutFloat(uint8_t* recPtr, int field, float value) {
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  layoutPut(recPtr, field, bits);
+}
+
+// Reads a little endian field of the heartbeat.
+static uint32_t heartbeatField(uint8_t* hbPtr, size_t offset, int size) {
+  uint32_t value;
+
+  value = 0;
+
+  while (size-- > 0) {
+    value = (value << 8) | hbPtr[offset + size];
+  }
+
+  return (value);
+}
+
+int layoutHeartbeat(iceDrifterChunk* idcPtr, int length) {
+  uint8_t* recPtr;
+  int32_t latitude;
+  int32_t longitude;
+  uint16_t pressure;
+  int16_t remoteTemp;
+  uint8_t switches;
+
+  if ((idcPtr->idcRecordType[0] != HEARTBEAT_RECORD_TYPE_0) ||
+      (idcPtr->idcRecordType[1] != HEARTBEAT_RECORD_TYPE_1)) {
+    return (length);
+  }
+
+  if (length < HEARTBEAT_LENGTH) {
+    return (0);
+  }
+
+  // The record is built in the same buffer, so read the heartbeat first.
+  recPtr = idcPtr->idcBuffer;
+  latitude = heartbeatField(recPtr, offsetof(heartbeatData, hbLatitude), 4);
+  longitude = heartbeatField(recPtr, offsetof(heartbeatData, hbLongitude), 4);
+  pressure = heartbeatField(recPtr, offsetof(heartbeatData, hbPressure), 2);
+  remoteTemp = heartbeatField(recPtr, offsetof(heartbeatData, hbRemoteTemp), 2);
+  switches = recPtr[offsetof(heartbeatData, hbSwitches)] & PROCESS_REMOTE_TEMP_SWITCH;
+
+  memset(recPtr, 0, BASE_RECORD_LENGTH);
+  layoutPut(recPtr, FIELD_SWITCHES, (RECORD_LAYOUT << RECORD_LAYOUT_SHIFT) | HEARTBEAT_SWITCH | switches);
+  layoutPut(recPtr, FIELD_GPS_TIME, idcPtr->idcSendTime);
+  layoutPutFloat(recPtr, FIELD_LATITUDE, latitude / 1000000.0);
+  layoutPutFloat(recPtr, FIELD_LONGITUDE, longitude / 1000000.0);
+  layoutPutFloat(recPtr, FIELD_PRESSURE, pressure / 10.0);
+  layoutPutFloat(recPtr, FIELD_REMOTE_TEMP, remoteTemp / 100.0);
+
+  idcPtr->idcRecordType[0] = 'I';
+  idcPtr->idcRecordType[1] = 'D';
+  idcPtr->idcRecordNumber = 0;
+  return (BASE_RECORD_LENGTH);
+}
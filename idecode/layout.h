@@ -0,0 +1,58 @@
+//*****************************************************************************
+// layout.h
+//
+// Field layouts of the records sent by each icedrifter hardware version and
+// views that read a received record through them.
+//
+//*****************************************************************************
+
+#ifndef _LAYOUT_H
+#define _LAYOUT_H
+
+#include "idecode.h"
+
+// The header fields of a record, numbered from FIELD_SWITCHES in the order
+// of RECORD_HEADER_FIELDS in icedrifter.h.
+#define LAYOUT_FIELD_ID(name, type, storage, id) FIELD_##id,
+
+enum {
+  RECORD_HEADER_FIELDS(LAYOUT_FIELD_ID)
+  FIELD_COUNT
+};
+
+// How a field is stored.  All fields are little endian.
+#define FIELD_ABSENT 0  // the layout does not have the field, it reads as 0.
+#define FIELD_U8     1
+#define FIELD_U16    2
+#define FIELD_U32    3
+#define FIELD_FLOAT  4
+
+typedef struct layoutField {
+  uint8_t lfType;    // FIELD_xxx storage.
+  uint8_t lfOffset;  // bytes from the start of the record.
+} layoutField;
+
+typedef struct recordLayout {
+  int rlVersion;         // RECORD_LAYOUT value in the switches.
+  char* rlHardware;      // hardware version that sends it.
+  int rlHeaderLength;    // bytes before the chain data.
+  layoutField rlFields[FIELD_COUNT];
+} recordLayout;
+
+// A received record seen through its layout.  The record is not copied.
+typedef struct recordView {
+  const recordLayout* rvLayout;
+  uint8_t* rvData;
+  int rvLength;  // bytes of the record that are present.
+} recordView;
+
+const recordLayout* layoutFind(uint8_t* recPtr);
+bool viewOpen(recordView* rvPtr, uint8_t* recPtr, int length);
+uint32_t viewUnsigned(recordView* rvPtr, int field);
+float viewFloat(recordView* rvPtr, int field);
+int viewRecordLength(recordView* rvPtr);
+void viewDecode(recordView* rvPtr, icedrifterData* idPtr);
+bool layoutDecodeSaved(uint8_t* datPtr, int length, icedrifterData* idPtr);
+int layoutHeartbeat(iceDrifterChunk* idcPtr, int length);
+
+#endif // _LAYOUT_H
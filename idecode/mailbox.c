@@ -0,0 +1,759 @@
+//*****************************************************************************
+// mailbox.c
+//
+// Mailbox mode for idecode.
+//
+// Reads RockBLOCK and Iridium delivery emails straight from mbox files and
+// maildir directories.  Each mailbox is read one line at a time and each
+// message is taken apart as it goes by:
+//
+//   headers      The Rockblock ID is taken from the attachment name
+//                (<IMEI>_<MOMSN>.sbd), an "IMEI:" body line or the
+//                "Unit: <IMEI>" in the subject.
+//   attachments  base64 attachments are decoded a line at a time into a
+//                buffer the size of one chunk.
+//   text         A body line holding only hex, optionally after "Data:", is
+//                taken as a chunk.
+//
+// Chunks are filed in a chunk set table as soon as their message ends and
+// every record that becomes complete is finished, a group at a time, the
+// same way as in batch mode.  Only the incomplete chunk sets and one group
+// of records are ever held, so mailboxes of any size can be read.
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE  // strcasestr
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "idecode.h"
+#include "reassemble.h"
+#include "store.h"
+#include "geoindex.h"
+#include "export.h"
+#include "summary.h"
+#include "convert.h"
+#include "layout.h"
+
+#define MAIL_LINE_SIZE 4096        // longest mailbox line looked at.
+#define MAIL_CHUNKS_PER_MESSAGE 8  // most chunks taken from one message.
+#define MAIL_BOUNDARY_COUNT 4      // deepest nesting of multipart parts.
+#define MAIL_BOUNDARY_SIZE 128
+#define MAIL_NAME_SIZE 256
+#define MAIL_FLUSH_RECORDS 256     // records finished as one group.
+
+#define PART_SKIP    0  // multipart preamble and epilogue, other attachments.
+#define PART_TEXT    1
+#define PART_BASE64  2
+
+// One chunk found in a message.
+typedef struct mailChunk {
+  iceDrifterChunk mcChunk;
+  int mcLength;  // bytes of chunk data.
+} mailChunk;
+
+// What is known about the message being read.
+typedef struct mailMessage {
+  long mmNumber;
+  char mmRockblockId[ROCKBLOCK_ID_SIZE];  // from the attachment name or body.
+  char mmSubjectId[ROCKBLOCK_ID_SIZE];    // from the subject.
+  char mmMomsn[16];
+  mailChunk mmChunks[MAIL_CHUNKS_PER_MESSAGE];
+  int mmChunkCount;
+  bool mmBadData;
+  char mmBoundary[MAIL_BOUNDARY_COUNT][MAIL_BOUNDARY_SIZE];
+  int mmBoundaryCount;
+
+  // The part being read.
+  bool mmInHeaders;
+  bool mmTopLevel;  // headers of the message itself, not of a part.
+  char mmHeader[MAIL_LINE_SIZE];  // header being unfolded.
+  bool mmMultipart;
+  bool mmBase64;
+  char mmPartName[MAIL_NAME_SIZE];
+  int mmPartType;
+  uint8_t mmPartData[sizeof(iceDrifterChunk) + 1];
+  int mmPartLength;
+  uint32_t mmBits;  // base64 bits not yet stored.
+  int mmBitCount;
+} mailMessage;
+
+typedef struct mailIngest {
+  reassembler miReassembler;
+  decodeContext* miRecords[MAIL_FLUSH_RECORDS];
+  int miRecordCount;
+  long miMessages;
+  long miChunks;
+  long miSkipped;
+  int miDecoded;
+  int miErrors;
+} mailIngest;
+
+static void partReset(mailMessage* mmPtr) {
+  mmPtr->mmInHeaders = true;
+  mmPtr->mmHeader[0] = 0;
+  mmPtr->mmMultipart = false;
+  mmPtr->mmBase64 = false;
+  mmPtr->mmPartName[0] = 0;
+  mmPtr->mmPartType = PART_SKIP;
+  mmPtr->mmPartLength = 0;
+  mmPtr->mmBits = 0;
+  mmPtr->mmBitCount = 0;
+}
+
+static void messageReset(mailMessage* mmPtr, long number) {
+  mmPtr->mmNumber = number;
+  mmPtr->mmRockblockId[0] = 0;
+  mmPtr->mmSubjectId[0] = 0;
+  mmPtr->mmMomsn[0] = 0;
+  mmPtr->mmChunkCount = 0;
+  mmPtr->mmBadData = false;
+  mmPtr->mmBoundaryCount = 0;
+  mmPtr->mmTopLevel = true;
+  partReset(mmPtr);
+}
+
+//*****************************************************************************
+//
+// headerParameter
+//
+// Copies the value of a parameter such as boundary= or filename= from a
+// header into value, without any quotes.
+//
+// returns true if the parameter was found.
+//
+//*****************************************************************************
+
+static bool headerParameter(char* header, char* name, char* value, int size) {
+  char* wkPtr;
+  int len;
+  int nameLen;
+
+  nameLen = strlen(name);
+
+  for (wkPtr = header; (wkPtr = strcasestr(wkPtr, name)) != NULL; wkPtr += nameLen) {
+    // The name must start a parameter, not end some longer name.
+    if ((wkPtr != header) && (wkPtr[-1] != ';') && !isspace((unsigned char)wkPtr[-1])) {
+      continue;
+    }
+
+    wkPtr += nameLen;
+
+    if (*wkPtr == '"') {
+      ++wkPtr;
+      len = strcspn(wkPtr, "\"");
+    } else {
+      len = strcspn(wkPtr, "; \t");
+    }
+
+    if (len >= size) {
+      len = size - 1;
+    }
+
+    memcpy(value, wkPtr, len);
+    value[len] = 0;
+    return (true);
+  }
+
+  return (false);
+}
+
+//*****************************************************************************
+//
+// digitsAfter
+//
+// Copies the run of digits following tag in line into value.
+//
+// returns true if there was one.
+//
+//*****************************************************************************
+
+static bool digitsAfter(char* line, char* tag, char* value, int size) {
+  char* wkPtr;
+  int len;
+
+  if ((wkPtr = strcasestr(line, tag)) == NULL) {
+    return (false);
+  }
+
+  for (wkPtr += strlen(tag); (*wkPtr == ' ') || (*wkPtr == '\t'); ++wkPtr) {
+  }
+
+  if ((len = strspn(wkPtr, "0123456789")) == 0 || (len >= size)) {
+    return (false);
+  }
+
+  memcpy(value, wkPtr, len);
+  value[len] = 0;
+  return (true);
+}
+
+static void headerDone(mailMessage* mmPtr) {
+  char* hdr = mmPtr->mmHeader;
+
+  if (hdr[0] == 0) {
+    return;
+  }
+
+  if (strncasecmp(hdr, "Subject:", 8) == 0) {
+    if (mmPtr->mmTopLevel) {
+      digitsAfter(hdr, "Unit:", mmPtr->mmSubjectId, sizeof(mmPtr->mmSubjectId));
+    }
+  } else if (strncasecmp(hdr, "Content-Type:", 13) == 0) {
+    if (strcasestr(hdr, "multipart/") != NULL) {
+      mmPtr->mmMultipart = true;
+
+      if ((mmPtr->mmBoundaryCount < MAIL_BOUNDARY_COUNT) &&
+          headerParameter(hdr, "boundary=", mmPtr->mmBoundary[mmPtr->mmBoundaryCount], MAIL_BOUNDARY_SIZE)) {
+        ++mmPtr->mmBoundaryCount;
+      }
+    }
+
+    if (mmPtr->mmPartName[0] == 0) {
+      headerParameter(hdr, "name=", mmPtr->mmPartName, sizeof(mmPtr->mmPartName));
+    }
+  } else if (strncasecmp(hdr, "Content-Disposition:", 20) == 0) {
+    headerParameter(hdr, "filename=", mmPtr->mmPartName, sizeof(mmPtr->mmPartName));
+  } else if (strncasecmp(hdr, "Content-Transfer-Encoding:", 26) == 0) {
+    mmPtr->mmBase64 = (strcasestr(hdr, "base64") != NULL);
+  }
+
+  hdr[0] = 0;
+}
+
+//*****************************************************************************
+//
+// addChunk
+//
+// Checks data as a chunk and keeps it with the message.
+//
+// returns true if data is a chunk.
+//
+//*****************************************************************************
+
+static bool addChunk(mailMessage* mmPtr, uint8_t* data, int len) {
+  iceDrifterChunk* idcPtr;
+
+  idcPtr = (iceDrifterChunk*)data;
+
+  // A heartbeat is kept as the record it stands for.
+  if ((len > CHUNK_HEADER_SIZE) && (len <= (int)sizeof(iceDrifterChunk))) {
+    len = layoutHeartbeat(idcPtr, len - CHUNK_HEADER_SIZE) + CHUNK_HEADER_SIZE;
+  }
+
+  if ((len <= CHUNK_HEADER_SIZE) || (len > (int)sizeof(iceDrifterChunk)) ||
+      (idcPtr->idcRecordType[0] != 'I') || (idcPtr->idcRecordType[1] != 'D') ||
+      (CHUNK_NUMBER(idcPtr->idcRecordNumber) >= MAX_RECORD_CHUNKS)) {
+    return (false);
+  }
+
+  if (mmPtr->mmChunkCount >= MAIL_CHUNKS_PER_MESSAGE) {
+    mmPtr->mmBadData = true;
+    return (true);
+  }
+
+  memcpy(&mmPtr->mmChunks[mmPtr->mmChunkCount].mcChunk, data, len);
+  mmPtr->mmChunks[mmPtr->mmChunkCount].mcLength = len - CHUNK_HEADER_SIZE;
+  ++mmPtr->mmChunkCount;
+  return (true);
+}
+
+static void partDone(mailMessage* mmPtr) {
+  char rbId[ROCKBLOCK_ID_SIZE];
+  int len;
+
+  if (mmPtr->mmPartType == PART_BASE64) {
+    len = strlen(mmPtr->mmPartName);
+
+    if ((len > 4) && ((strcasecmp(&mmPtr->mmPartName[len - 4], ".sbd") == 0) ||
+                      (strcasecmp(&mmPtr->mmPartName[len - 4], ".bin") == 0))) {
+      // The attachment is named for the Rockblock that sent it.
+      if (getRockblockId(mmPtr->mmPartName, rbId)) {
+        strcpy(mmPtr->mmRockblockId, rbId);
+      }
+
+      if (!addChunk(mmPtr, mmPtr->mmPartData, mmPtr->mmPartLength)) {
+        mmPtr->mmBadData = true;
+      }
+    }
+  }
+
+  partReset(mmPtr);
+  mmPtr->mmTopLevel = false;
+}
+
+//*****************************************************************************
+//
+// base64Line
+//
+// Decodes one line of a base64 part into the part buffer.  Anything past
+// the size of a chunk is counted but not kept.
+//
+//*****************************************************************************
+
+static void base64Line(mailMessage* mmPtr, char* line) {
+  int val;
+
+  for (; *line != 0; ++line) {
+    if ((*line >= 'A') && (*line <= 'Z')) {
+      val = *line - 'A';
+    } else if ((*line >= 'a') && (*line <= 'z')) {
+      val = *line - 'a' + 26;
+    } else if ((*line >= '0') && (*line <= '9')) {
+      val = *line - '0' + 52;
+    } else if (*line == '+') {
+      val = 62;
+    } else if (*line == '/') {
+      val = 63;
+    } else {
+      continue;
+    }
+
+    mmPtr->mmBits = (mmPtr->mmBits << 6) | val;
+    mmPtr->mmBitCount += 6;
+
+    if (mmPtr->mmBitCount >= 8) {
+      mmPtr->mmBitCount -= 8;
+
+      if (mmPtr->mmPartLength < (int)sizeof(mmPtr->mmPartData)) {
+        mmPtr->mmPartData[mmPtr->mmPartLength] = (mmPtr->mmBits >> mmPtr->mmBitCount) & 0xFF;
+      }
+
+      ++mmPtr->mmPartLength;
+    }
+  }
+}
+
+//*****************************************************************************
+//
+// textLine
+//
+// Looks for metadata and hex chunk data in one line of a text part.
+//
+//*****************************************************************************
+
+static void textLine(mailMessage* mmPtr, char* line) {
+  uint8_t data[MAX_CHUNK_LENGTH];
+  char* wkPtr;
+  int len;
+
+  if (digitsAfter(line, "IMEI:", mmPtr->mmRockblockId, sizeof(mmPtr->mmRockblockId)) ||
+      digitsAfter(line, "MOMSN:", mmPtr->mmMomsn, sizeof(mmPtr->mmMomsn))) {
+    return;
+  }
+
+  for (wkPtr = line; isspace((unsigned char)*wkPtr); ++wkPtr) {
+  }
+
+  if (strncasecmp(wkPtr, "Data:", 5) == 0) {
+    for (wkPtr += 5; isspace((unsigned char)*wkPtr); ++wkPtr) {
+    }
+  }
+
+  len = strspn(wkPtr, "0123456789abcdefABCDEF");
+
+  if ((wkPtr[len] != 0) || (len & 1) || (len <= CHUNK_HEADER_SIZE * 2) || (len > MAX_CHUNK_LENGTH * 2)) {
+    return;
+  }
+
+  if (convertHexToBinary(wkPtr, len, data) == len / 2) {
+    addChunk(mmPtr, data, len / 2);
+  }
+}
+
+//*****************************************************************************
+//
+// flushRecords
+//
+// Finishes the records waiting in the ingest the same way as batch mode.
+//
+//*****************************************************************************
+
+static void flushRecords(mailIngest* miPtr) {
+  decodeContext* ctx;
+  int i;
+  int k;
+
+  for (i = k = 0; i < miPtr->miRecordCount; ++i) {
+    ctx = miPtr->miRecords[i];
+    printf("Processing data for Rockblock %s sent %08x.\n", ctx->dcRockblockId, ctx->dcSendTime);
+
+    if ((finishRecord(ctx) != 0) || (mailRecord(ctx) != 0)) {
+      ++miPtr->miErrors;
+      free(ctx);
+    } else {
+      miPtr->miRecords[k++] = ctx;
+    }
+  }
+
+  if ((storeDirectory != NULL) && (storeAppend(storeDirectory, miPtr->miRecords, k) != 0)) {
+    ++miPtr->miErrors;
+  }
+
+  if ((indexDirectory != NULL) && (geoIndexAppend(indexDirectory, miPtr->miRecords, k) != 0)) {
+    ++miPtr->miErrors;
+  }
+
+  if ((exportFileName != NULL) && (exportAppend(miPtr->miRecords, k) != 0)) {
+    ++miPtr->miErrors;
+  }
+
+  if ((summaryFileName != NULL) && (summaryUpdate(miPtr->miRecords, k) != 0)) {
+    ++miPtr->miErrors;
+  }
+
+  for (i = 0; i < k; ++i) {
+    free(miPtr->miRecords[i]);
+  }
+
+  miPtr->miDecoded += k;
+  miPtr->miRecordCount = 0;
+}
+
+// A set pushed out of the reassembler by the memory cap is reported as it
+// goes, as it will never be complete.
+static void mailEvict(chunkSet* csPtr, void* arg) {
+  (void)arg;
+  chunkSetReport(csPtr);
+}
+
+//*****************************************************************************
+//
+// messageDone
+//
+// Files the chunks of a message that has been read in the reassembler.
+//
+//*****************************************************************************
+
+static void messageDone(mailIngest* miPtr, mailMessage* mmPtr, char* source) {
+  mailChunk* mcPtr;
+  chunkSet* csPtr;
+  char* rbId;
+  int i;
+
+  if (mmPtr->mmInHeaders) {
+    headerDone(mmPtr);
+  }
+
+  partDone(mmPtr);
+  ++miPtr->miMessages;
+
+  if ((mmPtr->mmChunkCount == 0) && !mmPtr->mmBadData) {
+    return;
+  }
+
+  rbId = (mmPtr->mmRockblockId[0] != 0) ? mmPtr->mmRockblockId : mmPtr->mmSubjectId;
+
+  if (mmPtr->mmBadData || (rbId[0] == 0)) {
+    printf("Skipping message %ld in %s (MOMSN %s): %s!\n", mmPtr->mmNumber, source,
+           (mmPtr->mmMomsn[0] != 0) ? mmPtr->mmMomsn : "unknown",
+           mmPtr->mmBadData ? "Attachment is not icedrifter data" : "No Rockblock ID found");
+    ++miPtr->miSkipped;
+    return;
+  }
+
+  for (i = 0; i < mmPtr->mmChunkCount; ++i) {
+    mcPtr = &mmPtr->mmChunks[i];
+    ++miPtr->miChunks;
+
+    if (reassemblerAdd(&miPtr->miReassembler, rbId, &mcPtr->mcChunk, mcPtr->mcLength, &csPtr) == CHUNK_COMPLETE) {
+      miPtr->miRecords[miPtr->miRecordCount++] = chunkSetRecord(csPtr);
+      reassemblerDone(&miPtr->miReassembler, csPtr);
+
+      if (miPtr->miRecordCount == MAIL_FLUSH_RECORDS) {
+        flushRecords(miPtr);
+      }
+    }
+  }
+}
+
+//*****************************************************************************
+//
+// readMailbox
+//
+// Reads every message in one mbox file or maildir message file.
+//
+//*****************************************************************************
+
+static void readMailbox(mailIngest* miPtr, mailMessage* mmPtr, char* fileName) {
+  char line[MAIL_LINE_SIZE];
+  FILE* fd;
+  bool lastBlank;
+  bool longLine;
+  bool started;
+  char* bndPtr;
+  long number;
+  int len;
+  int i;
+
+  if ((fd = fopen(fileName, "r")) == NULL) {
+    printf("Skipping %s: Unable to open file!\n", fileName);
+    ++miPtr->miSkipped;
+    return;
+  }
+
+  number = 0;
+  started = false;
+  lastBlank = true;
+  longLine = false;
+
+  while (fgets(line, sizeof(line), fd) != NULL) {
+    len = strlen(line);
+
+    // The rest of a line too long for the buffer is not looked at.
+    if (longLine) {
+      longLine = (line[len - 1] != '\n');
+      continue;
+    }
+
+    longLine = (line[len - 1] != '\n') && !feof(fd);
+
+    while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r'))) {
+      line[--len] = 0;
+    }
+
+    // A "From " line after a blank line starts the next mbox message.
+    if (lastBlank && (strncmp(line, "From ", 5) == 0)) {
+      if (started) {
+        messageDone(miPtr, mmPtr, fileName);
+      }
+
+      messageReset(mmPtr, ++number);
+      started = true;
+      lastBlank = false;
+      continue;
+    }
+
+    if (!started) {
+      messageReset(mmPtr, ++number);
+      started = true;
+    }
+
+    lastBlank = (len == 0);
+
+    // Part boundaries end the part being read.
+    if ((line[0] == '-') && (line[1] == '-')) {
+      for (i = mmPtr->mmBoundaryCount - 1; i >= 0; --i) {
+        bndPtr = mmPtr->mmBoundary[i];
+
+        if (strncmp(&line[2], bndPtr, strlen(bndPtr)) == 0) {
+          break;
+        }
+      }
+
+      if (i >= 0) {
+        if (mmPtr->mmInHeaders) {
+          headerDone(mmPtr);
+        }
+
+        partDone(mmPtr);
+
+        if (strcmp(&line[2 + strlen(mmPtr->mmBoundary[i])], "--") == 0) {
+          // The closing boundary is followed by the epilogue.
+          mmPtr->mmBoundaryCount = i;
+          mmPtr->mmInHeaders = false;
+        } else {
+          mmPtr->mmBoundaryCount = i + 1;
+        }
+
+        continue;
+      }
+    }
+
+    if (mmPtr->mmInHeaders) {
+      if (len == 0) {
+        headerDone(mmPtr);
+        mmPtr->mmInHeaders = false;
+
+        if (mmPtr->mmMultipart) {
+          mmPtr->mmPartType = PART_SKIP;
+        } else if (mmPtr->mmBase64) {
+          mmPtr->mmPartType = PART_BASE64;
+        } else {
+          mmPtr->mmPartType = PART_TEXT;
+        }
+      } else if ((line[0] == ' ') || (line[0] == '\t')) {
+        // Folded header lines are joined to the header they continue.
+        if (strlen(mmPtr->mmHeader) + len < sizeof(mmPtr->mmHeader)) {
+          strcat(mmPtr->mmHeader, line);
+        }
+      } else {
+        headerDone(mmPtr);
+        strcpy(mmPtr->mmHeader, line);
+      }
+
+      continue;
+    }
+
+    if (mmPtr->mmPartType == PART_BASE64) {
+      base64Line(mmPtr, line);
+    } else if (mmPtr->mmPartType == PART_TEXT) {
+      textLine(mmPtr, line);
+    }
+  }
+
+  if (started) {
+    messageDone(miPtr, mmPtr, fileName);
+  }
+
+  fclose(fd);
+}
+
+static int compareNames(const void* a, const void* b) {
+  return (strcmp(*(char**)a, *(char**)b));
+}
+
+//*****************************************************************************
+//
+// mailListFiles
+//
+// Adds the mailbox files named by path to the list.  A maildir directory
+// adds the messages in its new and cur directories, any other directory
+// adds the files in it.
+//
+//*****************************************************************************
+
+static void mailListFiles(char* path, char*** list, int* count, int* size, bool top) {
+  DIR* dir;
+  struct dirent* entry;
+  struct stat fileStat;
+  char fileName[FILE_NAME_SIZE];
+
+  if (stat(path, &fileStat) != 0) {
+    printf("Skipping %s: Unable to open file!\n", path);
+    return;
+  }
+
+  if (S_ISDIR(fileStat.st_mode)) {
+    snprintf(fileName, sizeof(fileName), "%s/cur", path);
+
+    if (top && (stat(fileName, &fileStat) == 0) && S_ISDIR(fileStat.st_mode)) {
+      snprintf(fileName, sizeof(fileName), "%s/new", path);
+      mailListFiles(fileName, list, count, size, false);
+      snprintf(fileName, sizeof(fileName), "%s/cur", path);
+      mailListFiles(fileName, list, count, size, false);
+      return;
+    }
+
+    if ((dir = opendir(path)) == NULL) {
+      printf("Skipping %s: Unable to open directory!\n", path);
+      return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+      if (entry->d_name[0] != '.') {
+        snprintf(fileName, sizeof(fileName), "%s/%s", path, entry->d_name);
+
+        if ((stat(fileName, &fileStat) == 0) && S_ISREG(fileStat.st_mode)) {
+          mailListFiles(fileName, list, count, size, false);
+        }
+      }
+    }
+
+    closedir(dir);
+    return;
+  }
+
+  if (*count >= *size) {
+    *size = (*size == 0) ? 1024 : *size * 2;
+
+    if ((*list = realloc(*list, *size * sizeof(char*))) == NULL) {
+      printf("Error: Out of memory for the file list!\n");
+      printf("idecode terminating.\n");
+      exit(1);
+    }
+  }
+
+  (*list)[(*count)++] = strdup(path);
+}
+
+//*****************************************************************************
+//
+// getDataByMail
+//
+// fnl is a pointer to the first mbox file or maildir directory specified on
+// the command line.
+//
+// cnt is the number of names specified on the command line.
+//
+// Reads every message in the mailboxes given and processes every report for
+// which all chunks are found.  Reports that are missing chunks are listed at
+// the end.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int getDataByMail(char** fnl, int cnt) {
+  mailIngest* miPtr;
+  mailMessage* mmPtr;
+  chunkSet** setList;
+  chunkSet* csPtr;
+  char** fileList;
+  int fileCount;
+  int listSize;
+  int setCount;
+  int rc;
+  int i;
+  int k;
+
+  fileList = NULL;
+  fileCount = listSize = 0;
+
+  for (i = 0; i < cnt; ++i) {
+    mailListFiles(fnl[i], &fileList, &fileCount, &listSize, true);
+  }
+
+  miPtr = reassembleAlloc(sizeof(mailIngest));
+  mmPtr = reassembleAlloc(sizeof(mailMessage));
+  reassemblerInit(&miPtr->miReassembler, reassembleMemory);
+  miPtr->miReassembler.raEvict = mailEvict;
+
+  // Maildir message files are sorted by name, which starts with the
+  // delivery time.
+  if (fileCount > 1) {
+    qsort(fileList, fileCount, sizeof(char*), compareNames);
+  }
+
+  for (i = 0; i < fileCount; ++i) {
+    readMailbox(miPtr, mmPtr, fileList[i]);
+    free(fileList[i]);
+  }
+
+  flushRecords(miPtr);
+  free(fileList);
+  free(mmPtr);
+
+  // Whatever is left in the reassembler is missing at least one chunk.
+  setCount = miPtr->miReassembler.raTable.ctCount;
+  setList = reassembleAlloc((setCount + 1) * sizeof(chunkSet*));
+
+  for (csPtr = miPtr->miReassembler.raOldest, k = 0; csPtr != NULL; csPtr = csPtr->csNewer) {
+    setList[k++] = csPtr;
+  }
+
+  qsort(setList, setCount, sizeof(chunkSet*), compareChunkSets);
+
+  for (i = 0; i < setCount; ++i) {
+    chunkSetReport(setList[i]);
+  }
+
+  free(setList);
+  setCount += miPtr->miReassembler.raEvicted;
+
+  printf("Mail done: %ld messages read, %ld chunks found, %d reports decoded, %d incomplete, %ld messages skipped.\n",
+         miPtr->miMessages, miPtr->miChunks, miPtr->miDecoded, setCount, miPtr->miSkipped);
+  reassemblerPrint(&miPtr->miReassembler);
+  reassemblerFree(&miPtr->miReassembler);
+
+  rc = (miPtr->miErrors != 0);
+  free(miPtr);
+  return (rc);
+}
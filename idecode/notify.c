@@ -0,0 +1,323 @@
+//*****************************************************************************
+// notify.c
+//
+// Notification spooler for idecode.
+//
+// Reports that are to be mailed are queued here instead of being sent one
+// at a time.  The queue is sent as one digest message to each address once
+// the oldest report in it has waited for the notification window, once it
+// holds NOTIFY_MAX_REPORTS reports, or when idecode is done.  A digest has
+// the decoded text of each report in its body and the .dat and .txt files
+// of each report attached.
+//
+// A digest is either handed to a sendmail compatible command on a pipe or
+// written to a maildir directory, which needs no mail system at all.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "idecode.h"
+#include "notify.h"
+
+#define NOTIFY_HOST_SIZE 256
+
+typedef struct notifyReport {
+  char nrRockblockId[ROCKBLOCK_ID_SIZE];
+  uint32_t nrSendTime;
+  char nrDatName[FILE_NAME_SIZE];
+  char nrTxtName[FILE_NAME_SIZE];
+} notifyReport;
+
+static notifyReport* notifyReports;  // the queue, NULL until a report is queued.
+static int notifyCount;
+static time_t notifyFirst;           // when the oldest queued report was queued.
+static long notifySequence;          // digests sent, used to make unique names.
+
+//*****************************************************************************
+//
+// copyFile
+//
+// Copies a file into the digest as it is, or base64 encoded.
+//
+//*****************************************************************************
+
+static int copyFile(FILE* out, char* fileName, bool base64) {
+  static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  uint8_t buff[57];  // one 76 character line of base64.
+  uint32_t val;
+  FILE* fd;
+  int len;
+  int i;
+
+  if ((fd = fopen(fileName, "rb")) == NULL) {
+    printf("Error: Unable to open %s for the digest!\n", fileName);
+    return (1);
+  }
+
+  while ((len = fread(buff, 1, sizeof(buff), fd)) > 0) {
+    if (!base64) {
+      fwrite(buff, 1, len, out);
+      continue;
+    }
+
+    for (i = 0; i < len; i += 3) {
+      val = buff[i] << 16;
+      val |= (i + 1 < len) ? buff[i + 1] << 8 : 0;
+      val |= (i + 2 < len) ? buff[i + 2] : 0;
+      fputc(base64Chars[(val >> 18) & 0x3F], out);
+      fputc(base64Chars[(val >> 12) & 0x3F], out);
+      fputc((i + 1 < len) ? base64Chars[(val >> 6) & 0x3F] : '=', out);
+      fputc((i + 2 < len) ? base64Chars[val & 0x3F] : '=', out);
+    }
+
+    fputc('\n', out);
+  }
+
+  fclose(fd);
+  return (0);
+}
+
+static void attachmentHeader(FILE* out, char* boundary, char* fileName, char* type, bool base64) {
+  char* namePtr;
+
+  namePtr = ((namePtr = strrchr(fileName, '/')) != NULL) ? namePtr + 1 : fileName;
+  fprintf(out, "\n--%s\n", boundary);
+  fprintf(out, "Content-Type: %s; name=\"%s\"\n", type, namePtr);
+  fprintf(out, "Content-Disposition: attachment; filename=\"%s\"\n", namePtr);
+
+  if (base64) {
+    fprintf(out, "Content-Transfer-Encoding: base64\n");
+  }
+
+  fprintf(out, "\n");
+}
+
+//*****************************************************************************
+//
+// writeDigest
+//
+// Writes the digest of the queued reports addressed to one address.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int writeDigest(FILE* out, char* address, char* host, char* boundary) {
+  char dateBuff[64];
+  struct tm timeInfo;
+  time_t now;
+  int rc;
+  int i;
+
+  now = time(NULL);
+  gmtime_r(&now, &timeInfo);
+  strftime(dateBuff, sizeof(dateBuff), "%a, %d %b %Y %H:%M:%S +0000", &timeInfo);
+
+  fprintf(out, "From: idecode <idecode@%s>\n", host);
+  fprintf(out, "To: %s\n", address);
+  fprintf(out, "Subject: Decoded data for %d icedrifter report%s\n", notifyCount, (notifyCount == 1) ? "" : "s");
+  fprintf(out, "Date: %s\n", dateBuff);
+  fprintf(out, "Message-ID: <%s@%s>\n", boundary, host);
+  fprintf(out, "MIME-Version: 1.0\n");
+  fprintf(out, "Content-Type: multipart/mixed; boundary=\"%s\"\n", boundary);
+  fprintf(out, "\n--%s\n", boundary);
+  fprintf(out, "Content-Type: text/plain; charset=us-ascii\n\n");
+
+  for (i = 0; i < notifyCount; ++i) {
+    fprintf(out, "Rockblock %s sent %08x: %s\n", notifyReports[i].nrRockblockId,
+            notifyReports[i].nrSendTime, notifyReports[i].nrTxtName);
+  }
+
+  rc = 0;
+
+  for (i = 0; i < notifyCount; ++i) {
+    fprintf(out, "\n%s\n\n", notifyReports[i].nrTxtName);
+    rc |= copyFile(out, notifyReports[i].nrTxtName, false);
+  }
+
+  for (i = 0; i < notifyCount; ++i) {
+    attachmentHeader(out, boundary, notifyReports[i].nrDatName, "application/octet-stream", true);
+    rc |= copyFile(out, notifyReports[i].nrDatName, true);
+    attachmentHeader(out, boundary, notifyReports[i].nrTxtName, "text/plain", false);
+    rc |= copyFile(out, notifyReports[i].nrTxtName, false);
+  }
+
+  fprintf(out, "\n--%s--\n", boundary);
+  return (rc | ferror(out));
+}
+
+//*****************************************************************************
+//
+// deliverDigest
+//
+// Sends the digest for one address through the delivery command or into
+// the delivery maildir.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int deliverDigest(char* address, char* host, char* boundary) {
+  char tempName[FILE_NAME_SIZE];
+  char newName[FILE_NAME_SIZE];
+  FILE* out;
+  int rc;
+
+  if (notifyDelivery[0] == '|') {
+    if ((out = popen(&notifyDelivery[1], "w")) == NULL) {
+      printf("Error: Unable to run %s!\n", &notifyDelivery[1]);
+      return (1);
+    }
+
+    rc = writeDigest(out, address, host, boundary);
+
+    if (pclose(out) != 0) {
+      printf("Error returned from %s!\n", &notifyDelivery[1]);
+      rc = 1;
+    }
+
+    return (rc);
+  }
+
+  // A maildir message is written in tmp and moved to new once it is whole.
+  snprintf(tempName, sizeof(tempName), "%s/tmp", notifyDelivery);
+  mkdir(notifyDelivery, 0775);
+  mkdir(tempName, 0775);
+  snprintf(newName, sizeof(newName), "%s/new", notifyDelivery);
+  mkdir(newName, 0775);
+  snprintf(newName, sizeof(newName), "%s/cur", notifyDelivery);
+  mkdir(newName, 0775);
+
+  snprintf(tempName, sizeof(tempName), "%s/tmp/%s.%s", notifyDelivery, boundary, address);
+  snprintf(newName, sizeof(newName), "%s/new/%s.%s", notifyDelivery, boundary, address);
+
+  if ((out = fopen(tempName, "w")) == NULL) {
+    printf("Error: Unable to create %s!\n", tempName);
+    return (1);
+  }
+
+  rc = writeDigest(out, address, host, boundary);
+
+  if ((fflush(out) != 0) || (fsync(fileno(out)) != 0)) {
+    rc = 1;
+  }
+
+  fclose(out);
+
+  if ((rc != 0) || (rename(tempName, newName) != 0)) {
+    printf("Error writing digest %s!\n", tempName);
+    unlink(tempName);
+    return (1);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// notifyQueue
+//
+// ctx: a record that has been finished with its .dat and .txt files.
+//
+// Adds the record to the next digest.  The queue is sent right away if it
+// is full.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int notifyQueue(decodeContext* ctx) {
+  notifyReport* nrPtr;
+
+  if (notifyReports == NULL) {
+    if ((notifyReports = malloc(NOTIFY_MAX_REPORTS * sizeof(notifyReport))) == NULL) {
+      printf("Error: Out of memory for the notification queue!\n");
+      return (1);
+    }
+  }
+
+  if (notifyCount == 0) {
+    notifyFirst = time(NULL);
+  }
+
+  nrPtr = &notifyReports[notifyCount++];
+  strcpy(nrPtr->nrRockblockId, ctx->dcRockblockId);
+  nrPtr->nrSendTime = ctx->dcSendTime;
+  strcpy(nrPtr->nrDatName, ctx->dcDatName);
+  strcpy(nrPtr->nrTxtName, ctx->dcTxtName);
+
+  return (notifyFlush(notifyCount == NOTIFY_MAX_REPORTS));
+}
+
+//*****************************************************************************
+//
+// notifyFlush
+//
+// force: true to send the queue even if the window has not passed.
+//
+// Sends a digest of the queued reports to every address once the oldest
+// report has waited for the notification window.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int notifyFlush(bool force) {
+  char host[NOTIFY_HOST_SIZE];
+  char boundary[128];
+  int rc;
+  int i;
+
+  if ((notifyCount == 0) || (!force && (time(NULL) - notifyFirst < notifyWindow))) {
+    return (0);
+  }
+
+  if (gethostname(host, sizeof(host)) != 0) {
+    strcpy(host, "localhost");
+  }
+
+  host[sizeof(host) - 1] = 0;
+  rc = 0;
+
+  for (i = 0; i < emailCount; ++i) {
+    snprintf(boundary, sizeof(boundary), "idecode.%ld.%d.%ld", (long)time(NULL), (int)getpid(), ++notifySequence);
+
+    if (deliverDigest(emailAddress[i], host, boundary) != 0) {
+      rc = 1;
+    }
+  }
+
+  if (rc == 0) {
+    printf("Sent a digest of %d report%s to %d address%s.\n", notifyCount, (notifyCount == 1) ? "" : "s",
+           emailCount, (emailCount == 1) ? "" : "es");
+  }
+
+  notifyCount = 0;
+  return (rc);
+}
+
+//*****************************************************************************
+//
+// notifyTimeLeft
+//
+// returns the number of seconds until the queue is due to be sent, or -1 if
+// it is empty.
+//
+//*****************************************************************************
+
+int notifyTimeLeft(void) {
+  time_t left;
+
+  if (notifyCount == 0) {
+    return (-1);
+  }
+
+  left = notifyFirst + notifyWindow - time(NULL);
+  return ((left < 0) ? 0 : (int)left);
+}
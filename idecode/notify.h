@@ -0,0 +1,20 @@
+//*****************************************************************************
+// notify.h
+//
+// Notification spooler that mails decoded reports out as digests.
+//
+//*****************************************************************************
+
+#ifndef _NOTIFY_H
+#define _NOTIFY_H
+
+#include "idecode.h"
+
+#define NOTIFY_MAX_REPORTS 200  // most reports put in one digest.
+#define NOTIFY_DEFAULT_DELIVERY "|/usr/sbin/sendmail -t -i"
+
+int notifyQueue(decodeContext* ctx);
+int notifyFlush(bool force);
+int notifyTimeLeft(void);
+
+#endif // _NOTIFY_H
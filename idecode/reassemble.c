@@ -0,0 +1,789 @@
+//*****************************************************************************
+// reassemble.c
+//
+// Chunk set tables used to put icedrifter records back together.
+//
+// Every chunk is filed in a chunk set keyed by its Rockblock ID and send
+// time.  A set is complete once chunk 0 has given the record length and
+// every chunk that length needs has been received.  A table is not locked,
+// so each thread must use its own.
+//
+// A reassembler wraps a table for streams of chunks.  It takes chunks in
+// any order, spots duplicates, chunks that disagree with the ones already
+// filed and chunks of reports it has already finished, and counts what
+// happened to every chunk.  Under a memory cap it evicts the set that has
+// waited longest for its next chunk.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "idecode.h"
+#include "reassemble.h"
+#include "layout.h"
+#include "timeline.h"
+
+//*****************************************************************************
+//
+// getRecordLength
+//
+// recPtr: the start of chunk 0 of a record.
+//
+// returns the length of the record the icedrifter sent, worked out from the
+// switches and chain byte counts in the record header, or 0 if the record
+// is from an unknown hardware version.
+//
+//*****************************************************************************
+
+int getRecordLength(uint8_t* recPtr) {
+  recordView view;
+
+  if (!viewOpen(&view, recPtr, MAX_CHUNK_DATA_LENGTH)) {
+    return (0);
+  }
+
+  return (viewRecordLength(&view));
+}
+
+//*****************************************************************************
+//
+// getSentLength
+//
+// recPtr: the start of chunk 0 of a record.
+//
+// compressed: true if the record was sent compressed.
+//
+// returns the number of chunk data bytes the record was sent in, or 0 if
+// the record can not be decoded.  The start of a compressed record is
+// expanded to check its layout.
+//
+//*****************************************************************************
+
+int getSentLength(uint8_t* recPtr, bool compressed) {
+  uint8_t record[MAX_CHUNK_DATA_LENGTH];
+  uint16_t streamLength;
+  int length;
+
+  if (!compressed) {
+    return (getRecordLength(recPtr));
+  }
+
+  memcpy(&streamLength, recPtr, sizeof(streamLength));
+  length = LZSS_HEADER_SIZE + streamLength;
+
+  if ((streamLength == 0) || (length > (int)(MAX_RECORD_CHUNKS * MAX_CHUNK_DATA_LENGTH))) {
+    return (0);
+  }
+
+  memset(record, 0, sizeof(record));
+
+  if ((lzssDecode(recPtr + LZSS_HEADER_SIZE, (length > MAX_CHUNK_DATA_LENGTH ? MAX_CHUNK_DATA_LENGTH : length) -
+                  LZSS_HEADER_SIZE, record, sizeof(record)) < 0) ||
+      (getRecordLength(record) == 0)) {
+    return (0);
+  }
+
+  return (length);
+}
+
+void* reassembleAlloc(size_t size) {
+  void* ptr;
+
+  if ((ptr = calloc(1, size)) == NULL) {
+    printf("Error: Out of memory reassembling records!\n");
+    printf("idecode terminating.\n");
+    exit(1);
+  }
+
+  return (ptr);
+}
+
+uint32_t chunkHash(char* rbId, uint32_t sendTime) {
+  uint32_t hash;
+  int i;
+
+  // FNV-1a over the ID string and the send time.
+  hash = 2166136261u;
+
+  while (*rbId != 0) {
+    hash = (hash ^ (uint8_t)*rbId++) * 16777619u;
+  }
+
+  for (i = 0; i < 4; ++i) {
+    hash = (hash ^ ((sendTime >> (i * 8)) & 0xFF)) * 16777619u;
+  }
+
+  return (hash);
+}
+
+void chunkTableGrow(chunkTable* tbl) {
+  chunkSet** oldBuckets;
+  chunkSet* csPtr;
+  chunkSet* nextPtr;
+  int oldSize;
+  int i;
+  uint32_t ix;
+
+  oldBuckets = tbl->ctBuckets;
+  oldSize = tbl->ctSize;
+  tbl->ctSize = (oldSize == 0) ? CHUNK_TABLE_SIZE : oldSize * 2;
+  tbl->ctBuckets = reassembleAlloc(tbl->ctSize * sizeof(chunkSet*));
+
+  for (i = 0; i < oldSize; ++i) {
+    for (csPtr = oldBuckets[i]; csPtr != NULL; csPtr = nextPtr) {
+      nextPtr = csPtr->csNext;
+      ix = csPtr->csHash & (tbl->ctSize - 1);
+      csPtr->csNext = tbl->ctBuckets[ix];
+      tbl->ctBuckets[ix] = csPtr;
+    }
+  }
+
+  free(oldBuckets);
+}
+
+//*****************************************************************************
+//
+// chunkTableFind
+//
+// returns the chunk set for the Rockblock ID and send time.  chunkTableFind
+// adds an empty one if there is none yet, chunkTableLookup returns NULL.
+//
+//*****************************************************************************
+
+chunkSet* chunkTableLookup(chunkTable* tbl, char* rbId, uint32_t sendTime, uint32_t hash) {
+  chunkSet* csPtr;
+
+  for (csPtr = tbl->ctBuckets[hash & (tbl->ctSize - 1)]; csPtr != NULL; csPtr = csPtr->csNext) {
+    if ((csPtr->csSendTime == sendTime) && (strcmp(csPtr->csRockblockId, rbId) == 0)) {
+      return (csPtr);
+    }
+  }
+
+  return (NULL);
+}
+
+chunkSet* chunkTableFind(chunkTable* tbl, char* rbId, uint32_t sendTime, uint32_t hash) {
+  chunkSet* csPtr;
+  uint32_t ix;
+
+  if (tbl->ctCount >= tbl->ctSize) {
+    chunkTableGrow(tbl);
+  }
+
+  if ((csPtr = chunkTableLookup(tbl, rbId, sendTime, hash)) != NULL) {
+    return (csPtr);
+  }
+
+  ix = hash & (tbl->ctSize - 1);
+  csPtr = reassembleAlloc(sizeof(chunkSet));
+  strcpy(csPtr->csRockblockId, rbId);
+  csPtr->csSendTime = sendTime;
+  csPtr->csHash = hash;
+  csPtr->csNext = tbl->ctBuckets[ix];
+  tbl->ctBuckets[ix] = csPtr;
+  ++tbl->ctCount;
+  return (csPtr);
+}
+
+void chunkTableRemove(chunkTable* tbl, chunkSet* setPtr) {
+  chunkSet** linkPtr;
+
+  for (linkPtr = &tbl->ctBuckets[setPtr->csHash & (tbl->ctSize - 1)]; *linkPtr != NULL; linkPtr = &(*linkPtr)->csNext) {
+    if (*linkPtr == setPtr) {
+      *linkPtr = setPtr->csNext;
+      free(setPtr);
+      --tbl->ctCount;
+      return;
+    }
+  }
+}
+
+//*****************************************************************************
+//
+// chunkFileRead
+//
+// fileName: a chunk file named <Rockblock ID>-<anything>.
+//
+// rbId: buffer of ROCKBLOCK_ID_SIZE bytes that receives the Rockblock ID.
+//
+// idcPtr: receives the chunk.
+//
+// message: buffer of size bytes that receives why the file was skipped.
+//
+// returns the number of bytes of chunk data, or 0 if the file is not a
+// chunk file.  A heartbeat is returned as chunk 0 of a record.  An event trace chunk is written out as a timeline and
+// CHUNK_FILE_TRACE is returned, with a message saying where it went.
+//
+//*****************************************************************************
+
+int chunkFileRead(char* fileName, char* rbId, iceDrifterChunk* idcPtr, char* message, int size) {
+  FILE* fd;
+  int recordSize;
+
+  if (getRockblockId(fileName, rbId) == false) {
+    snprintf(message, size, "Skipping %s: Invalid Icedrifter file name!\n", fileName);
+    return (0);
+  }
+
+  if ((fd = fopen(fileName, "r")) == NULL) {
+    snprintf(message, size, "Skipping %s: Unable to open file!\n", fileName);
+    return (0);
+  }
+
+  recordSize = fread(idcPtr, 1, sizeof(iceDrifterChunk), fd);
+
+  // A chunk file longer than a chunk is not a chunk file.
+  if (fgetc(fd) != EOF) {
+    recordSize = 0;
+  }
+
+  fclose(fd);
+
+  if (recordSize <= CHUNK_HEADER_SIZE) {
+    snprintf(message, size, "Skipping %s: Record size zero or too long!\n", fileName);
+    return (0);
+  }
+
+  // An event trace is not part of a record, it is written out on its own.
+  if (timelineChunk(idcPtr)) {
+    return (timelineWrite(rbId, idcPtr, recordSize - CHUNK_HEADER_SIZE, message, size) == 0 ? CHUNK_FILE_TRACE : 0);
+  }
+
+  // A heartbeat is read as a record without chain data.
+  if ((recordSize = layoutHeartbeat(idcPtr, recordSize - CHUNK_HEADER_SIZE) + CHUNK_HEADER_SIZE) == CHUNK_HEADER_SIZE) {
+    snprintf(message, size, "Skipping %s: Heartbeat too short!\n", fileName);
+    return (0);
+  }
+
+  if (!((idcPtr->idcRecordType[0] == 'I') && (idcPtr->idcRecordType[1] == 'D'))) {
+    snprintf(message, size, "Skipping %s: Chunk header - not \"IDxx\"!\n", fileName);
+    return (0);
+  }
+
+  if (CHUNK_NUMBER(idcPtr->idcRecordNumber) >= MAX_RECORD_CHUNKS) {
+    snprintf(message, size, "Skipping %s: Invalid record number %d!\n", fileName,
+             CHUNK_NUMBER(idcPtr->idcRecordNumber));
+    return (0);
+  }
+
+  if ((idcPtr->idcRecordNumber == CHUNK_COMPRESSED) && (getSentLength(idcPtr->idcBuffer, true) == 0)) {
+    snprintf(message, size, "Skipping %s: Compressed record can not be expanded!\n", fileName);
+    return (0);
+  }
+
+  if ((idcPtr->idcRecordNumber == 0) && (getRecordLength(idcPtr->idcBuffer) == 0)) {
+    snprintf(message, size, "Skipping %s: Unknown record layout %d!\n", fileName,
+             (idcPtr->idcBuffer[0] & RECORD_LAYOUT_MASK) >> RECORD_LAYOUT_SHIFT);
+    return (0);
+  }
+
+  return (recordSize - CHUNK_HEADER_SIZE);
+}
+
+//*****************************************************************************
+//
+// chunkSetNeeded
+//
+// returns the number of chunks the set's record was sent in, or 0 if chunk 0
+// has not been received yet so the record length is not known.
+//
+//*****************************************************************************
+
+int chunkSetNeeded(chunkSet* csPtr) {
+  int needed;
+
+  if (csPtr->csChunkLength[0] == 0) {
+    return (0);
+  }
+
+  needed = CHUNK_COUNT(getSentLength(csPtr->csChunkData[0], csPtr->csCompressed));
+
+  return ((needed > (int)MAX_RECORD_CHUNKS) ? (int)MAX_RECORD_CHUNKS : needed);
+}
+
+bool chunkSetComplete(chunkSet* csPtr) {
+  int needed;
+  int i;
+
+  if ((needed = chunkSetNeeded(csPtr)) == 0) {
+    return (false);
+  }
+
+  for (i = 0; i < needed; ++i) {
+    if (csPtr->csChunkLength[i] == 0) {
+      return (false);
+    }
+  }
+
+  return (true);
+}
+
+//*****************************************************************************
+//
+// chunkSetRecord
+//
+// returns a new decode context holding the record rebuilt from a complete
+// chunk set.
+//
+//*****************************************************************************
+
+decodeContext* chunkSetRecord(chunkSet* csPtr) {
+  decodeContext* ctx;
+  recordView view;
+  uint8_t record[sizeof(icedrifterData)];
+  int needed;
+  int len;
+  int i;
+
+  ctx = reassembleAlloc(sizeof(decodeContext));
+  strcpy(ctx->dcRockblockId, csPtr->csRockblockId);
+  ctx->dcSendTime = csPtr->csSendTime;
+
+  // A compressed record is expanded as far as the first missing chunk, and
+  // the rest of it reads as zeros.
+  if (csPtr->csCompressed) {
+    needed = chunkSetNeeded(csPtr);
+
+    for (i = 0; (i < needed) && (csPtr->csChunkLength[i] != 0); ++i) {
+    }
+
+    len = getSentLength(csPtr->csChunkData[0], true);
+
+    if (len > i * MAX_CHUNK_DATA_LENGTH) {
+      len = i * MAX_CHUNK_DATA_LENGTH;
+    }
+
+    memset(record, 0, sizeof(record));
+
+    if (lzssDecode(csPtr->csChunkData[0] + LZSS_HEADER_SIZE, len - LZSS_HEADER_SIZE, record, sizeof(record)) >= 0) {
+      len = getRecordLength(record);
+
+      if (len > (int)sizeof(record)) {
+        len = sizeof(record);
+      }
+
+      if (viewOpen(&view, record, len)) {
+        viewDecode(&view, &ctx->dcData);
+      }
+    }
+
+    return (ctx);
+  }
+
+  // The chunk data of a set lies end to end, so it is read in place as the
+  // record the icedrifter sent.  Chunks that are missing read as zeros.
+  len = getRecordLength(csPtr->csChunkData[0]);
+
+  if (len > (int)sizeof(csPtr->csChunkData)) {
+    len = sizeof(csPtr->csChunkData);
+  }
+
+  if (viewOpen(&view, csPtr->csChunkData[0], len)) {
+    viewDecode(&view, &ctx->dcData);
+  }
+
+  return (ctx);
+}
+
+int compareChunkSets(const void* a, const void* b) {
+  chunkSet* aPtr = *(chunkSet**)a;
+  chunkSet* bPtr = *(chunkSet**)b;
+  int rc;
+
+  if ((rc = strcmp(aPtr->csRockblockId, bPtr->csRockblockId)) != 0) {
+    return (rc);
+  }
+
+  return ((aPtr->csSendTime > bPtr->csSendTime) - (aPtr->csSendTime < bPtr->csSendTime));
+}
+
+//*****************************************************************************
+//
+// chunkSetReport
+//
+// Prints which chunks of an incomplete set were received.
+//
+//*****************************************************************************
+
+void chunkSetReport(chunkSet* csPtr) {
+  int needed;
+  int i;
+
+  printf("Incomplete report for Rockblock %s sent %08x: chunks received",
+         csPtr->csRockblockId, csPtr->csSendTime);
+
+  for (i = 0; i < (int)MAX_RECORD_CHUNKS; ++i) {
+    if (csPtr->csChunkLength[i] != 0) {
+      printf(" %d", i);
+    }
+  }
+
+  if ((needed = chunkSetNeeded(csPtr)) == 0) {
+    printf(", chunk 0 missing.\n");
+  } else {
+    printf(" of %d.\n", needed);
+  }
+}
+
+//*****************************************************************************
+//
+// The finished report ring.  A report is known by its send time and a 64
+// bit hash of its Rockblock ID, which is all a late chunk has to be checked
+// against.  The ring grows to DONE_KEYS_MAX reports and then forgets the
+// oldest.
+//
+//*****************************************************************************
+
+static uint64_t idHash(char* rbId) {
+  uint64_t hash;
+
+  // 64 bit FNV-1a.
+  hash = 14695981039346656037ull;
+
+  while (*rbId != 0) {
+    hash = (hash ^ (uint8_t)*rbId++) * 1099511628211ull;
+  }
+
+  return (hash);
+}
+
+static int doneBucket(reassembler* raPtr, uint64_t idHashVal, uint32_t sendTime) {
+  return ((int)((idHashVal ^ (sendTime * 2654435761u)) & (raPtr->raDoneSize - 1)));
+}
+
+static bool doneFind(reassembler* raPtr, uint64_t idHashVal, uint32_t sendTime) {
+  int ix;
+
+  if (raPtr->raDoneSize == 0) {
+    return (false);
+  }
+
+  for (ix = raPtr->raDoneBuckets[doneBucket(raPtr, idHashVal, sendTime)]; ix >= 0; ix = raPtr->raDone[ix].dkNext) {
+    if ((raPtr->raDone[ix].dkIdHash == idHashVal) && (raPtr->raDone[ix].dkSendTime == sendTime)) {
+      return (true);
+    }
+  }
+
+  return (false);
+}
+
+static void doneLink(reassembler* raPtr, int ix) {
+  int* bucketPtr;
+
+  bucketPtr = &raPtr->raDoneBuckets[doneBucket(raPtr, raPtr->raDone[ix].dkIdHash, raPtr->raDone[ix].dkSendTime)];
+  raPtr->raDone[ix].dkNext = *bucketPtr;
+  *bucketPtr = ix;
+}
+
+static void doneAdd(reassembler* raPtr, char* rbId, uint32_t sendTime) {
+  int* linkPtr;
+  int ix;
+
+  if ((raPtr->raDoneCount == raPtr->raDoneSize) && (raPtr->raDoneSize < DONE_KEYS_MAX)) {
+    // The ring has not wrapped yet, so the keys are in slot order.
+    raPtr->raDoneSize = (raPtr->raDoneSize == 0) ? DONE_KEYS_SIZE : raPtr->raDoneSize * 2;
+
+    if ((raPtr->raDone = realloc(raPtr->raDone, raPtr->raDoneSize * sizeof(doneKey))) == NULL) {
+      printf("Error: Out of memory reassembling records!\n");
+      printf("idecode terminating.\n");
+      exit(1);
+    }
+
+    free(raPtr->raDoneBuckets);
+    raPtr->raDoneBuckets = reassembleAlloc(raPtr->raDoneSize * sizeof(int));
+    memset(raPtr->raDoneBuckets, 0xFF, raPtr->raDoneSize * sizeof(int));
+
+    for (ix = 0; ix < raPtr->raDoneCount; ++ix) {
+      doneLink(raPtr, ix);
+    }
+
+    raPtr->raDoneNext = raPtr->raDoneCount;
+  }
+
+  ix = raPtr->raDoneNext;
+  raPtr->raDoneNext = (ix + 1) % raPtr->raDoneSize;
+
+  if (ix < raPtr->raDoneCount) {
+    // Forget the oldest report to make room.
+    linkPtr = &raPtr->raDoneBuckets[doneBucket(raPtr, raPtr->raDone[ix].dkIdHash, raPtr->raDone[ix].dkSendTime)];
+
+    while (*linkPtr != ix) {
+      linkPtr = &raPtr->raDone[*linkPtr].dkNext;
+    }
+
+    *linkPtr = raPtr->raDone[ix].dkNext;
+  } else {
+    ++raPtr->raDoneCount;
+  }
+
+  raPtr->raDone[ix].dkIdHash = idHash(rbId);
+  raPtr->raDone[ix].dkSendTime = sendTime;
+  doneLink(raPtr, ix);
+}
+
+static void ageUnlink(reassembler* raPtr, chunkSet* csPtr) {
+  if (csPtr->csOlder != NULL) {
+    csPtr->csOlder->csNewer = csPtr->csNewer;
+  } else {
+    raPtr->raOldest = csPtr->csNewer;
+  }
+
+  if (csPtr->csNewer != NULL) {
+    csPtr->csNewer->csOlder = csPtr->csOlder;
+  } else {
+    raPtr->raNewest = csPtr->csOlder;
+  }
+
+  csPtr->csOlder = csPtr->csNewer = NULL;
+}
+
+static void ageLink(reassembler* raPtr, chunkSet* csPtr) {
+  csPtr->csOlder = raPtr->raNewest;
+  csPtr->csNewer = NULL;
+
+  if (raPtr->raNewest != NULL) {
+    raPtr->raNewest->csNewer = csPtr;
+  } else {
+    raPtr->raOldest = csPtr;
+  }
+
+  raPtr->raNewest = csPtr;
+}
+
+//*****************************************************************************
+//
+// chunkExpected
+//
+// returns the number of data bytes chunk number of the set should have, 0
+// if the record has no such chunk, or -1 if it is not known yet.  The
+// last chunk may be longer than the record needs.
+//
+//*****************************************************************************
+
+static int chunkExpected(chunkSet* csPtr, int number) {
+  int needed;
+  int length;
+
+  if ((needed = chunkSetNeeded(csPtr)) == 0) {
+    return (-1);
+  }
+
+  if (number >= needed) {
+    return (0);
+  }
+
+  length = getSentLength(csPtr->csChunkData[0], csPtr->csCompressed) - (number * MAX_CHUNK_DATA_LENGTH);
+  return ((length > MAX_CHUNK_DATA_LENGTH) ? MAX_CHUNK_DATA_LENGTH : length);
+}
+
+static bool chunkFits(chunkSet* csPtr, int number, int length) {
+  int expected;
+
+  expected = chunkExpected(csPtr, number);
+
+  if (number == chunkSetNeeded(csPtr) - 1) {
+    // A record longer than icedrifterData is cut short by chunkSetRecord,
+    // so its last chunk cannot be checked.
+    return ((length >= expected) ||
+            (getSentLength(csPtr->csChunkData[0], csPtr->csCompressed) > (int)sizeof(icedrifterData)));
+  }
+
+  return ((expected < 0) || (length == expected));
+}
+
+void reassemblerInit(reassembler* raPtr, size_t memoryCap) {
+  memset(raPtr, 0, sizeof(reassembler));
+  raPtr->raMemoryCap = memoryCap;
+  chunkTableGrow(&raPtr->raTable);
+}
+
+//*****************************************************************************
+//
+// reassemblerAdd
+//
+// rbId: the Rockblock ID the chunk came from.
+//
+// idcPtr, length: the chunk and its number of data bytes.
+//
+// setPtr: receives the set the chunk was filed in, or NULL if it was not.
+//
+// Files a chunk.  A complete set stays in the reassembler until it is
+// handed to reassemblerDone.
+//
+// returns the CHUNK_xxx outcome, which is also counted.
+//
+//*****************************************************************************
+
+int reassemblerAdd(reassembler* raPtr, char* rbId, iceDrifterChunk* idcPtr, int length, chunkSet** setPtr) {
+  chunkSet* csPtr;
+  uint32_t hash;
+  bool compressed;
+  int number;
+  int outcome;
+  int i;
+
+  *setPtr = NULL;
+  number = CHUNK_NUMBER(idcPtr->idcRecordNumber);
+  compressed = (idcPtr->idcRecordNumber & CHUNK_COMPRESSED) != 0;
+
+  // A chunk 0 from an unknown hardware version can not be decoded.
+  if ((length <= 0) || (length > MAX_CHUNK_DATA_LENGTH) || (number >= (int)MAX_RECORD_CHUNKS) ||
+      ((number == 0) && (getSentLength(idcPtr->idcBuffer, compressed) == 0))) {
+    ++raPtr->raCounts[CHUNK_INVALID];
+    return (CHUNK_INVALID);
+  }
+
+  hash = chunkHash(rbId, idcPtr->idcSendTime);
+
+  if ((csPtr = chunkTableLookup(&raPtr->raTable, rbId, idcPtr->idcSendTime, hash)) == NULL) {
+    if (doneFind(raPtr, idHash(rbId), idcPtr->idcSendTime)) {
+      ++raPtr->raCounts[CHUNK_LATE];
+      return (CHUNK_LATE);
+    }
+
+    // Make room for the new set.
+    while ((raPtr->raMemoryCap != 0) && (raPtr->raOldest != NULL) &&
+           ((raPtr->raTable.ctCount + 1) * sizeof(chunkSet) > raPtr->raMemoryCap)) {
+      ++raPtr->raEvicted;
+
+      if (raPtr->raEvict != NULL) {
+        raPtr->raEvict(raPtr->raOldest, raPtr->raEvictArg);
+      }
+
+      reassemblerDrop(raPtr, raPtr->raOldest);
+    }
+
+    csPtr = chunkTableFind(&raPtr->raTable, rbId, idcPtr->idcSendTime, hash);
+    csPtr->csCompressed = compressed;
+    ageLink(raPtr, csPtr);
+  }
+
+  // Every chunk of a record is sent compressed or none is.
+  if (csPtr->csCompressed != compressed) {
+    ++raPtr->raCounts[CHUNK_CONFLICT];
+    return (CHUNK_CONFLICT);
+  }
+
+  if (csPtr->csChunkLength[number] != 0) {
+    outcome = ((csPtr->csChunkLength[number] == length) &&
+               (memcmp(csPtr->csChunkData[number], idcPtr->idcBuffer, length) == 0)) ? CHUNK_DUPLICATE : CHUNK_CONFLICT;
+    ++raPtr->raCounts[outcome];
+    return (outcome);
+  }
+
+  if ((number != 0) && !chunkFits(csPtr, number, length)) {
+    ++raPtr->raCounts[CHUNK_CONFLICT];
+    return (CHUNK_CONFLICT);
+  }
+
+  csPtr->csChunkLength[number] = length;
+  memcpy(csPtr->csChunkData[number], idcPtr->idcBuffer, length);
+  csPtr->csUpdated = time(NULL);
+  ageUnlink(raPtr, csPtr);
+  ageLink(raPtr, csPtr);
+  *setPtr = csPtr;
+
+  // Chunk 0 gives the record length, which the chunks filed before it
+  // must agree with.
+  if (number == 0) {
+    for (i = 1; i < (int)MAX_RECORD_CHUNKS; ++i) {
+      if ((csPtr->csChunkLength[i] != 0) && !chunkFits(csPtr, i, csPtr->csChunkLength[i])) {
+        memset(csPtr->csChunkData[i], 0, csPtr->csChunkLength[i]);
+        csPtr->csChunkLength[i] = 0;
+        ++raPtr->raCounts[CHUNK_CONFLICT];
+      }
+    }
+  }
+
+  outcome = chunkSetComplete(csPtr) ? CHUNK_COMPLETE : CHUNK_ADDED;
+  ++raPtr->raCounts[outcome];
+  return (outcome);
+}
+
+//*****************************************************************************
+//
+// reassemblerDone
+// reassemblerDrop
+//
+// Remove a set from the reassembler and free it.  reassemblerDone is for a
+// set whose record has been rebuilt, and remembers the report so its late
+// chunks are not taken for a new report.
+//
+//*****************************************************************************
+
+void reassemblerDone(reassembler* raPtr, chunkSet* csPtr) {
+  doneAdd(raPtr, csPtr->csRockblockId, csPtr->csSendTime);
+  reassemblerDrop(raPtr, csPtr);
+}
+
+void reassemblerDrop(reassembler* raPtr, chunkSet* csPtr) {
+  ageUnlink(raPtr, csPtr);
+  chunkTableRemove(&raPtr->raTable, csPtr);
+}
+
+//*****************************************************************************
+//
+// reassemblerExpire
+//
+// Drops every set that has had no chunk since before, oldest first.
+//
+//*****************************************************************************
+
+void reassemblerExpire(reassembler* raPtr, time_t before) {
+  while ((raPtr->raOldest != NULL) && (raPtr->raOldest->csUpdated < before)) {
+    ++raPtr->raExpired;
+
+    if (raPtr->raEvict != NULL) {
+      raPtr->raEvict(raPtr->raOldest, raPtr->raEvictArg);
+    }
+
+    reassemblerDrop(raPtr, raPtr->raOldest);
+  }
+}
+
+void reassemblerFree(reassembler* raPtr) {
+  while (raPtr->raOldest != NULL) {
+    reassemblerDrop(raPtr, raPtr->raOldest);
+  }
+
+  free(raPtr->raTable.ctBuckets);
+  free(raPtr->raDone);
+  free(raPtr->raDoneBuckets);
+  memset(raPtr, 0, sizeof(reassembler));
+}
+
+void reassemblerSum(reassembler* sumPtr, reassembler* raPtr) {
+  int i;
+
+  for (i = 0; i < CHUNK_OUTCOMES; ++i) {
+    sumPtr->raCounts[i] += raPtr->raCounts[i];
+  }
+
+  sumPtr->raEvicted += raPtr->raEvicted;
+  sumPtr->raExpired += raPtr->raExpired;
+}
+
+//*****************************************************************************
+//
+// reassemblerPrint
+//
+// Prints what happened to the chunks given to the reassembler.
+//
+//*****************************************************************************
+
+void reassemblerPrint(reassembler* raPtr) {
+  printf("Chunks: %ld filed, %ld completed a report, %ld duplicate, %ld conflicting, %ld late, %ld invalid.",
+         raPtr->raCounts[CHUNK_ADDED] + raPtr->raCounts[CHUNK_COMPLETE], raPtr->raCounts[CHUNK_COMPLETE],
+         raPtr->raCounts[CHUNK_DUPLICATE], raPtr->raCounts[CHUNK_CONFLICT], raPtr->raCounts[CHUNK_LATE],
+         raPtr->raCounts[CHUNK_INVALID]);
+
+  if ((raPtr->raEvicted != 0) || (raPtr->raExpired != 0)) {
+    printf("  Sets: %ld evicted, %ld expired.", raPtr->raEvicted, raPtr->raExpired);
+  }
+
+  printf("\n");
+}
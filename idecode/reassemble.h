@@ -0,0 +1,94 @@
+//*****************************************************************************
+// reassemble.h
+//
+// Groups icedrifter chunks by Rockblock ID and send time and rebuilds the
+// records whose chunks have all been found.
+//
+//*****************************************************************************
+
+#ifndef _REASSEMBLE_H
+#define _REASSEMBLE_H
+
+#include "idecode.h"
+
+#define CHUNK_TABLE_SIZE 1024  // initial number of buckets in a chunk set table.
+#define DONE_KEYS_SIZE 1024    // initial number of finished reports remembered.
+#define DONE_KEYS_MAX 65536    // most finished reports remembered.
+
+// What happened to a chunk given to reassemblerAdd.
+#define CHUNK_ADDED     0  // filed in a set that is still missing chunks.
+#define CHUNK_COMPLETE  1  // filed and its set is now complete.
+#define CHUNK_DUPLICATE 2  // the same chunk was already filed, ignored.
+#define CHUNK_CONFLICT  3  // disagrees with a chunk already filed, ignored.
+#define CHUNK_LATE      4  // its report was already finished, ignored.
+#define CHUNK_INVALID   5  // not a chunk of any record, ignored.
+#define CHUNK_OUTCOMES  6
+
+typedef struct chunkSet {
+  struct chunkSet* csNext;  // next set in the same hash bucket.
+  struct chunkSet* csOlder;  // sets in order of their last chunk.
+  struct chunkSet* csNewer;
+  char csRockblockId[ROCKBLOCK_ID_SIZE];
+  uint32_t csSendTime;
+  uint32_t csHash;
+  time_t csUpdated;  // when the last chunk was filed.
+  bool csCompressed;  // the record was sent compressed.
+  int csChunkLength[MAX_RECORD_CHUNKS];  // data bytes in each chunk, 0 if not received.
+  uint8_t csChunkData[MAX_RECORD_CHUNKS][MAX_CHUNK_DATA_LENGTH];
+} chunkSet;
+
+typedef struct chunkTable {
+  chunkSet** ctBuckets;
+  int ctSize;   // number of hash buckets, always a power of two.
+  int ctCount;  // number of chunk sets in the table.
+} chunkTable;
+
+// A finished report, remembered so late duplicates of its chunks are not
+// taken for a new report.
+typedef struct doneKey {
+  uint64_t dkIdHash;
+  uint32_t dkSendTime;
+  int dkNext;  // next key in the same bucket, -1 for none.
+} doneKey;
+
+typedef struct reassembler {
+  chunkTable raTable;       // the sets still missing chunks.
+  chunkSet* raOldest;       // least recently added to set.
+  chunkSet* raNewest;
+  size_t raMemoryCap;       // most bytes of sets held, 0 for no limit.
+  void (*raEvict)(chunkSet* csPtr, void* arg);  // called before a set is evicted or expired.
+  void* raEvictArg;
+  doneKey* raDone;          // ring of finished reports.
+  int* raDoneBuckets;
+  int raDoneSize;
+  int raDoneCount;
+  int raDoneNext;           // ring slot the next finished report goes in.
+  long raCounts[CHUNK_OUTCOMES];
+  long raEvicted;           // sets dropped to stay under the memory cap.
+  long raExpired;           // sets dropped by reassemblerExpire.
+} reassembler;
+
+void* reassembleAlloc(size_t size);
+uint32_t chunkHash(char* rbId, uint32_t sendTime);
+void chunkTableGrow(chunkTable* tbl);
+chunkSet* chunkTableLookup(chunkTable* tbl, char* rbId, uint32_t sendTime, uint32_t hash);
+chunkSet* chunkTableFind(chunkTable* tbl, char* rbId, uint32_t sendTime, uint32_t hash);
+void chunkTableRemove(chunkTable* tbl, chunkSet* setPtr);
+#define CHUNK_FILE_TRACE (-1)  // chunkFileRead wrote an event trace out.
+
+int chunkFileRead(char* fileName, char* rbId, iceDrifterChunk* idcPtr, char* message, int size);
+int chunkSetNeeded(chunkSet* csPtr);
+bool chunkSetComplete(chunkSet* csPtr);
+decodeContext* chunkSetRecord(chunkSet* csPtr);
+int compareChunkSets(const void* a, const void* b);
+void chunkSetReport(chunkSet* csPtr);
+void reassemblerInit(reassembler* raPtr, size_t memoryCap);
+int reassemblerAdd(reassembler* raPtr, char* rbId, iceDrifterChunk* idcPtr, int length, chunkSet** setPtr);
+void reassemblerDone(reassembler* raPtr, chunkSet* csPtr);
+void reassemblerDrop(reassembler* raPtr, chunkSet* csPtr);
+void reassemblerExpire(reassembler* raPtr, time_t before);
+void reassemblerFree(reassembler* raPtr);
+void reassemblerSum(reassembler* sumPtr, reassembler* raPtr);
+void reassemblerPrint(reassembler* raPtr);
+
+#endif // _REASSEMBLE_H
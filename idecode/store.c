@@ -0,0 +1,759 @@
+//*****************************************************************************
+// store.c
+//
+// Append-only columnar store for decoded icedrifter records.
+//
+// Each Rockblock has its own directory in the store.  Every value that is
+// decoded from a record - time, latitude, longitude, pressure, temperature,
+// remote temperature and each chain sensor - has its own column file
+// <column>.col made of compressed blocks of up to STORE_BLOCK_RECORDS
+// values, and an index file <column>.idx holding the offset and the minimum
+// and maximum time of every block.  A query for one column over a time range
+// reads that column's index and only the blocks that overlap the range.
+//
+// Every block carries its own times so a column can be read on its own.
+// Times are stored as deltas from the previous time and values are stored
+// as the XOR (floats) or difference (chain words) from the previous value,
+// all as variable length integers, so slowly changing data takes a byte or
+// two per value.
+//
+// Records are added at the end of the columns.  If the last block of a
+// column is not full it is rewritten with the new values merged in, so
+// single records appended one at a time still end up in full blocks.  A
+// record appended again while its block is still open replaces the first.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "idecode.h"
+#include "store.h"
+
+// Largest encoded size of a block: a time and a value per entry, each at
+// most a 5 byte variable length integer.
+#define STORE_BLOCK_MAX (STORE_BLOCK_RECORDS * 10)
+
+// The values of one column gathered from the records being appended.
+typedef struct storeColumn {
+  char scName[STORE_NAME_SIZE];
+  uint8_t scType;
+  int scCount;
+  int scSize;
+  uint32_t* scTimes;
+  uint32_t* scValues;  // raw bits of the value.
+} storeColumn;
+
+static void* storeAlloc(size_t size) {
+  void* ptr;
+
+  if ((ptr = malloc(size)) == NULL) {
+    printf("Error: Out of memory in the store!\n");
+    printf("idecode terminating.\n");
+    exit(1);
+  }
+
+  return (ptr);
+}
+
+static uint8_t* putVarint(uint8_t* ptr, uint32_t value) {
+  while (value >= 0x80) {
+    *ptr++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+
+  *ptr++ = (uint8_t)value;
+  return (ptr);
+}
+
+static uint8_t* getVarint(uint8_t* ptr, uint8_t* endPtr, uint32_t* value) {
+  uint32_t result;
+  int shift;
+
+  result = 0;
+
+  for (shift = 0; (ptr < endPtr) && (shift < 35); shift += 7) {
+    result |= (uint32_t)(*ptr & 0x7F) << shift;
+
+    if ((*ptr++ & 0x80) == 0) {
+      *value = result;
+      return (ptr);
+    }
+  }
+
+  return (NULL);
+}
+
+static uint32_t zigzag(int32_t value) {
+  return (((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return ((int32_t)(value >> 1) ^ -(int32_t)(value & 1));
+}
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits);
+}
+
+static float bitsFloat(uint32_t bits) {
+  float value;
+
+  memcpy(&value, &bits, sizeof(value));
+  return (value);
+}
+
+//*****************************************************************************
+//
+// encodeBlock / decodeBlock
+//
+// Convert between count time/value pairs and the compressed block data.
+// encodeBlock returns the encoded length.  decodeBlock returns false if the
+// block data is damaged.
+//
+//*****************************************************************************
+
+static int encodeBlock(uint8_t type, uint32_t* times, uint32_t* values, int count, uint8_t* out) {
+  uint8_t* ptr;
+  uint32_t prevTime;
+  uint32_t prevValue;
+  int i;
+
+  ptr = out;
+  prevTime = prevValue = 0;
+
+  for (i = 0; i < count; ++i) {
+    ptr = putVarint(ptr, times[i] - prevTime);
+    prevTime = times[i];
+
+    if (type == STORE_TYPE_FLOAT) {
+      ptr = putVarint(ptr, values[i] ^ prevValue);
+    } else if (type != STORE_TYPE_TIME) {
+      ptr = putVarint(ptr, zigzag((int16_t)values[i] - (int16_t)prevValue));
+    }
+
+    prevValue = values[i];
+  }
+
+  return (ptr - out);
+}
+
+static bool decodeBlock(uint8_t type, uint8_t* data, int length, int count, uint32_t* times, uint32_t* values) {
+  uint8_t* ptr;
+  uint8_t* endPtr;
+  uint32_t prevTime;
+  uint32_t prevValue;
+  uint32_t wk;
+  int i;
+
+  ptr = data;
+  endPtr = data + length;
+  prevTime = prevValue = 0;
+
+  for (i = 0; i < count; ++i) {
+    if ((ptr = getVarint(ptr, endPtr, &wk)) == NULL) {
+      return (false);
+    }
+
+    times[i] = prevTime = prevTime + wk;
+
+    if (type == STORE_TYPE_TIME) {
+      values[i] = 0;
+      continue;
+    }
+
+    if ((ptr = getVarint(ptr, endPtr, &wk)) == NULL) {
+      return (false);
+    }
+
+    if (type == STORE_TYPE_FLOAT) {
+      prevValue ^= wk;
+    } else {
+      prevValue = (uint16_t)((int16_t)prevValue + unzigzag(wk));
+    }
+
+    values[i] = prevValue;
+  }
+
+  return (true);
+}
+
+static void columnAdd(storeColumn* col, uint32_t time, uint32_t value) {
+  if (col->scCount >= col->scSize) {
+    col->scSize = (col->scSize == 0) ? 64 : col->scSize * 2;
+
+    if (((col->scTimes = realloc(col->scTimes, col->scSize * sizeof(uint32_t))) == NULL) ||
+        ((col->scValues = realloc(col->scValues, col->scSize * sizeof(uint32_t))) == NULL)) {
+      printf("Error: Out of memory in the store!\n");
+      exit(1);
+    }
+  }
+
+  col->scTimes[col->scCount] = time;
+  col->scValues[col->scCount] = value;
+  ++col->scCount;
+}
+
+// Every column has a fixed slot: the six record values, then the chain
+// temperature sensors, then the four fields of each chain light sensor.
+#define STORE_BASE_COLUMNS 6
+#define STORE_COLUMNS (STORE_BASE_COLUMNS + TEMP_SENSOR_COUNT + (LIGHT_SENSOR_COUNT * LIGHT_SENSOR_FIELDS))
+#define STORE_TEMP_COLUMN(i) (STORE_BASE_COLUMNS + (i))
+#define STORE_LIGHT_COLUMN(i, j) (STORE_BASE_COLUMNS + TEMP_SENSOR_COUNT + ((i) * LIGHT_SENSOR_FIELDS) + (j))
+
+static const char* baseColumnNames[STORE_BASE_COLUMNS] = {
+  "time", "lat", "lon", "pressure", "temperature", "remotetemp"
+};
+
+// Return the column in slot ix, naming it the first time it is used.
+static storeColumn* columnAt(storeColumn* cols, int ix) {
+  storeColumn* col;
+  int sensor;
+
+  col = &cols[ix];
+
+  if (col->scName[0] != 0) {
+    return (col);
+  }
+
+  if (ix < STORE_BASE_COLUMNS) {
+    strcpy(col->scName, baseColumnNames[ix]);
+    col->scType = (ix == 0) ? STORE_TYPE_TIME : STORE_TYPE_FLOAT;
+  } else if (ix < STORE_LIGHT_COLUMN(0, 0)) {
+    snprintf(col->scName, sizeof(col->scName), "chaintemp%03d", ix - STORE_TEMP_COLUMN(0));
+    col->scType = STORE_TYPE_CHAIN;
+  } else {
+    sensor = ix - STORE_LIGHT_COLUMN(0, 0);
+    snprintf(col->scName, sizeof(col->scName), "chainlight%02d%c",
+             sensor / LIGHT_SENSOR_FIELDS, "crgb"[sensor % LIGHT_SENSOR_FIELDS]);
+    col->scType = STORE_TYPE_WORD;
+  }
+
+  return (col);
+}
+
+//*****************************************************************************
+//
+// gatherRecord
+//
+// Adds every value in a finished record to its column.
+//
+//*****************************************************************************
+
+static void gatherRecord(icedrifterData* idPtr, storeColumn* cols) {
+  uint32_t t;
+  int i;
+  int j;
+  int count;
+
+  t = (uint32_t)((time_t)idPtr->idGPSTime + SECONDS_IN_30_YEARS);
+
+  columnAdd(columnAt(cols, 0), t, 0);
+  columnAdd(columnAt(cols, 1), t, floatBits(idPtr->idLatitude));
+  columnAdd(columnAt(cols, 2), t, floatBits(idPtr->idLongitude));
+  columnAdd(columnAt(cols, 3), t, floatBits(idPtr->idPressure));
+
+  if (!(idPtr->idSwitches & HEARTBEAT_SWITCH)) {
+    columnAdd(columnAt(cols, 4), t, floatBits(idPtr->idTemperature));
+  }
+
+  if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+    columnAdd(columnAt(cols, 5), t, floatBits(idPtr->idRemoteTemp));
+  }
+
+  if (!(idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH)) {
+    return;
+  }
+
+  count = chainTempCount(idPtr);
+
+  for (i = 0; i < count; ++i) {
+    columnAdd(columnAt(cols, STORE_TEMP_COLUMN(i)), t, idPtr->idChainData.cdTempData[i]);
+  }
+
+  count = chainLightCount(idPtr);
+
+  for (i = 0; i < count; ++i) {
+    for (j = 0; j < LIGHT_SENSOR_FIELDS; ++j) {
+      columnAdd(columnAt(cols, STORE_LIGHT_COLUMN(i, j)), t, idPtr->idChainData.cdLightData[i][j]);
+    }
+  }
+}
+
+// Sort the values of a column by time.  A record that is decoded again has
+// the same time as before, so only the last value for each time is kept.
+// returns the number of values left.
+static int columnSort(uint32_t* times, uint32_t* values, int count) {
+  uint32_t t;
+  uint32_t v;
+  int i;
+  int j;
+  int k;
+
+  // The values are nearly always in order already.
+  for (i = 1; i < count; ++i) {
+    t = times[i];
+    v = values[i];
+
+    for (j = i; (j > 0) && (times[j - 1] > t); --j) {
+      times[j] = times[j - 1];
+      values[j] = values[j - 1];
+    }
+
+    times[j] = t;
+    values[j] = v;
+  }
+
+  for (i = k = 0; i < count; ++i) {
+    if ((k > 0) && (times[k - 1] == times[i])) {
+      values[k - 1] = values[i];
+    } else {
+      times[k] = times[i];
+      values[k++] = values[i];
+    }
+  }
+
+  return (k);
+}
+
+//*****************************************************************************
+//
+// columnWrite
+//
+// Appends the gathered values of one column to its column and index files.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int columnWrite(char* dirName, storeColumn* col) {
+  char colName[FILE_NAME_SIZE];
+  char idxName[FILE_NAME_SIZE];
+  FILE* colFd;
+  FILE* idxFd;
+  storeIndexEntry entry;
+  storeBlockHeader hdr;
+  uint8_t* data;
+  uint32_t* times;
+  uint32_t* values;
+  long idxSize;
+  int count;
+  int oldCount;
+  int n;
+  int i;
+
+  if ((snprintf(colName, sizeof(colName), "%s/%s.col", dirName, col->scName) >= (int)sizeof(colName)) ||
+      (snprintf(idxName, sizeof(idxName), "%s/%s.idx", dirName, col->scName) >= (int)sizeof(idxName))) {
+    printf("Error: Store file name in %s too long!\n", dirName);
+    return (1);
+  }
+
+  if (((colFd = fopen(colName, "r+b")) == NULL) && ((colFd = fopen(colName, "w+b")) == NULL)) {
+    printf("Error opening store file %s!\n", colName);
+    return (1);
+  }
+
+  if (((idxFd = fopen(idxName, "r+b")) == NULL) && ((idxFd = fopen(idxName, "w+b")) == NULL)) {
+    printf("Error opening store file %s!\n", idxName);
+    fclose(colFd);
+    return (1);
+  }
+
+  data = storeAlloc(STORE_BLOCK_MAX);
+  times = storeAlloc((col->scCount + STORE_BLOCK_RECORDS) * sizeof(uint32_t));
+  values = storeAlloc((col->scCount + STORE_BLOCK_RECORDS) * sizeof(uint32_t));
+  oldCount = 0;
+
+  // If the last block is not full, read it back so it can be merged with
+  // the new values and written again.
+  fseek(idxFd, 0, SEEK_END);
+  idxSize = ftell(idxFd);
+  idxSize -= idxSize % sizeof(storeIndexEntry);
+
+  if (idxSize > 0) {
+    fseek(idxFd, idxSize - sizeof(storeIndexEntry), SEEK_SET);
+
+    if ((fread(&entry, sizeof(entry), 1, idxFd) == 1) && (entry.siCount < STORE_BLOCK_RECORDS) &&
+        (entry.siLength <= sizeof(hdr) + STORE_BLOCK_MAX)) {
+      fseek(colFd, entry.siOffset, SEEK_SET);
+
+      if ((fread(&hdr, sizeof(hdr), 1, colFd) == 1) &&
+          (fread(data, hdr.sbLength, 1, colFd) == 1) &&
+          (hdr.sbType == col->scType) &&
+          decodeBlock(hdr.sbType, data, hdr.sbLength, hdr.sbCount, times, values)) {
+        oldCount = hdr.sbCount;
+        idxSize -= sizeof(storeIndexEntry);
+
+        if ((ftruncate(fileno(colFd), entry.siOffset) != 0) || (ftruncate(fileno(idxFd), idxSize) != 0)) {
+          printf("Error truncating store file %s!\n", colName);
+          oldCount = -1;
+        }
+      }
+    }
+  }
+
+  count = oldCount;
+
+  if (count >= 0) {
+    memcpy(&times[count], col->scTimes, col->scCount * sizeof(uint32_t));
+    memcpy(&values[count], col->scValues, col->scCount * sizeof(uint32_t));
+    count = columnSort(times, values, count + col->scCount);
+
+    fseek(colFd, 0, SEEK_END);
+    fseek(idxFd, idxSize, SEEK_SET);
+
+    for (i = 0; i < count; i += n) {
+      n = (count - i > STORE_BLOCK_RECORDS) ? STORE_BLOCK_RECORDS : count - i;
+
+      memcpy(hdr.sbMagic, "IDCB", 4);
+      hdr.sbType = col->scType;
+      hdr.sbSpare = 0;
+      hdr.sbCount = n;
+      hdr.sbMinTime = times[i];
+      hdr.sbMaxTime = times[i + n - 1];
+      hdr.sbLength = encodeBlock(col->scType, &times[i], &values[i], n, data);
+
+      entry.siMinTime = hdr.sbMinTime;
+      entry.siMaxTime = hdr.sbMaxTime;
+      entry.siOffset = ftell(colFd);
+      entry.siLength = sizeof(hdr) + hdr.sbLength;
+      entry.siCount = n;
+
+      if ((fwrite(&hdr, sizeof(hdr), 1, colFd) != 1) ||
+          (fwrite(data, hdr.sbLength, 1, colFd) != 1) ||
+          (fwrite(&entry, sizeof(entry), 1, idxFd) != 1)) {
+        printf("Error writing store file %s!\n", colName);
+        count = -1;
+        break;
+      }
+    }
+  }
+
+  free(data);
+  free(times);
+  free(values);
+
+  if ((fclose(colFd) != 0) | (fclose(idxFd) != 0)) {
+    count = -1;
+  }
+
+  return (count < 0);
+}
+
+static int makeDirectory(char* dirName) {
+  if ((mkdir(dirName, 0775) != 0) && (errno != EEXIST)) {
+    printf("Error creating store directory %s!\n", dirName);
+    return (1);
+  }
+
+  return (0);
+}
+
+//*****************************************************************************
+//
+// storeAppend
+//
+// storeDir: the directory holding the store.
+//
+// ctxList: finished records to add, sorted by Rockblock ID.
+//
+// count: the number of records in ctxList.
+//
+// Adds the records to the columns of their Rockblocks.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int storeAppend(char* storeDir, decodeContext** ctxList, int count) {
+  storeColumn* cols;
+  char dirName[FILE_NAME_SIZE];
+  int first;
+  int last;
+  int rc;
+  int i;
+
+  if (makeDirectory(storeDir) != 0) {
+    return (1);
+  }
+
+  cols = storeAlloc(STORE_COLUMNS * sizeof(storeColumn));
+  rc = 0;
+
+  for (first = 0; first < count; first = last) {
+    for (last = first + 1;
+         (last < count) && (strcmp(ctxList[last]->dcRockblockId, ctxList[first]->dcRockblockId) == 0);
+         ++last) {
+    }
+
+    if (snprintf(dirName, sizeof(dirName), "%s/%s", storeDir, ctxList[first]->dcRockblockId) >= (int)sizeof(dirName)) {
+      printf("Error: Store directory name in %s too long!\n", storeDir);
+      rc = 1;
+      continue;
+    }
+
+    if (makeDirectory(dirName) != 0) {
+      rc = 1;
+      continue;
+    }
+
+    memset(cols, 0, STORE_COLUMNS * sizeof(storeColumn));
+
+    for (i = first; i < last; ++i) {
+      gatherRecord(&ctxList[i]->dcData, cols);
+    }
+
+    for (i = 0; i < STORE_COLUMNS; ++i) {
+      if (cols[i].scCount != 0) {
+        rc |= columnWrite(dirName, &cols[i]);
+      }
+
+      free(cols[i].scTimes);
+      free(cols[i].scValues);
+    }
+  }
+
+  free(cols);
+  return (rc);
+}
+
+// Reads and decodes the block an index entry points to.  returns false if
+// the block is damaged.
+static bool readBlock(FILE* colFd, storeIndexEntry* entry, storeBlockHeader* hdr, uint8_t* data,
+                      uint32_t* times, uint32_t* values) {
+  fseek(colFd, entry->siOffset, SEEK_SET);
+
+  return ((fread(hdr, sizeof(storeBlockHeader), 1, colFd) == 1) && (memcmp(hdr->sbMagic, "IDCB", 4) == 0) &&
+          (hdr->sbCount <= STORE_BLOCK_RECORDS) && (hdr->sbLength <= STORE_BLOCK_MAX) &&
+          (fread(data, hdr->sbLength, 1, colFd) == 1) &&
+          decodeBlock(hdr->sbType, data, hdr->sbLength, hdr->sbCount, times, values));
+}
+
+//*****************************************************************************
+//
+// storeQuery
+//
+// Writes the values of one column of one Rockblock between fromTime and
+// toTime (unix times, inclusive) as CSV to out.  Only the blocks whose time
+// range overlaps the query are read.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int storeQuery(char* storeDir, char* rbId, char* column, uint32_t fromTime, uint32_t toTime, FILE* out) {
+  char colName[FILE_NAME_SIZE];
+  char idxName[FILE_NAME_SIZE];
+  char timeBuff[32];
+  FILE* colFd;
+  FILE* idxFd;
+  storeIndexEntry entry;
+  storeBlockHeader hdr;
+  struct tm timeInfo;
+  time_t tempTime;
+  uint8_t* data;
+  uint32_t times[STORE_BLOCK_RECORDS];
+  uint32_t values[STORE_BLOCK_RECORDS];
+  int rc;
+  int i;
+
+  if ((snprintf(colName, sizeof(colName), "%s/%s/%s.col", storeDir, rbId, column) >= (int)sizeof(colName)) ||
+      (snprintf(idxName, sizeof(idxName), "%s/%s/%s.idx", storeDir, rbId, column) >= (int)sizeof(idxName))) {
+    printf("Error: Store file name in %s too long!\n", storeDir);
+    return (1);
+  }
+
+  if ((idxFd = fopen(idxName, "rb")) == NULL) {
+    printf("Error: No column %s stored for Rockblock %s!\n", column, rbId);
+    return (1);
+  }
+
+  if ((colFd = fopen(colName, "rb")) == NULL) {
+    printf("Error opening store file %s!\n", colName);
+    fclose(idxFd);
+    return (1);
+  }
+
+  data = storeAlloc(STORE_BLOCK_MAX);
+  rc = 0;
+  fprintf(out, "time,%s\n", column);
+
+  while (fread(&entry, sizeof(entry), 1, idxFd) == 1) {
+    if ((entry.siMaxTime < fromTime) || (entry.siMinTime > toTime)) {
+      continue;
+    }
+
+    if (!readBlock(colFd, &entry, &hdr, data, times, values)) {
+      printf("Error: Damaged block at offset %llu in %s!\n", (unsigned long long)entry.siOffset, colName);
+      rc = 1;
+      break;
+    }
+
+    for (i = 0; i < hdr.sbCount; ++i) {
+      if ((times[i] < fromTime) || (times[i] > toTime)) {
+        continue;
+      }
+
+      tempTime = times[i];
+      gmtime_r(&tempTime, &timeInfo);
+      strftime(timeBuff, sizeof(timeBuff), "%Y-%m-%dT%H:%M:%SZ", &timeInfo);
+
+      if (hdr.sbType == STORE_TYPE_FLOAT) {
+        fprintf(out, "%s,%f\n", timeBuff, bitsFloat(values[i]));
+      } else if (hdr.sbType == STORE_TYPE_CHAIN) {
+        fprintf(out, "%s,%f\n", timeBuff, convertTempToC(values[i]));
+      } else if (hdr.sbType == STORE_TYPE_WORD) {
+        fprintf(out, "%s,%u\n", timeBuff, values[i]);
+      } else {
+        fprintf(out, "%s,\n", timeBuff);
+      }
+    }
+  }
+
+  free(data);
+  fclose(colFd);
+  fclose(idxFd);
+  return (rc);
+}
+
+//*****************************************************************************
+//
+// storeLoad
+//
+// Reads the values of one float column of one Rockblock between fromTime
+// and toTime (unix times, inclusive) into memory.  Only the blocks whose
+// time range overlaps the range are read.
+//
+// times, values: receive malloced arrays of the times and values, which
+// the caller frees.  They are NULL if there are no values.
+//
+// returns the number of values, or -1 if an error is detected.
+//
+//*****************************************************************************
+
+int storeLoad(char* storeDir, char* rbId, char* column, uint32_t fromTime, uint32_t toTime, uint32_t** times,
+              float** values) {
+  char colName[FILE_NAME_SIZE];
+  char idxName[FILE_NAME_SIZE];
+  FILE* colFd;
+  FILE* idxFd;
+  storeIndexEntry entry;
+  storeBlockHeader hdr;
+  uint8_t* data;
+  uint32_t blockTimes[STORE_BLOCK_RECORDS];
+  uint32_t blockValues[STORE_BLOCK_RECORDS];
+  int count;
+  int size;
+  int i;
+
+  *times = NULL;
+  *values = NULL;
+  if ((snprintf(colName, sizeof(colName), "%s/%s/%s.col", storeDir, rbId, column) >= (int)sizeof(colName)) ||
+      (snprintf(idxName, sizeof(idxName), "%s/%s/%s.idx", storeDir, rbId, column) >= (int)sizeof(idxName))) {
+    printf("Error: Store file name in %s too long!\n", storeDir);
+    return (-1);
+  }
+
+  if ((idxFd = fopen(idxName, "rb")) == NULL) {
+    return (0);
+  }
+
+  if ((colFd = fopen(colName, "rb")) == NULL) {
+    printf("Error opening store file %s!\n", colName);
+    fclose(idxFd);
+    return (-1);
+  }
+
+  data = storeAlloc(STORE_BLOCK_MAX);
+  count = size = 0;
+
+  while (fread(&entry, sizeof(entry), 1, idxFd) == 1) {
+    if ((entry.siMaxTime < fromTime) || (entry.siMinTime > toTime)) {
+      continue;
+    }
+
+    if (!readBlock(colFd, &entry, &hdr, data, blockTimes, blockValues) || (hdr.sbType != STORE_TYPE_FLOAT)) {
+      printf("Error: Damaged block at offset %llu in %s!\n", (unsigned long long)entry.siOffset, colName);
+      count = -1;
+      break;
+    }
+
+    if (count + hdr.sbCount > size) {
+      size = (size == 0) ? STORE_BLOCK_RECORDS * 4 : size * 2;
+      size = (size < count + hdr.sbCount) ? count + hdr.sbCount : size;
+
+      if (((*times = realloc(*times, size * sizeof(uint32_t))) == NULL) ||
+          ((*values = realloc(*values, size * sizeof(float))) == NULL)) {
+        printf("Error: Out of memory in the store!\n");
+        printf("idecode terminating.\n");
+        exit(1);
+      }
+    }
+
+    for (i = 0; i < hdr.sbCount; ++i) {
+      if ((blockTimes[i] >= fromTime) && (blockTimes[i] <= toTime)) {
+        (*times)[count] = blockTimes[i];
+        (*values)[count++] = bitsFloat(blockValues[i]);
+      }
+    }
+  }
+
+  if (count <= 0) {
+    free(*times);
+    free(*values);
+    *times = NULL;
+    *values = NULL;
+  }
+
+  free(data);
+  fclose(colFd);
+  fclose(idxFd);
+  return (count);
+}
+
+//*****************************************************************************
+//
+// parseDateTime
+//
+// str: a UTC date as yyyymmdd or a date and time as yyyymmddhhmmss.
+//
+// unixTime: receives the unix time.
+//
+// returns false if the date is not valid.
+//
+//*****************************************************************************
+
+bool parseDateTime(char* str, uint32_t* unixTime) {
+  struct tm timeInfo;
+  int len;
+
+  len = strlen(str);
+
+  if ((len != 8) && (len != 14)) {
+    return (false);
+  }
+
+  memset(&timeInfo, 0, sizeof(timeInfo));
+
+  if ((len == 8) && (sscanf(str, "%4d%2d%2d", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday) != 3)) {
+    return (false);
+  }
+
+  if ((len == 14) && (sscanf(str, "%4d%2d%2d%2d%2d%2d", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+                             &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec) != 6)) {
+    return (false);
+  }
+
+  timeInfo.tm_year -= 1900;
+  timeInfo.tm_mon -= 1;
+  *unixTime = (uint32_t)timegm(&timeInfo);
+  return (true);
+}
@@ -0,0 +1,48 @@
+//*****************************************************************************
+// store.h
+//
+// Append-only columnar store for decoded icedrifter records.
+//
+//*****************************************************************************
+
+#ifndef _STORE_H
+#define _STORE_H
+
+#include "idecode.h"
+
+#define STORE_BLOCK_RECORDS 256  // values per column block.
+#define STORE_NAME_SIZE 32       // size of a column name.
+
+// Column value encodings.
+#define STORE_TYPE_TIME  0  // time only, no values.
+#define STORE_TYPE_FLOAT 1  // float32, XOR with the previous value.
+#define STORE_TYPE_CHAIN 2  // raw chain temperature word, delta from the previous value.
+#define STORE_TYPE_WORD  3  // raw 16 bit word, delta from the previous value.
+
+// Every block in a column file starts with this header.
+typedef struct storeBlockHeader {
+  char sbMagic[4];     // "IDCB"
+  uint8_t sbType;      // STORE_TYPE_xxx
+  uint8_t sbSpare;
+  uint16_t sbCount;    // number of values in the block.
+  uint32_t sbMinTime;  // unix time of the first value.
+  uint32_t sbMaxTime;  // unix time of the last value.
+  uint32_t sbLength;   // bytes of encoded data after the header.
+} storeBlockHeader;
+
+// Each column file has an index file with one entry per block.
+typedef struct storeIndexEntry {
+  uint32_t siMinTime;
+  uint32_t siMaxTime;
+  uint64_t siOffset;  // offset of the block header in the column file.
+  uint32_t siLength;  // length of the block including its header.
+  uint32_t siCount;
+} storeIndexEntry;
+
+int storeAppend(char* storeDir, decodeContext** ctxList, int count);
+int storeQuery(char* storeDir, char* rbId, char* column, uint32_t fromTime, uint32_t toTime, FILE* out);
+int storeLoad(char* storeDir, char* rbId, char* column, uint32_t fromTime, uint32_t toTime, uint32_t** times,
+              float** values);
+bool parseDateTime(char* str, uint32_t* unixTime);
+
+#endif // _STORE_H
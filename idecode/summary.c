@@ -0,0 +1,411 @@
+//*****************************************************************************
+// summary.c
+//
+// Per-buoy summary for idecode.
+//
+// The summary file holds a small fixed size entry for each buoy with its
+// latest fix, the distance it has drifted, its drift speed and heading
+// between its last two fixes, running statistics of its temperatures and
+// pressure, and a count of the gaps between its reports.  Each decoded
+// record is folded into its buoy's entry, so keeping the summary costs the
+// same however long the deployment has run, and printing the fleet status
+// only reads the summary file.
+//
+// Reports are folded in in the order they were sent.  A report sent no
+// later than the latest one already summarized is left out, so decoding an
+// archive a second time does not count its reports twice.
+//
+// The summary is read the first time a record is added and written back,
+// through a temporary file, by summaryFlush.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "idecode.h"
+#include "summary.h"
+#include "convert.h"
+
+static buoySummary* summaryTable;  // NULL until the summary is read.
+static int summaryCount;
+static int summarySize;
+static bool summaryChanged;
+
+//*****************************************************************************
+//
+// summaryRead
+//
+// Reads a summary file into summaryTable.  A summary file that does not
+// exist yet is an empty summary.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int summaryRead(char* fileName) {
+  summaryHeader header;
+  FILE* fd;
+
+  summaryCount = 0;
+  summarySize = 64;
+
+  if ((summaryTable = malloc(summarySize * sizeof(buoySummary))) == NULL) {
+    printf("Error: Out of memory for the summary!\n");
+    return (1);
+  }
+
+  if ((fd = fopen(fileName, "rb")) == NULL) {
+    if (errno == ENOENT) {
+      return (0);
+    }
+
+    printf("Error: Unable to open summary file %s!\n", fileName);
+    return (1);
+  }
+
+  if ((fread(&header, sizeof(header), 1, fd) != 1) || (memcmp(header.shMagic, "IDSM", 4) != 0) ||
+      (header.shVersion != SUMMARY_VERSION) || (header.shEntrySize != sizeof(buoySummary))) {
+    printf("Error: %s is not an idecode summary file!\n", fileName);
+    fclose(fd);
+    return (1);
+  }
+
+  if (header.shCount > (uint32_t)summarySize) {
+    summarySize = header.shCount;
+
+    if ((summaryTable = realloc(summaryTable, summarySize * sizeof(buoySummary))) == NULL) {
+      printf("Error: Out of memory for the summary!\n");
+      fclose(fd);
+      return (1);
+    }
+  }
+
+  if (fread(summaryTable, sizeof(buoySummary), header.shCount, fd) != header.shCount) {
+    printf("Error reading summary file %s!\n", fileName);
+    fclose(fd);
+    return (1);
+  }
+
+  summaryCount = header.shCount;
+  fclose(fd);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// summaryFind
+//
+// returns the entry of a Rockblock, adding an empty one in Rockblock id
+// order if it has none yet.
+//
+//*****************************************************************************
+
+static buoySummary* summaryFind(char* rbId) {
+  buoySummary* bsPtr;
+  int low;
+  int high;
+  int mid;
+  int rc;
+
+  low = 0;
+  high = summaryCount;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+
+    if ((rc = strcmp(summaryTable[mid].bsRockblockId, rbId)) == 0) {
+      return (&summaryTable[mid]);
+    }
+
+    if (rc < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (summaryCount == summarySize) {
+    summarySize *= 2;
+
+    if ((summaryTable = realloc(summaryTable, summarySize * sizeof(buoySummary))) == NULL) {
+      printf("Error: Out of memory for the summary!\n");
+      printf("idecode terminating.\n");
+      exit(1);
+    }
+  }
+
+  bsPtr = &summaryTable[low];
+  memmove(bsPtr + 1, bsPtr, (summaryCount - low) * sizeof(buoySummary));
+  ++summaryCount;
+  memset(bsPtr, 0, sizeof(buoySummary));
+  strcpy(bsPtr->bsRockblockId, rbId);
+  return (bsPtr);
+}
+
+static void statAdd(summaryStat* ssPtr, float value) {
+  if ((ssPtr->ssCount == 0) || (value < ssPtr->ssMin)) {
+    ssPtr->ssMin = value;
+  }
+
+  if ((ssPtr->ssCount == 0) || (value > ssPtr->ssMax)) {
+    ssPtr->ssMax = value;
+  }
+
+  ssPtr->ssSum += value;
+  ++ssPtr->ssCount;
+}
+
+//*****************************************************************************
+//
+// summaryFix
+//
+// Moves a buoy's latest fix to a new one, adding the great circle distance
+// between them to the distance drifted and working out the drift speed and
+// heading.
+//
+//*****************************************************************************
+
+static void summaryFix(buoySummary* bsPtr, uint32_t fixTime, float latitude, float longitude) {
+  double lat1;
+  double lat2;
+  double dLat;
+  double dLon;
+  double a;
+  double km;
+
+  if (bsPtr->bsFixTime != 0) {
+    lat1 = bsPtr->bsLatitude * (M_PI / 180.0);
+    lat2 = latitude * (M_PI / 180.0);
+    dLat = lat2 - lat1;
+    dLon = (longitude - bsPtr->bsLongitude) * (M_PI / 180.0);
+
+    // Haversine distance and initial bearing.
+    a = sin(dLat / 2.0) * sin(dLat / 2.0) + cos(lat1) * cos(lat2) * sin(dLon / 2.0) * sin(dLon / 2.0);
+    km = 2.0 * EARTH_RADIUS_KM * atan2(sqrt(a), sqrt(1.0 - a));
+    bsPtr->bsDistance += km;
+    bsPtr->bsSpeed = (km * 1000.0) / (fixTime - bsPtr->bsFixTime);
+    bsPtr->bsHeading = fmod(atan2(sin(dLon) * cos(lat2), cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(dLon)) *
+                            (180.0 / M_PI) + 360.0, 360.0);
+  }
+
+  bsPtr->bsFixTime = fixTime;
+  bsPtr->bsLatitude = latitude;
+  bsPtr->bsLongitude = longitude;
+}
+
+//*****************************************************************************
+//
+// summaryAdd
+//
+// Folds one decoded record into its buoy's entry.
+//
+//*****************************************************************************
+
+static void summaryAdd(decodeContext* ctx) {
+  icedrifterData* idPtr;
+  buoySummary* bsPtr;
+  float temps[TEMP_SENSOR_COUNT];
+  uint32_t wait;
+  int count;
+  int i;
+
+  idPtr = &ctx->dcData;
+  bsPtr = summaryFind(ctx->dcRockblockId);
+
+  if (bsPtr->bsReports == 0) {
+    bsPtr->bsFirstSent = ctx->dcSendTime;
+  } else if (ctx->dcSendTime <= bsPtr->bsLastSent) {
+    return;
+  } else {
+    wait = ctx->dcSendTime - bsPtr->bsLastSent;
+
+    if (wait > SUMMARY_GAP_SECONDS) {
+      ++bsPtr->bsGaps;
+    }
+
+    if (wait > bsPtr->bsLongestGap) {
+      bsPtr->bsLongestGap = wait;
+    }
+  }
+
+  bsPtr->bsLastSent = ctx->dcSendTime;
+  ++bsPtr->bsReports;
+
+  // A heartbeat has no temperature.
+  if (!(idPtr->idSwitches & HEARTBEAT_SWITCH)) {
+    statAdd(&bsPtr->bsTemperature, idPtr->idTemperature);
+  }
+
+  statAdd(&bsPtr->bsPressure, idPtr->idPressure);
+
+  if (idPtr->idSwitches & PROCESS_REMOTE_TEMP_SWITCH) {
+    statAdd(&bsPtr->bsRemoteTemp, idPtr->idRemoteTemp);
+  }
+
+  if (idPtr->idSwitches & PROCESS_CHAIN_DATA_SWITCH) {
+    count = chainTempCount(idPtr);
+    convertTempsToC(idPtr->idChainData.cdTempData, count, temps, false);
+
+    for (i = 0; i < count; ++i) {
+      statAdd(&bsPtr->bsChainTemp, temps[i]);
+    }
+  }
+
+  // A record without a fix has no position, and one whose GPS time has
+  // not moved on repeats the last fix.
+  if (((idPtr->idLatitude != 0.0) || (idPtr->idLongitude != 0.0)) && (idPtr->idGPSTime > bsPtr->bsFixTime)) {
+    summaryFix(bsPtr, idPtr->idGPSTime, idPtr->idLatitude, idPtr->idLongitude);
+  }
+}
+
+//*****************************************************************************
+//
+// summaryUpdate
+//
+// ctxList: finished records to fold into the summary.
+//
+// count: number of records in ctxList.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int summaryUpdate(decodeContext** ctxList, int count) {
+  int i;
+
+  if ((summaryTable == NULL) && (summaryRead(summaryFileName) != 0)) {
+    free(summaryTable);
+    summaryTable = NULL;
+    return (1);
+  }
+
+  for (i = 0; i < count; ++i) {
+    summaryAdd(ctxList[i]);
+  }
+
+  summaryChanged |= (count != 0);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// summaryFlush
+//
+// Writes the summary file if the summary has changed.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int summaryFlush(void) {
+  char tempName[FILE_NAME_SIZE];
+  summaryHeader header;
+  FILE* fd;
+  int rc;
+
+  if (!summaryChanged) {
+    return (0);
+  }
+
+  snprintf(tempName, sizeof(tempName), "%s.tmp", summaryFileName);
+
+  if ((fd = fopen(tempName, "wb")) == NULL) {
+    printf("Error: Unable to create summary file %s!\n", tempName);
+    return (1);
+  }
+
+  memcpy(header.shMagic, "IDSM", 4);
+  header.shVersion = SUMMARY_VERSION;
+  header.shEntrySize = sizeof(buoySummary);
+  header.shCount = summaryCount;
+
+  rc = (fwrite(&header, sizeof(header), 1, fd) != 1) ||
+       (fwrite(summaryTable, sizeof(buoySummary), summaryCount, fd) != (size_t)summaryCount) ||
+       (fflush(fd) != 0) || (fsync(fileno(fd)) != 0);
+
+  if ((fclose(fd) != 0) || rc || (rename(tempName, summaryFileName) != 0)) {
+    printf("Error writing summary file %s!\n", summaryFileName);
+    unlink(tempName);
+    return (1);
+  }
+
+  summaryChanged = false;
+  return (0);
+}
+
+static char* summaryTime(char* buff, int size, uint32_t driftTime) {
+  struct tm timeInfo;
+  time_t tempTime;
+
+  tempTime = (time_t)driftTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
+  strftime(buff, size, "%Y-%m-%dT%H:%M:%SZ", &timeInfo);
+  return (buff);
+}
+
+static void printStat(FILE* out, summaryStat* ssPtr) {
+  if (ssPtr->ssCount == 0) {
+    fprintf(out, ",,,");
+  } else {
+    fprintf(out, ",%.4f,%.4f,%.4f", ssPtr->ssMin, ssPtr->ssMax, ssPtr->ssSum / ssPtr->ssCount);
+  }
+}
+
+//*****************************************************************************
+//
+// summaryPrint
+//
+// fileName: the summary file.
+//
+// Prints the status of every buoy in the summary as CSV, one row per buoy.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+int summaryPrint(char* fileName, FILE* out) {
+  char firstBuff[32];
+  char lastBuff[32];
+  char fixBuff[32];
+  buoySummary* bsPtr;
+  int i;
+
+  if (summaryRead(fileName) != 0) {
+    return (1);
+  }
+
+  fprintf(out, "rockblock,reports,first,last,fixtime,lat,lon,distancekm,speedms,heading,gaps,longestgaph,"
+          "mintemperature,maxtemperature,meantemperature,minpressure,maxpressure,meanpressure,"
+          "minremotetemp,maxremotetemp,meanremotetemp,minchaintemp,maxchaintemp,meanchaintemp\n");
+
+  for (i = 0; i < summaryCount; ++i) {
+    bsPtr = &summaryTable[i];
+    fprintf(out, "%s,%u,%s,%s,", bsPtr->bsRockblockId, bsPtr->bsReports,
+            summaryTime(firstBuff, sizeof(firstBuff), bsPtr->bsFirstSent),
+            summaryTime(lastBuff, sizeof(lastBuff), bsPtr->bsLastSent));
+
+    if (bsPtr->bsFixTime == 0) {
+      fprintf(out, ",,,,,");
+    } else {
+      fprintf(out, "%s,%.6f,%.6f,%.3f,%.4f,%.1f", summaryTime(fixBuff, sizeof(fixBuff), bsPtr->bsFixTime),
+              bsPtr->bsLatitude, bsPtr->bsLongitude, bsPtr->bsDistance, bsPtr->bsSpeed, bsPtr->bsHeading);
+    }
+
+    fprintf(out, ",%u,%.1f", bsPtr->bsGaps, bsPtr->bsLongestGap / 3600.0);
+    printStat(out, &bsPtr->bsTemperature);
+    printStat(out, &bsPtr->bsPressure);
+    printStat(out, &bsPtr->bsRemoteTemp);
+    printStat(out, &bsPtr->bsChainTemp);
+    fprintf(out, "\n");
+  }
+
+  free(summaryTable);
+  summaryTable = NULL;
+  return (0);
+}
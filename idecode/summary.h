@@ -0,0 +1,57 @@
+//*****************************************************************************
+// summary.h
+//
+// Per-buoy summary kept up to date as records are decoded.
+//
+//*****************************************************************************
+
+#ifndef _SUMMARY_H
+#define _SUMMARY_H
+
+#include "idecode.h"
+
+#define SUMMARY_VERSION 1
+#define SUMMARY_GAP_SECONDS (12 * 60 * 60)  // a longer wait between reports is a gap.
+
+// Running statistics of one value.
+typedef struct summaryStat {
+  float ssMin;
+  float ssMax;
+  double ssSum;
+  uint32_t ssCount;
+} summaryStat;
+
+// Everything the fleet status needs to know about one buoy.
+typedef struct buoySummary {
+  char bsRockblockId[ROCKBLOCK_ID_SIZE];
+  uint32_t bsFirstSent;  // icedrifter send time of the first report.
+  uint32_t bsLastSent;   // icedrifter send time of the latest report.
+  uint32_t bsReports;    // reports summarized.
+  uint32_t bsGaps;       // waits between reports longer than SUMMARY_GAP_SECONDS.
+  uint32_t bsLongestGap; // seconds.
+  uint32_t bsFixTime;    // icedrifter GPS time of the latest fix.
+  float bsLatitude;      // latest fix.
+  float bsLongitude;
+  float bsSpeed;         // drift in m/s between the last two fixes.
+  float bsHeading;       // degrees true between the last two fixes.
+  double bsDistance;     // km drifted along the fixes.
+  summaryStat bsTemperature;
+  summaryStat bsPressure;
+  summaryStat bsRemoteTemp;
+  summaryStat bsChainTemp;  // every chain temperature sensor.
+} buoySummary;
+
+// The summary file is this header followed by a buoySummary for each buoy
+// in Rockblock id order.
+typedef struct summaryHeader {
+  char shMagic[4];       // "IDSM"
+  uint16_t shVersion;    // SUMMARY_VERSION
+  uint16_t shEntrySize;  // sizeof(buoySummary)
+  uint32_t shCount;      // number of buoys.
+} summaryHeader;
+
+int summaryUpdate(decodeContext** ctxList, int count);
+int summaryFlush(void);
+int summaryPrint(char* fileName, FILE* out);
+
+#endif // _SUMMARY_H
@@ -0,0 +1,313 @@
+//*****************************************************************************
+// threadpool.c
+//
+// Work-stealing thread pool.
+//
+// Each worker has its own deque of tasks.  A worker takes new work from the
+// bottom of its own deque and, when that is empty, steals the oldest task
+// from the top of another worker's deque.  Tasks submitted from inside a
+// task go on the submitting worker's deque so related work stays on the
+// same core; tasks submitted from outside the pool are dealt out round
+// robin.  tpWait blocks until every submitted task has finished.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+typedef struct tpTask {
+  tpTaskFunc ttFunc;
+  void* ttArg;
+} tpTask;
+
+typedef struct tpDeque {
+  pthread_mutex_t tdLock;
+  tpTask* tdTasks;   // ring buffer of tasks.
+  int tdSize;        // size of the ring buffer, always a power of two.
+  int tdTop;         // index of the oldest task, where thieves take from.
+  int tdBottom;      // index past the newest task, where the owner works.
+} tpDeque;
+
+typedef struct tpWorker {
+  threadPool* twPool;
+  pthread_t twThread;
+  int twIndex;
+} tpWorker;
+
+struct threadPool {
+  int tpThreads;
+  tpDeque* tpDeques;
+  tpWorker* tpWorkers;
+  pthread_mutex_t tpLock;
+  pthread_cond_t tpWorkCond;  // signalled when tasks are submitted.
+  pthread_cond_t tpDoneCond;  // signalled when the last pending task finishes.
+  int tpQueued;               // tasks sitting in deques.
+  int tpPending;              // tasks submitted but not finished.
+  int tpNextDeque;            // round robin index for outside submissions.
+  int tpShutdown;
+};
+
+// Index of the worker running on this thread, or -1 outside the pool.
+static __thread int tpSelf = -1;
+static __thread threadPool* tpSelfPool = NULL;
+
+static void tpPush(tpDeque* dq, tpTaskFunc func, void* arg) {
+  tpTask* newTasks;
+  int count;
+  int i;
+
+  pthread_mutex_lock(&dq->tdLock);
+
+  count = dq->tdBottom - dq->tdTop;
+
+  if (count == dq->tdSize) {
+    if ((newTasks = malloc(dq->tdSize * 2 * sizeof(tpTask))) == NULL) {
+      printf("Error: Out of memory for the thread pool!\n");
+      exit(1);
+    }
+
+    for (i = 0; i < count; ++i) {
+      newTasks[i] = dq->tdTasks[(dq->tdTop + i) & (dq->tdSize - 1)];
+    }
+
+    free(dq->tdTasks);
+    dq->tdTasks = newTasks;
+    dq->tdSize *= 2;
+    dq->tdTop = 0;
+    dq->tdBottom = count;
+  }
+
+  dq->tdTasks[dq->tdBottom & (dq->tdSize - 1)].ttFunc = func;
+  dq->tdTasks[dq->tdBottom & (dq->tdSize - 1)].ttArg = arg;
+  ++dq->tdBottom;
+
+  pthread_mutex_unlock(&dq->tdLock);
+}
+
+// Take the newest task from the bottom (own deque) or the oldest from the
+// top (stealing).  Returns 0 if the deque is empty.
+static int tpTake(tpDeque* dq, tpTask* task, int steal) {
+  int found;
+
+  found = 0;
+  pthread_mutex_lock(&dq->tdLock);
+
+  if (dq->tdBottom != dq->tdTop) {
+    if (steal) {
+      *task = dq->tdTasks[dq->tdTop & (dq->tdSize - 1)];
+      ++dq->tdTop;
+    } else {
+      --dq->tdBottom;
+      *task = dq->tdTasks[dq->tdBottom & (dq->tdSize - 1)];
+    }
+
+    found = 1;
+  }
+
+  pthread_mutex_unlock(&dq->tdLock);
+  return (found);
+}
+
+static int tpFindTask(threadPool* pool, int self, tpTask* task) {
+  int i;
+
+  if (tpTake(&pool->tpDeques[self], task, 0)) {
+    return (1);
+  }
+
+  for (i = 1; i < pool->tpThreads; ++i) {
+    if (tpTake(&pool->tpDeques[(self + i) % pool->tpThreads], task, 1)) {
+      return (1);
+    }
+  }
+
+  return (0);
+}
+
+static void* tpWorkerMain(void* arg) {
+  tpWorker* worker = arg;
+  threadPool* pool = worker->twPool;
+  tpTask task;
+
+  tpSelf = worker->twIndex;
+  tpSelfPool = pool;
+
+  while (1) {
+    pthread_mutex_lock(&pool->tpLock);
+
+    while ((pool->tpQueued == 0) && !pool->tpShutdown) {
+      pthread_cond_wait(&pool->tpWorkCond, &pool->tpLock);
+    }
+
+    if ((pool->tpQueued == 0) && pool->tpShutdown) {
+      pthread_mutex_unlock(&pool->tpLock);
+      break;
+    }
+
+    pthread_mutex_unlock(&pool->tpLock);
+
+    if (!tpFindTask(pool, worker->twIndex, &task)) {
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->tpLock);
+    --pool->tpQueued;
+    pthread_mutex_unlock(&pool->tpLock);
+
+    task.ttFunc(task.ttArg);
+
+    pthread_mutex_lock(&pool->tpLock);
+
+    if (--pool->tpPending == 0) {
+      pthread_cond_broadcast(&pool->tpDoneCond);
+    }
+
+    pthread_mutex_unlock(&pool->tpLock);
+  }
+
+  return (NULL);
+}
+
+//*****************************************************************************
+//
+// tpCreate
+//
+// threads: the number of worker threads to start.
+//
+// returns the new pool.
+//
+//*****************************************************************************
+
+threadPool* tpCreate(int threads) {
+  threadPool* pool;
+  int i;
+
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  if (((pool = calloc(1, sizeof(threadPool))) == NULL) ||
+      ((pool->tpDeques = calloc(threads, sizeof(tpDeque))) == NULL) ||
+      ((pool->tpWorkers = calloc(threads, sizeof(tpWorker))) == NULL)) {
+    printf("Error: Out of memory for the thread pool!\n");
+    exit(1);
+  }
+
+  pool->tpThreads = threads;
+  pthread_mutex_init(&pool->tpLock, NULL);
+  pthread_cond_init(&pool->tpWorkCond, NULL);
+  pthread_cond_init(&pool->tpDoneCond, NULL);
+
+  for (i = 0; i < threads; ++i) {
+    pthread_mutex_init(&pool->tpDeques[i].tdLock, NULL);
+    pool->tpDeques[i].tdSize = 64;
+
+    if ((pool->tpDeques[i].tdTasks = malloc(64 * sizeof(tpTask))) == NULL) {
+      printf("Error: Out of memory for the thread pool!\n");
+      exit(1);
+    }
+  }
+
+  for (i = 0; i < threads; ++i) {
+    pool->tpWorkers[i].twPool = pool;
+    pool->tpWorkers[i].twIndex = i;
+
+    if (pthread_create(&pool->tpWorkers[i].twThread, NULL, tpWorkerMain, &pool->tpWorkers[i]) != 0) {
+      printf("Error: Unable to start decoder thread %d!\n", i);
+      exit(1);
+    }
+  }
+
+  return (pool);
+}
+
+//*****************************************************************************
+//
+// tpSubmit
+//
+// Queues func(arg) to be run by one of the pool's threads.
+//
+//*****************************************************************************
+
+void tpSubmit(threadPool* pool, tpTaskFunc func, void* arg) {
+  int ix;
+
+  // The task is counted before it is pushed, so a worker that takes it
+  // as soon as it lands can never drive tpQueued below 0.
+  pthread_mutex_lock(&pool->tpLock);
+  ++pool->tpPending;
+  ++pool->tpQueued;
+
+  if ((tpSelfPool == pool) && (tpSelf >= 0)) {
+    ix = tpSelf;
+  } else {
+    ix = pool->tpNextDeque;
+    pool->tpNextDeque = (pool->tpNextDeque + 1) % pool->tpThreads;
+  }
+
+  pthread_mutex_unlock(&pool->tpLock);
+
+  tpPush(&pool->tpDeques[ix], func, arg);
+
+  pthread_mutex_lock(&pool->tpLock);
+  pthread_cond_signal(&pool->tpWorkCond);
+  pthread_mutex_unlock(&pool->tpLock);
+}
+
+//*****************************************************************************
+//
+// tpWait
+//
+// Blocks until every task submitted to the pool, including tasks submitted
+// by other tasks, has finished.  Must not be called from a pool thread.
+//
+//*****************************************************************************
+
+void tpWait(threadPool* pool) {
+  pthread_mutex_lock(&pool->tpLock);
+
+  while (pool->tpPending != 0) {
+    pthread_cond_wait(&pool->tpDoneCond, &pool->tpLock);
+  }
+
+  pthread_mutex_unlock(&pool->tpLock);
+}
+
+void tpDestroy(threadPool* pool) {
+  int i;
+
+  tpWait(pool);
+
+  pthread_mutex_lock(&pool->tpLock);
+  pool->tpShutdown = 1;
+  pthread_cond_broadcast(&pool->tpWorkCond);
+  pthread_mutex_unlock(&pool->tpLock);
+
+  for (i = 0; i < pool->tpThreads; ++i) {
+    pthread_join(pool->tpWorkers[i].twThread, NULL);
+  }
+
+  for (i = 0; i < pool->tpThreads; ++i) {
+    pthread_mutex_destroy(&pool->tpDeques[i].tdLock);
+    free(pool->tpDeques[i].tdTasks);
+  }
+
+  pthread_mutex_destroy(&pool->tpLock);
+  pthread_cond_destroy(&pool->tpWorkCond);
+  pthread_cond_destroy(&pool->tpDoneCond);
+  free(pool->tpDeques);
+  free(pool->tpWorkers);
+  free(pool);
+}
+
+// Number of threads to use when none is asked for: one per online core.
+int tpDefaultThreads(void) {
+  long cores;
+
+  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return (cores < 1 ? 1 : (int)cores);
+}
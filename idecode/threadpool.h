@@ -0,0 +1,22 @@
+//*****************************************************************************
+// threadpool.h
+//
+// A small work-stealing thread pool used by the decoder to spread work over
+// all of the cores of the machine.
+//
+//*****************************************************************************
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+typedef void (*tpTaskFunc)(void* arg);
+
+typedef struct threadPool threadPool;
+
+threadPool* tpCreate(int threads);
+void tpSubmit(threadPool* pool, tpTaskFunc func, void* arg);
+void tpWait(threadPool* pool);
+void tpDestroy(threadPool* pool);
+int tpDefaultThreads(void);
+
+#endif // _THREADPOOL_H
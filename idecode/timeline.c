@@ -0,0 +1,206 @@
+//*****************************************************************************
+// timeline.c
+//
+// Event trace records for idecode.
+//
+// After something goes wrong, such as a watchdog reset or a failed send,
+// the icedrifter sends the most recent events from its EEPROM trace in a
+// chunk of its own with record type "TR".  Each event is a time, an event
+// code and a one byte value.  A trace chunk is written out as a timeline,
+// one line per event, to <Rockblock id>-<yyyymmddhhmmss>.trc next to the
+// decoded reports.
+//
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "idecode.h"
+#include "timeline.h"
+
+static const char* railNames[] = {"?", "sensor and GPS", "RockBLOCK", "chain"};
+static const char* bootNames[] = {"unknown", "power on", "reset button", "brownout", "watchdog"};
+
+#define NAME_OF(names, value) \
+  (((value) < sizeof(names) / sizeof(names[0])) ? names[value] : "?")
+
+//*****************************************************************************
+//
+// timelineChunk
+//
+// returns true if the chunk is an event trace record.
+//
+//*****************************************************************************
+
+bool timelineChunk(iceDrifterChunk* idcPtr) {
+  return ((idcPtr->idcRecordType[0] == TRACE_RECORD_TYPE_0) && (idcPtr->idcRecordType[1] == TRACE_RECORD_TYPE_1));
+}
+
+// Prints an icedrifter time, or the seconds since boot if the icedrifter
+// did not have the time yet.
+static void timelineTime(uint32_t time, FILE* fd) {
+  struct tm timeInfo;
+  time_t tempTime;
+  char timeBuff[32];
+
+  if (time < TIMELINE_RELATIVE_LIMIT) {
+    snprintf(timeBuff, sizeof(timeBuff), "boot + %lus", (unsigned long)time);
+  } else {
+    tempTime = (time_t)time + SECONDS_IN_30_YEARS;
+    gmtime_r(&tempTime, &timeInfo);
+    strftime(timeBuff, sizeof(timeBuff), "%Y-%m-%d %H:%M:%S", &timeInfo);
+  }
+
+  fprintf(fd, "%-19s", timeBuff);
+}
+
+// Prints what an event means.
+static void timelineEvent(int event, unsigned int value, FILE* fd) {
+  switch (event) {
+    case TRACE_BOOT:
+      fprintf(fd, "boot, last reset %s\n", NAME_OF(bootNames, value));
+      break;
+
+    case TRACE_WAKE:
+      fprintf(fd, "wake up\n");
+      break;
+
+    case TRACE_SLEEP:
+      fprintf(fd, "sleep %u minutes\n", value);
+      break;
+
+    case TRACE_POWER_ON:
+      fprintf(fd, "%s power on\n", NAME_OF(railNames, value));
+      break;
+
+    case TRACE_POWER_OFF:
+      fprintf(fd, "%s power off\n", NAME_OF(railNames, value));
+      break;
+
+    case TRACE_FIX:
+      fprintf(fd, value ? "GPS fix found\n" : "no GPS fix\n");
+      break;
+
+    case TRACE_CHAIN_TEMP:
+      fprintf(fd, "chain sent %u temperature sensors\n", value);
+      break;
+
+    case TRACE_CHAIN_LIGHT:
+      fprintf(fd, "chain sent %u light sensors\n", value);
+      break;
+
+    case TRACE_CHAIN_ERROR:
+      fprintf(fd, "chain error 0x%02x\n", value);
+      break;
+
+    case TRACE_ISBD_BEGIN:
+      fprintf(fd, "RockBLOCK begin, return code %u%s\n", value, value ? " !!!" : "");
+      break;
+
+    case TRACE_ISBD_SEND:
+      fprintf(fd, "RockBLOCK send, return code %u%s\n", value, value ? " !!!" : "");
+      break;
+
+    default:
+      fprintf(fd, "unknown event %d, value %u\n", event, value);
+      break;
+  }
+}
+
+//*****************************************************************************
+//
+// timelinePrint
+//
+// idcPtr, length: the trace chunk and the number of bytes after its header.
+//
+// fd: where to print the timeline.
+//
+//*****************************************************************************
+
+void timelinePrint(iceDrifterChunk* idcPtr, int length, FILE* fd) {
+  uint8_t* wkPtr;
+  uint32_t time;
+  uint32_t lastTime;
+  int event;
+  int count;
+  int i;
+
+  count = 0;
+
+  for (i = 0; i + TRACE_EVENT_SIZE <= length; i += TRACE_EVENT_SIZE) {
+    count += ((idcPtr->idcBuffer[i + 4] & TRACE_EVENT_MASK) != TRACE_EMPTY);
+  }
+
+  fprintf(fd, "Event trace sent ");
+  timelineTime(idcPtr->idcSendTime, fd);
+  fprintf(fd, ", %d events\n\n", count);
+  lastTime = 0;
+
+  for (i = 0; i + TRACE_EVENT_SIZE <= length; i += TRACE_EVENT_SIZE) {
+    wkPtr = idcPtr->idcBuffer + i;
+    time = wkPtr[0] | (wkPtr[1] << 8) | (wkPtr[2] << 16) | ((uint32_t)wkPtr[3] << 24);
+    event = wkPtr[4] & TRACE_EVENT_MASK;
+
+    if (event == TRACE_EMPTY) {
+      continue;
+    }
+
+    // The time since the event before makes long steps easy to spot.  It
+    // is left out where the clock was set or restarted.
+    timelineTime(time, fd);
+
+    if ((i == 0) || (time < lastTime) || (event == TRACE_BOOT) ||
+        ((lastTime < TIMELINE_RELATIVE_LIMIT) != (time < TIMELINE_RELATIVE_LIMIT))) {
+      fprintf(fd, "           ");
+    } else {
+      fprintf(fd, " %+7lds  ", (long)(time - lastTime));
+    }
+
+    timelineEvent(event, wkPtr[5], fd);
+    lastTime = time;
+  }
+}
+
+//*****************************************************************************
+//
+// timelineWrite
+//
+// rbId: the Rockblock id the trace came from.
+//
+// idcPtr, length: the trace chunk and the number of bytes after its header.
+//
+// message, size: receives the console message.
+//
+// Writes the timeline to <Rockblock id>-<yyyymmddhhmmss>.trc.
+//
+// returns 0 for good completion and non-zero if the file could not be
+// written.
+//
+//*****************************************************************************
+
+int timelineWrite(char* rbId, iceDrifterChunk* idcPtr, int length, char* message, int size) {
+  struct tm timeInfo;
+  time_t tempTime;
+  char sendTime[GPS_TIME_SIZE];
+  char fileName[FILE_NAME_SIZE];
+  FILE* fd;
+
+  tempTime = (time_t)idcPtr->idcSendTime + SECONDS_IN_30_YEARS;
+  gmtime_r(&tempTime, &timeInfo);
+  sendTime[0] = 0;
+  strftime(sendTime, sizeof(sendTime), "%Y%m%d%H%M%S", &timeInfo);
+  snprintf(fileName, sizeof(fileName), "%s-%s.trc", rbId, sendTime);
+
+  if ((fd = fopen(fileName, "w")) == NULL) {
+    snprintf(message, size, "Unable to write trace file %s!\n", fileName);
+    return (1);
+  }
+
+  fprintf(fd, "Rockblock %s\n", rbId);
+  timelinePrint(idcPtr, length, fd);
+  fclose(fd);
+  snprintf(message, size, "Event trace from Rockblock %s written to %s.\n", rbId, fileName);
+  return (0);
+}
@@ -0,0 +1,20 @@
+//*****************************************************************************
+// timeline.h
+//
+// Renders the event trace records sent by the icedrifter as a timeline.
+//
+//*****************************************************************************
+
+#ifndef _TIMELINE_H
+#define _TIMELINE_H
+
+#include "idecode.h"
+
+// Event times below this are seconds since boot, not icedrifter time.
+#define TIMELINE_RELATIVE_LIMIT (365 * 24 * 60 * 60)
+
+bool timelineChunk(iceDrifterChunk* idcPtr);
+void timelinePrint(iceDrifterChunk* idcPtr, int length, FILE* fd);
+int timelineWrite(char* rbId, iceDrifterChunk* idcPtr, int length, char* message, int size);
+
+#endif // _TIMELINE_H
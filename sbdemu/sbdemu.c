@@ -0,0 +1,849 @@
+//*****************************************************************************
+// sbdemu.c
+//
+// RockBLOCK emulator.
+//
+// Answers the SBD AT commands the IridiumSBD library sends to a RockBLOCK
+// (AT+SBDWB, AT+SBDIX, AT+CSQ, AT+SBDRB, AT*F, ...) with a link model in
+// place of the sky, so changes to the icedrifter transmit path can be
+// measured on the bench without a modem or a view of the sky.
+//
+// The emulator talks through one of:
+//
+//   a pty        the default.  The slave name is printed, and -L makes a
+//                symlink to it, for a host build of the transmit code.
+//   a serial     -d <device>, for an icedrifter board whose RockBLOCK pins
+//   device       are wired to a USB serial adapter.
+//   stdin/stdout -d -, for a stubbed stream.
+//
+// The link model:
+//
+//   -r  seconds from power up until the modem has network service.
+//   -q  signal quality 0 to 5, or -T a trace file of "<seconds> <quality>"
+//       lines giving the quality from that many seconds after power up.
+//   -p  percent chance a session fails even with network and signal.
+//   -s  seconds a session takes, -f seconds a failed session takes.
+//   -t  a file to deliver as an MT message, may be given more than once.
+//       The messages are queued at the gateway and delivered one per
+//       successful session.
+//
+// A run lasts from the first command after the modem is idle until AT*F,
+// which the library sends before the modem is put to sleep, or until the
+// other end closes.  For each run a CSV line is written to the -l log:
+// the seconds the modem was powered, the seconds in sessions, the session
+// attempts, the messages sent and failed, the MO and MT bytes, and the
+// energy used at the RockBLOCK 9603 idle and mean transmit currents.
+// Failures are drawn from a generator seeded by -S plus the run number, so
+// run N sees the same link every time.
+//
+// Delays are real time so the transmit code's own waits count as powered
+// time.  -x <factor> runs the emulator's clock that many times faster.
+//
+// Build with:
+//
+//   gcc -O2 -o sbdemu sbdemu.c
+//
+// Run with:
+//
+//   sbdemu [-d <device> | -] [-L <link>] [-l <log>] [-r <seconds>]
+//          [-q <quality> | -T <trace file>] [-p <fail percent>]
+//          [-s <seconds>] [-f <seconds>] [-t <MT file>]... [-S <seed>]
+//          [-x <factor>] [-v]
+//
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NAME_SIZE 1024
+#define COMMAND_SIZE 512
+#define SBD_MO_SIZE 340         // largest MO message.
+#define SBD_MT_SIZE 270         // largest MT message.
+#define MAX_MT_FILES 64
+#define MAX_TRACE 4096
+#define BINARY_TIMEOUT 60.0     // seconds the modem waits for AT+SBDWB data.
+#define IRIDIUM_EPOCH 1399818235  // 2014-05-11 14:23:55 UTC, -MSSTM tick 0.
+#define DEFAULT_IMEI "300234010000000"
+
+// RockBLOCK 9603 supply and currents.
+#define SUPPLY_VOLTS 5.0
+#define IDLE_AMPS 0.034     // powered, not in a session.
+#define SESSION_AMPS 0.145  // mean over an SBD session.
+
+// +SBDIX MO status values used by the link model.
+#define MO_SENT 0
+#define MO_RF_DROP 18        // connection lost.
+#define MO_NO_SERVICE 32     // no network service.
+
+typedef struct traceEntry {
+  double teSeconds;
+  int teQuality;
+} traceEntry;
+
+// Everything the link model is set up with.
+typedef struct linkModel {
+  double lmRegistration;   // seconds from power up to network service.
+  int lmQuality;           // used when there is no trace.
+  traceEntry lmTrace[MAX_TRACE];
+  int lmTraceCount;
+  double lmFailPercent;
+  double lmSessionSeconds;
+  double lmFailSeconds;
+  char* lmMtFiles[MAX_MT_FILES];
+  int lmMtCount;
+  uint64_t lmSeed;
+  double lmSpeed;          // emulator clock speed.
+} linkModel;
+
+// The state of the emulated modem and the run it is in.
+typedef struct modemState {
+  int msInFd;
+  int msOutFd;
+  uint8_t msIn[256];       // bytes read and not yet looked at.
+  int msInLength;
+  int msInNext;
+  bool msEcho;
+  char msCommand[COMMAND_SIZE];
+  int msCommandLength;
+
+  uint8_t msMo[SBD_MO_SIZE];
+  int msMoLength;
+  uint8_t msMt[SBD_MT_SIZE];
+  int msMtLength;
+  int msMomsn;
+  int msMtmsn;
+  int msMtNext;            // next of the -t files to deliver.
+
+  bool msRunning;
+  int msRun;
+  double msRunStart;       // wall time the run started.
+  uint64_t msRandom;
+  double msSessionSeconds; // emulated seconds in sessions this run.
+  int msAttempts;
+  int msSent;
+  int msFailed;
+  long msMoBytes;
+  long msMtBytes;
+} modemState;
+
+static linkModel model;
+static FILE* logFd;
+static bool verbose;
+static volatile sig_atomic_t stopRequested;
+
+static void stopHandler(int sig) {
+  (void)sig;
+  stopRequested = 1;
+}
+
+static double nowSeconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec + (ts.tv_nsec / 1e9));
+}
+
+// Emulated seconds since the modem was powered up.
+static double runClock(modemState* msPtr) {
+  return ((nowSeconds() - msPtr->msRunStart) * model.lmSpeed);
+}
+
+// Waits for an emulated number of seconds.
+static void modelDelay(double seconds) {
+  struct timespec ts;
+  double wall;
+
+  wall = seconds / model.lmSpeed;
+  ts.tv_sec = (time_t)wall;
+  ts.tv_nsec = (long)((wall - ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+
+// xorshift64*, so each run's draws are the same on every machine.
+static double randomUnit(modemState* msPtr) {
+  msPtr->msRandom ^= msPtr->msRandom >> 12;
+  msPtr->msRandom ^= msPtr->msRandom << 25;
+  msPtr->msRandom ^= msPtr->msRandom >> 27;
+  return ((double)((msPtr->msRandom * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0);
+}
+
+static void modemWrite(modemState* msPtr, const void* data, int length) {
+  const uint8_t* ptr;
+  int rc;
+
+  ptr = data;
+
+  while (length > 0) {
+    if ((rc = write(msPtr->msOutFd, ptr, length)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return;
+    }
+
+    ptr += rc;
+    length -= rc;
+  }
+}
+
+static void modemPrint(modemState* msPtr, const char* text) {
+  modemWrite(msPtr, text, strlen(text));
+}
+
+// Reads what has arrived into the input buffer, waiting at most ms
+// milliseconds.  returns the read result, or -2 if nothing arrived.
+static int modemFill(modemState* msPtr, int ms) {
+  struct pollfd pfd;
+  int rc;
+
+  pfd.fd = msPtr->msInFd;
+  pfd.events = POLLIN;
+
+  if (poll(&pfd, 1, ms) <= 0) {
+    return (-2);
+  }
+
+  if ((rc = read(msPtr->msInFd, msPtr->msIn, sizeof(msPtr->msIn))) > 0) {
+    msPtr->msInLength = rc;
+    msPtr->msInNext = 0;
+  }
+
+  return (rc);
+}
+
+// Reads one byte, waiting at most timeout seconds.  returns -1 if none came.
+static int modemReadByte(modemState* msPtr, double timeout) {
+  double end;
+  int ms;
+  int rc;
+
+  end = nowSeconds() + timeout;
+
+  while ((msPtr->msInNext >= msPtr->msInLength) && !stopRequested) {
+    ms = (int)((end - nowSeconds()) * 1000.0);
+
+    if ((ms < 0) || (((rc = modemFill(msPtr, ms)) != -2) && (rc <= 0))) {
+      return (-1);
+    }
+  }
+
+  if (msPtr->msInNext >= msPtr->msInLength) {
+    return (-1);
+  }
+
+  return (msPtr->msIn[msPtr->msInNext++]);
+}
+
+//*****************************************************************************
+//
+// signalQuality
+//
+// returns the signal quality the link model gives at an emulated time
+// since power up.
+//
+//*****************************************************************************
+
+static int signalQuality(double seconds) {
+  int quality;
+  int i;
+
+  if (seconds < model.lmRegistration) {
+    return (0);
+  }
+
+  if (model.lmTraceCount == 0) {
+    return (model.lmQuality);
+  }
+
+  quality = 0;
+
+  for (i = 0; (i < model.lmTraceCount) && (model.lmTrace[i].teSeconds <= seconds); ++i) {
+    quality = model.lmTrace[i].teQuality;
+  }
+
+  return (quality);
+}
+
+static void runStart(modemState* msPtr) {
+  msPtr->msRunning = true;
+  ++msPtr->msRun;
+  msPtr->msRunStart = nowSeconds();
+  msPtr->msRandom = (model.lmSeed + msPtr->msRun) * 0x9E3779B97F4A7C15ULL;
+
+  if (msPtr->msRandom == 0) {
+    msPtr->msRandom = 1;
+  }
+
+  msPtr->msSessionSeconds = 0.0;
+  msPtr->msAttempts = msPtr->msSent = msPtr->msFailed = 0;
+  msPtr->msMoBytes = msPtr->msMtBytes = 0;
+  msPtr->msEcho = true;
+  msPtr->msMoLength = 0;
+}
+
+//*****************************************************************************
+//
+// runEnd
+//
+// Logs the run that has just finished.
+//
+//*****************************************************************************
+
+static void runEnd(modemState* msPtr, const char* how) {
+  double powered;
+  double joules;
+
+  if (!msPtr->msRunning) {
+    return;
+  }
+
+  powered = runClock(msPtr);
+
+  if (powered < msPtr->msSessionSeconds) {
+    powered = msPtr->msSessionSeconds;
+  }
+
+  joules = SUPPLY_VOLTS * ((IDLE_AMPS * (powered - msPtr->msSessionSeconds)) +
+                           (SESSION_AMPS * msPtr->msSessionSeconds));
+  fprintf(logFd, "%d,%s,%.2f,%.2f,%d,%d,%d,%ld,%ld,%.3f\n", msPtr->msRun, how, powered,
+          msPtr->msSessionSeconds, msPtr->msAttempts, msPtr->msSent, msPtr->msFailed, msPtr->msMoBytes,
+          msPtr->msMtBytes, joules);
+  fflush(logFd);
+  msPtr->msRunning = false;
+}
+
+static void loadMt(modemState* msPtr) {
+  FILE* fd;
+
+  msPtr->msMtLength = 0;
+
+  if ((fd = fopen(model.lmMtFiles[msPtr->msMtNext], "rb")) == NULL) {
+    fprintf(stderr, "sbdemu: Unable to open MT file %s!\n", model.lmMtFiles[msPtr->msMtNext]);
+  } else {
+    msPtr->msMtLength = fread(msPtr->msMt, 1, SBD_MT_SIZE, fd);
+    fclose(fd);
+  }
+
+  ++msPtr->msMtNext;
+}
+
+//*****************************************************************************
+//
+// doSession
+//
+// AT+SBDIX: runs an SBD session through the link model.
+//
+//*****************************************************************************
+
+static void doSession(modemState* msPtr) {
+  char buff[128];
+  double seconds;
+  int moStatus;
+  int mtStatus;
+  int quality;
+
+  quality = signalQuality(runClock(msPtr));
+
+  if (quality == 0) {
+    moStatus = MO_NO_SERVICE;
+  } else if (randomUnit(msPtr) * 100.0 < model.lmFailPercent) {
+    moStatus = MO_RF_DROP;
+  } else {
+    moStatus = MO_SENT;
+  }
+
+  seconds = (moStatus == MO_SENT) ? model.lmSessionSeconds : model.lmFailSeconds;
+  modelDelay(seconds);
+  msPtr->msSessionSeconds += seconds;
+  ++msPtr->msAttempts;
+  mtStatus = 0;
+
+  if (moStatus == MO_SENT) {
+    ++msPtr->msMomsn;
+
+    if (msPtr->msMoLength != 0) {
+      ++msPtr->msSent;
+      msPtr->msMoBytes += msPtr->msMoLength;
+    }
+
+    if (msPtr->msMtNext < model.lmMtCount) {
+      loadMt(msPtr);
+      ++msPtr->msMtmsn;
+      msPtr->msMtBytes += msPtr->msMtLength;
+      mtStatus = 1;
+    }
+  } else {
+    ++msPtr->msFailed;
+    mtStatus = 2;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "sbdemu: run %d session %d at %.1fs quality %d status %d\n", msPtr->msRun,
+            msPtr->msAttempts, runClock(msPtr), quality, moStatus);
+  }
+
+  snprintf(buff, sizeof(buff), "+SBDIX: %d, %d, %d, %d, %d, %d\r\n\r\nOK\r\n", moStatus, msPtr->msMomsn, mtStatus,
+           msPtr->msMtmsn, (mtStatus == 1) ? msPtr->msMtLength : 0, model.lmMtCount - msPtr->msMtNext);
+  modemPrint(msPtr, buff);
+}
+
+//*****************************************************************************
+//
+// doWriteBinary
+//
+// AT+SBDWB=<length>: takes the MO message and its checksum.
+//
+//*****************************************************************************
+
+static void doWriteBinary(modemState* msPtr, int length) {
+  uint8_t data[SBD_MO_SIZE + 2];
+  uint16_t sum;
+  int chr;
+  int i;
+
+  if ((length < 1) || (length > SBD_MO_SIZE)) {
+    modemPrint(msPtr, "3\r\n\r\nOK\r\n");
+    return;
+  }
+
+  modemPrint(msPtr, "READY\r\n");
+  sum = 0;
+
+  for (i = 0; i < length + 2; ++i) {
+    if ((chr = modemReadByte(msPtr, BINARY_TIMEOUT / model.lmSpeed)) < 0) {
+      modemPrint(msPtr, "1\r\n\r\nOK\r\n");
+      return;
+    }
+
+    data[i] = chr;
+
+    if (i < length) {
+      sum += chr;
+    }
+  }
+
+  if ((data[length] != (sum >> 8)) || (data[length + 1] != (sum & 0xFF))) {
+    modemPrint(msPtr, "2\r\n\r\nOK\r\n");
+    return;
+  }
+
+  memcpy(msPtr->msMo, data, length);
+  msPtr->msMoLength = length;
+  modemPrint(msPtr, "0\r\n\r\nOK\r\n");
+}
+
+// AT+SBDRB: sends the MT message with its length and checksum.
+static void doReadBinary(modemState* msPtr) {
+  uint8_t header[2];
+  uint8_t trailer[2];
+  uint16_t sum;
+  int i;
+
+  sum = 0;
+
+  for (i = 0; i < msPtr->msMtLength; ++i) {
+    sum += msPtr->msMt[i];
+  }
+
+  header[0] = msPtr->msMtLength >> 8;
+  header[1] = msPtr->msMtLength & 0xFF;
+  trailer[0] = sum >> 8;
+  trailer[1] = sum & 0xFF;
+  modemWrite(msPtr, header, 2);
+  modemWrite(msPtr, msPtr->msMt, msPtr->msMtLength);
+  modemWrite(msPtr, trailer, 2);
+  modemPrint(msPtr, "\r\nOK\r\n");
+}
+
+//*****************************************************************************
+//
+// doCommand
+//
+// Answers one AT command line.
+//
+//*****************************************************************************
+
+static void doCommand(modemState* msPtr, char* cmd) {
+  char buff[SBD_MT_SIZE + 64];
+  double seconds;
+  int quality;
+
+  if (verbose) {
+    fprintf(stderr, "sbdemu: run %d at %.1fs: %s\n", msPtr->msRun, runClock(msPtr), cmd);
+  }
+
+  if (strncasecmp(cmd, "AT", 2) != 0) {
+    return;
+  }
+
+  cmd += 2;
+
+  if ((*cmd == 0) || (strcmp(cmd, "&D0") == 0) || (strcmp(cmd, "&K0") == 0) ||
+      (strncasecmp(cmd, "+SBDMTA", 7) == 0) || (strncasecmp(cmd, "+SBDAREG", 8) == 0) ||
+      (strncasecmp(cmd, "+CIER", 5) == 0)) {
+    modemPrint(msPtr, "OK\r\n");
+  } else if ((strcasecmp(cmd, "E0") == 0) || (strcasecmp(cmd, "E1") == 0)) {
+    msPtr->msEcho = (cmd[1] == '1');
+    modemPrint(msPtr, "OK\r\n");
+  } else if ((strcasecmp(cmd, "+CSQ") == 0) || (strcasecmp(cmd, "+CSQF") == 0)) {
+    // A full CSQ takes the modem a few seconds to measure.
+    if (cmd[4] == 0) {
+      modelDelay(2.0);
+    }
+
+    quality = signalQuality(runClock(msPtr));
+    snprintf(buff, sizeof(buff), "+CSQ%s:%d\r\n\r\nOK\r\n", (cmd[4] == 0) ? "" : "F", quality);
+    modemPrint(msPtr, buff);
+  } else if (strcasecmp(cmd, "+CGMM") == 0) {
+    modemPrint(msPtr, "IRIDIUM 9600 Family SBD Transceiver\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "+CGMR") == 0) {
+    modemPrint(msPtr, "Call Processor Version: TA16005\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "+CGSN") == 0) {
+    modemPrint(msPtr, DEFAULT_IMEI "\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "-MSSTM") == 0) {
+    if (runClock(msPtr) < model.lmRegistration) {
+      modemPrint(msPtr, "-MSSTM: no network service\r\n\r\nOK\r\n");
+    } else {
+      seconds = (double)time(NULL) - IRIDIUM_EPOCH;
+      snprintf(buff, sizeof(buff), "-MSSTM: %08lx\r\n\r\nOK\r\n", (unsigned long)(seconds * 1000.0 / 90.0));
+      modemPrint(msPtr, buff);
+    }
+  } else if (strncasecmp(cmd, "+SBDWB=", 7) == 0) {
+    doWriteBinary(msPtr, atoi(cmd + 7));
+  } else if (strncasecmp(cmd, "+SBDWT=", 7) == 0) {
+    msPtr->msMoLength = strlen(cmd + 7);
+
+    if (msPtr->msMoLength > SBD_MO_SIZE) {
+      msPtr->msMoLength = SBD_MO_SIZE;
+    }
+
+    memcpy(msPtr->msMo, cmd + 7, msPtr->msMoLength);
+    modemPrint(msPtr, "OK\r\n");
+  } else if ((strcasecmp(cmd, "+SBDIX") == 0) || (strcasecmp(cmd, "+SBDIXA") == 0)) {
+    doSession(msPtr);
+  } else if (strcasecmp(cmd, "+SBDRB") == 0) {
+    doReadBinary(msPtr);
+  } else if (strcasecmp(cmd, "+SBDRT") == 0) {
+    snprintf(buff, sizeof(buff), "+SBDRT:\r\n%.*s\r\nOK\r\n", msPtr->msMtLength, (char*)msPtr->msMt);
+    modemPrint(msPtr, buff);
+  } else if (strncasecmp(cmd, "+SBDD", 5) == 0) {
+    if ((cmd[5] == '0') || (cmd[5] == '2')) {
+      msPtr->msMoLength = 0;
+    }
+
+    if ((cmd[5] == '1') || (cmd[5] == '2')) {
+      msPtr->msMtLength = 0;
+    }
+
+    modemPrint(msPtr, "\r\n0\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "+SBDC") == 0) {
+    msPtr->msMomsn = 0;
+    modemPrint(msPtr, "\r\n0\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "+SBDSX") == 0) {
+    snprintf(buff, sizeof(buff), "+SBDSX: %d, %d, %d, %d, 0, %d\r\n\r\nOK\r\n", (msPtr->msMoLength != 0),
+             msPtr->msMomsn, (msPtr->msMtLength != 0), msPtr->msMtmsn, model.lmMtCount - msPtr->msMtNext);
+    modemPrint(msPtr, buff);
+  } else if (strcasecmp(cmd, "+CRIS") == 0) {
+    modemPrint(msPtr, "+CRIS:000,000\r\n\r\nOK\r\n");
+  } else if (strcasecmp(cmd, "*F") == 0) {
+    modemPrint(msPtr, "OK\r\n");
+    runEnd(msPtr, "sleep");
+  } else {
+    if (verbose) {
+      fprintf(stderr, "sbdemu: Unknown command AT%s\n", cmd);
+    }
+
+    modemPrint(msPtr, "ERROR\r\n");
+  }
+}
+
+//*****************************************************************************
+//
+// modemInput
+//
+// Collects command characters into a line and answers the line when its
+// carriage return arrives.
+//
+//*****************************************************************************
+
+static void modemInput(modemState* msPtr, uint8_t chr) {
+  if (!msPtr->msRunning) {
+    runStart(msPtr);
+  }
+
+  if (msPtr->msEcho) {
+    modemWrite(msPtr, &chr, 1);
+  }
+
+  if (chr == '\r') {
+    msPtr->msCommand[msPtr->msCommandLength] = 0;
+    msPtr->msCommandLength = 0;
+    doCommand(msPtr, msPtr->msCommand);
+  } else if ((chr != '\n') && (msPtr->msCommandLength < COMMAND_SIZE - 1)) {
+    msPtr->msCommand[msPtr->msCommandLength++] = chr;
+  }
+}
+
+static int readTrace(char* fileName) {
+  char line[NAME_SIZE];
+  FILE* fd;
+
+  if ((fd = fopen(fileName, "r")) == NULL) {
+    fprintf(stderr, "Error: Unable to open trace file %s!\n", fileName);
+    return (1);
+  }
+
+  while ((fgets(line, sizeof(line), fd) != NULL) && (model.lmTraceCount < MAX_TRACE)) {
+    if (sscanf(line, "%lf %d", &model.lmTrace[model.lmTraceCount].teSeconds,
+               &model.lmTrace[model.lmTraceCount].teQuality) == 2) {
+      ++model.lmTraceCount;
+    }
+  }
+
+  fclose(fd);
+  return (0);
+}
+
+//*****************************************************************************
+//
+// openPort
+//
+// Opens the pty, serial device or standard streams the modem talks through.
+//
+// returns 0 for good completion and non-zero if an error is detected.
+//
+//*****************************************************************************
+
+static int openPort(char* device, char* linkName, modemState* msPtr) {
+  struct termios tio;
+  char* slaveName;
+  int fd;
+
+  if ((device != NULL) && (strcmp(device, "-") == 0)) {
+    msPtr->msInFd = STDIN_FILENO;
+    msPtr->msOutFd = STDOUT_FILENO;
+    return (0);
+  }
+
+  if (device != NULL) {
+    if ((fd = open(device, O_RDWR | O_NOCTTY)) < 0) {
+      fprintf(stderr, "Error: Unable to open %s!\n", device);
+      return (1);
+    }
+
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B19200);
+    cfsetospeed(&tio, B19200);
+    tcsetattr(fd, TCSANOW, &tio);
+    msPtr->msInFd = msPtr->msOutFd = fd;
+    return (0);
+  }
+
+  if (((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0) ||
+      ((slaveName = ptsname(fd)) == NULL)) {
+    fprintf(stderr, "Error: Unable to create a pty!\n");
+    return (1);
+  }
+
+  tcgetattr(fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(fd, TCSANOW, &tio);
+
+  if (linkName != NULL) {
+    unlink(linkName);
+
+    if (symlink(slaveName, linkName) != 0) {
+      fprintf(stderr, "Error: Unable to link %s to %s!\n", linkName, slaveName);
+      return (1);
+    }
+  }
+
+  fprintf(stderr, "sbdemu: RockBLOCK on %s\n", (linkName != NULL) ? linkName : slaveName);
+  msPtr->msInFd = msPtr->msOutFd = fd;
+  return (0);
+}
+
+static void usage(void) {
+  printf("sbdemu [-d <device> | -] [-L <link>] [-l <log>] [-r <seconds>]\n");
+  printf("       [-q <quality> | -T <trace file>] [-p <fail percent>]\n");
+  printf("       [-s <seconds>] [-f <seconds>] [-t <MT file>]... [-S <seed>]\n");
+  printf("       [-x <factor>] [-v]\n");
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  struct sigaction sa;
+  modemState state;
+  char* device;
+  char* linkName;
+  char* logName;
+  int argIx;
+  int opt;
+  int rc;
+
+  memset(&model, 0, sizeof(model));
+  model.lmRegistration = 15.0;
+  model.lmQuality = 4;
+  model.lmFailPercent = 10.0;
+  model.lmSessionSeconds = 12.0;
+  model.lmFailSeconds = 25.0;
+  model.lmSeed = 1;
+  model.lmSpeed = 1.0;
+  device = linkName = logName = NULL;
+  verbose = false;
+
+  for (argIx = 1; argIx < argc; ++argIx) {
+    if ((argv[argIx][0] != '-') || (argv[argIx][1] == 0) || (argv[argIx][2] != 0)) {
+      usage();
+    }
+
+    if (argv[argIx][1] == 'v') {
+      verbose = true;
+      continue;
+    }
+
+    if (argIx + 1 >= argc) {
+      usage();
+    }
+
+    opt = argv[argIx++][1];
+
+    switch (opt) {
+      case 'd':
+        device = argv[argIx];
+        break;
+
+      case 'L':
+        linkName = argv[argIx];
+        break;
+
+      case 'l':
+        logName = argv[argIx];
+        break;
+
+      case 'r':
+        model.lmRegistration = atof(argv[argIx]);
+        break;
+
+      case 'q':
+        model.lmQuality = atoi(argv[argIx]);
+        break;
+
+      case 'T':
+        if (readTrace(argv[argIx]) != 0) {
+          exit(1);
+        }
+
+        break;
+
+      case 'p':
+        model.lmFailPercent = atof(argv[argIx]);
+        break;
+
+      case 's':
+        model.lmSessionSeconds = atof(argv[argIx]);
+        break;
+
+      case 'f':
+        model.lmFailSeconds = atof(argv[argIx]);
+        break;
+
+      case 't':
+        if (model.lmMtCount < MAX_MT_FILES) {
+          model.lmMtFiles[model.lmMtCount++] = argv[argIx];
+        }
+
+        break;
+
+      case 'S':
+        model.lmSeed = strtoull(argv[argIx], NULL, 10);
+        break;
+
+      case 'x':
+        model.lmSpeed = atof(argv[argIx]);
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if ((model.lmSpeed <= 0.0) || (model.lmQuality < 0) || (model.lmQuality > 5)) {
+    usage();
+  }
+
+  logFd = stderr;
+
+  if (logName != NULL) {
+    if ((logFd = fopen(logName, "a")) == NULL) {
+      fprintf(stderr, "Error: Unable to open log %s!\n", logName);
+      exit(1);
+    }
+
+    if (ftell(logFd) == 0) {
+      fprintf(logFd, "run,end,poweredsec,sessionsec,attempts,sent,failed,mobytes,mtbytes,energyj\n");
+    }
+  }
+
+  memset(&state, 0, sizeof(state));
+
+  if (openPort(device, linkName, &state) != 0) {
+    exit(1);
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stopHandler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  while (!stopRequested) {
+    if ((rc = modemFill(&state, 100)) == -2) {
+      continue;
+    }
+
+    // A pty reads EIO while nothing has its slave open, and a stream reads
+    // 0 at its end.  Either ends the run.
+    if (rc <= 0) {
+      if ((rc < 0) && (errno == EINTR)) {
+        continue;
+      }
+
+      runEnd(&state, "closed");
+
+      if ((rc == 0) || (device != NULL)) {
+        break;
+      }
+
+      usleep(100000);
+      continue;
+    }
+
+    while (state.msInNext < state.msInLength) {
+      modemInput(&state, state.msIn[state.msInNext++]);
+    }
+  }
+
+  runEnd(&state, "stopped");
+
+  if (linkName != NULL) {
+    unlink(linkName);
+  }
+
+  return (0);
+}